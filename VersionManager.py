@@ -52,7 +52,7 @@ GREGORIO_FILES = ["configure.ac",
                   "tex/gregoriotex.tex",
                   "tex/gregoriotex-chars.tex",
                   "tex/gregoriotex-signs.tex",
-                  "tex/gregoriotex-signs.lua",
+                  "tex/gregoriotex-offset-cases.tex",
                   "tex/gregoriotex-spaces.tex",
                   "tex/gregoriotex-symbols.tex",
                   "tex/gregoriotex-symbols.lua",
@@ -84,7 +84,6 @@ COPYRIGHT_FILES = ["install-gtex.sh",
                    "tex/gregoriosyms.sty",
                    "tex/gregoriotex-nabc.tex",
                    "tex/gregoriotex.tex",
-                   "tex/gregoriotex-signs.lua",
                    "tex/gregoriotex-symbols.tex",
                    "contrib/TeXShop/Makefile.am",
                    "contrib/vim/Makefile.am",
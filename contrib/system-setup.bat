@@ -94,6 +94,7 @@ gregoriotex-chars.tex ^
 gregoriotex-main.tex ^
 gregoriotex-nabc.tex ^
 gregoriotex-signs.tex ^
+gregoriotex-offset-cases.tex ^
 gregoriotex-spaces.tex ^
 gregoriotex-syllable.tex ^
 gregoriotex-common.tex ^
@@ -117,7 +118,6 @@ for %%G in (%files%) do (
 
 :: Files using GREGORIO_VERSION in spaces
 set files=gregoriotex-nabc.lua ^
-gregoriotex-signs.lua ^
 gregoriotex-symbols.lua
 
 for %%G in (%files%) do (
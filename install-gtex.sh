@@ -75,7 +75,7 @@ FILEVERSION=`echo $VERSION | sed 's/\./_/g'`
 
 TEXFILES=(tex/gregoriotex*.tex tex/gregoriotex*.lua
           tex/*.dat)
-LATEXFILES=(tex/gregorio*.sty)
+LATEXFILES=(tex/gregorio*.sty tex/gregoriotex.ini)
 TTFFILES=(fonts/*.ttf)
 DOCFILES=(doc/*.tex doc/*.lua doc/*.gabc doc/*.pdf doc/doc_README.md)
 EXAMPLEFILES=(examples/FactusEst.gabc examples/PopulusSion.gabc
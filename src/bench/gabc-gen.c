@@ -0,0 +1,328 @@
+/*
+ * Gregorio is a program that translates gabc files to GregorioTeX
+ * This program generates synthetic gabc scores for benchmarking.
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * Gregorio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Gregorio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gregorio.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The output only depends on the options (the pseudo-random generator is
+ * our own), so that a given command line produces the same corpus on every
+ * platform.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bool.h"
+
+static const char *const syllables[] = {
+    "Al", "le", "lu", "ia", "Glo", "ri", "a", "in", "ex", "cel", "sis", "De",
+    "o", "et", "ter", "ra", "pax", "ho", "mi", "ni", "bus", "bo", "nae",
+    "vo", "lun", "ta", "tis", "Lau", "da", "mus", "te", "be", "ne", "di",
+    "ci", "Sanc", "tus", "Do", "mi", "nus", "Ky", "ri", "e", "e", "lé",
+    "i", "son", "Chri", "ste", "æ", "ter", "na", "Pá", "tris",
+};
+#define NUMBER_OF_SYLLABLES (sizeof syllables / sizeof *syllables)
+
+static const char *const languages[] = {
+    "Latin", "English", "German", "Polish", "Hungarian", "Czech",
+};
+#define NUMBER_OF_LANGUAGES (sizeof languages / sizeof *languages)
+
+static const char *const nabc_glyphs[] = {
+    "vi", "pu", "ta", "gr", "cl", "pe", "po", "to", "ci", "sc", "pf", "sf",
+    "tr", "st", "ds", "pr", "sa", "pq", "qi", "pt", "vs", "or", "un",
+};
+#define NUMBER_OF_NABC_GLYPHS (sizeof nabc_glyphs / sizeof *nabc_glyphs)
+
+typedef struct generator_options {
+    unsigned long syllables;
+    unsigned int melisma;
+    unsigned int episemata;
+    unsigned int texverbs;
+    unsigned int languages;
+    unsigned int headers;
+    bool nabc;
+} generator_options;
+
+/* xorshift32; the state must never be zero */
+static unsigned long random_state = 2463534242UL;
+
+static unsigned long next_random(void)
+{
+    random_state ^= (random_state << 13) & 0xFFFFFFFFUL;
+    random_state ^= random_state >> 17;
+    random_state ^= (random_state << 5) & 0xFFFFFFFFUL;
+    return random_state;
+}
+
+static __inline unsigned long random_below(const unsigned long bound)
+{
+    return next_random() % bound;
+}
+
+static __inline bool percent_chance(const unsigned int percent)
+{
+    return random_below(100) < percent;
+}
+
+static void write_headers(FILE *const f, const generator_options *const opt)
+{
+    unsigned int i;
+
+    fprintf(f, "name: Synthetic benchmark score;\n");
+    fprintf(f, "annotation: Ant.;\n");
+    fprintf(f, "annotation: VIII G;\n");
+    fprintf(f, "mode: 8;\n");
+    fprintf(f, "mode-modifier: G;\n");
+    fprintf(f, "mode-differentia: g;\n");
+    fprintf(f, "author: gabc-gen;\n");
+    fprintf(f, "staff-lines: 4;\n");
+    fprintf(f, "oriscus-orientation: dependent;\n");
+    fprintf(f, "def-m0: \\relax;\n");
+    fprintf(f, "def-m1: \\relax;\n");
+    for (i = 0; i < opt->headers; ++i) {
+        fprintf(f, "voice-%u-header: value %u;\n", i % 4, i);
+    }
+    /* each language header reloads the vowel tables */
+    for (i = 0; i < opt->languages; ++i) {
+        fprintf(f, "language: %s;\n", languages[i % NUMBER_OF_LANGUAGES]);
+    }
+    if (opt->nabc) {
+        fprintf(f, "nabc-lines: 1;\n");
+    }
+    fprintf(f, "%%%%\n");
+}
+
+static char next_pitch(const char pitch)
+{
+    /* a bounded random walk between c and l, favouring small steps */
+    static const int steps[] = { -2, -1, -1, 0, 1, 1, 2 };
+    int result = pitch + steps[random_below(sizeof steps / sizeof *steps)];
+    if (result < 'c') {
+        result = 'd';
+    } else if (result > 'l') {
+        result = 'k';
+    }
+    return (char)result;
+}
+
+static char write_note(FILE *const f, const generator_options *const opt,
+        char pitch)
+{
+    pitch = next_pitch(pitch);
+    fputc(pitch, f);
+    switch (random_below(16)) {
+    case 0:
+        fputc('v', f);
+        break;
+    case 1:
+        fputc('w', f);
+        break;
+    case 2:
+        fputc('o', f);
+        break;
+    case 3:
+        fputc('~', f);
+        break;
+    case 4:
+        fputc('.', f);
+        break;
+    default:
+        break;
+    }
+    if (percent_chance(opt->episemata)) {
+        fputc('_', f);
+    }
+    if (percent_chance(opt->episemata)) {
+        fputc('\'', f);
+    }
+    if (percent_chance(opt->texverbs)) {
+        fprintf(f, "[nv:\\relax]");
+    }
+    return pitch;
+}
+
+static char write_notes(FILE *const f, const generator_options *const opt,
+        char pitch)
+{
+    unsigned long notes = 1 + random_below(opt->melisma);
+    unsigned long i;
+
+    fputc('(', f);
+    for (i = 0; i < notes; ++i) {
+        if (i && random_below(4) == 0) {
+            fputc(random_below(2) ? '/' : '!', f);
+        }
+        pitch = write_note(f, opt, pitch);
+    }
+    if (opt->nabc) {
+        fprintf(f, "|%s", nabc_glyphs[random_below(NUMBER_OF_NABC_GLYPHS)]);
+    }
+    fputc(')', f);
+    return pitch;
+}
+
+static void write_score(FILE *const f, const generator_options *const opt)
+{
+    static const char *const bars[] = { "(,)", "(;)", "(:)" };
+    unsigned long i;
+    char pitch = 'g';
+
+    write_headers(f, opt);
+    fprintf(f, "(c4) ");
+    for (i = 0; i < opt->syllables; ++i) {
+        if (percent_chance(opt->texverbs)) {
+            fprintf(f, "<v>\\relax</v>");
+        }
+        fputs(syllables[random_below(NUMBER_OF_SYLLABLES)], f);
+        pitch = write_notes(f, opt, pitch);
+        if (random_below(3) == 0) {
+            /* end of word */
+            fputc(' ', f);
+            if (random_below(6) == 0) {
+                fprintf(f, "%s ", bars[random_below(3)]);
+            }
+            if (random_below(40) == 0) {
+                fprintf(f, "(z)\n");
+            }
+        }
+    }
+    fprintf(f, " (::)\n");
+}
+
+static void print_usage(const char *const name)
+{
+    printf("Usage: %s [OPTION]...\n\
+\nGenerate a synthetic gabc score for benchmarking.\n\n\
+Options:\n\
+  -o FILE    write the score to FILE (default: stdout)\n\
+  -n NUMBER  number of syllables (default: 1000)\n\
+  -m NUMBER  maximum number of notes per syllable (default: 4)\n\
+  -e PERCENT chance of each kind of episema on a note (default: 5)\n", name);
+    printf("\
+  -t PERCENT chance of a texverb on a syllable or a note (default: 2)\n\
+  -l NUMBER  number of language headers (default: 1)\n\
+  -H NUMBER  number of extra headers (default: 0)\n\
+  -a         add a line of nabc\n\
+  -s SEED    seed of the pseudo-random generator (default: 1)\n\
+  -h         print this help message\n");
+}
+
+static unsigned long parse_number(const char *const name, const char option,
+        const char *const arg)
+{
+    char *end;
+    unsigned long value = strtoul(arg, &end, 10);
+    if (!*arg || *end) {
+        fprintf(stderr, "%s: invalid number for -%c: %s\n", name, option,
+                arg);
+        exit(1);
+    }
+    return value;
+}
+
+int main(int argc, char **argv)
+{
+    generator_options opt;
+    const char *output_file_name = NULL;
+    FILE *f;
+    unsigned long seed = 1;
+    int c, i;
+
+    opt.syllables = 1000;
+    opt.melisma = 4;
+    opt.episemata = 5;
+    opt.texverbs = 2;
+    opt.languages = 1;
+    opt.headers = 0;
+    opt.nabc = false;
+
+    while ((c = getopt(argc, argv, "o:n:m:e:t:l:H:as:h")) != -1) {
+        switch (c) {
+        case 'o':
+            output_file_name = optarg;
+            break;
+        case 'n':
+            opt.syllables = parse_number(argv[0], (char)c, optarg);
+            break;
+        case 'm':
+            opt.melisma = (unsigned int)parse_number(argv[0], (char)c, optarg);
+            if (!opt.melisma) {
+                opt.melisma = 1;
+            }
+            break;
+        case 'e':
+            opt.episemata = (unsigned int)parse_number(argv[0], (char)c,
+                    optarg);
+            break;
+        case 't':
+            opt.texverbs = (unsigned int)parse_number(argv[0], (char)c,
+                    optarg);
+            break;
+        case 'l':
+            opt.languages = (unsigned int)parse_number(argv[0], (char)c,
+                    optarg);
+            break;
+        case 'H':
+            opt.headers = (unsigned int)parse_number(argv[0], (char)c,
+                    optarg);
+            break;
+        case 'a':
+            opt.nabc = true;
+            break;
+        case 's':
+            seed = parse_number(argv[0], (char)c, optarg);
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    /* mix the seed in, keeping the state non-zero */
+    random_state ^= seed & 0xFFFFFFFFUL;
+    if (!random_state) {
+        random_state = 2463534242UL;
+    }
+    for (i = 0; i < 16; ++i) {
+        next_random();
+    }
+
+    if (output_file_name) {
+        f = fopen(output_file_name, "w");
+        if (!f) {
+            fprintf(stderr, "%s: can't open file %s for writing\n", argv[0],
+                    output_file_name);
+            return 1;
+        }
+    } else {
+        f = stdout;
+    }
+    write_score(f, &opt);
+    if (f != stdout) {
+        fclose(f);
+    }
+    return 0;
+}
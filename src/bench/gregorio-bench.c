@@ -0,0 +1,321 @@
+/*
+ * Gregorio is a program that translates gabc files to GregorioTeX
+ * This program times the reading and writing phases over a set of scores.
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * Gregorio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Gregorio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gregorio.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "bool.h"
+#include "struct.h"
+#include "plugins.h"
+#include "messages.h"
+#include "support.h"
+#include "stats.h"
+#include "gabc/gabc.h"
+#include "vowel/vowel.h"
+
+#ifdef _WIN32
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+typedef enum bench_phase {
+    BENCH_READ = 0,
+    BENCH_GTEX,
+    BENCH_GABC,
+    BENCH_DUMP,
+    BENCH_NUMBER_OF_PHASES
+} bench_phase;
+
+static const char *const phase_names[BENCH_NUMBER_OF_PHASES] = {
+    "gabc_read_score",
+    "gregoriotex_write_score",
+    "gabc_write_score",
+    "dump_write_score",
+};
+
+typedef struct bench_file {
+    const char *name;
+    gregorio_score_counts counts;
+    /* times[phase * runs + run], in seconds */
+    double *times;
+    /* whether a run failed, leaving the file out of the report */
+    bool failed;
+} bench_file;
+
+static void free_lexers(void)
+{
+    gregorio_vowel_tables_free();
+    gabc_score_determination_lex_destroy();
+    gabc_notes_determination_lex_destroy();
+    gregorio_vowel_rulefile_lex_destroy();
+}
+
+/* runs every phase once on the given file, storing the times in times, and
+ * returns false, leaving times unset, if the file can't be read or has
+ * errors */
+static bool run_file(bench_file *const file, FILE *const sink,
+        const gregorio_digest_algorithm algorithm, double *const times)
+{
+    gregorio_score *score;
+    double start;
+    FILE *f;
+
+    f = fopen(file->name, "r");
+    if (!f) {
+        fprintf(stderr, "error: can't open file %s for reading\n",
+                file->name);
+        return false;
+    }
+    gregorio_reset_return_value();
+    start = gregorio_stats_clock();
+    score = gabc_read_score(f, false, algorithm);
+    times[BENCH_READ] = gregorio_stats_clock() - start;
+    fclose(f);
+    if (!score || gregorio_get_return_value()) {
+        if (score) {
+            gregorio_free_score(score);
+        }
+        free_lexers();
+        gregorio_struct_reset();
+        return false;
+    }
+
+    start = gregorio_stats_clock();
+    gregoriotex_write_score(sink, score, NULL);
+    fflush(sink);
+    times[BENCH_GTEX] = gregorio_stats_clock() - start;
+
+    start = gregorio_stats_clock();
+    gabc_write_score(sink, score);
+    fflush(sink);
+    times[BENCH_GABC] = gregorio_stats_clock() - start;
+
+    start = gregorio_stats_clock();
+    dump_write_score(sink, score);
+    fflush(sink);
+    times[BENCH_DUMP] = gregorio_stats_clock() - start;
+
+    gregorio_stats_count_score(score, &file->counts);
+    gregorio_free_score(score);
+    /* the next file is read as by a new process */
+    free_lexers();
+    gregorio_struct_reset();
+    return true;
+}
+
+/* computes the mean and the sample standard deviation of the given times,
+ * or, if count is positive, of the rates count / times[i] */
+static void statistics(const double *const times, const int runs,
+        const double count, double *const mean, double *const deviation)
+{
+    double sum = 0.0, squares = 0.0, value;
+    int i;
+
+    for (i = 0; i < runs; ++i) {
+        if (count > 0.0) {
+            value = times[i] > 0.0 ? count / times[i] : 0.0;
+        } else {
+            value = times[i];
+        }
+        sum += value;
+        squares += value * value;
+    }
+    *mean = sum / runs;
+    *deviation = 0.0;
+    if (runs > 1) {
+        value = (squares - sum * sum / runs) / (runs - 1);
+        if (value > 0.0) {
+            *deviation = sqrt(value);
+        }
+    }
+}
+
+static void print_row(const char *const name, const char *const phase,
+        const double *const times, const int runs,
+        const gregorio_score_counts *const counts)
+{
+    double time, time_sd, syllables, syllables_sd, notes, notes_sd;
+
+    statistics(times, runs, 0.0, &time, &time_sd);
+    statistics(times, runs, counts->syllables, &syllables, &syllables_sd);
+    statistics(times, runs, counts->notes, &notes, &notes_sd);
+    printf("%-28s %-24s %10.3f %8.3f %12.0f %10.0f %12.0f %10.0f\n", name,
+            phase, time * 1000.0, time_sd * 1000.0, syllables, syllables_sd,
+            notes, notes_sd);
+}
+
+static const char *base_name(const char *const path)
+{
+    const char *slash = strrchr(path, '/');
+#ifdef _WIN32
+    const char *backslash = strrchr(path, '\\');
+    if (backslash > slash) {
+        slash = backslash;
+    }
+#endif
+    return slash ? slash + 1 : path;
+}
+
+static void print_usage(const char *const name)
+{
+    printf("Usage: %s [OPTION]... FILE...\n\
+\nTime gabc_read_score, gregoriotex_write_score, gabc_write_score and\n\
+dump_write_score over the given gabc files.\n\n\
+Options:\n\
+  -r NUMBER     number of measured runs (default: 10)\n\
+  -w NUMBER     number of warm-up runs (default: 1)\n\
+  -H ALGORITHM  digest algorithm, sha1 or xxh3 (default: sha1)\n\
+  -h            print this help message\n\
+\n\
+Times are in milliseconds, rates in syllables and notes per second, each\n\
+followed by its standard deviation over the runs.\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    gregorio_digest_algorithm algorithm = DIGEST_SHA1;
+    gregorio_score_counts total_counts;
+    bench_file *files;
+    double *total_times;
+    FILE *sink;
+    int runs = 10, warmups = 1, number_of_files, run, i, j, c;
+    int failures = 0;
+    bench_phase phase;
+
+    gregorio_support_init("gregorio-bench", argv[0]);
+
+    while ((c = getopt(argc, argv, "r:w:H:h")) != -1) {
+        switch (c) {
+        case 'r':
+            runs = atoi(optarg);
+            break;
+        case 'w':
+            warmups = atoi(optarg);
+            break;
+        case 'H':
+            if (!strcmp(optarg, "xxh3")) {
+                algorithm = DIGEST_XXH3;
+            } else if (strcmp(optarg, "sha1")) {
+                fprintf(stderr, "error: unknown digest algorithm: %s\n",
+                        optarg);
+                return 1;
+            }
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (runs < 1) {
+        runs = 1;
+    }
+    if (warmups < 0) {
+        warmups = 0;
+    }
+    number_of_files = argc - optind;
+    if (number_of_files < 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    /* warnings would only slow the runs down and clutter the report */
+    gregorio_set_verbosity_mode(VERBOSITY_ERROR);
+    /* a file with a fatal error is left out like one with errors */
+    gregorio_set_fatal_exit(false);
+
+    sink = fopen(NULL_DEVICE, "wb");
+    if (!sink) {
+        fprintf(stderr, "error: can't open %s for writing\n", NULL_DEVICE);
+        return 1;
+    }
+
+    files = (bench_file *)gregorio_calloc(number_of_files, sizeof *files);
+    total_times = (double *)gregorio_calloc(BENCH_NUMBER_OF_PHASES * runs,
+            sizeof(double));
+    for (i = 0; i < number_of_files; ++i) {
+        files[i].name = argv[optind + i];
+        files[i].times = (double *)gregorio_calloc(
+                BENCH_NUMBER_OF_PHASES * runs, sizeof(double));
+    }
+
+    for (run = -warmups; run < runs; ++run) {
+        for (i = 0; i < number_of_files; ++i) {
+            double times[BENCH_NUMBER_OF_PHASES];
+            if (files[i].failed) {
+                continue;
+            }
+            if (!run_file(files + i, sink, algorithm, times)) {
+                fprintf(stderr, "error: %s has errors, leaving it out\n",
+                        files[i].name);
+                files[i].failed = true;
+                ++failures;
+                continue;
+            }
+            if (run < 0) {
+                continue;
+            }
+            for (phase = 0; phase < BENCH_NUMBER_OF_PHASES; ++phase) {
+                files[i].times[phase * runs + run] = times[phase];
+            }
+        }
+    }
+
+    if (failures < number_of_files) {
+        memset(&total_counts, 0, sizeof total_counts);
+        printf("%-28s %-24s %10s %8s %12s %10s %12s %10s\n", "file", "phase",
+                "ms", "sd", "syl/s", "sd", "notes/s", "sd");
+        for (i = 0; i < number_of_files; ++i) {
+            if (files[i].failed) {
+                continue;
+            }
+            for (j = 0; j < BENCH_NUMBER_OF_PHASES * runs; ++j) {
+                total_times[j] += files[i].times[j];
+            }
+            for (phase = 0; phase < BENCH_NUMBER_OF_PHASES; ++phase) {
+                print_row(base_name(files[i].name), phase_names[phase],
+                        files[i].times + phase * runs, runs,
+                        &files[i].counts);
+            }
+            total_counts.syllables += files[i].counts.syllables;
+            total_counts.notes += files[i].counts.notes;
+        }
+        for (phase = 0; phase < BENCH_NUMBER_OF_PHASES; ++phase) {
+            print_row("(total)", phase_names[phase],
+                    total_times + phase * runs, runs, &total_counts);
+        }
+    }
+
+    for (i = 0; i < number_of_files; ++i) {
+        free(files[i].times);
+    }
+    free(files);
+    free(total_times);
+    fclose(sink);
+    return failures ? 1 : 0;
+}
@@ -43,6 +43,7 @@
 #include "characters.h"
 #include "messages.h"
 #include "support.h"
+#include "stats.h"
 #include "utf8strings.h"
 #include "vowel/vowel.h"
 
@@ -107,6 +108,7 @@ static bool read_vowel_rules(char *const lang) {
 
 void gregorio_set_centering_language(char *const language)
 {
+    gregorio_stats_start(STATS_VOWELS);
     if (!read_vowel_rules(language)) {
         if (strcmp(language, "Latin") != 0 && strcmp(language, "latin") != 0 && strcmp(language, "la") != 0 && strcmp(language, "lat") != 0) {
             gregorio_messagef("gregorio_set_centering_language",
@@ -121,6 +123,7 @@ void gregorio_set_centering_language(char *const language)
         gregorio_prefix_table_add("u");
         gregorio_prefix_table_add("U");
     }
+    gregorio_stats_stop(STATS_VOWELS);
 }
 
 static __inline const gregorio_character *skip_verbatim_or_special(
@@ -0,0 +1,846 @@
+/*
+ * Gregorio is a program that translates gabc files to GregorioTeX
+ * This file implements the semantic diff of gregorio --diff.
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * Gregorio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Gregorio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gregorio.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * gregorio --diff compares two gabc files as scores rather than as text.  Each
+ * file is read as for its canonical form (see gabc_read_canonical_score), and
+ * each syllable becomes a token, its canonical gabc and its position in its
+ * word, so that the way a file is formatted makes no difference.  The
+ * syllables of the two files are aligned by the O(ND) difference algorithm of
+ * Eugene W. Myers, in linear space, over the hashes of their tokens.  A
+ * changed syllable is then compared glyph by glyph, and a changed glyph note
+ * by note, in the same way.
+ *
+ * The report gives the differences in the headers and the initial clef, then a
+ * line for each removed ("-"), added ("+") or changed ("~") syllable, with its
+ * number in the files, its line when it is known and its canonical gabc, and
+ * under a changed syllable, the changes in its text, its position in its word
+ * (which tells where the words are divided), its glyphs and its notes.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bool.h"
+#include "struct.h"
+#include "messages.h"
+#include "support.h"
+#include "plugins.h"
+#include "gabc/gabc.h"
+#include "diff.h"
+
+/* a part of a score as canonical gabc, within the text of a sink */
+typedef struct diff_token {
+    unsigned long hash;
+    size_t start, length;
+} diff_token;
+
+/* A temporary file the tokens are written to, each one followed by a NUL
+ * (which canonical gabc does not contain), then read back.  The tokens are
+ * found back in the order they were written, which costs much less than
+ * asking the file its position for each one. */
+typedef struct diff_sink {
+    FILE *f;
+    char *text;
+    diff_token **order;
+    size_t count, capacity;
+} diff_sink;
+
+/* a sequence of tokens to align, and which of them the alignment changes */
+typedef struct diff_sequence {
+    const diff_token *tokens;
+    const char *text;
+    long count;
+    /* set for a token removed from a or added to b */
+    char *changed;
+} diff_sequence;
+
+typedef struct diff_aligner {
+    diff_sequence *a, *b;
+    /* the furthest reaching paths of the forward and backward searches,
+     * indexed by diagonal */
+    long *forward, *backward;
+} diff_aligner;
+
+/* called for each run of removed and added tokens */
+typedef void (*diff_hunk_handler)(void *data, long a_start, long a_end,
+        long b_start, long b_end);
+
+typedef struct diff_score {
+    gregorio_score *score;
+    gregorio_syllable **syllables;
+    /* the whole syllable and its parts, its text, its notes and its position
+     * in its word */
+    diff_token *tokens, *texts, *notes, *positions;
+    diff_sequence sequence;
+    diff_sink sink;
+} diff_score;
+
+/* the glyphs (and other elements) of a syllable, and their notes */
+typedef struct diff_items {
+    long count;
+    diff_token *tokens;
+    /* the glyph of each item, NULL for an element not made of glyphs */
+    gregorio_glyph **glyphs;
+    /* the index in notes of the first note of each item */
+    long *first_note;
+    long note_count;
+    diff_token *notes;
+} diff_items;
+
+typedef struct diff_report {
+    FILE *out;
+    diff_score *a, *b;
+    const char *name_a, *name_b;
+    /* the scratch sink of the items of a changed syllable */
+    diff_sink *scratch;
+    diff_items *items_a, *items_b;
+    /* the notes of the glyphs compared, numbered from their first */
+    const diff_token *notes_a, *notes_b;
+    bool header_written;
+    bool ok;
+} diff_report;
+
+static bool sink_open(diff_sink *const sink)
+{
+    sink->text = NULL;
+    sink->order = NULL;
+    sink->count = 0;
+    sink->capacity = 256;
+    sink->f = tmpfile();
+    if (!sink->f) {
+        gregorio_message(_("unable to create a temporary file"), "diff",
+                VERBOSITY_ERROR, 0);
+        return false;
+    }
+    return true;
+}
+
+/* ends the token just written to the sink */
+static void sink_end(diff_sink *const sink, diff_token *const token)
+{
+    fputc('\0', sink->f);
+    if (!sink->order) {
+        sink->order = gregorio_grow_buffer(NULL, &sink->capacity,
+                diff_token *);
+    } else if (sink->count == sink->capacity) {
+        sink->order = gregorio_grow_buffer(sink->order, &sink->capacity,
+                diff_token *);
+    }
+    sink->order[sink->count++] = token;
+}
+
+/* reads back the tokens written since the sink was last read */
+static bool sink_read(diff_sink *const sink)
+{
+    const long length = ftell(sink->f);
+    size_t i;
+    const char *p, *end;
+
+    if (length < 0 || fflush(sink->f) || fseek(sink->f, 0, SEEK_SET)) {
+        return false;
+    }
+    sink->text = (char *) gregorio_realloc(sink->text, length + 1);
+    if (fread(sink->text, 1, length, sink->f) != (size_t) length) {
+        return false;
+    }
+    sink->text[length] = '\0';
+    for (i = 0, p = sink->text, end = p + length; i < sink->count; ++i) {
+        const char *const nul = (const char *) memchr(p, '\0', end - p);
+        if (!nul) {
+            return false;
+        }
+        sink->order[i]->start = p - sink->text;
+        sink->order[i]->length = nul - p;
+        p = nul + 1;
+    }
+    sink->count = 0;
+    /* the next tokens are written from the start again */
+    return fseek(sink->f, 0, SEEK_SET) == 0;
+}
+
+static void sink_close(diff_sink *const sink)
+{
+    if (sink->f) {
+        fclose(sink->f);
+    }
+    free(sink->text);
+    free(sink->order);
+}
+
+/* FNV-1a, which is enough to tell tokens apart before comparing them */
+static void hash_tokens(diff_token *const tokens, const long count,
+        const char *const text)
+{
+    long i;
+    for (i = 0; i < count; ++i) {
+        unsigned long hash = 2166136261UL;
+        const unsigned char *p = (const unsigned char *) text
+                + tokens[i].start;
+        const unsigned char *const end = p + tokens[i].length;
+        for (; p < end; ++p) {
+            hash = ((hash ^ *p) * 16777619UL) & 0xffffffffUL;
+        }
+        tokens[i].hash = hash;
+    }
+}
+
+static __inline bool same_token(const diff_aligner *const aligner,
+        const long i, const long j)
+{
+    const diff_token *const x = aligner->a->tokens + i;
+    const diff_token *const y = aligner->b->tokens + j;
+    return x->hash == y->hash && x->length == y->length
+            && memcmp(aligner->a->text + x->start,
+                aligner->b->text + y->start, x->length) == 0;
+}
+
+/* Finds the middle snake of an optimal path from (a_lo, b_lo) to (a_hi, b_hi),
+ * the tokens of which are known to differ at both ends, by searching from both
+ * ends at once until the paths overlap. */
+static void find_middle_snake(const diff_aligner *const aligner,
+        const long a_lo, const long a_hi, const long b_lo, const long b_hi,
+        long *const x_start, long *const y_start, long *const x_end,
+        long *const y_end)
+{
+    const long n = a_hi - a_lo, m = b_hi - b_lo;
+    const long delta = n - m;
+    const bool odd = (delta % 2) != 0;
+    const long max = (n + m + 1) / 2;
+    long *const forward = aligner->forward;
+    long *const backward = aligner->backward;
+    long d, k, x, y, x0, y0;
+
+    forward[1] = 0;
+    backward[1] = 0;
+    for (d = 0; d <= max; ++d) {
+        for (k = -d; k <= d; k += 2) {
+            if (k == -d || (k != d && forward[k - 1] < forward[k + 1])) {
+                x = forward[k + 1];
+            } else {
+                x = forward[k - 1] + 1;
+            }
+            y = x - k;
+            x0 = x;
+            y0 = y;
+            while (x < n && y < m && same_token(aligner, a_lo + x, b_lo + y)) {
+                ++x;
+                ++y;
+            }
+            forward[k] = x;
+            if (odd && delta - k >= -(d - 1) && delta - k <= d - 1
+                    && forward[k] + backward[delta - k] >= n) {
+                *x_start = a_lo + x0;
+                *y_start = b_lo + y0;
+                *x_end = a_lo + x;
+                *y_end = b_lo + y;
+                return;
+            }
+        }
+        for (k = -d; k <= d; k += 2) {
+            if (k == -d || (k != d && backward[k - 1] < backward[k + 1])) {
+                x = backward[k + 1];
+            } else {
+                x = backward[k - 1] + 1;
+            }
+            y = x - k;
+            x0 = x;
+            y0 = y;
+            while (x < n && y < m
+                    && same_token(aligner, a_hi - 1 - x, b_hi - 1 - y)) {
+                ++x;
+                ++y;
+            }
+            backward[k] = x;
+            if (!odd && delta - k >= -d && delta - k <= d
+                    && backward[k] + forward[delta - k] >= n) {
+                *x_start = a_hi - x;
+                *y_start = b_hi - y;
+                *x_end = a_hi - x0;
+                *y_end = b_hi - y0;
+                return;
+            }
+        }
+    }
+    /* not reachable: the paths overlap by d = max */
+    /* LCOV_EXCL_START */
+    gregorio_fail(find_middle_snake, "no middle snake");
+    *x_start = *x_end = a_lo;
+    *y_start = *y_end = b_hi;
+    /* LCOV_EXCL_STOP */
+}
+
+static void compare_sequences(const diff_aligner *const aligner, long a_lo,
+        long a_hi, long b_lo, long b_hi)
+{
+    long x_start, y_start, x_end, y_end;
+
+    /* the common prefix and suffix are kept */
+    while (a_lo < a_hi && b_lo < b_hi && same_token(aligner, a_lo, b_lo)) {
+        ++a_lo;
+        ++b_lo;
+    }
+    while (a_lo < a_hi && b_lo < b_hi
+            && same_token(aligner, a_hi - 1, b_hi - 1)) {
+        --a_hi;
+        --b_hi;
+    }
+    if (a_lo == a_hi) {
+        for (; b_lo < b_hi; ++b_lo) {
+            aligner->b->changed[b_lo] = 1;
+        }
+        return;
+    }
+    if (b_lo == b_hi) {
+        for (; a_lo < a_hi; ++a_lo) {
+            aligner->a->changed[a_lo] = 1;
+        }
+        return;
+    }
+    /* both ends differ, so the middle snake splits the differences in two
+     * smaller halves */
+    find_middle_snake(aligner, a_lo, a_hi, b_lo, b_hi, &x_start, &y_start,
+            &x_end, &y_end);
+    compare_sequences(aligner, a_lo, x_start, b_lo, y_start);
+    compare_sequences(aligner, x_end, a_hi, y_end, b_hi);
+}
+
+/* Aligns two sequences, calling handler for each run of changed tokens. */
+static void align(diff_sequence *const a, diff_sequence *const b,
+        const diff_hunk_handler handler, void *const data)
+{
+    diff_aligner aligner;
+    const long max = (a->count + b->count + 1) / 2;
+    long *const forward = (long *) gregorio_malloc((2 * max + 3)
+            * sizeof(long));
+    long *const backward = (long *) gregorio_malloc((2 * max + 3)
+            * sizeof(long));
+    long i = 0, j = 0, i0, j0;
+
+    a->changed = (char *) gregorio_calloc(a->count + 1, 1);
+    b->changed = (char *) gregorio_calloc(b->count + 1, 1);
+    aligner.a = a;
+    aligner.b = b;
+    /* the diagonals run from -(max + 1) to max + 1 */
+    aligner.forward = forward + max + 1;
+    aligner.backward = backward + max + 1;
+    compare_sequences(&aligner, 0, a->count, 0, b->count);
+    free(forward);
+    free(backward);
+
+    while (i < a->count || j < b->count) {
+        if (i < a->count && j < b->count && !a->changed[i]
+                && !b->changed[j]) {
+            ++i;
+            ++j;
+            continue;
+        }
+        i0 = i;
+        j0 = j;
+        while (i < a->count && a->changed[i]) {
+            ++i;
+        }
+        while (j < b->count && b->changed[j]) {
+            ++j;
+        }
+        handler(data, i0, i, j0, j);
+    }
+    free(a->changed);
+    free(b->changed);
+    a->changed = b->changed = NULL;
+}
+
+static void write_token(FILE *const out, const char *const text,
+        const diff_token *const token)
+{
+    fwrite(text + token->start, 1, token->length, out);
+}
+
+/* writes syllable i of a score as "text(notes)" */
+static void write_syllable(FILE *const out, const diff_score *const score,
+        const long i)
+{
+    write_token(out, score->sink.text, score->texts + i);
+    fputc('(', out);
+    write_token(out, score->sink.text, score->notes + i);
+    fputc(')', out);
+}
+
+static void write_position(FILE *const out, const long index,
+        const gregorio_syllable *const syllable)
+{
+    fprintf(out, "%ld", index + 1);
+    if (syllable->src_line) {
+        fprintf(out, " (line %u)", syllable->src_line);
+    }
+}
+
+static void write_clef(FILE *const out, const gregorio_clef_info *const clef)
+{
+    fprintf(out, "%c%s%d", clef->clef == CLEF_C? 'c' : 'f',
+            clef->flatted? "b" : "", clef->line);
+    if (clef->secondary_line) {
+        fprintf(out, "@%c%s%d", clef->secondary_clef == CLEF_C? 'c' : 'f',
+                clef->secondary_flatted? "b" : "", clef->secondary_line);
+    }
+}
+
+static bool same_clef(const gregorio_clef_info *const x,
+        const gregorio_clef_info *const y)
+{
+    return x->clef == y->clef && x->line == y->line
+            && x->flatted == y->flatted
+            && x->secondary_line == y->secondary_line
+            && (!x->secondary_line || (x->secondary_clef == y->secondary_clef
+                    && x->secondary_flatted == y->secondary_flatted));
+}
+
+static void begin_report(diff_report *const report)
+{
+    if (!report->header_written) {
+        fprintf(report->out, "--- %s\n+++ %s\n", report->name_a,
+                report->name_b);
+        report->header_written = true;
+    }
+    report->ok = false;
+}
+
+/* Reports the headers of one score which the other does not have, pairing
+ * headers of the same name and value in the order of the files. */
+static void compare_headers(diff_report *const report, const char sign,
+        const gregorio_score *const score, const gregorio_score *const other)
+{
+    gregorio_header *header, *match;
+    long count = 0, i;
+    char *used;
+
+    for (match = other->headers; match; match = match->next) {
+        ++count;
+    }
+    used = (char *) gregorio_calloc(count + 1, 1);
+    for (header = score->headers; header; header = header->next) {
+        if (strcmp(header->name, "generated-by") == 0) {
+            continue;
+        }
+        for (match = other->headers, i = 0; match; match = match->next, ++i) {
+            if (!used[i] && strcmp(header->name, match->name) == 0
+                    && strcmp(header->value, match->value) == 0) {
+                used[i] = 1;
+                break;
+            }
+        }
+        if (!match) {
+            begin_report(report);
+            fprintf(report->out, "%c header %s: %s\n", sign, header->name,
+                    header->value);
+        }
+    }
+    free(used);
+}
+
+static void count_items(diff_items *const items,
+        const gregorio_syllable *const syllable)
+{
+    const gregorio_element *element;
+    const gregorio_glyph *glyph;
+    const gregorio_note *note;
+
+    items->count = items->note_count = 0;
+    for (element = syllable->elements[0]; element; element = element->next) {
+        if (element->type != GRE_ELEMENT) {
+            ++items->count;
+            continue;
+        }
+        for (glyph = element->u.first_glyph; glyph; glyph = glyph->next) {
+            ++items->count;
+            if (glyph->type == GRE_GLYPH) {
+                for (note = glyph->u.notes.first_note; note;
+                        note = note->next) {
+                    ++items->note_count;
+                }
+            }
+        }
+    }
+}
+
+/* writes the items of a syllable to the sink, items having been counted */
+static void write_items(diff_items *const items, diff_sink *const sink,
+        gregorio_syllable *const syllable)
+{
+    gregorio_element *element;
+    gregorio_glyph *glyph;
+    gregorio_note *note;
+    long i = 0, n = 0;
+
+    items->tokens = (diff_token *) gregorio_malloc((items->count + 1)
+            * sizeof(diff_token));
+    items->glyphs = (gregorio_glyph **) gregorio_malloc((items->count + 1)
+            * sizeof(gregorio_glyph *));
+    items->first_note = (long *) gregorio_malloc((items->count + 1)
+            * sizeof(long));
+    items->notes = (diff_token *) gregorio_malloc((items->note_count + 1)
+            * sizeof(diff_token));
+    for (element = syllable->elements[0]; element; element = element->next) {
+        if (element->type != GRE_ELEMENT) {
+            gabc_write_element(sink->f, syllable, element);
+            sink_end(sink, items->tokens + i);
+            items->glyphs[i] = NULL;
+            items->first_note[i] = n;
+            ++i;
+            continue;
+        }
+        for (glyph = element->u.first_glyph; glyph; glyph = glyph->next) {
+            gabc_write_glyph(sink->f, syllable, element, glyph);
+            sink_end(sink, items->tokens + i);
+            items->glyphs[i] = glyph->type == GRE_GLYPH? glyph : NULL;
+            items->first_note[i] = n;
+            ++i;
+            if (glyph->type == GRE_GLYPH) {
+                for (note = glyph->u.notes.first_note; note;
+                        note = note->next) {
+                    gabc_write_note(sink->f, glyph, note);
+                    sink_end(sink, items->notes + n);
+                    ++n;
+                }
+            }
+        }
+    }
+    /* the end of the notes of the last item */
+    items->first_note[i] = n;
+}
+
+static void free_items(diff_items *const items)
+{
+    free(items->tokens);
+    free(items->glyphs);
+    free(items->first_note);
+    free(items->notes);
+}
+
+static void report_notes(void *const data, const long a_start,
+        const long a_end, const long b_start, const long b_end)
+{
+    diff_report *const report = (diff_report *) data;
+    const char *const text = report->scratch->text;
+    long i = a_start, j = b_start;
+
+    for (; i < a_end && j < b_end; ++i, ++j) {
+        fprintf(report->out, "        ~ note %ld -> %ld: ", i + 1, j + 1);
+        write_token(report->out, text, report->notes_a + i);
+        fputs(" -> ", report->out);
+        write_token(report->out, text, report->notes_b + j);
+        fputc('\n', report->out);
+    }
+    for (; i < a_end; ++i) {
+        fprintf(report->out, "        - note %ld: ", i + 1);
+        write_token(report->out, text, report->notes_a + i);
+        fputc('\n', report->out);
+    }
+    for (; j < b_end; ++j) {
+        fprintf(report->out, "        + note %ld: ", j + 1);
+        write_token(report->out, text, report->notes_b + j);
+        fputc('\n', report->out);
+    }
+}
+
+/* compares the notes of item i of a with those of item j of b */
+static void compare_notes(diff_report *const report, const long i,
+        const long j)
+{
+    const diff_items *const items_a = report->items_a;
+    const diff_items *const items_b = report->items_b;
+    diff_sequence a, b;
+
+    report->notes_a = items_a->notes + items_a->first_note[i];
+    report->notes_b = items_b->notes + items_b->first_note[j];
+    a.tokens = report->notes_a;
+    a.text = report->scratch->text;
+    a.count = items_a->first_note[i + 1] - items_a->first_note[i];
+    b.tokens = report->notes_b;
+    b.text = report->scratch->text;
+    b.count = items_b->first_note[j + 1] - items_b->first_note[j];
+    align(&a, &b, report_notes, report);
+}
+
+static const char *item_name(const diff_items *const items, const long i)
+{
+    return items->glyphs[i]? "glyph" : "element";
+}
+
+static void report_items(void *const data, const long a_start,
+        const long a_end, const long b_start, const long b_end)
+{
+    diff_report *const report = (diff_report *) data;
+    const char *const text = report->scratch->text;
+    diff_items *const items_a = report->items_a, *const items_b =
+            report->items_b;
+    long i = a_start, j = b_start;
+
+    for (; i < a_end && j < b_end; ++i, ++j) {
+        fprintf(report->out, "    ~ %s %ld -> %ld: ", item_name(items_a, i),
+                i + 1, j + 1);
+        write_token(report->out, text, items_a->tokens + i);
+        fputs(" -> ", report->out);
+        write_token(report->out, text, items_b->tokens + j);
+        fputc('\n', report->out);
+        if (items_a->glyphs[i] && items_b->glyphs[j]) {
+            compare_notes(report, i, j);
+        }
+    }
+    for (; i < a_end; ++i) {
+        fprintf(report->out, "    - %s %ld: ", item_name(items_a, i), i + 1);
+        write_token(report->out, text, items_a->tokens + i);
+        fputc('\n', report->out);
+    }
+    for (; j < b_end; ++j) {
+        fprintf(report->out, "    + %s %ld: ", item_name(items_b, j), j + 1);
+        write_token(report->out, text, items_b->tokens + j);
+        fputc('\n', report->out);
+    }
+}
+
+/* reports the changes in syllable i of a, which became syllable j of b */
+static void compare_syllables(diff_report *const report, const long i,
+        const long j)
+{
+    diff_score *const a = report->a, *const b = report->b;
+    diff_items items_a, items_b;
+    diff_sequence sequence_a, sequence_b;
+    const diff_token *const text_a = a->texts + i, *const text_b = b->texts
+            + j;
+
+    fputs("~ syllable ", report->out);
+    write_position(report->out, i, a->syllables[i]);
+    fputs(" -> ", report->out);
+    write_position(report->out, j, b->syllables[j]);
+    fputs(": ", report->out);
+    write_syllable(report->out, a, i);
+    fputs(" -> ", report->out);
+    write_syllable(report->out, b, j);
+    fputc('\n', report->out);
+
+    if (text_a->length != text_b->length || memcmp(a->sink.text
+                + text_a->start, b->sink.text + text_b->start,
+                text_a->length) != 0) {
+        fputs("    text: ", report->out);
+        write_token(report->out, a->sink.text, text_a);
+        fputs(" -> ", report->out);
+        write_token(report->out, b->sink.text, text_b);
+        fputc('\n', report->out);
+    }
+    if (a->syllables[i]->position != b->syllables[j]->position) {
+        fprintf(report->out, "    position: %s -> %s\n",
+                gregorio_word_position_to_string(a->syllables[i]->position),
+                gregorio_word_position_to_string(b->syllables[j]->position));
+    }
+
+    count_items(&items_a, a->syllables[i]);
+    count_items(&items_b, b->syllables[j]);
+    write_items(&items_a, report->scratch, a->syllables[i]);
+    write_items(&items_b, report->scratch, b->syllables[j]);
+    if (!sink_read(report->scratch)) {
+        gregorio_message(_("unable to read a temporary file"), "diff",
+                VERBOSITY_ERROR, 0);
+        free_items(&items_a);
+        free_items(&items_b);
+        return;
+    }
+    hash_tokens(items_a.tokens, items_a.count, report->scratch->text);
+    hash_tokens(items_a.notes, items_a.note_count, report->scratch->text);
+    hash_tokens(items_b.tokens, items_b.count, report->scratch->text);
+    hash_tokens(items_b.notes, items_b.note_count, report->scratch->text);
+    sequence_a.tokens = items_a.tokens;
+    sequence_a.text = report->scratch->text;
+    sequence_a.count = items_a.count;
+    sequence_b.tokens = items_b.tokens;
+    sequence_b.text = report->scratch->text;
+    sequence_b.count = items_b.count;
+    report->items_a = &items_a;
+    report->items_b = &items_b;
+    align(&sequence_a, &sequence_b, report_items, report);
+    report->items_a = report->items_b = NULL;
+    free_items(&items_a);
+    free_items(&items_b);
+}
+
+static void report_syllables(void *const data, const long a_start,
+        const long a_end, const long b_start, const long b_end)
+{
+    diff_report *const report = (diff_report *) data;
+    long i = a_start, j = b_start;
+
+    begin_report(report);
+    for (; i < a_end && j < b_end; ++i, ++j) {
+        compare_syllables(report, i, j);
+    }
+    for (; i < a_end; ++i) {
+        fputs("- syllable ", report->out);
+        write_position(report->out, i, report->a->syllables[i]);
+        fputs(": ", report->out);
+        write_syllable(report->out, report->a, i);
+        fputc('\n', report->out);
+    }
+    for (; j < b_end; ++j) {
+        fputs("+ syllable ", report->out);
+        write_position(report->out, j, report->b->syllables[j]);
+        fputs(": ", report->out);
+        write_syllable(report->out, report->b, j);
+        fputc('\n', report->out);
+    }
+}
+
+/* reads a score and writes the tokens of its syllables */
+static bool read_score(diff_score *const score, const char *const name)
+{
+    FILE *f;
+    gregorio_syllable *syllable;
+    long count = 0, i;
+
+    gregorio_check_file_access(read, name, ERROR, return false);
+    f = fopen(name, "r");
+    if (!f) {
+        gregorio_messagef("diff", VERBOSITY_ERROR, 0,
+                _("can't open file %s for reading"), name);
+        return false;
+    }
+    score->score = gabc_read_canonical_score(f);
+    fclose(f);
+    /* the lexers must start afresh for the next file */
+    gabc_score_determination_lex_destroy();
+    gabc_notes_determination_lex_destroy();
+    if (!score->score || gregorio_get_return_value()) {
+        gregorio_messagef("diff", VERBOSITY_ERROR, 0, _("unable to read %s"),
+                name);
+        return false;
+    }
+    if (!sink_open(&score->sink)) {
+        return false;
+    }
+
+    for (syllable = score->score->first_syllable; syllable;
+            syllable = syllable->next_syllable) {
+        ++count;
+    }
+    score->syllables = (gregorio_syllable **) gregorio_malloc((count + 1)
+            * sizeof(gregorio_syllable *));
+    score->tokens = (diff_token *) gregorio_malloc((count + 1)
+            * sizeof(diff_token));
+    score->texts = (diff_token *) gregorio_malloc((count + 1)
+            * sizeof(diff_token));
+    score->notes = (diff_token *) gregorio_malloc((count + 1)
+            * sizeof(diff_token));
+    score->positions = (diff_token *) gregorio_malloc((count + 1)
+            * sizeof(diff_token));
+    for (syllable = score->score->first_syllable, i = 0; syllable;
+            syllable = syllable->next_syllable, ++i) {
+        score->syllables[i] = syllable;
+        gabc_write_syllable_text(score->sink.f, syllable);
+        sink_end(&score->sink, score->texts + i);
+        gabc_write_syllable_notes(score->sink.f, syllable);
+        sink_end(&score->sink, score->notes + i);
+        fputs(gregorio_word_position_to_string(syllable->position),
+                score->sink.f);
+        sink_end(&score->sink, score->positions + i);
+    }
+    if (!sink_read(&score->sink)) {
+        gregorio_message(_("unable to read a temporary file"), "diff",
+                VERBOSITY_ERROR, 0);
+        return false;
+    }
+    /* the whole syllable spans its text, its notes and its position, with
+     * the NULs between them */
+    for (i = 0; i < count; ++i) {
+        score->tokens[i].start = score->texts[i].start;
+        score->tokens[i].length = score->positions[i].start
+                + score->positions[i].length - score->texts[i].start;
+    }
+    hash_tokens(score->tokens, count, score->sink.text);
+    score->sequence.tokens = score->tokens;
+    score->sequence.text = score->sink.text;
+    score->sequence.count = count;
+    score->sequence.changed = NULL;
+    return true;
+}
+
+static void free_score(diff_score *const score)
+{
+    if (score->score) {
+        gregorio_free_score(score->score);
+    }
+    free(score->syllables);
+    free(score->tokens);
+    free(score->texts);
+    free(score->notes);
+    free(score->positions);
+    sink_close(&score->sink);
+}
+
+/*
+ * Compares the gabc files name_a and name_b, writing the differences to out.
+ * Returns 0 if the scores are the same, 1 if they differ and 2 if a file
+ * could not be read, as diff does.
+ */
+int gregorio_diff(const char *const name_a, const char *const name_b,
+        FILE *const out)
+{
+    diff_score a, b;
+    diff_sink scratch;
+    diff_report report;
+    int status = 2;
+
+    memset(&a, 0, sizeof(diff_score));
+    memset(&b, 0, sizeof(diff_score));
+    memset(&scratch, 0, sizeof(diff_sink));
+    gregorio_reset_return_value();
+    if (read_score(&a, name_a) && read_score(&b, name_b)
+            && sink_open(&scratch)) {
+        report.out = out;
+        report.a = &a;
+        report.b = &b;
+        report.name_a = name_a;
+        report.name_b = name_b;
+        report.scratch = &scratch;
+        report.items_a = report.items_b = NULL;
+        report.header_written = false;
+        report.ok = true;
+
+        compare_headers(&report, '-', a.score, b.score);
+        compare_headers(&report, '+', b.score, a.score);
+        if (a.score->first_voice_info && b.score->first_voice_info
+                && !same_clef(&a.score->first_voice_info->initial_clef,
+                    &b.score->first_voice_info->initial_clef)) {
+            begin_report(&report);
+            fputs("~ initial clef: ", out);
+            write_clef(out, &a.score->first_voice_info->initial_clef);
+            fputs(" -> ", out);
+            write_clef(out, &b.score->first_voice_info->initial_clef);
+            fputc('\n', out);
+        }
+        align(&a.sequence, &b.sequence, report_syllables, &report);
+        status = gregorio_get_return_value()? 2 : report.ok? 0 : 1;
+    }
+    free_score(&a);
+    free_score(&b);
+    sink_close(&scratch);
+    return status;
+}
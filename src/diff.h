@@ -0,0 +1,30 @@
+/*
+ * Gregorio is a program that translates gabc files to GregorioTeX
+ * This header declares the semantic diff of gregorio --diff.
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * Gregorio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Gregorio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gregorio.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DIFF_H
+#define DIFF_H
+
+#include <stdio.h>
+
+int gregorio_diff(const char *name_a, const char *name_b, FILE *out);
+
+#endif
@@ -0,0 +1,634 @@
+/*
+ * Utility program to generate gabc/gabc-glyphs-transitions.h, the transition
+ * table of the glyph determination automaton (see gabc-glyphs-automaton.h)
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * Gregorio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Gregorio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gregorio.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The table is built by running the determination code below, which is the
+ * code that add_note_to_a_glyph used before the table, on every input that
+ * add_note_to_a_glyph can get: every glyph type, shape, liquescentia, kind of
+ * first note, orientation of the puncta inclinata, last pitch and pitch.  All
+ * the inputs which fall in the same entry of the table must give the same
+ * result, and the program fails otherwise, so the table gives exactly the
+ * results of the determination code.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "bool.h"
+#include "struct.h"
+#include "gabc.h"
+#include "gabc-glyphs-automaton.h"
+
+static const char *const shape_class_names[SC_COUNT] = {
+    "SC_INVALID", "SC_LINEA", "SC_ALTERATION", "SC_PUNCTUM",
+    "SC_PUNCTUM_AFTER_OTHER", "SC_PUNCTUM_DEMINUTUS",
+    "SC_PUNCTUM_DEMINUTUS_AFTER_OTHER", "SC_PUNCTUM_DEMINUTUS_MIXED",
+    "SC_PUNCTUM_DEMINUTUS_MIXED_AFTER_OTHER", "SC_STARTS_GLYPH", "SC_VIRGA",
+    "SC_VIRGA_REVERSA", "SC_BIVIRGA", "SC_TRIVIRGA", "SC_QUADRATUM",
+    "SC_QUILISMA_QUADRATUM", "SC_ORISCUS_SCAPUS_ASCENDENS",
+    "SC_ORISCUS_SCAPUS_DESCENDENS", "SC_PUNCTUM_INCLINATUM",
+    "SC_PUNCTUM_INCLINATUM_REORIENTED", "SC_STROPHA", "SC_DISTROPHA",
+    "SC_TRISTROPHA"
+};
+
+static const gregorio_liquescentia liquescentiae[] = {
+    L_NO_LIQUESCENTIA, L_DEMINUTUS, L_AUCTUS_ASCENDENS, L_AUCTUS_DESCENDENS,
+    L_INITIO_DEBILIS, L_DEMINUTUS_INITIO_DEBILIS,
+    L_AUCTUS_ASCENDENS_INITIO_DEBILIS, L_AUCTUS_DESCENDENS_INITIO_DEBILIS,
+    L_FUSED, L_FUSED_DEMINUTUS, L_FUSED_AUCTUS_ASCENDENS,
+    L_FUSED_AUCTUS_DESCENDENS
+};
+#define LIQUESCENTIA_COUNT \
+    ((int)(sizeof liquescentiae / sizeof liquescentiae[0]))
+
+static const gregorio_shape orientations[] = {
+    S_PUNCTUM_INCLINATUM_UNDETERMINED, S_PUNCTUM_INCLINATUM_ASCENDENS,
+    S_PUNCTUM_INCLINATUM_STANS, S_PUNCTUM_INCLINATUM_DESCENDENS
+};
+#define ORIENTATION_COUNT ((int)(sizeof orientations / sizeof orientations[0]))
+
+static const char *glyph_type_name(const gregorio_glyph_type type)
+{
+    switch (type) {
+        GREGORIO_GLYPH_TYPE(ENUM_VALUE_CASE, ENUM_ENTRY_CASE, ENUM_VALUE_CASE,
+                ENUM_ENTRY_CASE)
+    default:
+        return "(none)";
+    }
+}
+
+/* the determination code, see add_note_to_a_glyph in
+ * gabc-glyphs-determination.c for its description; an invalid shape gives
+ * what it gave after the failure message */
+static gregorio_glyph_type determine(gregorio_glyph_type current_glyph_type,
+        char current_pitch, char last_pitch, gregorio_shape shape,
+        gregorio_liquescentia liquescentia,
+        const gregorio_note *current_glyph_first_note,
+        gabc_determination *end_of_glyph,
+        gregorio_shape *punctum_inclinatum_orientation)
+{
+    #define this_note_starts_new_glyph { \
+        next_glyph_type = G_PUNCTUM; \
+        *end_of_glyph = DET_END_OF_PREVIOUS; \
+    }
+
+    gregorio_glyph_type next_glyph_type = G_UNDETERMINED;
+
+    *end_of_glyph = DET_NO_END;
+
+    if (last_pitch) {
+        if (current_pitch - last_pitch > MAX_AMBITUS
+                || current_pitch - last_pitch < -MAX_AMBITUS) {
+            current_glyph_type = G_UNDETERMINED;
+        }
+    }
+
+    switch (shape) {
+    case S_LINEA_PUNCTUM:
+    case S_LINEA:
+        next_glyph_type = G_PUNCTUM;
+        *end_of_glyph = DET_END_OF_BOTH;
+        break;
+    case S_FLAT:
+    case S_FLAT_PAREN:
+    case S_FLAT_SOFT:
+    case S_SHARP:
+    case S_SHARP_PAREN:
+    case S_SHARP_SOFT:
+    case S_NATURAL:
+    case S_NATURAL_PAREN:
+    case S_NATURAL_SOFT:
+        next_glyph_type = G_ALTERATION;
+        *end_of_glyph = DET_END_OF_BOTH;
+        break;
+    case S_PUNCTUM:
+        if (current_pitch == last_pitch) {
+            this_note_starts_new_glyph;
+            break;
+        }
+        switch (current_glyph_type) {
+        case G_PUNCTUM:
+            if (current_pitch > last_pitch) {
+                next_glyph_type = G_PODATUS;
+            } else {
+                next_glyph_type = G_FLEXA;
+            }
+            break;
+        case G_PODATUS:
+            if (current_pitch > last_pitch) {
+                if (is_normal_punctum(current_glyph_first_note)) {
+                    next_glyph_type = G_SCANDICUS;
+                    *end_of_glyph = DET_END_OF_CURRENT;
+                } else {
+                    this_note_starts_new_glyph;
+                }
+            } else {
+                next_glyph_type = G_TORCULUS;
+            }
+            break;
+        case G_PES_QUADRATUM_FIRST_PART:
+            if (current_pitch > last_pitch) {
+                next_glyph_type = G_PES_QUADRATUM;
+                *end_of_glyph = DET_END_OF_CURRENT;
+            } else {
+                next_glyph_type = G_FLEXA;
+            }
+            break;
+        case G_PES_QUILISMA_QUADRATUM_FIRST_PART:
+            if (current_pitch > last_pitch) {
+                next_glyph_type = G_PES_QUADRATUM;
+                *end_of_glyph = DET_END_OF_CURRENT;
+            } else {
+                this_note_starts_new_glyph;
+            }
+            break;
+        case G_PES_ASCENDENS_ORISCUS:
+        case G_PES_DESCENDENS_ORISCUS:
+            if (current_pitch > last_pitch) {
+                next_glyph_type = G_SALICUS;
+            } else {
+                this_note_starts_new_glyph;
+            }
+            break;
+        case G_SALICUS:
+            if (current_pitch < last_pitch) {
+                next_glyph_type = G_SALICUS_FLEXUS;
+                *end_of_glyph = DET_END_OF_CURRENT;
+            } else {
+                this_note_starts_new_glyph;
+            }
+            break;
+        case G_FLEXA:
+            if (current_pitch > last_pitch) {
+                if (is_normal_punctum(current_glyph_first_note)) {
+                    next_glyph_type = G_PORRECTUS;
+                } else {
+                    this_note_starts_new_glyph;
+                }
+            } else {
+                if (liquescentia & L_DEMINUTUS) {
+                    *end_of_glyph = DET_END_OF_CURRENT;
+                    next_glyph_type = G_ANCUS;
+                } else {
+                    this_note_starts_new_glyph;
+                }
+            }
+            break;
+        case G_TORCULUS:
+            if (current_pitch > last_pitch) {
+                next_glyph_type = G_TORCULUS_RESUPINUS;
+            } else if (liquescentia == L_DEMINUTUS) {
+                *end_of_glyph = DET_END_OF_CURRENT;
+                next_glyph_type = G_TORCULUS_LIQUESCENS;
+            } else {
+                this_note_starts_new_glyph;
+            }
+            break;
+        case G_TORCULUS_RESUPINUS:
+            if (current_pitch > last_pitch) {
+                this_note_starts_new_glyph;
+            } else {
+                *end_of_glyph = DET_END_OF_CURRENT;
+                next_glyph_type = G_TORCULUS_RESUPINUS_FLEXUS;
+            }
+            break;
+        case G_PORRECTUS:
+            if (current_pitch > last_pitch) {
+                this_note_starts_new_glyph;
+            } else {
+                *end_of_glyph = DET_END_OF_CURRENT;
+                next_glyph_type = G_PORRECTUS_FLEXUS;
+            }
+            break;
+        default:
+            this_note_starts_new_glyph;
+            break;
+        }
+        break;
+    case S_ORISCUS_UNDETERMINED:
+    case S_ORISCUS_ASCENDENS:
+    case S_ORISCUS_DESCENDENS:
+    case S_ORISCUS_DEMINUTUS:
+    case S_QUILISMA:
+        this_note_starts_new_glyph;
+        break;
+    case S_VIRGA:
+        if (current_glyph_type == G_VIRGA && last_pitch == current_pitch) {
+            next_glyph_type = G_BIVIRGA;
+        } else {
+            if (current_glyph_type == G_BIVIRGA && last_pitch == current_pitch) {
+                next_glyph_type = G_TRIVIRGA;
+            } else {
+                *end_of_glyph = DET_END_OF_PREVIOUS;
+                next_glyph_type = G_VIRGA;
+            }
+        }
+        break;
+    case S_VIRGA_REVERSA:
+        *end_of_glyph = DET_END_OF_PREVIOUS;
+        next_glyph_type = G_VIRGA_REVERSA;
+        break;
+    case S_BIVIRGA:
+        if (current_glyph_type == G_VIRGA && last_pitch == current_pitch) {
+            *end_of_glyph = DET_END_OF_CURRENT;
+            next_glyph_type = G_TRIVIRGA;
+        } else {
+            *end_of_glyph = DET_END_OF_PREVIOUS;
+            next_glyph_type = G_BIVIRGA;
+        }
+        break;
+    case S_TRIVIRGA:
+        *end_of_glyph = DET_END_OF_BOTH;
+        next_glyph_type = G_TRIVIRGA;
+        break;
+    case S_QUADRATUM:
+        *end_of_glyph = DET_END_OF_PREVIOUS;
+        next_glyph_type = G_PES_QUADRATUM_FIRST_PART;
+        break;
+    case S_QUILISMA_QUADRATUM:
+        *end_of_glyph = DET_END_OF_PREVIOUS;
+        next_glyph_type = G_PES_QUILISMA_QUADRATUM_FIRST_PART;
+        break;
+    case S_ORISCUS_SCAPUS_UNDETERMINED:
+    case S_ORISCUS_SCAPUS_ASCENDENS:
+        if (current_glyph_type == G_PUNCTUM && last_pitch < current_pitch) {
+            next_glyph_type = G_PES_ASCENDENS_ORISCUS;
+        } else {
+            this_note_starts_new_glyph;
+        }
+        break;
+    case S_ORISCUS_SCAPUS_DESCENDENS:
+        if (current_glyph_type == G_PUNCTUM && last_pitch < current_pitch) {
+            next_glyph_type = G_PES_DESCENDENS_ORISCUS;
+        } else {
+            this_note_starts_new_glyph;
+        }
+        break;
+    case S_PUNCTUM_INCLINATUM_UNDETERMINED:
+    case S_PUNCTUM_INCLINATUM_ASCENDENS:
+    case S_PUNCTUM_INCLINATUM_STANS:
+    case S_PUNCTUM_INCLINATUM_DESCENDENS:
+        if (current_glyph_type > G_PUNCTA_INCLINATA) {
+            *end_of_glyph = DET_END_OF_PREVIOUS;
+            next_glyph_type = G_PUNCTUM_INCLINATUM;
+            break;
+        }
+        if (current_pitch == last_pitch) {
+            *end_of_glyph = DET_END_OF_PREVIOUS;
+            next_glyph_type = G_PUNCTUM_INCLINATUM;
+            break;
+        }
+        if (is_punctum_inclinatum(shape, true)
+                && *punctum_inclinatum_orientation != shape
+                && *punctum_inclinatum_orientation
+                != S_PUNCTUM_INCLINATUM_UNDETERMINED) {
+            *end_of_glyph = DET_END_OF_PREVIOUS;
+            next_glyph_type = G_PUNCTUM_INCLINATUM;
+            break;
+        }
+        switch (current_glyph_type) {
+        case G_PUNCTUM_INCLINATUM:
+            if (last_pitch < current_pitch) {
+                next_glyph_type = G_2_PUNCTA_INCLINATA_ASCENDENS;
+            } else {
+                next_glyph_type = G_2_PUNCTA_INCLINATA_DESCENDENS;
+            }
+            break;
+        case G_2_PUNCTA_INCLINATA_ASCENDENS:
+            if (last_pitch < current_pitch) {
+                next_glyph_type = G_3_PUNCTA_INCLINATA_ASCENDENS;
+            } else {
+                next_glyph_type = G_PUNCTA_INCLINATA;
+            }
+            break;
+        case G_3_PUNCTA_INCLINATA_ASCENDENS:
+            if (last_pitch < current_pitch) {
+                next_glyph_type = G_4_PUNCTA_INCLINATA_ASCENDENS;
+            } else {
+                next_glyph_type = G_PUNCTA_INCLINATA;
+            }
+            break;
+        case G_4_PUNCTA_INCLINATA_ASCENDENS:
+            if (last_pitch < current_pitch) {
+                next_glyph_type = G_5_PUNCTA_INCLINATA_ASCENDENS;
+            } else {
+                next_glyph_type = G_PUNCTA_INCLINATA;
+            }
+            break;
+        case G_2_PUNCTA_INCLINATA_DESCENDENS:
+            if (last_pitch < current_pitch) {
+                next_glyph_type = G_PUNCTA_INCLINATA;
+            } else {
+                next_glyph_type = G_3_PUNCTA_INCLINATA_DESCENDENS;
+            }
+            break;
+        case G_3_PUNCTA_INCLINATA_DESCENDENS:
+            if (last_pitch < current_pitch) {
+                next_glyph_type = G_PUNCTA_INCLINATA;
+            } else {
+                next_glyph_type = G_4_PUNCTA_INCLINATA_DESCENDENS;
+            }
+            break;
+        case G_4_PUNCTA_INCLINATA_DESCENDENS:
+            if (last_pitch < current_pitch) {
+                next_glyph_type = G_PUNCTA_INCLINATA;
+            } else {
+                next_glyph_type = G_5_PUNCTA_INCLINATA_DESCENDENS;
+            }
+            break;
+        default:
+            next_glyph_type = G_PUNCTA_INCLINATA;
+            break;
+        }
+        break;
+    case S_STROPHA:
+        if (last_pitch != current_pitch) {
+            *end_of_glyph = DET_END_OF_PREVIOUS;
+            next_glyph_type = G_STROPHA;
+            break;
+        }
+        switch (current_glyph_type) {
+        case G_STROPHA:
+            next_glyph_type = G_DISTROPHA;
+            break;
+        case G_DISTROPHA:
+            *end_of_glyph = DET_END_OF_CURRENT;
+            next_glyph_type = G_TRISTROPHA;
+            break;
+        default:
+            *end_of_glyph = DET_END_OF_PREVIOUS;
+            next_glyph_type = G_STROPHA;
+            break;
+        }
+        break;
+    case S_DISTROPHA:
+        if (last_pitch == current_pitch && current_glyph_type == G_STROPHA) {
+            *end_of_glyph = DET_END_OF_CURRENT;
+            next_glyph_type = G_TRISTROPHA;
+        } else {
+            *end_of_glyph = DET_END_OF_PREVIOUS;
+            next_glyph_type = G_DISTROPHA;
+        }
+        break;
+    case S_TRISTROPHA:
+        *end_of_glyph = DET_END_OF_BOTH;
+        next_glyph_type = G_TRISTROPHA;
+        break;
+    default:
+        break;
+    }
+
+    if (current_glyph_type == G_UNDETERMINED) {
+        if (*end_of_glyph == DET_END_OF_PREVIOUS) {
+            *end_of_glyph = DET_NO_END;
+        } else {
+            if (*end_of_glyph == DET_END_OF_BOTH) {
+                *end_of_glyph = DET_END_OF_CURRENT;
+            }
+        }
+    }
+
+    if (last_pitch) {
+        if (current_pitch - last_pitch > MAX_AMBITUS
+                || current_pitch - last_pitch < -MAX_AMBITUS) {
+            if (*end_of_glyph == DET_END_OF_CURRENT
+                    || *end_of_glyph == DET_END_OF_BOTH) {
+                /* add_note_to_a_glyph warns here */
+                *end_of_glyph = DET_END_OF_BOTH;
+            } else {
+                *end_of_glyph = DET_END_OF_PREVIOUS;
+            }
+        }
+    }
+
+    switch (shape) {
+    case S_PUNCTUM_INCLINATUM_ASCENDENS:
+    case S_PUNCTUM_INCLINATUM_STANS:
+    case S_PUNCTUM_INCLINATUM_DESCENDENS:
+        *punctum_inclinatum_orientation = shape;
+        break;
+    case S_PUNCTUM_INCLINATUM_UNDETERMINED:
+        break;
+    default:
+        *punctum_inclinatum_orientation = S_PUNCTUM_INCLINATUM_UNDETERMINED;
+        break;
+    }
+
+    return next_glyph_type;
+
+    #undef this_note_starts_new_glyph
+}
+
+static unsigned char transitions[G_FUSED + 1][SC_COUNT][DIR_COUNT];
+static bool filled[G_FUSED + 1][SC_COUNT][DIR_COUNT];
+
+/* runs the determination code on one input and records its result in the
+ * table, returning false when the entry already holds another result */
+static bool record(const gregorio_glyph_type type, const char pitch,
+        const char last_pitch, const gregorio_shape shape,
+        const gregorio_liquescentia liquescentia,
+        const gregorio_note *const first_note,
+        const gregorio_shape orientation)
+{
+    const gabc_shape_class shape_class = gabc_shape_class_of(shape,
+            liquescentia, first_note, orientation);
+    const gabc_direction direction = gabc_direction_of(pitch, last_pitch);
+    gabc_determination end;
+    gregorio_shape next_orientation = orientation;
+    const gregorio_glyph_type next_type = determine(type, pitch, last_pitch,
+            shape, liquescentia, first_note, &end, &next_orientation);
+    const unsigned char entry = GABC_TRANSITION(next_type, end);
+
+    if (next_orientation != gabc_next_orientation(shape, orientation)) {
+        fprintf(stderr, "Orientation mismatch for %s after %s with shape %d\n",
+                glyph_type_name(next_type), glyph_type_name(type), shape);
+        return false;
+    }
+    if (filled[type][shape_class][direction]) {
+        if (transitions[type][shape_class][direction] != entry) {
+            fprintf(stderr, "Transition mismatch for %s, %s, direction %d: "
+                    "shape %d, liquescentia %d, pitches %d and %d\n",
+                    glyph_type_name(type), shape_class_names[shape_class],
+                    direction, shape, liquescentia, last_pitch, pitch);
+            return false;
+        }
+    } else {
+        transitions[type][shape_class][direction] = entry;
+        filled[type][shape_class][direction] = true;
+    }
+    return true;
+}
+
+/* enumerates all the inputs of add_note_to_a_glyph */
+static bool build(void)
+{
+    gregorio_note first_notes[3];
+    const gregorio_note *first_note;
+    int type, shape, liquescentia, note, orientation, last_pitch, pitch;
+
+    memset(first_notes, 0, sizeof first_notes);
+    first_notes[0].u.note.shape = S_PUNCTUM;
+    first_notes[0].u.note.liquescentia = L_NO_LIQUESCENTIA;
+    first_notes[1].u.note.shape = S_PUNCTUM;
+    first_notes[1].u.note.liquescentia = L_INITIO_DEBILIS;
+    first_notes[2].u.note.shape = S_VIRGA;
+    first_notes[2].u.note.liquescentia = L_NO_LIQUESCENTIA;
+
+    for (type = 0; type <= G_FUSED; ++type) {
+        for (shape = S_UNDETERMINED; shape <= S_LINEA; ++shape) {
+            for (liquescentia = 0; liquescentia < LIQUESCENTIA_COUNT;
+                    ++liquescentia) {
+                /* the glyph has no first note only when it is undetermined */
+                for (note = type == G_UNDETERMINED ? -1 : 0; note < 3; ++note) {
+                    first_note = note < 0 ? NULL : first_notes + note;
+                    for (orientation = 0; orientation < ORIENTATION_COUNT;
+                            ++orientation) {
+                        for (last_pitch = LOWEST_PITCH - 1;
+                                last_pitch <= MAX_PITCH; ++last_pitch) {
+                            for (pitch = LOWEST_PITCH; pitch <= MAX_PITCH;
+                                    ++pitch) {
+                                if (!record((gregorio_glyph_type)type,
+                                            (char)pitch,
+                                            /* 0 for the first note */
+                                            (char)(last_pitch < LOWEST_PITCH
+                                                ? 0 : last_pitch),
+                                            (gregorio_shape)shape,
+                                            liquescentiae[liquescentia],
+                                            first_note,
+                                            orientations[orientation])) {
+                                    return false;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static const char *const header = "\
+/*\n\
+ * Gregorio is a program that translates gabc files to GregorioTeX\n\
+ * This header, generated by encode_glyph_transitions.c, holds the transition\n\
+ * table of the glyph determination automaton; do not edit it.\n\
+ *\n\
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)\n\
+ *\n\
+ * This file is part of Gregorio.\n\
+ *\n";
+
+static const char *const header2 = "\
+ * This program is free software: you can redistribute it and/or modify it\n\
+ * under the terms of the GNU General Public License as published by the Free\n\
+ * Software Foundation, either version 3 of the License, or (at your option)\n\
+ * any later version.\n\
+ *\n";
+
+static const char *const header3 = "\
+ * This program is distributed in the hope that it will be useful, but WITHOUT\n\
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or\n\
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for\n\
+ * more details.\n\
+ *\n\
+ * You should have received a copy of the GNU General Public License along with\n\
+ * this program.  If not, see <http://www.gnu.org/licenses/>.\n\
+ */\n\
+\n";
+
+static const char *const header4 = "\
+#ifndef GABC_GLYPHS_TRANSITIONS_H\n\
+#define GABC_GLYPHS_TRANSITIONS_H\n\
+\n\
+#include \"gabc-glyphs-automaton.h\"\n\
+\n\
+/* indexed by glyph type, shape class and direction, see GABC_TRANSITION */\n\
+static const unsigned char\n\
+gabc_glyph_transitions[G_FUSED + 1][SC_COUNT][DIR_COUNT] = {\n";
+
+int main(int argc, char **argv)
+{
+    FILE *output;
+    int type, shape_class, direction;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s OUTPUT\n", argv[0]);
+        return -1;
+    }
+
+    /* the glyph type must fit in the six upper bits of an entry */
+    if (G_FUSED > 63) {
+        fprintf(stderr, "Too many glyph types for the transition table\n");
+        return 1;
+    }
+    if (!build()) {
+        return 1;
+    }
+    for (type = 0; type <= G_FUSED; ++type) {
+        for (shape_class = 0; shape_class < SC_COUNT; ++shape_class) {
+            for (direction = 0; direction < DIR_COUNT; ++direction) {
+                if (!filled[type][shape_class][direction]) {
+                    fprintf(stderr, "No input for %s, %s, direction %d\n",
+                            glyph_type_name((gregorio_glyph_type)type),
+                            shape_class_names[shape_class], direction);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    output = fopen(argv[1], "wb");
+    if (output == NULL) {
+        fprintf(stderr, "Error creating %s: %s\n", argv[1], strerror(errno));
+        return -1;
+    }
+
+    fputs(header, output);
+    fputs(header2, output);
+    fputs(header3, output);
+    fputs(header4, output);
+    for (type = 0; type <= G_FUSED; ++type) {
+        fprintf(output, "    /* %s */ {\n",
+                glyph_type_name((gregorio_glyph_type)type));
+        for (shape_class = 0; shape_class < SC_COUNT; ++shape_class) {
+            fprintf(output, "        {");
+            for (direction = 0; direction < DIR_COUNT; ++direction) {
+                fprintf(output, " 0x%02x%s",
+                        transitions[type][shape_class][direction],
+                        direction + 1 < DIR_COUNT ? "," : "");
+            }
+            fprintf(output, " }%s /* %s */\n",
+                    shape_class + 1 < SC_COUNT ? "," : "",
+                    shape_class_names[shape_class]);
+        }
+        fprintf(output, "    }%s\n", type < G_FUSED ? "," : "");
+    }
+    fprintf(output, "};\n\n#endif\n");
+
+    if (fclose(output)) {
+        fprintf(stderr, "Error writing %s: %s\n", argv[1], strerror(errno));
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * Utility program to generate tex/gregoriotex-offset-cases.tex from
+ * gregoriotex/gregoriotex-offset-cases.def
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * Gregorio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Gregorio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gregorio.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+typedef struct offset_case {
+    const char *name;
+    const char *v;
+    const char *h;
+} offset_case;
+
+#define OFFSET_CASE(name, v, h) { #name, v, h },
+static const offset_case offset_cases[] = {
+#include "gregoriotex-offset-cases.def"
+    { NULL, NULL, NULL }
+};
+#undef OFFSET_CASE
+
+static const char *const header = "\
+% GregorioTeX file, generated from src/gregoriotex/gregoriotex-offset-cases.def\n\
+% by src/encode_offset_cases.c; do not edit it, edit the list of cases.\n\
+%\n\
+% Copyright (C) 2007-2025 The Gregorio Project (see CONTRIBUTORS.md)\n\
+%\n\
+% This file is part of Gregorio.\n\
+%\n\
+% Gregorio is free software: you can redistribute it and/or modify\n\
+% it under the terms of the GNU General Public License as published by\n\
+% the Free Software Foundation, either version 3 of the License, or\n\
+% (at your option) any later version.\n\
+%\n";
+
+static const char *const header2 = "\
+% Gregorio is distributed in the hope that it will be useful,\n\
+% but WITHOUT ANY WARRANTY; without even the implied warranty of\n\
+% MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the\n\
+% GNU General Public License for more details.\n\
+%\n\
+% You should have received a copy of the GNU General Public License\n\
+% along with Gregorio.  If not, see <http://www.gnu.org/licenses/>.\n\
+\n\
+% this file contains the note offset cases, see \\gre@vepisemaorrare and\n\
+% \\gre@hepisorline in gregoriotex-signs.tex\n\
+\n";
+
+/* writes one of the dispatchers, from the TeX code of the vertical or of the
+ * horizontal episema of each case */
+static void write_dispatcher(FILE *const output, const char *const name,
+        const int vertical)
+{
+    const offset_case *item;
+    const char *code;
+
+    fprintf(output, "\\def\\%s#1#2#3#4{%%\n"
+            "  \\ifcase#1\\gre@bug{Invalid note offset case: \\string#1}%%\n",
+            name);
+    for (item = offset_cases; item->name; ++item) {
+        code = vertical ? item->v : item->h;
+        fprintf(output, "  \\or%s%% %s\n", code ? code : "", item->name);
+    }
+    fprintf(output, "  \\else\\gre@bug{Invalid note offset case: "
+            "\\string#1}%%\n  \\fi%%\n}%%\n\n");
+}
+
+int main(int argc, char **argv)
+{
+    const offset_case *item;
+    FILE *output;
+    int i;
+
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s VERSION OUTPUT\n", argv[0]);
+        return -1;
+    }
+
+    output = fopen(argv[2], "wb");
+    if (output == NULL) {
+        fprintf(stderr, "Error creating %s: %s\n", argv[2], strerror(errno));
+        return -1;
+    }
+
+    fputs(header, output);
+    fputs(header2, output);
+    fprintf(output, "\\gre@declarefileversion{gregoriotex-offset-cases.tex}"
+            "{%s}%% GREGORIO_VERSION\n\n", argv[1]);
+    for (item = offset_cases, i = 1; item->name; ++item, ++i) {
+        fprintf(output, "\\def\\GreOCase%s{%d}%%\n", item->name, i);
+    }
+    fprintf(output, "\n");
+    write_dispatcher(output, "gre@v@case", 1);
+    write_dispatcher(output, "gre@h@case", 0);
+
+    if (fclose(output)) {
+        fprintf(stderr, "Error writing %s: %s\n", argv[2], strerror(errno));
+        return -1;
+    }
+    return 0;
+}
@@ -25,6 +25,7 @@
 #include "bool.h"
 #include "struct.h"
 #include "messages.h"
+#include "stats.h"
 
 #include "gabc.h"
 
@@ -315,9 +316,14 @@ static gregorio_element *gabc_det_elements_from_notes(
         const gregorio_score *const score)
 {
     gregorio_element *final = NULL;
-    gregorio_glyph *tmp = gabc_det_glyphs_from_notes(current_note, current_key,
+    gregorio_glyph *tmp;
+    gregorio_stats_start(STATS_GLYPHS);
+    tmp = gabc_det_glyphs_from_notes(current_note, current_key,
             punctum_inclinatum_orientation, score);
+    gregorio_stats_stop(STATS_GLYPHS);
+    gregorio_stats_start(STATS_ELEMENTS);
     final = gabc_det_elements_from_glyphs(tmp);
+    gregorio_stats_stop(STATS_ELEMENTS);
     return final;
 }
 
@@ -329,7 +335,9 @@ gregorio_element *gabc_det_elements_from_string(char *const str,
 {
     gregorio_element *final;
     gregorio_note *tmp;
+    gregorio_stats_start(STATS_NOTES);
     tmp = gabc_det_notes_from_string(str, macros, loc, score);
+    gregorio_stats_stop(STATS_NOTES);
     final = gabc_det_elements_from_notes(tmp, current_key,
             punctum_inclinatum_orientation, score);
     return final;
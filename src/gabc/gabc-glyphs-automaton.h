@@ -0,0 +1,231 @@
+/*
+ * Gregorio is a program that translates gabc files to GregorioTeX
+ * This header declares the classes of the glyph determination automaton,
+ * shared by gabc-glyphs-determination.c and encode_glyph_transitions.c.
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Adding a note to a glyph depends on the type of the glyph, on the shape of
+ * the note, on its pitch relative to the last note of the glyph and, for a few
+ * shapes, on its liquescentia, on the first note of the glyph and on the
+ * orientation of the preceding puncta inclinata.  These inputs are reduced
+ * here to a shape class and a direction, and the transition table generated
+ * by encode_glyph_transitions.c (gabc-glyphs-transitions.h) gives the new
+ * glyph type and the end of glyph for each glyph type, shape class and
+ * direction.  The generator checks all the inputs against the original
+ * determination code, so any change here or there must be done on both.
+ */
+
+#ifndef GABC_GLYPHS_AUTOMATON_H
+#define GABC_GLYPHS_AUTOMATON_H
+
+#include "bool.h"
+#include "struct.h"
+#include "gabc.h"
+
+typedef enum gabc_shape_class {
+    /* shapes which must not reach the glyph determination */
+    SC_INVALID = 0,
+    SC_LINEA,
+    SC_ALTERATION,
+    /* the liquescentia and the first note of the glyph only matter to
+     * puncta, so they are folded into six punctum classes: without
+     * deminutus, exactly L_DEMINUTUS or deminutus with other bits, each after
+     * a normal punctum or after anything else (the order matters, see
+     * gabc_shape_class_of) */
+    SC_PUNCTUM,
+    SC_PUNCTUM_AFTER_OTHER,
+    SC_PUNCTUM_DEMINUTUS,
+    SC_PUNCTUM_DEMINUTUS_AFTER_OTHER,
+    SC_PUNCTUM_DEMINUTUS_MIXED,
+    SC_PUNCTUM_DEMINUTUS_MIXED_AFTER_OTHER,
+    /* oriscus and quilisma, which always start a glyph */
+    SC_STARTS_GLYPH,
+    SC_VIRGA,
+    SC_VIRGA_REVERSA,
+    SC_BIVIRGA,
+    SC_TRIVIRGA,
+    SC_QUADRATUM,
+    SC_QUILISMA_QUADRATUM,
+    SC_ORISCUS_SCAPUS_ASCENDENS,
+    SC_ORISCUS_SCAPUS_DESCENDENS,
+    SC_PUNCTUM_INCLINATUM,
+    /* a punctum inclinatum which changes the orientation of the preceding
+     * ones */
+    SC_PUNCTUM_INCLINATUM_REORIENTED,
+    SC_STROPHA,
+    SC_DISTROPHA,
+    SC_TRISTROPHA,
+    SC_COUNT
+} gabc_shape_class;
+
+typedef enum gabc_direction {
+    /* also the direction of the first note of a glyph */
+    DIR_UP = 0,
+    DIR_DOWN,
+    DIR_SAME,
+    /* too far (more than MAX_AMBITUS) to be in the same glyph */
+    DIR_FAR,
+    DIR_COUNT
+} gabc_direction;
+
+/* the transition table holds one byte per entry */
+#define GABC_TRANSITION(type, end) ((unsigned char)(((type) << 2) | (end)))
+#define GABC_TRANSITION_TYPE(entry) ((gregorio_glyph_type)((entry) >> 2))
+#define GABC_TRANSITION_END(entry) ((gabc_determination)((entry) & 3))
+
+static __inline bool is_normal_punctum(const gregorio_note *const note)
+{
+    return note->u.note.shape == S_PUNCTUM
+        && note->u.note.liquescentia != L_INITIO_DEBILIS;
+}
+
+static __inline bool is_punctum_inclinatum(const gregorio_shape shape,
+        const bool determined_only)
+{
+    switch (shape) {
+    case S_PUNCTUM_INCLINATUM_ASCENDENS:
+    case S_PUNCTUM_INCLINATUM_STANS:
+    case S_PUNCTUM_INCLINATUM_DESCENDENS:
+        return true;
+    case S_PUNCTUM_INCLINATUM_UNDETERMINED:
+        return !determined_only;
+    default:
+        return false;
+    }
+}
+
+/* first_note is the first note of the glyph, NULL when there is none yet */
+static __inline gabc_shape_class gabc_shape_class_of(
+        const gregorio_shape shape, const gregorio_liquescentia liquescentia,
+        const gregorio_note *const first_note,
+        const gregorio_shape punctum_inclinatum_orientation)
+{
+    int punctum_class;
+
+    switch (shape) {
+    case S_LINEA_PUNCTUM:
+    case S_LINEA:
+        return SC_LINEA;
+    case S_FLAT:
+    case S_FLAT_PAREN:
+    case S_FLAT_SOFT:
+    case S_SHARP:
+    case S_SHARP_PAREN:
+    case S_SHARP_SOFT:
+    case S_NATURAL:
+    case S_NATURAL_PAREN:
+    case S_NATURAL_SOFT:
+        return SC_ALTERATION;
+    case S_PUNCTUM:
+        if (!(liquescentia & L_DEMINUTUS)) {
+            punctum_class = SC_PUNCTUM;
+        } else if (liquescentia == L_DEMINUTUS) {
+            punctum_class = SC_PUNCTUM_DEMINUTUS;
+        } else {
+            punctum_class = SC_PUNCTUM_DEMINUTUS_MIXED;
+        }
+        if (!first_note || !is_normal_punctum(first_note)) {
+            ++punctum_class;
+        }
+        return (gabc_shape_class)punctum_class;
+    case S_ORISCUS_UNDETERMINED:
+    case S_ORISCUS_ASCENDENS:
+    case S_ORISCUS_DESCENDENS:
+    case S_ORISCUS_DEMINUTUS:
+    case S_QUILISMA:
+        return SC_STARTS_GLYPH;
+    case S_VIRGA:
+        return SC_VIRGA;
+    case S_VIRGA_REVERSA:
+        return SC_VIRGA_REVERSA;
+    case S_BIVIRGA:
+        return SC_BIVIRGA;
+    case S_TRIVIRGA:
+        return SC_TRIVIRGA;
+    case S_QUADRATUM:
+        return SC_QUADRATUM;
+    case S_QUILISMA_QUADRATUM:
+        return SC_QUILISMA_QUADRATUM;
+    case S_ORISCUS_SCAPUS_UNDETERMINED:
+    case S_ORISCUS_SCAPUS_ASCENDENS:
+        return SC_ORISCUS_SCAPUS_ASCENDENS;
+    case S_ORISCUS_SCAPUS_DESCENDENS:
+        return SC_ORISCUS_SCAPUS_DESCENDENS;
+    case S_PUNCTUM_INCLINATUM_UNDETERMINED:
+    case S_PUNCTUM_INCLINATUM_ASCENDENS:
+    case S_PUNCTUM_INCLINATUM_STANS:
+    case S_PUNCTUM_INCLINATUM_DESCENDENS:
+        if (is_punctum_inclinatum(shape, true)
+                && punctum_inclinatum_orientation != shape
+                && punctum_inclinatum_orientation
+                != S_PUNCTUM_INCLINATUM_UNDETERMINED) {
+            return SC_PUNCTUM_INCLINATUM_REORIENTED;
+        }
+        return SC_PUNCTUM_INCLINATUM;
+    case S_STROPHA:
+        return SC_STROPHA;
+    case S_DISTROPHA:
+        return SC_DISTROPHA;
+    case S_TRISTROPHA:
+        return SC_TRISTROPHA;
+    default:
+        return SC_INVALID;
+    }
+}
+
+/* last_pitch is 0 for the first note of a glyph */
+static __inline gabc_direction gabc_direction_of(const char current_pitch,
+        const char last_pitch)
+{
+    const int interval = current_pitch - last_pitch;
+
+    if (!last_pitch) {
+        return DIR_UP;
+    }
+    if (interval > MAX_AMBITUS || interval < -MAX_AMBITUS) {
+        return DIR_FAR;
+    }
+    if (interval > 0) {
+        return DIR_UP;
+    }
+    if (interval < 0) {
+        return DIR_DOWN;
+    }
+    return DIR_SAME;
+}
+
+/* the orientation of the puncta inclinata after adding a note of this shape */
+static __inline gregorio_shape gabc_next_orientation(const gregorio_shape shape,
+        const gregorio_shape punctum_inclinatum_orientation)
+{
+    switch (shape) {
+    case S_PUNCTUM_INCLINATUM_ASCENDENS:
+    case S_PUNCTUM_INCLINATUM_STANS:
+    case S_PUNCTUM_INCLINATUM_DESCENDENS:
+        return shape;
+    case S_PUNCTUM_INCLINATUM_UNDETERMINED:
+        return punctum_inclinatum_orientation;
+    default:
+        return S_PUNCTUM_INCLINATUM_UNDETERMINED;
+    }
+}
+
+#endif
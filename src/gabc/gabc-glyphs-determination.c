@@ -28,6 +28,8 @@
 #include "messages.h"
 
 #include "gabc.h"
+#include "gabc-glyphs-automaton.h"
+#include "gabc-glyphs-transitions.h"
 
 static __inline gregorio_scanner_location *copy_note_location(
         const gregorio_note *const note, gregorio_scanner_location *const loc)
@@ -41,27 +43,6 @@ static __inline gregorio_scanner_location *copy_note_location(
     return loc;
 }
 
-static __inline bool is_normal_punctum(const gregorio_note *const note)
-{
-    return note->u.note.shape == S_PUNCTUM
-        && note->u.note.liquescentia != L_INITIO_DEBILIS;
-}
-
-static __inline bool is_punctum_inclinatum(const gregorio_shape shape,
-        const bool determined_only)
-{
-    switch (shape) {
-    case S_PUNCTUM_INCLINATUM_ASCENDENS:
-    case S_PUNCTUM_INCLINATUM_STANS:
-    case S_PUNCTUM_INCLINATUM_DESCENDENS:
-        return true;
-    case S_PUNCTUM_INCLINATUM_UNDETERMINED:
-        return !determined_only;
-    default:
-        return false;
-    }
-}
-
 /****************************
  *
  * This function is the basis of all the determination of glyphs. The
@@ -109,401 +90,50 @@ static char add_note_to_a_glyph(gregorio_glyph_type current_glyph_type,
         gabc_determination *end_of_glyph,
         gregorio_shape *punctum_inclinatum_orientation)
 {
-    #define this_note_starts_new_glyph { \
-        next_glyph_type = G_PUNCTUM; \
-        *end_of_glyph = DET_END_OF_PREVIOUS; \
-    }
-
-    /* next glyph type is the type of the glyph that will be returned (the
-     * new type of the glyph with the note added to it, or the type of the
-     * new glyph with the note alone. */
-    gregorio_glyph_type next_glyph_type = G_UNDETERMINED;
-
-    *end_of_glyph = DET_NO_END;
-
-    /* here we separate notes that would be logically in the same glyph
-     * but that are too far to be so */
-    if (last_pitch) {
-        if (current_pitch - last_pitch > MAX_AMBITUS
-                || current_pitch - last_pitch < -MAX_AMBITUS) {
-            current_glyph_type = G_UNDETERMINED;
-        }
-    }
-
-    switch (shape) {
-    case S_LINEA_PUNCTUM:
-    case S_LINEA:
-        next_glyph_type = G_PUNCTUM;
-        *end_of_glyph = DET_END_OF_BOTH;
-        break;
-    case S_FLAT:
-    case S_FLAT_PAREN:
-    case S_FLAT_SOFT:
-    case S_SHARP:
-    case S_SHARP_PAREN:
-    case S_SHARP_SOFT:
-    case S_NATURAL:
-    case S_NATURAL_PAREN:
-    case S_NATURAL_SOFT:
-        next_glyph_type = G_ALTERATION;
-        *end_of_glyph = DET_END_OF_BOTH;
-        break;
-    case S_PUNCTUM:
-        /*
-         * we determine here the shape of the thing if it is made of puncta
-         */
-        if (current_pitch == last_pitch) {
-            this_note_starts_new_glyph;
-            break;
-        }
-        switch (current_glyph_type) {
-        case G_PUNCTUM:
-            if (current_pitch > last_pitch) {
-                next_glyph_type = G_PODATUS;
-            } else {
-                next_glyph_type = G_FLEXA;
-            }
-            break;
-        case G_PODATUS:
-            if (current_pitch > last_pitch) {
-                if (is_normal_punctum(current_glyph_first_note)) {
-                    next_glyph_type = G_SCANDICUS;
-                    *end_of_glyph = DET_END_OF_CURRENT;
-                } else {
-                    this_note_starts_new_glyph;
-                }
-            } else {
-                next_glyph_type = G_TORCULUS;
-            }
-            break;
-        case G_PES_QUADRATUM_FIRST_PART:
-            if (current_pitch > last_pitch) {
-                next_glyph_type = G_PES_QUADRATUM;
-                *end_of_glyph = DET_END_OF_CURRENT;
-            } else {
-                next_glyph_type = G_FLEXA;
-            }
-            break;
-        case G_PES_QUILISMA_QUADRATUM_FIRST_PART:
-            if (current_pitch > last_pitch) {
-                next_glyph_type = G_PES_QUADRATUM;
-                *end_of_glyph = DET_END_OF_CURRENT;
-            } else {
-                this_note_starts_new_glyph;
-            }
-            break;
-        case G_PES_ASCENDENS_ORISCUS:
-        case G_PES_DESCENDENS_ORISCUS:
-            if (current_pitch > last_pitch) {
-                next_glyph_type = G_SALICUS;
-            } else {
-                this_note_starts_new_glyph;
-            }
-            break;
-        case G_SALICUS:
-            if (current_pitch < last_pitch) {
-                next_glyph_type = G_SALICUS_FLEXUS;
-                *end_of_glyph = DET_END_OF_CURRENT;
-            } else {
-                this_note_starts_new_glyph;
-            }
-            break;
-        case G_FLEXA:
-            if (current_pitch > last_pitch) {
-                if (is_normal_punctum(current_glyph_first_note)) {
-                    next_glyph_type = G_PORRECTUS;
-                } else {
-                    this_note_starts_new_glyph;
-                }
-            } else {
-                if (liquescentia & L_DEMINUTUS) {
-                    *end_of_glyph = DET_END_OF_CURRENT;
-                    next_glyph_type = G_ANCUS;
-                } else {
-                    this_note_starts_new_glyph;
-                }
-            }
-            break;
-        case G_TORCULUS:
-            if (current_pitch > last_pitch) {
-                next_glyph_type = G_TORCULUS_RESUPINUS;
-            } else if (liquescentia == L_DEMINUTUS) {
-                *end_of_glyph = DET_END_OF_CURRENT;
-                next_glyph_type = G_TORCULUS_LIQUESCENS;
-            } else {
-                this_note_starts_new_glyph;
-            }
-            break;
-        case G_TORCULUS_RESUPINUS:
-            if (current_pitch > last_pitch) {
-                this_note_starts_new_glyph;
-            } else {
-                *end_of_glyph = DET_END_OF_CURRENT;
-                next_glyph_type = G_TORCULUS_RESUPINUS_FLEXUS;
-            }
-            break;
-        case G_PORRECTUS:
-            if (current_pitch > last_pitch) {
-                this_note_starts_new_glyph;
-            } else {
-                *end_of_glyph = DET_END_OF_CURRENT;
-                next_glyph_type = G_PORRECTUS_FLEXUS;
-            }
-            break;
-        default:
-            this_note_starts_new_glyph;
-            break;
-        }
-        break;
-    case S_ORISCUS_UNDETERMINED:
-    case S_ORISCUS_ASCENDENS:
-    case S_ORISCUS_DESCENDENS:
-    case S_ORISCUS_DEMINUTUS:
-    case S_QUILISMA:
-        this_note_starts_new_glyph;
-        break;
-    case S_VIRGA:
-        if (current_glyph_type == G_VIRGA && last_pitch == current_pitch) {
-            next_glyph_type = G_BIVIRGA;
-        } else {
-            if (current_glyph_type == G_BIVIRGA && last_pitch == current_pitch) {
-                next_glyph_type = G_TRIVIRGA;
-            } else {
-                *end_of_glyph = DET_END_OF_PREVIOUS;
-                next_glyph_type = G_VIRGA;
-            }
-        }
-        break;
-    case S_VIRGA_REVERSA:
-        *end_of_glyph = DET_END_OF_PREVIOUS;
-        next_glyph_type = G_VIRGA_REVERSA;
-        break;
-    case S_BIVIRGA:
-        if (current_glyph_type == G_VIRGA && last_pitch == current_pitch) {
-            *end_of_glyph = DET_END_OF_CURRENT;
-            next_glyph_type = G_TRIVIRGA;
-        } else {
-            *end_of_glyph = DET_END_OF_PREVIOUS;
-            next_glyph_type = G_BIVIRGA;
-        }
-        break;
-    case S_TRIVIRGA:
-        *end_of_glyph = DET_END_OF_BOTH;
-        next_glyph_type = G_TRIVIRGA;
-        break;
-    case S_QUADRATUM:
-        *end_of_glyph = DET_END_OF_PREVIOUS;
-        next_glyph_type = G_PES_QUADRATUM_FIRST_PART;
-        break;
-    case S_QUILISMA_QUADRATUM:
-        *end_of_glyph = DET_END_OF_PREVIOUS;
-        next_glyph_type = G_PES_QUILISMA_QUADRATUM_FIRST_PART;
-        break;
-    case S_ORISCUS_SCAPUS_UNDETERMINED:
-    case S_ORISCUS_SCAPUS_ASCENDENS:
-        if (current_glyph_type == G_PUNCTUM && last_pitch < current_pitch) {
-            next_glyph_type = G_PES_ASCENDENS_ORISCUS;
-            /* Therefore G_PES_ASCENDENS_ORISCUS might be fronting an
-             * undetermined oriscus scapus.  This will be resolved during
-             * oriscus orientation determination */
-        } else {
-            this_note_starts_new_glyph;
-        }
-        break;
-    case S_ORISCUS_SCAPUS_DESCENDENS:
-        if (current_glyph_type == G_PUNCTUM && last_pitch < current_pitch) {
-            next_glyph_type = G_PES_DESCENDENS_ORISCUS;
-        } else {
-            this_note_starts_new_glyph;
-        }
-        break;
-    case S_PUNCTUM_INCLINATUM_UNDETERMINED:
-    case S_PUNCTUM_INCLINATUM_ASCENDENS:
-    case S_PUNCTUM_INCLINATUM_STANS:
-    case S_PUNCTUM_INCLINATUM_DESCENDENS:
-        /*
-         * Warning : this part of the code is specific to the
-         * declarations of the header file
-         */
-        if (current_glyph_type > G_PUNCTA_INCLINATA) {
-            /*
-             * meaning that the previous glyph is not a combination of puncta
-             * inclinata, see header file for details
-             */
-            *end_of_glyph = DET_END_OF_PREVIOUS;
-            next_glyph_type = G_PUNCTUM_INCLINATUM;
-            break;
-        }
-        if (current_pitch == last_pitch) {
-            *end_of_glyph = DET_END_OF_PREVIOUS;
-            next_glyph_type = G_PUNCTUM_INCLINATUM;
-            break;
-        }
-        if (is_punctum_inclinatum(shape, true)
-                && *punctum_inclinatum_orientation != shape
-                && *punctum_inclinatum_orientation
-                != S_PUNCTUM_INCLINATUM_UNDETERMINED) {
-            /* change of orientation ends the glyph */
-            *end_of_glyph = DET_END_OF_PREVIOUS;
-            next_glyph_type = G_PUNCTUM_INCLINATUM;
-            break;
-        }
-        switch (current_glyph_type) {
-        case G_PUNCTUM_INCLINATUM:
-            if (last_pitch < current_pitch) {
-                next_glyph_type = G_2_PUNCTA_INCLINATA_ASCENDENS;
-            } else {
-                next_glyph_type = G_2_PUNCTA_INCLINATA_DESCENDENS;
-            }
-            break;
-        case G_2_PUNCTA_INCLINATA_ASCENDENS:
-            if (last_pitch < current_pitch) {
-                next_glyph_type = G_3_PUNCTA_INCLINATA_ASCENDENS;
-            } else {
-                next_glyph_type = G_PUNCTA_INCLINATA;
-            }
-            break;
-        case G_3_PUNCTA_INCLINATA_ASCENDENS:
-            if (last_pitch < current_pitch) {
-                next_glyph_type = G_4_PUNCTA_INCLINATA_ASCENDENS;
-            } else {
-                next_glyph_type = G_PUNCTA_INCLINATA;
-            }
-            break;
-        case G_4_PUNCTA_INCLINATA_ASCENDENS:
-            if (last_pitch < current_pitch) {
-                next_glyph_type = G_5_PUNCTA_INCLINATA_ASCENDENS;
-            } else {
-                next_glyph_type = G_PUNCTA_INCLINATA;
-            }
-            break;
-        case G_2_PUNCTA_INCLINATA_DESCENDENS:
-            if (last_pitch < current_pitch) {
-                next_glyph_type = G_PUNCTA_INCLINATA;
-            } else {
-                next_glyph_type = G_3_PUNCTA_INCLINATA_DESCENDENS;
-            }
-            break;
-        case G_3_PUNCTA_INCLINATA_DESCENDENS:
-            if (last_pitch < current_pitch) {
-                next_glyph_type = G_PUNCTA_INCLINATA;
-            } else {
-                next_glyph_type = G_4_PUNCTA_INCLINATA_DESCENDENS;
-            }
-            break;
-        case G_4_PUNCTA_INCLINATA_DESCENDENS:
-            if (last_pitch < current_pitch) {
-                next_glyph_type = G_PUNCTA_INCLINATA;
-            } else {
-                next_glyph_type = G_5_PUNCTA_INCLINATA_DESCENDENS;
-            }
-            break;
-        default:
-            next_glyph_type = G_PUNCTA_INCLINATA;
-            break;
-        }
-        break;
-    case S_STROPHA:
-        if (last_pitch != current_pitch) {
-            *end_of_glyph = DET_END_OF_PREVIOUS;
-            next_glyph_type = G_STROPHA;
-            break;
-        }
-        switch (current_glyph_type) {
-        case G_STROPHA:
-            next_glyph_type = G_DISTROPHA;
-            break;
-        case G_DISTROPHA:
-            *end_of_glyph = DET_END_OF_CURRENT;
-            next_glyph_type = G_TRISTROPHA;
-            break;
-        default:
-            *end_of_glyph = DET_END_OF_PREVIOUS;
-            next_glyph_type = G_STROPHA;
-            break;
-        }
-        break;
-    case S_DISTROPHA:
-        if (last_pitch == current_pitch && current_glyph_type == G_STROPHA) {
-            *end_of_glyph = DET_END_OF_CURRENT;
-            next_glyph_type = G_TRISTROPHA;
-        } else {
-            *end_of_glyph = DET_END_OF_PREVIOUS;
-            next_glyph_type = G_DISTROPHA;
-        }
-        break;
-    case S_TRISTROPHA:
-        *end_of_glyph = DET_END_OF_BOTH;
-        next_glyph_type = G_TRISTROPHA;
-        break;
-    default:
+    /* the determination is done by the transition table, see
+     * gabc-glyphs-automaton.h and encode_glyph_transitions.c, which also
+     * holds the code this table comes from */
+    const gabc_shape_class shape_class = gabc_shape_class_of(shape,
+            liquescentia, current_glyph_first_note,
+            *punctum_inclinatum_orientation);
+    const gabc_direction direction = gabc_direction_of(current_pitch,
+            last_pitch);
+    const unsigned char transition =
+            gabc_glyph_transitions[current_glyph_type][shape_class][direction];
+
+    if (shape_class == SC_INVALID) {
         /* not reachable unless there's a programming error */
         /* LCOV_EXCL_START */
         gregorio_fail2(add_note_to_a_glyph, "unexpected shape: %s",
                 gregorio_shape_to_string(shape));
-        break;
         /* LCOV_EXCL_STOP */
     }
-    /* end of the main switch */
-
-    if (current_glyph_type == G_UNDETERMINED) {
-        /*
-         * means that this is the first glyph or that the previous glyph has
-         * already been added
-         */
-        if (*end_of_glyph == DET_END_OF_PREVIOUS) {
-            *end_of_glyph = DET_NO_END;
-        } else {
-            if (*end_of_glyph == DET_END_OF_BOTH) {
-                *end_of_glyph = DET_END_OF_CURRENT;
-            }
-        }
-    }
+
+    *end_of_glyph = GABC_TRANSITION_END(transition);
 
     /*
      * WARNING : Ugly section of the code, just some kind of patch for it to work
      * with fonts that can't handle large intervals.
      */
-    /* here we separate notes that would be logically in the same glyph
-     * but that are too far to be so, we already said to the function that
-     * it was not the same glyph, there we must say that the previous
-     * glyph has ended. */
-    if (last_pitch) {
-        if (current_pitch - last_pitch > MAX_AMBITUS
-                || current_pitch - last_pitch < -MAX_AMBITUS) {
-            if (*end_of_glyph == DET_END_OF_CURRENT
-                    || *end_of_glyph == DET_END_OF_BOTH) {
-                /* There is no current way for the code to end up here, but
-                 * we'll leave it in because it's a good safety precaution in
-                 * case something new is added in the future */
-                /* LCOV_EXCL_START */
-                gregorio_message(_("Encountered the need to switch "
-                            "DET_END_OF_CURRENT to DET_END_OF_BOTH because of "
-                            "overly large ambitus"),
-                            "add_note_to_a_glyph", VERBOSITY_WARNING,
-                            __LINE__);
-                *end_of_glyph = DET_END_OF_BOTH;
-            } else {
-                /* LCOV_EXCL_STOP */
-                *end_of_glyph = DET_END_OF_PREVIOUS;
-            }
-        }
+    /* notes that are too far are never in the same glyph, and a note which
+     * would end its glyph then also ends the previous one */
+    if (direction == DIR_FAR && *end_of_glyph == DET_END_OF_BOTH) {
+        /* There is no current way for the code to end up here, but
+         * we'll leave it in because it's a good safety precaution in
+         * case something new is added in the future */
+        /* LCOV_EXCL_START */
+        gregorio_message(_("Encountered the need to switch "
+                    "DET_END_OF_CURRENT to DET_END_OF_BOTH because of "
+                    "overly large ambitus"),
+                    "add_note_to_a_glyph", VERBOSITY_WARNING,
+                    __LINE__);
+        /* LCOV_EXCL_STOP */
     }
 
-    switch (shape) {
-    case S_PUNCTUM_INCLINATUM_ASCENDENS:
-    case S_PUNCTUM_INCLINATUM_STANS:
-    case S_PUNCTUM_INCLINATUM_DESCENDENS:
-        *punctum_inclinatum_orientation = shape;
-        break;
-    case S_PUNCTUM_INCLINATUM_UNDETERMINED:
-        break;
-    default:
-        *punctum_inclinatum_orientation = S_PUNCTUM_INCLINATUM_UNDETERMINED;
-        break;
-    }
+    *punctum_inclinatum_orientation = gabc_next_orientation(shape,
+            *punctum_inclinatum_orientation);
 
-    return next_glyph_type;
+    return GABC_TRANSITION_TYPE(transition);
 }
 
 static bool is_cavum(gregorio_note *note, gregorio_note *last_note)
@@ -0,0 +1,983 @@
+/*
+ * Gregorio is a program that translates gabc files to GregorioTeX
+ * This file implements the incremental parsing of a gabc text.
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A session keeps a gabc text with its score, so that an editor can apply
+ * edits to the text and get the score again without parsing the whole text.
+ *
+ * An edit is parsed again with the whole words it touches and a guard word on
+ * each side, resuming the parser from the state it had after the syllable
+ * before the first guard, and the passes which follow the parse (oriscus and
+ * punctum inclinatum orientation, ledger lines, custos suppression and
+ * pitches) are run on these words only.  The guard words are chosen so that
+ * no pass looks through them: each has a note which is not a punctum
+ * inclinatum and notes of two different pitches, and no brace, slur, variable
+ * ledger line or h-episema adjustment is open across them.  The syllables
+ * between the guards then replace the old ones, but only if the guards come
+ * out of this parse exactly as they were, if the state of the parser after the
+ * last guard is the one it had, and if nothing was reported; otherwise, the
+ * whole text is parsed again.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bool.h"
+#include "struct.h"
+#include "messages.h"
+#include "support.h"
+#include "sha1.h"
+#include "xxh3.h"
+#include "gabc.h"
+
+/* what the session knows of a syllable */
+typedef struct syllable_info {
+    gregorio_syllable *syllable;
+    /* the byte offset of its start in the text and its location */
+    size_t start;
+    unsigned short line, offset;
+    /* the clef and the state of the parser after it */
+    gregorio_clef_info clef;
+    gabc_syllable_state state;
+} syllable_info;
+
+/* the syllables of a parse, recorded by record_syllable */
+typedef struct syllable_record {
+    syllable_info *infos;
+    size_t count, capacity;
+    const char *text;
+    size_t length;
+    /* the bytes of text before the start of the parse */
+    size_t shift;
+    /* the scanner position in text */
+    size_t position;
+    unsigned short line, offset;
+} syllable_record;
+
+struct gabc_session {
+    char *text;
+    size_t length, capacity;
+    gregorio_score *score;
+    /* the syllables, or none if they could not be located */
+    syllable_record syllables;
+    /* the start of the first syllable, where the headers end */
+    size_t body;
+    /* the part of the text which was parsed again by the last edit */
+    size_t changed_start, changed_end;
+    /* the messages reported by the headers alone */
+    unsigned int header_messages;
+    bool point_and_click;
+    gregorio_digest_algorithm algorithm;
+};
+
+static __inline bool is_continuation_byte(const char c)
+{
+    return ((unsigned char)c & 0xc0u) == 0x80u;
+}
+
+/* moves the scanner position of record to the given location, which is after
+ * it, counting lines and characters like gabc_update_location */
+static size_t byte_at(syllable_record *const record, const unsigned short line,
+        const unsigned short offset)
+{
+    while (record->position < record->length
+            && (record->line != line || record->offset != offset
+                || is_continuation_byte(record->text[record->position]))) {
+        const char c = record->text[record->position++];
+        if (c == '\n') {
+            ++record->line;
+            record->offset = 0;
+        } else if (!is_continuation_byte(c)) {
+            ++record->offset;
+        }
+    }
+    return record->position;
+}
+
+static void record_syllable(void *const data,
+        const gregorio_scanner_location *const start,
+        const gabc_syllable_state *const state)
+{
+    syllable_record *const record = (syllable_record *)data;
+    syllable_info *info;
+
+    if (!record->infos || record->count >= record->capacity) {
+        record->infos = gregorio_grow_buffer(record->infos, &record->capacity,
+                syllable_info);
+    }
+    info = record->infos + record->count++;
+    memset(info, 0, sizeof *info);
+    info->start = byte_at(record, start->first_line, start->first_offset)
+            + record->shift;
+    info->line = start->first_line;
+    info->offset = start->first_offset;
+    info->state = *state;
+}
+
+static void start_record(syllable_record *const record, const char *const text,
+        const size_t length, const size_t shift)
+{
+    record->count = 0;
+    record->text = text;
+    record->length = length;
+    record->shift = shift;
+    record->position = 0;
+    record->line = 1;
+    record->offset = 0;
+}
+
+/* fills the syllable pointers and the clefs of the record from the score it
+ * was recorded for, starting with clef; returns false if they don't match */
+static bool finish_record(syllable_record *const record,
+        const gregorio_score *const score, gregorio_clef_info clef)
+{
+    gregorio_syllable *syllable;
+    size_t count = 0, i;
+
+    for (syllable = score->first_syllable; syllable;
+            syllable = syllable->next_syllable) {
+        ++count;
+    }
+    if (count + 1 == record->count) {
+        /* gregorio_fix_initial_keys removed a first syllable with nothing
+         * but the initial clef */
+        memmove(record->infos, record->infos + 1,
+                count * sizeof(syllable_info));
+        record->count = count;
+    }
+    if (count != record->count) {
+        record->count = 0;
+        return false;
+    }
+    for (syllable = score->first_syllable, i = 0; syllable;
+            syllable = syllable->next_syllable, ++i) {
+        const gregorio_element *element;
+        for (element = syllable->elements[0]; element;
+                element = element->next) {
+            if (element->type == GRE_CLEF) {
+                clef = element->u.misc.clef;
+            }
+        }
+        record->infos[i].syllable = syllable;
+        record->infos[i].clef = clef;
+    }
+    return true;
+}
+
+/* parses text; clef and state are NULL except to resume the parse */
+static gregorio_score *parse(const gabc_session *const session,
+        const char *const text, const size_t length,
+        const gregorio_clef_info *const clef,
+        const gabc_syllable_state *const state,
+        syllable_record *const record)
+{
+    gregorio_score *score;
+    FILE *const f = tmpfile();
+
+    if (!f) {
+        gregorio_message(_("unable to create a temporary file"),
+                "gabc_session", VERBOSITY_ERROR, 0);
+        return NULL;
+    }
+    if (fwrite(text, 1, length, f) != length || fseek(f, 0, SEEK_SET)) {
+        gregorio_message(_("unable to write a temporary file"),
+                "gabc_session", VERBOSITY_ERROR, 0);
+        fclose(f);
+        return NULL;
+    }
+    score = gabc_read_score_part(f, session->point_and_click,
+            session->algorithm, clef, state, record? record_syllable : NULL,
+            record);
+    fclose(f);
+    /* the lexer must start afresh for the next parse */
+    gabc_score_determination_lex_destroy();
+    return score;
+}
+
+static void compute_digest(const gabc_session *const session)
+{
+    struct sha1_ctx sha1;
+    struct xxh3_ctx xxh3;
+
+    switch (session->algorithm) {
+    case DIGEST_XXH3:
+        xxh3_init_ctx(&xxh3);
+        xxh3_process_bytes(GREGORIO_VERSION, strlen(GREGORIO_VERSION), &xxh3);
+        xxh3_process_bytes(session->text, session->length, &xxh3);
+        xxh3_finish_ctx(&xxh3, session->score->digest);
+        break;
+    default:
+        sha1_init_ctx(&sha1);
+        sha1_process_bytes(GREGORIO_VERSION, strlen(GREGORIO_VERSION), &sha1);
+        sha1_process_bytes(session->text, session->length, &sha1);
+        sha1_finish_ctx(&sha1, session->score->digest);
+        break;
+    }
+}
+
+/* parses the whole text again */
+static bool parse_all(gabc_session *const session)
+{
+    gregorio_score *score;
+    syllable_record *const record = &session->syllables;
+    gregorio_score *headers;
+    char *text;
+
+    session->changed_start = 0;
+    session->changed_end = session->length;
+    start_record(record, session->text, session->length, 0);
+    score = parse(session, session->text, session->length, NULL, NULL,
+            record);
+    if (!score) {
+        record->count = 0;
+        return false;
+    }
+    if (session->score) {
+        gregorio_free_score(session->score);
+    }
+    session->score = score;
+    session->body = record->count? record->infos[0].start : session->length;
+    if (score->number_of_voices != 1 || !score->first_voice_info
+            || !finish_record(record, score,
+                score->first_voice_info->initial_clef) || !record->count) {
+        record->count = 0;
+        return true;
+    }
+
+    /* the headers alone, for the messages they report when they are parsed
+     * again with some words; the grammar wants a syllable before the end of
+     * the file, so they get an empty one */
+    text = gregorio_malloc(session->body + 2);
+    memcpy(text, session->text, session->body);
+    memcpy(text + session->body, "()", 2);
+    gregorio_hold_messages(true);
+    headers = parse(session, text, session->body + 2, &gregorio_default_clef,
+            &record->infos[0].state, NULL);
+    session->header_messages = gregorio_held_message_count();
+    gregorio_hold_messages(false);
+    free(text);
+    if (headers) {
+        gregorio_free_score(headers);
+    } else {
+        record->count = 0;
+    }
+    return true;
+}
+
+gabc_session *gabc_session_new(const char *const text, const size_t length,
+        const bool point_and_click,
+        const gregorio_digest_algorithm algorithm)
+{
+    gabc_session *const session = gregorio_calloc(1, sizeof(gabc_session));
+
+    session->capacity = length + 1;
+    session->text = gregorio_malloc(session->capacity);
+    memcpy(session->text, text, length);
+    session->length = length;
+    session->point_and_click = point_and_click;
+    session->algorithm = algorithm;
+    session->syllables.capacity = 16;
+    if (!parse_all(session)) {
+        gabc_session_free(session);
+        return NULL;
+    }
+    return session;
+}
+
+void gabc_session_free(gabc_session *const session)
+{
+    if (session) {
+        if (session->score) {
+            gregorio_free_score(session->score);
+        }
+        free(session->syllables.infos);
+        free(session->text);
+        free(session);
+    }
+}
+
+/* parses the whole text again, for a score none of whose syllables were
+ * written: gregoriotex positions the notes of a syllable in place, and only
+ * once */
+void gabc_session_reparse(gabc_session *const session)
+{
+    parse_all(session);
+}
+
+gregorio_score *gabc_session_score(const gabc_session *const session)
+{
+    return session->score;
+}
+
+const char *gabc_session_text(const gabc_session *const session,
+        size_t *const length)
+{
+    *length = session->length;
+    return session->text;
+}
+
+/* the bytes of the text which the last call to gabc_session_new or
+ * gabc_session_edit parsed, from start to end (excluded) */
+void gabc_session_changed_range(const gabc_session *const session,
+        size_t *const start, size_t *const end)
+{
+    *start = session->changed_start;
+    *end = session->changed_end;
+}
+
+static __inline bool ends_word(const gregorio_syllable *const syllable)
+{
+    return syllable->position == WORD_END
+        || syllable->position == WORD_ONE_SYLLABLE;
+}
+
+static size_t word_start(const syllable_info *const infos, size_t i)
+{
+    while (i > 0 && !ends_word(infos[i - 1].syllable)) {
+        --i;
+    }
+    return i;
+}
+
+static size_t word_end(const syllable_info *const infos, const size_t count,
+        size_t i)
+{
+    while (i + 1 < count && !ends_word(infos[i].syllable)) {
+        ++i;
+    }
+    return i;
+}
+
+/* whether no pass looks through the syllables from first to last: they have
+ * a note which is not a punctum inclinatum and notes of two pitches */
+static bool is_guard(const syllable_info *const infos, const size_t first,
+        const size_t last)
+{
+    size_t i;
+    signed char pitch = 0;
+    bool two_pitches = false, steady = false;
+
+    for (i = first; i <= last; ++i) {
+        const gregorio_element *element;
+        for (element = infos[i].syllable->elements[0]; element;
+                element = element->next) {
+            const gregorio_glyph *glyph;
+            if (element->type != GRE_ELEMENT) {
+                continue;
+            }
+            for (glyph = element->u.first_glyph; glyph; glyph = glyph->next) {
+                const gregorio_note *note;
+                if (glyph->type != GRE_GLYPH) {
+                    continue;
+                }
+                for (note = glyph->u.notes.first_note; note;
+                        note = note->next) {
+                    if (note->type != GRE_NOTE) {
+                        continue;
+                    }
+                    if (!pitch) {
+                        pitch = note->u.note.pitch;
+                    } else if (note->u.note.pitch != pitch) {
+                        two_pitches = true;
+                    }
+                    switch (note->u.note.shape) {
+                    case S_PUNCTUM_INCLINATUM_UNDETERMINED:
+                    case S_PUNCTUM_INCLINATUM_ASCENDENS:
+                    case S_PUNCTUM_INCLINATUM_STANS:
+                    case S_PUNCTUM_INCLINATUM_DESCENDENS:
+                    case S_PUNCTUM_INCLINATUM_DEMINUTUS:
+                    case S_PUNCTUM_INCLINATUM_AUCTUS:
+                        break;
+                    default:
+                        steady = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    return two_pitches && steady && !infos[last].state.notes_pending;
+}
+
+static __inline bool same_string(const char *const a, const char *const b)
+{
+    return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+static __inline bool same_texverb(const unsigned short a,
+        const unsigned short b)
+{
+    return same_string(a? gregorio_texverb(a) : NULL,
+            b? gregorio_texverb(b) : NULL);
+}
+
+static bool same_extra_info(const gregorio_extra_info *const a,
+        const gregorio_extra_info *const b)
+{
+    return a->bar == b->bar && a->space == b->space && a->nlba == b->nlba
+        && a->eol_ragged == b->eol_ragged
+        && a->eol_forces_custos == b->eol_forces_custos
+        && a->eol_forces_custos_on == b->eol_forces_custos_on
+        && same_string(a->ad_hoc_space_factor, b->ad_hoc_space_factor);
+}
+
+static bool same_clef(const gregorio_clef_info *const a,
+        const gregorio_clef_info *const b)
+{
+    return a->line == b->line && a->secondary_line == b->secondary_line
+        && a->pitch_difference == b->pitch_difference && a->clef == b->clef
+        && a->flatted == b->flatted && a->secondary_clef == b->secondary_clef
+        && a->secondary_flatted == b->secondary_flatted;
+}
+
+static bool same_misc(const gregorio_type type,
+        const gregorio_misc_element_info *const a,
+        const gregorio_misc_element_info *const b)
+{
+    switch (type) {
+    case GRE_CUSTOS:
+        return a->pitched.pitch == b->pitched.pitch
+            && a->pitched.force_pitch == b->pitched.force_pitch;
+    case GRE_CLEF:
+        return same_clef(&a->clef, &b->clef);
+    default:
+        return a->unpitched.special_sign == b->unpitched.special_sign
+            && same_extra_info(&a->unpitched.info, &b->unpitched.info);
+    }
+}
+
+/* compares what the parse determines of two notes, leaving out what the
+ * positioning of gregoriotex changes and the identifiers of variable items */
+static bool same_note(const gregorio_note *const a,
+        const gregorio_note *const b)
+{
+    if (a->type != b->type || a->signs != b->signs
+            || a->special_sign != b->special_sign
+            || a->mora_vposition != b->mora_vposition
+            || a->high_ledger_specificity != b->high_ledger_specificity
+            || a->low_ledger_specificity != b->low_ledger_specificity
+            || (a->high_ledger_specificity
+                && a->high_ledger_line != b->high_ledger_line)
+            || (a->low_ledger_specificity
+                && a->low_ledger_line != b->low_ledger_line)
+            || !a->he_adjustment_index[SO_OVER]
+                != !b->he_adjustment_index[SO_OVER]
+            || !a->he_adjustment_index[SO_UNDER]
+                != !b->he_adjustment_index[SO_UNDER]
+            || a->choral_sign_is_nabc != b->choral_sign_is_nabc
+            || !same_string(a->choral_sign, b->choral_sign)
+            || !same_string(a->shape_hint, b->shape_hint)
+            || !same_texverb(a->texverb, b->texverb)) {
+        return false;
+    }
+    switch (a->type) {
+    case GRE_NOTE:
+        return a->u.note.pitch == b->u.note.pitch
+            && a->u.note.shape == b->u.note.shape
+            && a->u.note.liquescentia == b->u.note.liquescentia
+            && a->u.note.is_cavum == b->u.note.is_cavum;
+    case GRE_CLEF:
+        return same_clef(&a->u.clef, &b->u.clef);
+    default:
+        return same_extra_info(&a->u.other, &b->u.other);
+    }
+}
+
+static bool same_glyph(const gregorio_glyph *const a,
+        const gregorio_glyph *const b)
+{
+    const gregorio_note *na, *nb;
+
+    if (a->type != b->type || !same_texverb(a->texverb, b->texverb)) {
+        return false;
+    }
+    if (a->type != GRE_GLYPH) {
+        return same_misc(a->type, &a->u.misc, &b->u.misc);
+    }
+    if (a->u.notes.glyph_type != b->u.notes.glyph_type
+            || a->u.notes.liquescentia != b->u.notes.liquescentia
+            || a->u.notes.is_cavum != b->u.notes.is_cavum) {
+        return false;
+    }
+    for (na = a->u.notes.first_note, nb = b->u.notes.first_note; na && nb;
+            na = na->next, nb = nb->next) {
+        if (!same_note(na, nb)) {
+            return false;
+        }
+    }
+    return !na && !nb;
+}
+
+static bool same_element(const gregorio_element *const a,
+        const gregorio_element *const b)
+{
+    size_t i;
+
+    if (a->type != b->type || !same_texverb(a->texverb, b->texverb)
+            || a->nabc_lines != b->nabc_lines) {
+        return false;
+    }
+    for (i = 0; i < a->nabc_lines; ++i) {
+        if (!same_string(a->nabc[i], b->nabc[i])) {
+            return false;
+        }
+    }
+    if (a->type == GRE_ELEMENT) {
+        const gregorio_glyph *ga, *gb;
+        for (ga = a->u.first_glyph, gb = b->u.first_glyph; ga && gb;
+                ga = ga->next, gb = gb->next) {
+            if (!same_glyph(ga, gb)) {
+                return false;
+            }
+        }
+        return !ga && !gb;
+    }
+    return same_misc(a->type, &a->u.misc, &b->u.misc);
+}
+
+static bool same_characters(const gregorio_character *a,
+        const gregorio_character *b)
+{
+    for (; a && b; a = a->next_character, b = b->next_character) {
+        if (a->is_character != b->is_character) {
+            return false;
+        }
+        if (a->is_character) {
+            if (a->cos.character != b->cos.character) {
+                return false;
+            }
+        } else if (a->cos.s.style != b->cos.s.style
+                || a->cos.s.type != b->cos.s.type) {
+            return false;
+        }
+    }
+    return !a && !b;
+}
+
+static bool same_syllable(const gregorio_syllable *const a,
+        const gregorio_syllable *const b)
+{
+    const gregorio_element *ea, *eb;
+
+    if (a->position != b->position || a->translation_type != b->translation_type
+            || a->no_linebreak_area != b->no_linebreak_area
+            || a->euouae != b->euouae || a->first_word != b->first_word
+            || a->forced_center != b->forced_center || a->clear != b->clear
+            || !same_string(a->abovelinestext, b->abovelinestext)
+            || !same_characters(a->text, b->text)
+            || !same_characters(a->translation, b->translation)) {
+        return false;
+    }
+    for (ea = a->elements[0], eb = b->elements[0]; ea && eb;
+            ea = ea->next, eb = eb->next) {
+        if (!same_element(ea, eb)) {
+            return false;
+        }
+    }
+    return !ea && !eb;
+}
+
+static bool same_state(const syllable_info *const a,
+        const syllable_info *const b)
+{
+    return a->state.current_key == b->state.current_key
+        && a->state.punctum_inclinatum_orientation
+            == b->state.punctum_inclinatum_orientation
+        && a->state.styles == b->state.styles
+        && a->state.notes_pending == b->state.notes_pending
+        && same_clef(&a->clef, &b->clef);
+}
+
+/* the column of the given character offset in the line starting at start */
+static unsigned short column_of(const char *const text, const size_t start,
+        const unsigned short offset)
+{
+    gregorio_scanner_location loc;
+    size_t end;
+
+    memset(&loc, 0, sizeof loc);
+    for (end = start; loc.last_offset < offset && text[end] != '\n'; ++end) {
+        gabc_update_location(&loc, text + end, 1);
+    }
+    return loc.last_column;
+}
+
+/* the byte offset of the start of the line holding the given byte */
+static size_t line_start(const char *const text, size_t byte)
+{
+    while (byte > 0 && text[byte - 1] != '\n') {
+        --byte;
+    }
+    return byte;
+}
+
+/* how the locations of the syllables of a fragment, or of the syllables after
+ * an edit, change */
+typedef struct relocation {
+    /* the locations at line, from offset on, move to new_line and by
+     * offset_shift, and those on the following lines by line_shift */
+    unsigned short line, offset, new_line;
+    int offset_shift, line_shift;
+    /* the start of new_line in the text */
+    size_t new_line_start;
+    const char *text;
+} relocation;
+
+static void relocate(const relocation *const r, unsigned short *const line,
+        unsigned short *const column, unsigned short *const offset)
+{
+    if (*line == r->line && *offset >= r->offset) {
+        *line = r->new_line;
+        *offset = (unsigned short)(*offset + r->offset_shift);
+        *column = column_of(r->text, r->new_line_start, *offset);
+    } else if (*line > r->line) {
+        *line = (unsigned short)(*line + r->line_shift);
+    }
+}
+
+/* relocates the syllables from first to last (or to the end of the score if
+ * last is NULL), stopping after the first line when lines don't move */
+static void relocate_syllables(const relocation *const r,
+        gregorio_syllable *syllable, const gregorio_syllable *const last)
+{
+    for (; syllable; syllable = syllable->next_syllable) {
+        const gregorio_element *element;
+        bool after = false;
+        if (syllable->src_line) {
+            after = syllable->src_line > r->line;
+            relocate(r, &syllable->src_line, &syllable->src_column,
+                    &syllable->src_offset);
+        }
+        for (element = syllable->elements[0]; element;
+                element = element->next) {
+            const gregorio_glyph *glyph;
+            if (element->type != GRE_ELEMENT) {
+                continue;
+            }
+            for (glyph = element->u.first_glyph; glyph; glyph = glyph->next) {
+                gregorio_note *note;
+                if (glyph->type != GRE_GLYPH) {
+                    continue;
+                }
+                for (note = glyph->u.notes.first_note; note;
+                        note = note->next) {
+                    after = after || note->src_line > r->line;
+                    relocate(r, &note->src_line, &note->src_column,
+                            &note->src_offset);
+                }
+            }
+        }
+        if (syllable == last || (after && !r->line_shift)) {
+            break;
+        }
+    }
+}
+
+/* the number of lines and of characters on the last line of text */
+static void count_location(const char *const text, const size_t length,
+        unsigned short *const lines, unsigned short *const offset)
+{
+    size_t i;
+
+    *lines = 0;
+    *offset = 0;
+    for (i = 0; i < length; ++i) {
+        if (text[i] == '\n') {
+            ++*lines;
+            *offset = 0;
+        } else if (!is_continuation_byte(text[i])) {
+            ++*offset;
+        }
+    }
+}
+
+/*
+ * Parses again the words around the edit, from the syllable lead to the
+ * syllable tail (included, tail being session->syllables.count for no
+ * trailing guard), the edit being between the syllables first and last
+ * (included).  Returns false if the whole text must be parsed again.
+ */
+static bool parse_window(gabc_session *const session, const size_t lead,
+        const size_t first, const size_t last, const size_t tail,
+        const long delta, gregorio_syllable **const first_changed,
+        gregorio_syllable **const last_changed)
+{
+    syllable_record *const record = &session->syllables;
+    syllable_info *const infos = record->infos;
+    const size_t start = infos[lead].start;
+    const bool has_tail = tail < record->count;
+    const size_t lead_count = first - lead;
+    const size_t tail_count = has_tail? tail - last : 0;
+    /* the end of the window in the edited text */
+    const size_t end = (tail + 1 < record->count
+            ? infos[tail + 1].start : session->length - delta) + delta;
+    const size_t length = session->body + end - start;
+    syllable_record fragment;
+    gregorio_score *score;
+    char *text;
+    bool ok;
+    size_t i, inner;
+    unsigned short lines, offset;
+    relocation r;
+    gregorio_syllable *before, *after, *old_first, *old_last;
+
+    text = gregorio_malloc(length);
+    memcpy(text, session->text, session->body);
+    memcpy(text + session->body, session->text + start, end - start);
+    memset(&fragment, 0, sizeof fragment);
+    fragment.capacity = 16;
+    start_record(&fragment, text, length, start - session->body);
+
+    gregorio_hold_messages(true);
+    score = parse(session, text, length, &infos[lead - 1].clef,
+            &infos[lead - 1].state, &fragment);
+    ok = score && gregorio_held_message_count() == session->header_messages
+            && finish_record(&fragment, score, infos[lead - 1].clef)
+            && fragment.count >= lead_count + tail_count;
+    gregorio_hold_messages(false);
+
+    /* the guards must be the same */
+    for (i = 0; ok && i < lead_count; ++i) {
+        ok = fragment.infos[i].start == infos[lead + i].start
+            && same_syllable(fragment.infos[i].syllable,
+                    infos[lead + i].syllable);
+    }
+    for (i = 0; ok && i < tail_count; ++i) {
+        const syllable_info *const new_info =
+                fragment.infos + fragment.count - tail_count + i;
+        ok = new_info->start == infos[last + 1 + i].start + delta
+            && same_syllable(new_info->syllable,
+                    infos[last + 1 + i].syllable);
+    }
+    if (ok && has_tail) {
+        ok = same_state(fragment.infos + fragment.count - 1, infos + tail);
+    }
+    inner = fragment.count - lead_count - tail_count;
+
+    /* the locations in the fragment after the headers move to the window */
+    count_location(text, session->body, &lines, &offset);
+    r.line = (unsigned short)(lines + 1);
+    r.offset = offset;
+    r.new_line = infos[lead].line;
+    r.offset_shift = infos[lead].offset - offset;
+    r.line_shift = infos[lead].line - (lines + 1);
+    r.new_line_start = line_start(session->text, start);
+    r.text = session->text;
+
+    if (!ok) {
+        if (score) {
+            gregorio_free_score(score);
+        }
+        free(fragment.infos);
+        free(text);
+        return false;
+    }
+
+    /* the syllables after the edit move with it */
+    if (has_tail) {
+        const syllable_info *const new_tail =
+                fragment.infos + fragment.count - tail_count;
+        relocation after_edit;
+        unsigned short new_line = new_tail->line, new_offset = new_tail->offset,
+                ignored = 0;
+        relocate(&r, &new_line, &ignored, &new_offset);
+        after_edit.line = infos[last + 1].line;
+        after_edit.offset = infos[last + 1].offset;
+        after_edit.new_line = new_line;
+        after_edit.offset_shift = new_offset - after_edit.offset;
+        after_edit.line_shift = new_line - after_edit.line;
+        after_edit.new_line_start = line_start(session->text,
+                infos[last + 1].start + delta);
+        after_edit.text = session->text;
+        relocate_syllables(&after_edit, infos[last + 1].syllable, NULL);
+        for (i = last + 1; i < record->count; ++i) {
+            unsigned short column = 0;
+            infos[i].start += delta;
+            relocate(&after_edit, &infos[i].line, &column, &infos[i].offset);
+        }
+    }
+
+    /* replace the syllables between the guards */
+    old_first = infos[first].syllable;
+    old_last = infos[last].syllable;
+    before = old_first->previous_syllable;
+    after = old_last->next_syllable;
+    old_last->next_syllable = NULL;
+    gregorio_free_syllables(&old_first, 1);
+    if (inner) {
+        gregorio_syllable *const new_first =
+                fragment.infos[lead_count].syllable;
+        gregorio_syllable *const new_last =
+                fragment.infos[lead_count + inner - 1].syllable;
+        relocate_syllables(&r, new_first, new_last);
+        if (new_first->previous_syllable) {
+            new_first->previous_syllable->next_syllable =
+                    new_last->next_syllable;
+        } else {
+            score->first_syllable = new_last->next_syllable;
+        }
+        if (new_last->next_syllable) {
+            new_last->next_syllable->previous_syllable =
+                    new_first->previous_syllable;
+        }
+        new_first->previous_syllable = before;
+        new_last->next_syllable = after;
+        before->next_syllable = new_first;
+        if (after) {
+            after->previous_syllable = new_last;
+        }
+        for (i = lead_count; i < lead_count + inner; ++i) {
+            unsigned short column = 0;
+            relocate(&r, &fragment.infos[i].line, &column,
+                    &fragment.infos[i].offset);
+        }
+    } else {
+        before->next_syllable = after;
+        if (after) {
+            after->previous_syllable = before;
+        }
+    }
+    gregorio_free_score(score);
+
+    if (inner != last + 1 - first) {
+        const size_t count = record->count - (last + 1 - first) + inner;
+        while (count > record->capacity) {
+            record->infos = gregorio_grow_buffer(record->infos,
+                    &record->capacity, syllable_info);
+        }
+        memmove(record->infos + first + inner, record->infos + last + 1,
+                (record->count - last - 1) * sizeof(syllable_info));
+        record->count = count;
+    }
+    memcpy(record->infos + first, fragment.infos + lead_count,
+            inner * sizeof(syllable_info));
+    free(fragment.infos);
+    free(text);
+
+    session->changed_start = start;
+    session->changed_end = end;
+
+    /* links to the next pitches may point into the old syllables */
+    gregorio_determine_next_pitches(session->score);
+
+    *first_changed = record->infos[lead].syllable;
+    *last_changed = has_tail
+            ? record->infos[first + inner + tail_count - 1].syllable
+            : record->infos[record->count - 1].syllable;
+    return true;
+}
+
+/*
+ * Replaces the bytes of the text from start to end (excluded) by replacement.
+ * Returns true if only the syllables from *first_changed to *last_changed
+ * changed (the others being the same structures), and false if the whole
+ * score was parsed again (*first_changed and *last_changed being then its
+ * first and last syllables).  The score must not be used any more after a
+ * call returning false if gabc_session_score returns NULL.  A start after end
+ * or after the end of the text changes nothing and returns false with
+ * *first_changed and *last_changed set to NULL.
+ */
+bool gabc_session_edit(gabc_session *const session, const size_t start,
+        size_t end, const char *const replacement,
+        const size_t replacement_length,
+        gregorio_syllable **const first_changed,
+        gregorio_syllable **const last_changed)
+{
+    const syllable_record *const record = &session->syllables;
+    long delta;
+    size_t first, last, lead, tail;
+    gregorio_syllable *syllable;
+
+    if (start > end || start > session->length) {
+        *first_changed = *last_changed = NULL;
+        return false;
+    }
+    if (end > session->length) {
+        end = session->length;
+    }
+    delta = (long)replacement_length - (long)(end - start);
+
+    /* edit the text */
+    if (session->length + delta + 1 > session->capacity) {
+        session->capacity = session->length + delta + 1;
+        session->text = gregorio_realloc(session->text, session->capacity);
+    }
+    memmove(session->text + start + replacement_length, session->text + end,
+            session->length - end);
+    memcpy(session->text + start, replacement, replacement_length);
+    session->length += delta;
+
+    if (record->count > 2 && start > record->infos[1].start) {
+        /* the syllables holding the start and the end of the edit */
+        for (first = record->count - 1; record->infos[first].start > start;
+                --first) {
+        }
+        for (last = record->count - 1; record->infos[last].start > end;
+                --last) {
+        }
+        first = word_start(record->infos, first);
+        last = word_end(record->infos, record->count, last);
+        /* a guard word on each side; the edit may be in the first word when
+         * it follows the first syllable */
+        lead = first;
+        while (lead > 0) {
+            lead = word_start(record->infos, lead - 1);
+            if (lead <= 1 || is_guard(record->infos, lead,
+                        word_end(record->infos, record->count, lead))) {
+                break;
+            }
+        }
+        if (lead > 1 && !record->infos[lead - 1].state.notes_pending
+                && !record->infos[lead].syllable->first_word) {
+            tail = last;
+            do {
+                if (tail + 1 >= record->count) {
+                    tail = record->count;
+                    break;
+                }
+                tail = word_end(record->infos, record->count, tail + 1);
+            } while (!is_guard(record->infos, last + 1, tail));
+            if (tail == record->count) {
+                /* the window runs to the end of the text, and so do the
+                 * syllables it replaces */
+                last = record->count - 1;
+            }
+            if (parse_window(session, lead, first, last, tail, delta,
+                        first_changed, last_changed)) {
+                compute_digest(session);
+                return true;
+            }
+        }
+    }
+
+    parse_all(session);
+    *first_changed = *last_changed = NULL;
+    if (session->score) {
+        *first_changed = session->score->first_syllable;
+        for (syllable = *first_changed; syllable && syllable->next_syllable;
+                syllable = syllable->next_syllable) {
+        }
+        *last_changed = syllable;
+    }
+    return false;
+}
@@ -41,6 +41,7 @@ typedef union gabc_score_determination_lval_t {
 YY_DECL;
 
 #define YYLTYPE gregorio_scanner_location
+extern YYLTYPE gabc_score_determination_lloc;
 
 void gabc_suppress_extra_custos_at_linebreak(gregorio_score *score);
 void gabc_fix_custos_pitches(gregorio_score *score_to_check);
@@ -40,7 +40,10 @@
 #include "characters.h"
 #include "support.h"
 #include "sha1.h"
+#include "xxh3.h"
 #include "plugins.h"
+#include "stats.h"
+#include "nabc.h"
 #include "gabc.h"
 
 #define YYLLOC_DEFAULT(Current, Rhs, N) \
@@ -117,7 +120,9 @@ static int current_key;
 static bool got_language;
 static bool got_staff_lines;
 static bool started_first_word;
+static gregorio_digest_algorithm digest_algorithm;
 static struct sha1_ctx digester;
+static struct xxh3_ctx fingerprinter;
 /* used to track styles that stay open across syllables */
 static gabc_style_bits styles;
 static bool generate_point_and_click;
@@ -141,6 +146,18 @@ static bool has_protrusion;
  * require a cut of the glyph. */
 static gregorio_shape punctum_inclinatum_orientation;
 
+/* when not NULL, the parse resumes from this clef and syllable state, after
+ * the first syllable of a score (see gabc_read_score_part) */
+static const gregorio_clef_info *resume_clef;
+/* called at the end of each syllable, when not NULL */
+static gabc_syllable_handler syllable_handler;
+static void *syllable_handler_data;
+/* whether the score is being parsed, for gabc_current_location */
+static bool parsing = false;
+/* whether the passes which only prepare the score for GregorioTeX are
+ * skipped (see gabc_read_canonical_score) */
+static bool canonical = false;
+
 static __inline void check_multiple(const char *name, bool exists) {
     if (exists) {
         gregorio_messagef("det_score", VERBOSITY_WARNING, 0,
@@ -159,7 +176,14 @@ static void gabc_score_determination_error(const char *error_str)
  * The function that will initialize the variables.
  */
 
-static void initialize_variables(bool point_and_click)
+static char position;
+static gregorio_syllable *current_syllable;
+static char *abovelinestext;
+unsigned char nabc_state = 0;
+size_t nabc_lines = 0;
+
+static void initialize_variables(bool point_and_click,
+        const gabc_syllable_state *const state)
 {
     int i;
     /* build a brand new empty score */
@@ -179,7 +203,8 @@ static void initialize_variables(bool point_and_click)
     no_linebreak_area = NLBA_NORMAL;
     euouae = EUOUAE_NORMAL;
     center_is_determined = CENTER_NOT_DETERMINED;
-    current_key = gregorio_calculate_new_key(gregorio_default_clef);
+    current_key = gregorio_calculate_new_key(resume_clef? *resume_clef
+            : gregorio_default_clef);
     for (i = 0; i < 10; i++) {
         macros[i] = NULL;
     }
@@ -188,9 +213,19 @@ static void initialize_variables(bool point_and_click)
     started_first_word = false;
     styles = 0;
     punctum_inclinatum_orientation = S_PUNCTUM_INCLINATUM_UNDETERMINED;
+    if (state) {
+        styles = (gabc_style_bits)state->styles;
+        punctum_inclinatum_orientation = state->punctum_inclinatum_orientation;
+    }
     generate_point_and_click = point_and_click;
     clear_syllable_text = false;
     has_protrusion = false;
+    /* these stay set at the end of a parse */
+    position = WORD_BEGINNING;
+    current_syllable = NULL;
+    abovelinestext = NULL;
+    nabc_state = 0;
+    nabc_lines = 0;
 }
 
 /*
@@ -202,6 +237,8 @@ static void free_variables(void)
 {
     int i;
     free(elements);
+    /* a parse which stops before the end of the definitions has none */
+    elements = NULL;
     for (i = 0; i < 10; i++) {
         free(macros[i]);
     }
@@ -235,10 +272,6 @@ static void end_definitions(void)
  * precisely determined here, we separate the text describing the notes of each
  * voice, and we call determine_elements_from_string to really determine them.
  */
-static char position = WORD_BEGINNING;
-static gregorio_syllable *current_syllable = NULL;
-static char *abovelinestext = NULL;
-
 /*
  * Function called each time we find a space, it updates the current position.
  */
@@ -286,9 +319,9 @@ static void ready_characters(void)
 {
     if (current_character) {
         gregorio_go_to_first_character_c(&current_character);
-        if (!score->first_syllable || (current_syllable
+        if (!resume_clef && (!score->first_syllable || (current_syllable
                 && !current_syllable->previous_syllable
-                && !current_syllable->text)) {
+                && !current_syllable->text))) {
             started_first_word = true;
         }
     }
@@ -312,7 +345,7 @@ static void rebuild_score_characters(void)
                 }
             }
 
-            if (syllable == score->first_syllable) {
+            if (syllable == score->first_syllable && !resume_clef) {
                 /* leave the first syllable text untouched at this time */
                 continue;
             }
@@ -509,7 +542,7 @@ static void add_auto_protrusion(char *protrusion)
  * Function to close a syllable and update the position.
  */
 
-static void close_syllable(YYLTYPE *loc)
+static void close_syllable(YYLTYPE *const loc, const bool has_text)
 {
     int i = 0;
     gregorio_character *ch;
@@ -562,8 +595,8 @@ static void close_syllable(YYLTYPE *loc)
 
     gregorio_add_syllable(&current_syllable, number_of_voices, elements,
             first_text_character, first_translation_character, position,
-            abovelinestext, translation_type, no_linebreak_area, euouae, loc,
-            started_first_word, clear_syllable_text);
+            abovelinestext, translation_type, no_linebreak_area, euouae,
+            has_text? loc : NULL, started_first_word, clear_syllable_text);
     if (!score->first_syllable) {
         /* we rebuild the first syllable if we have to */
         score->first_syllable = current_syllable;
@@ -597,11 +630,27 @@ static void close_syllable(YYLTYPE *loc)
     current_element = NULL;
     clear_syllable_text = false;
     has_protrusion = false;
+
+    if (syllable_handler) {
+        gabc_syllable_state state;
+        state.current_key = current_key;
+        state.punctum_inclinatum_orientation = punctum_inclinatum_orientation;
+        state.styles = (unsigned char)styles;
+        state.notes_pending = gabc_det_notes_pending();
+        syllable_handler(syllable_handler_data, loc, &state);
+    }
 }
 
 void gabc_digest(const void *const buf, const size_t size)
 {
-    sha1_process_bytes(buf, size, &digester);
+    switch (digest_algorithm) {
+    case DIGEST_XXH3:
+        xxh3_process_bytes(buf, size, &fingerprinter);
+        break;
+    default:
+        sha1_process_bytes(buf, size, &digester);
+        break;
+    }
 }
 
 /*
@@ -610,43 +659,162 @@ void gabc_digest(const void *const buf, const size_t size)
  * aleady open. It returns a valid gregorio_score
  */
 
-gregorio_score *gabc_read_score(FILE *f_in, bool point_and_click)
+gregorio_score *gabc_read_score(FILE *f_in, bool point_and_click,
+        gregorio_digest_algorithm algorithm)
+{
+    return gabc_read_score_part(f_in, point_and_click, algorithm, NULL, NULL,
+            NULL, NULL);
+}
+
+/*
+ * Reads a gabc file for gabc_write_canonical_score, like gabc_read_score but
+ * without the passes which only prepare the score for GregorioTeX: the
+ * orientation of the oriscus and punctum inclinatum, the ledger lines, the
+ * custos and the next pitches.  What the file leaves to gregorio is thus
+ * still left to it when the score is written back, and a file is formatted in
+ * about the time it takes to parse it.
+ */
+gregorio_score *gabc_read_canonical_score(FILE *f_in)
 {
-    /* compute the SHA-1 digest while parsing, for I/O efficiency */
+    gregorio_score *result;
+    canonical = true;
+    /* the digest is not used, so take the fastest */
+    result = gabc_read_score_part(f_in, false, DIGEST_XXH3, NULL, NULL, NULL,
+            NULL);
+    canonical = false;
+    return result;
+}
+
+/*
+ * Reads a gabc file like gabc_read_score, calling handler (if not NULL) at the
+ * end of each syllable with the location of its start and the state of the
+ * parser.  If clef is not NULL, the syllables of the file are taken as coming
+ * after the first syllable of a score, with clef as the current clef and state
+ * as the state left by the syllable before them: the first syllable keeps its
+ * clef and its text is handled like the others.
+ */
+gregorio_score *gabc_read_score_part(FILE *f_in, bool point_and_click,
+        gregorio_digest_algorithm algorithm, const gregorio_clef_info *clef,
+        const gabc_syllable_state *state, gabc_syllable_handler handler,
+        void *handler_data)
+{
+    gregorio_stats_start(STATS_READ);
+    /* compute the digest while parsing, for I/O efficiency */
+    digest_algorithm = algorithm;
     sha1_init_ctx(&digester);
+    xxh3_init_ctx(&fingerprinter);
     /* digest GREGORIO_VERSION to get a different value when the version
     changes */
-    sha1_process_bytes(GREGORIO_VERSION, strlen(GREGORIO_VERSION), &digester);
+    gabc_digest(GREGORIO_VERSION, strlen(GREGORIO_VERSION));
     /* the input file that flex will parse */
     gabc_score_determination_in = f_in;
     gregorio_assert(f_in, gabc_read_score, "can't read stream from NULL",
             return NULL);
-    initialize_variables(point_and_click);
+    resume_clef = clef;
+    syllable_handler = handler;
+    syllable_handler_data = handler_data;
+    initialize_variables(point_and_click, clef? state : NULL);
     /* the flex/bison main call, it will build the score (that we have
      * initialized) */
+    gregorio_stats_start(STATS_PARSE);
+    parsing = true;
     gabc_score_determination_parse();
-    if (!score->legacy_oriscus_orientation) {
+    parsing = false;
+    gregorio_stats_stop(STATS_PARSE);
+    if (!canonical && !score->legacy_oriscus_orientation) {
+        gregorio_stats_start(STATS_ORISCUS_ORIENTATION);
         gabc_determine_oriscus_orientation(score);
+        gregorio_stats_stop(STATS_ORISCUS_ORIENTATION);
+    }
+    if (!canonical) {
+        gregorio_stats_start(STATS_PUNCTUM_INCLINATUM_ORIENTATION);
+        gabc_determine_punctum_inclinatum_orientation(score);
+        gregorio_stats_stop(STATS_PUNCTUM_INCLINATUM_ORIENTATION);
+        gregorio_stats_start(STATS_LEDGER_LINES);
+        gabc_determine_ledger_lines(score);
+        gregorio_stats_stop(STATS_LEDGER_LINES);
+    }
+    gregorio_stats_start(STATS_INITIAL_KEYS);
+    if (resume_clef) {
+        score->first_voice_info->initial_clef = *resume_clef;
+    } else {
+        gregorio_fix_initial_keys(score, gregorio_default_clef);
     }
-    gabc_determine_punctum_inclinatum_orientation(score);
-    gabc_determine_ledger_lines(score);
-    gregorio_fix_initial_keys(score, gregorio_default_clef);
+    gregorio_stats_stop(STATS_INITIAL_KEYS);
+    gregorio_stats_start(STATS_SCORE_CHARACTERS);
     rebuild_score_characters();
-    gabc_suppress_extra_custos_at_linebreak(score);
-    gabc_fix_custos_pitches(score);
+    gregorio_stats_stop(STATS_SCORE_CHARACTERS);
+    if (!canonical) {
+        gregorio_stats_start(STATS_CUSTOS_SUPPRESSION);
+        gabc_suppress_extra_custos_at_linebreak(score);
+        gregorio_stats_stop(STATS_CUSTOS_SUPPRESSION);
+        gregorio_stats_start(STATS_NEXT_PITCHES);
+        gregorio_determine_next_pitches(score);
+        gregorio_stats_stop(STATS_NEXT_PITCHES);
+        gregorio_stats_start(STATS_CUSTOS_PITCHES);
+        gabc_fix_custos_pitches(score);
+        gregorio_stats_stop(STATS_CUSTOS_PITCHES);
+    }
     gabc_det_notes_finish();
     free_variables();
     /* then we check the validity and integrity of the score we have built. */
-    if (!gabc_check_score_integrity(score)) {
+    gregorio_stats_start(STATS_INTEGRITY);
+    if (!resume_clef && !gabc_check_score_integrity(score)) {
         gregorio_message(_("unable to determine a valid score from file"),
                 "gabc_read_score", VERBOSITY_ERROR, 0);
     }
-    sha1_finish_ctx(&digester, score->digest);
+    gregorio_stats_stop(STATS_INTEGRITY);
+    score->digest_algorithm = digest_algorithm;
+    switch (digest_algorithm) {
+    case DIGEST_XXH3:
+        xxh3_finish_ctx(&fingerprinter, score->digest);
+        break;
+    default:
+        sha1_finish_ctx(&digester, score->digest);
+        break;
+    }
+    resume_clef = NULL;
+    syllable_handler = NULL;
+    gregorio_stats_stop(STATS_READ);
     return score;
 }
 
-unsigned char nabc_state = 0;
-size_t nabc_lines = 0;
+/*
+ * The location of what the parser is reading, for a front end which reports
+ * the messages with their location (see lsp.c), or NULL outside of the parse
+ * itself.  It is the note being read by the notes lexer when it runs, and the
+ * last token of the score lexer otherwise.
+ */
+const gregorio_scanner_location *gabc_current_location(void)
+{
+    const gregorio_scanner_location *const notes_location =
+            gabc_det_notes_location();
+
+    if (notes_location) {
+        return notes_location;
+    }
+    return parsing? &gabc_score_determination_lloc : NULL;
+}
+
+/* reports the errors in a nabc string, loc being the location of its start */
+static void check_nabc(const char *const nabc, const YYLTYPE *const loc)
+{
+    size_t offset;
+    const char *error;
+    YYLTYPE error_loc;
+
+    if (gregorio_nabc_parse(nabc, NULL, NULL, NULL, &offset, &error)) {
+        return;
+    }
+    error_loc = *loc;
+    error_loc.last_line = loc->first_line;
+    error_loc.last_column = loc->first_column;
+    error_loc.last_offset = loc->first_offset;
+    gabc_update_location(&error_loc, nabc, offset);
+    gregorio_messagef("det_score", VERBOSITY_ERROR, 0,
+            _("%s in \"%s\" at line %u, column %u"), error, nabc,
+            error_loc.last_line, error_loc.last_column + 1);
+}
 
 static void gabc_y_add_notes(char *notes, YYLTYPE loc) {
     if (nabc_state == 0) {
@@ -678,6 +846,7 @@ static void gabc_y_add_notes(char *notes, YYLTYPE loc) {
             current_element->nabc = (char **) gregorio_calloc (nabc_lines,
                     sizeof (char *));
         }
+        check_nabc(notes, &loc);
         current_element->nabc[nabc_state-1] = gregorio_strdup(notes);
         current_element->nabc_lines = nabc_state;
     }
@@ -1086,68 +1255,68 @@ above_line_text:
 syllable_with_notes:
     text OPENING_BRACKET notes {
         save_text();
-        close_syllable(&@1);
+        close_syllable(&@1, true);
     }
     | HYPHEN OPENING_BRACKET notes {
         add_style(ST_VERBATIM, SB_IGNORE);
         add_text(gregorio_strdup("\\GreForceHyphen"));
         end_style(ST_VERBATIM, SB_IGNORE);
         save_text();
-        close_syllable(&@1);
+        close_syllable(&@1, true);
     }
     | text HYPHEN OPENING_BRACKET notes {
         add_style(ST_VERBATIM, SB_IGNORE);
         add_text(gregorio_strdup("\\GreForceHyphen"));
         end_style(ST_VERBATIM, SB_IGNORE);
         save_text();
-        close_syllable(&@1);
+        close_syllable(&@1, true);
     }
     | PROTRUDING_PUNCTUATION OPENING_BRACKET notes {
         add_auto_protrusion($1.text);
         save_text();
-        close_syllable(&@1);
+        close_syllable(&@1, true);
     }
     | text PROTRUDING_PUNCTUATION OPENING_BRACKET notes {
         add_auto_protrusion($2.text);
         save_text();
-        close_syllable(&@1);
+        close_syllable(&@1, true);
     }
     | text translation OPENING_BRACKET notes {
         save_text();
-        close_syllable(&@1);
+        close_syllable(&@1, true);
     }
     | HYPHEN translation OPENING_BRACKET notes {
         add_style(ST_VERBATIM, SB_IGNORE);
         add_text(gregorio_strdup("\\GreForceHyphen"));
         end_style(ST_VERBATIM, SB_IGNORE);
         save_text();
-        close_syllable(&@1);
+        close_syllable(&@1, true);
     }
     | text HYPHEN translation OPENING_BRACKET notes {
         add_style(ST_VERBATIM, SB_IGNORE);
         add_text(gregorio_strdup("\\GreForceHyphen"));
         end_style(ST_VERBATIM, SB_IGNORE);
         save_text();
-        close_syllable(&@1);
+        close_syllable(&@1, true);
     }
     | PROTRUDING_PUNCTUATION translation OPENING_BRACKET notes {
         add_auto_protrusion($1.text);
         save_text();
-        close_syllable(&@1);
+        close_syllable(&@1, true);
     }
     | text PROTRUDING_PUNCTUATION translation OPENING_BRACKET notes {
         add_auto_protrusion($2.text);
         save_text();
-        close_syllable(&@1);
+        close_syllable(&@1, true);
     }
     ;
 
 notes_without_word:
     OPENING_BRACKET notes {
-        close_syllable(NULL);
+        close_syllable(&@1, false);
     }
     | translation OPENING_BRACKET notes {
-        close_syllable(NULL);
+        close_syllable(&@1, false);
     }
     ;
 
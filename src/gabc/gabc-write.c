@@ -88,28 +88,28 @@ static void gabc_write_begin(FILE *f, grestyle_style style)
 {
     switch (style) {
     case ST_ITALIC:
-        fprintf(f, "<i>");
+        fputs("<i>", f);
         break;
     case ST_COLORED:
-        fprintf(f, "<c>");
+        fputs("<c>", f);
         break;
     case ST_SMALL_CAPS:
-        fprintf(f, "<sc>");
+        fputs("<sc>", f);
         break;
     case ST_BOLD:
-        fprintf(f, "<b>");
+        fputs("<b>", f);
         break;
     case ST_FORCED_CENTER:
-        fprintf(f, "{");
+        fputc('{', f);
         break;
     case ST_TT:
-        fprintf(f, "<tt>");
+        fputs("<tt>", f);
         break;
     case ST_UNDERLINED:
-        fprintf(f, "<ul>");
+        fputs("<ul>", f);
         break;
     case ST_ELISION:
-        fprintf(f, "<e>");
+        fputs("<e>", f);
         break;
     case ST_PROTRUSION_FACTOR:
         write_state = GABC_AT_PROTRUSION_FACTOR;
@@ -142,32 +142,32 @@ static void gabc_write_end(FILE *f, grestyle_style style)
 {
     switch (style) {
     case ST_ITALIC:
-        fprintf(f, "</i>");
+        fputs("</i>", f);
         break;
     case ST_COLORED:
-        fprintf(f, "</c>");
+        fputs("</c>", f);
         break;
     case ST_SMALL_CAPS:
-        fprintf(f, "</sc>");
+        fputs("</sc>", f);
         break;
     case ST_BOLD:
-        fprintf(f, "</b>");
+        fputs("</b>", f);
         break;
     case ST_FORCED_CENTER:
-        fprintf(f, "}");
+        fputc('}', f);
         break;
     case ST_TT:
-        fprintf(f, "</tt>");
+        fputs("</tt>", f);
         break;
     case ST_UNDERLINED:
-        fprintf(f, "</ul>");
+        fputs("</ul>", f);
         break;
     case ST_ELISION:
-        fprintf(f, "</e>");
+        fputs("</e>", f);
         break;
     case ST_PROTRUSION_FACTOR:
         if (write_state == GABC_IN_PROTRUSION_FACTOR) {
-            fprintf(f, ">");
+            fputc('>', f);
         }
         break;
     case ST_INITIAL:
@@ -201,9 +201,9 @@ static void gabc_print_char(FILE *f, const grewchar to_print)
     if (write_state == GABC_AT_PROTRUSION_FACTOR) {
         write_state = GABC_IN_PROTRUSION_FACTOR;
         if (to_print == 'd') {
-            fprintf(f, "<pr");
+            fputs("<pr", f);
         } else {
-            fprintf(f, "<pr:");
+            fputs("<pr:", f);
             gregorio_print_unichar(f, to_print);
         }
     } else {
@@ -271,9 +271,9 @@ static void gabc_print_string(FILE *f, const char *first_char)
  */
 static void gabc_write_special_char(FILE *f, const grewchar *first_char)
 {
-    fprintf(f, "<sp>");
+    fputs("<sp>", f);
     gabc_print_unistring(f, first_char);
-    fprintf(f, "</sp>");
+    fputs("</sp>", f);
 }
 
 /*
@@ -288,9 +288,9 @@ static void gabc_write_verb(FILE *f, const grewchar *first_char)
         /* this is an auto protrusion, so ignore it */
         write_state = GABC_IN_AUTO_PROTRUSION;
     } else {
-        fprintf(f, "<v>");
+        fputs("<v>", f);
         gabc_print_unistring(f, first_char);
-        fprintf(f, "</v>");
+        fputs("</v>", f);
     }
 }
 
@@ -305,13 +305,13 @@ static void gabc_write_end_liquescentia(FILE *f, char liquescentia)
 {
     switch (liquescentia & TAIL_LIQUESCENTIA_MASK) {
     case L_DEMINUTUS:
-        fprintf(f, "~");
+        fputc('~', f);
         break;
     case L_AUCTUS_ASCENDENS:
-        fprintf(f, "<");
+        fputc('<', f);
         break;
     case L_AUCTUS_DESCENDENS:
-        fprintf(f, ">");
+        fputc('>', f);
         break;
     }
 }
@@ -347,26 +347,26 @@ static void gabc_write_space(FILE *f, gregorio_space type, char *factor,
             /* if the following is not a space, we omit this because the
              * code always puts a "/" between elements unless there is some
              * other space there */
-            fprintf (f, "/");
+            fputc('/', f);
         }
         break;
     case SP_LARGER_SPACE:
-        fprintf(f, "//");
+        fputs("//", f);
         break;
     case SP_GLYPH_SPACE:
-        fprintf(f, " ");
+        fputc(' ', f);
         break;
     case SP_AD_HOC_SPACE:
         fprintf(f, "/[%s]", factor);
         break;
     case SP_NEUMATIC_CUT_NB:
-        fprintf(f, "!/");
+        fputs("!/", f);
         break;
     case SP_LARGER_SPACE_NB:
-        fprintf(f, "!//");
+        fputs("!//", f);
         break;
     case SP_GLYPH_SPACE_NB:
-        fprintf(f, "! ");
+        fputs("! ", f);
         break;
     case SP_AD_HOC_SPACE_NB:
         fprintf(f, "!/[%s]", factor);
@@ -391,70 +391,70 @@ static void gabc_write_bar(FILE *f, gregorio_bar type)
 {
     switch (type) {
     case B_VIRGULA:
-        fprintf(f, "`");
+        fputc('`', f);
         break;
     case B_DIVISIO_MINIMA:
-        fprintf(f, ",");
+        fputc(',', f);
         break;
     case B_DIVISIO_MINOR:
-        fprintf(f, ";");
+        fputc(';', f);
         break;
     case B_DIVISIO_MAIOR:
-        fprintf(f, ":");
+        fputc(':', f);
         break;
     case B_DIVISIO_FINALIS:
-        fprintf(f, "::");
+        fputs("::", f);
         break;
     case B_DIVISIO_MINOR_D1:
-        fprintf(f, ";1");
+        fputs(";1", f);
         break;
     case B_DIVISIO_MINOR_D2:
-        fprintf(f, ";2");
+        fputs(";2", f);
         break;
     case B_DIVISIO_MINOR_D3:
-        fprintf(f, ";3");
+        fputs(";3", f);
         break;
     case B_DIVISIO_MINOR_D4:
-        fprintf(f, ";4");
+        fputs(";4", f);
         break;
     case B_DIVISIO_MINOR_D5:
-        fprintf(f, ";5");
+        fputs(";5", f);
         break;
     case B_DIVISIO_MINOR_D6:
-        fprintf(f, ";6");
+        fputs(";6", f);
         break;
     case B_DIVISIO_MINOR_D7:
-        fprintf(f, ";7");
+        fputs(";7", f);
         break;
     case B_DIVISIO_MINOR_D8:
-        fprintf(f, ";8");
+        fputs(";8", f);
         break;
     case B_VIRGULA_HIGH:
-        fprintf(f, "`0");
+        fputs("`0", f);
         break;
     case B_DIVISIO_MINIMA_HIGH:
-        fprintf(f, ",0");
+        fputs(",0", f);
         break;
     case B_DIVISIO_MAIOR_DOTTED:
-        fprintf(f, ":?");
+        fputs(":?", f);
         break;
     case B_DIVISIO_MINIMIS:
-        fprintf(f, "^");
+        fputc('^', f);
         break;
     case B_DIVISIO_MINIMIS_HIGH:
-        fprintf(f, "^0");
+        fputs("^0", f);
         break;
     case B_VIRGULA_PAREN:
-        fprintf(f, "`?");
+        fputs("`?", f);
         break;
     case B_VIRGULA_PAREN_HIGH:
-        fprintf(f, "`0?");
+        fputs("`0?", f);
         break;
     case B_DIVISIO_MINIMA_PAREN:
-        fprintf(f, ",?");
+        fputs(",?", f);
         break;
     case B_DIVISIO_MINIMA_PAREN_HIGH:
-        fprintf(f, ",0?");
+        fputs(",0?", f);
         break;
     default:
         /* not reachable unless there's a programming error */
@@ -472,13 +472,13 @@ static void gabc_write_bar_signs(FILE *f, gregorio_sign type)
 {
     switch (type) {
     case _V_EPISEMA:
-        fprintf(f, "'");
+        fputc('\'', f);
         break;
     case _V_EPISEMA_BAR_H_EPISEMA:
-        fprintf(f, "'_");
+        fputs("'_", f);
         break;
     case _BAR_H_EPISEMA:
-        fprintf(f, "_");
+        fputc('_', f);
         break;
     case _NO_SIGN:
         /* if there's no sign, don't emit anything */
@@ -498,17 +498,17 @@ static void gabc_hepisema(FILE *f, const char *prefix, bool connect,
 {
     fprintf(f, "_%s", prefix);
     if (!connect) {
-        fprintf(f, "2");
+        fputc('2', f);
     }
     switch (size) {
     case H_SMALL_LEFT:
-        fprintf(f, "3");
+        fputc('3', f);
         break;
     case H_SMALL_CENTRE:
-        fprintf(f, "4");
+        fputc('4', f);
         break;
     case H_SMALL_RIGHT:
-        fprintf(f, "5");
+        fputc('5', f);
         break;
     case H_NORMAL:
         /* nothing to print */
@@ -592,104 +592,109 @@ static void gabc_write_gregorio_note(FILE *f, gregorio_note *note,
         const bool is_quadratum)
 {
     char shape;
+    char letter;
+    const char *suffix = "";
     gregorio_assert(note, gabc_write_gregorio_note, "call with NULL argument",
             return);
     gregorio_assert(note->type == GRE_NOTE, gabc_write_gregorio_note,
             "call with argument which type is not GRE_NOTE", return);
     shape = note->u.note.shape;
+    letter = pitch_letter(note->u.note.pitch);
     switch (shape) {
         /* first we write the letters that determine the shapes */
     case S_PUNCTUM:
         if (is_quadratum) {
-            fprintf(f, "%cq", pitch_letter(note->u.note.pitch));
-        } else {
-            fprintf(f, "%c", pitch_letter(note->u.note.pitch));
+            suffix = "q";
         }
         break;
     case S_PUNCTUM_INCLINATUM_ASCENDENS:
-        fprintf(f, "%c1", toupper((unsigned char)pitch_letter(note->u.note.pitch)));
+        letter = toupper((unsigned char)letter);
+        suffix = "1";
         break;
     case S_PUNCTUM_INCLINATUM_DESCENDENS:
-        fprintf(f, "%c0", toupper((unsigned char)pitch_letter(note->u.note.pitch)));
+        letter = toupper((unsigned char)letter);
+        suffix = "0";
         break;
     case S_PUNCTUM_INCLINATUM_STANS:
-        fprintf(f, "%c2", toupper((unsigned char)pitch_letter(note->u.note.pitch)));
+        letter = toupper((unsigned char)letter);
+        suffix = "2";
         break;
     case S_PUNCTUM_INCLINATUM_DEMINUTUS:
+        letter = toupper((unsigned char)letter);
         if (note->next) {
-            fprintf(f, "%c~", toupper((unsigned char)pitch_letter(note->u.note.pitch)));
-        } else {
-            fprintf(f, "%c", toupper((unsigned char)pitch_letter(note->u.note.pitch)));
+            suffix = "~";
         }
         break;
     case S_PUNCTUM_INCLINATUM_AUCTUS:
-        fprintf(f, "%c", toupper((unsigned char)pitch_letter(note->u.note.pitch)));
+    case S_PUNCTUM_INCLINATUM_UNDETERMINED:
+        /* undetermined is only left by gabc_read_canonical_score */
+        letter = toupper((unsigned char)letter);
         break;
     case S_FLAT:
-        fprintf(f, "%cx", pitch_letter(note->u.note.pitch));
+        suffix = "x";
         break;
     case S_FLAT_PAREN:
-        fprintf(f, "%cx?", pitch_letter(note->u.note.pitch));
+        suffix = "x?";
         break;
     case S_FLAT_SOFT:
-        fprintf(f, "%cX", pitch_letter(note->u.note.pitch));
+        suffix = "X";
         break;
     case S_NATURAL:
-        fprintf(f, "%cy", pitch_letter(note->u.note.pitch));
+        suffix = "y";
         break;
     case S_NATURAL_PAREN:
-        fprintf(f, "%cy?", pitch_letter(note->u.note.pitch));
+        suffix = "y?";
         break;
     case S_NATURAL_SOFT:
-        fprintf(f, "%cY", pitch_letter(note->u.note.pitch));
+        suffix = "Y";
         break;
     case S_SHARP:
-        fprintf(f, "%c#", pitch_letter(note->u.note.pitch));
+        suffix = "#";
         break;
     case S_SHARP_PAREN:
-        fprintf(f, "%c#?", pitch_letter(note->u.note.pitch));
+        suffix = "#?";
         break;
     case S_SHARP_SOFT:
-        fprintf(f, "%c#*", pitch_letter(note->u.note.pitch));
+        suffix = "#*";
         break;
     case S_VIRGA:
-        fprintf(f, "%cv", pitch_letter(note->u.note.pitch));
+        suffix = "v";
         break;
     case S_VIRGA_REVERSA:
-        fprintf(f, "%cV", pitch_letter(note->u.note.pitch));
+        suffix = "V";
         break;
     case S_ORISCUS_ASCENDENS:
-        fprintf(f, "%co1", pitch_letter(note->u.note.pitch));
+        suffix = "o1";
         break;
     case S_ORISCUS_DESCENDENS:
-        fprintf(f, "%co0", pitch_letter(note->u.note.pitch));
+        suffix = "o0";
         break;
     case S_ORISCUS_DEMINUTUS:
-        fprintf(f, "%co", pitch_letter(note->u.note.pitch));
+    case S_ORISCUS_UNDETERMINED:
+        suffix = "o";
         /* Note: the DEMINUTUS is also in the liquescentia */
         break;
     case S_QUILISMA:
-        if (is_quadratum) {
-            fprintf(f, "%cW", pitch_letter(note->u.note.pitch));
-        } else {
-            fprintf(f, "%cw", pitch_letter(note->u.note.pitch));
-        }
+        suffix = is_quadratum? "W" : "w";
         break;
     case S_LINEA:
-        fprintf(f, "%c=", pitch_letter(note->u.note.pitch));
+        suffix = "=";
         break;
     case S_LINEA_PUNCTUM:
-        fprintf(f, "%cR", pitch_letter(note->u.note.pitch));
+        suffix = "R";
         break;
     case S_ORISCUS_SCAPUS_ASCENDENS:
-        fprintf(f, "%cO1", pitch_letter(note->u.note.pitch));
+        suffix = "O1";
         break;
     case S_ORISCUS_SCAPUS_DESCENDENS:
-        fprintf(f, "%cO0", pitch_letter(note->u.note.pitch));
+        suffix = "O0";
+        break;
+    case S_ORISCUS_SCAPUS_UNDETERMINED:
+        suffix = "O";
         break;
     case S_STROPHA:
     case S_STROPHA_AUCTA:
-        fprintf(f, "%cs", pitch_letter(note->u.note.pitch));
+        suffix = "s";
         break;
     default:
         /* includes S_BIVIRGA, S_TRIVIRGA, S_DISTROPHA, and S_TRISTROPHA */
@@ -697,28 +702,36 @@ static void gabc_write_gregorio_note(FILE *f, gregorio_note *note,
         /* LCOV_EXCL_START */
         unsupported("gabc_write_gregorio_note", __LINE__, "shape",
                 gregorio_shape_to_string(shape));
-        fprintf(f, "%c", pitch_letter(note->u.note.pitch));
         break;
         /* LCOV_EXCL_STOP */
     }
+    fputc(letter, f);
+    fputs(suffix, f);
     if (note->u.note.is_cavum) {
-        fprintf(f, "r");
+        fputc('r', f);
     }
     switch (note->signs) {
     case _PUNCTUM_MORA:
-        fprintf(f, ".%s", mora_vposition(note));
+        fputc('.', f);
+        fputs(mora_vposition(note), f);
         break;
     case _AUCTUM_DUPLEX:
-        fprintf(f, "..");
+        fputs("..", f);
         break;
     case _V_EPISEMA:
-        fprintf(f, "'%s", vepisema_position(note));
+        fputc('\'', f);
+        fputs(vepisema_position(note), f);
         break;
     case _V_EPISEMA_PUNCTUM_MORA:
-        fprintf(f, "'%s.%s", vepisema_position(note), mora_vposition(note));
+        fputc('\'', f);
+        fputs(vepisema_position(note), f);
+        fputc('.', f);
+        fputs(mora_vposition(note), f);
         break;
     case _V_EPISEMA_AUCTUM_DUPLEX:
-        fprintf(f, "'%s..", vepisema_position(note));
+        fputc('\'', f);
+        fputs(vepisema_position(note), f);
+        fputs("..", f);
         break;
     case _NO_SIGN:
         /* if there's no sign, don't emit anything */
@@ -733,28 +746,28 @@ static void gabc_write_gregorio_note(FILE *f, gregorio_note *note,
     }
     switch (note->special_sign) {
     case _ACCENTUS:
-        fprintf(f, "r1");
+        fputs("r1", f);
         break;
     case _ACCENTUS_REVERSUS:
-        fprintf(f, "r2");
+        fputs("r2", f);
         break;
     case _CIRCULUS:
-        fprintf(f, "r3");
+        fputs("r3", f);
         break;
     case _SEMI_CIRCULUS:
-        fprintf(f, "r4");
+        fputs("r4", f);
         break;
     case _SEMI_CIRCULUS_REVERSUS:
-        fprintf(f, "r5");
+        fputs("r5", f);
         break;
     case _MUSICA_FICTA_FLAT:
-        fprintf(f, "r6");
+        fputs("r6", f);
         break;
     case _MUSICA_FICTA_NATURAL:
-        fprintf(f, "r7");
+        fputs("r7", f);
         break;
     case _MUSICA_FICTA_SHARP:
-        fprintf(f, "r8");
+        fputs("r8", f);
         break;
     case _NO_SIGN:
         /* if there's no sign, don't emit anything */
@@ -783,9 +796,9 @@ static void gabc_write_gregorio_note(FILE *f, gregorio_note *note,
     }
     write_note_heuristics(f, note);
     if (note->texverb) {
-        fprintf(f, "[nv:");
+        fputs("[nv:", f);
         gabc_print_string(f, gregorio_texverb(note->texverb));
-        fprintf(f, "]");
+        fputc(']', f);
     }
     if (note->choral_sign) {
         fprintf(f, "[cs:%s]", note->choral_sign);
@@ -859,33 +872,33 @@ static __inline void emit_hepisema_adjustment(FILE *const f,
             if (index == SO_OVER) {
                 fputc('l', f);
             } else {
-                fprintf(f, "ol");
+                fputs("ol", f);
             }
             break;
         case HVB_O_HIGH:
             if (index == SO_OVER) {
                 fputc('h', f);
             } else {
-                fprintf(f, "oh");
+                fputs("oh", f);
             }
             break;
         case HVB_U_LOW:
             if (index == SO_UNDER) {
                 fputc('l', f);
             } else {
-                fprintf(f, "ul");
+                fputs("ul", f);
             }
             break;
         case HVB_U_HIGH:
             if (index == SO_UNDER) {
                 fputc('h', f);
             } else {
-                fprintf(f, "uh");
+                fputs("uh", f);
             }
             break;
         }
         if (adj->nudge) {
-            fprintf(f, "%s", adj->nudge);
+            fputs(adj->nudge, f);
         }
     }
     if (open_brace) {
@@ -949,22 +962,22 @@ static void gabc_write_gregorio_glyph(FILE *f, gregorio_glyph *glyph,
     switch (glyph->type) {
     case GRE_TEXVERB_GLYPH:
         if (glyph->texverb) {
-            fprintf(f, "[gv:");
+            fputs("[gv:", f);
             gabc_print_string(f, gregorio_texverb(glyph->texverb));
-            fprintf(f, "]");
+            fputc(']', f);
         }
         break;
     case GRE_SPACE:
         if (glyph->next) {
             switch (glyph->u.misc.unpitched.info.space) {
             case SP_ZERO_WIDTH:
-                fprintf(f, "!");
+                fputc('!', f);
                 break;
             case SP_HALF_SPACE:
-                fprintf(f, "/0");
+                fputs("/0", f);
                 break;
             case SP_INTERGLYPH_SPACE:
-                fprintf(f, "/!");
+                fputs("/!", f);
                 break;
             default:
                 /* not reachable unless there's a programming error */
@@ -984,9 +997,12 @@ static void gabc_write_gregorio_glyph(FILE *f, gregorio_glyph *glyph,
         break;
     case GRE_GLYPH:
         if (is_initio_debilis(glyph->u.notes.liquescentia)) {
-            fprintf(f, "-");
-        } else if (is_fused(glyph->u.notes.liquescentia)) {
-            fprintf(f, "@");
+            fputc('-', f);
+        } else if (is_fused(glyph->u.notes.liquescentia)
+                || is_fused(glyph->u.notes.first_note->u.note.liquescentia)) {
+            /* a note which could not be fused keeps its liquescentia, which
+             * still affects the episemas before it */
+            fputc('@', f);
         }
 
         current_note = glyph->u.notes.first_note;
@@ -1057,16 +1073,16 @@ static void gabc_write_gregorio_element(FILE *f, gregorio_element *element,
         break;
     case GRE_TEXVERB_ELEMENT:
         if (element->texverb) {
-            fprintf(f, "[ev:");
+            fputs("[ev:", f);
             gabc_print_string(f, gregorio_texverb(element->texverb));
-            fprintf(f, "]");
+            fputc(']', f);
         }
         break;
     case GRE_ALT:
         if (element->texverb) {
-            fprintf(f, "[alt:");
+            fputs("[alt:", f);
             gabc_print_string(f, gregorio_texverb(element->texverb));
-            fprintf(f, "]");
+            fputc(']', f);
         }
         break;
     case GRE_SPACE:
@@ -1083,32 +1099,32 @@ static void gabc_write_gregorio_element(FILE *f, gregorio_element *element,
         break;
     case GRE_END_OF_LINE:
         if (element->u.misc.unpitched.info.eol_ragged) {
-            fprintf(f, "Z");
+            fputc('Z', f);
         } else {
-            fprintf(f, "z");
+            fputc('z', f);
         }
         if (element->u.misc.unpitched.info.eol_forces_custos) {
-            fprintf(f, element->u.misc.unpitched.info.eol_forces_custos_on? "+"
-                    : "-");
+            fputc(element->u.misc.unpitched.info.eol_forces_custos_on? '+'
+                    : '-', f);
         }
         break;
     case GRE_CUSTOS:
         if (element->u.misc.pitched.force_pitch) {
             fprintf(f, "%c+", pitch_letter(element->u.misc.pitched.pitch));
         } else {
-            fprintf(f, "z0");
+            fputs("z0", f);
         }
         break;
     case GRE_SUPPRESS_CUSTOS:
-        fprintf(f, "[nocustos]");
+        fputs("[nocustos]", f);
         break;
     case GRE_NLBA:
         switch (element->u.misc.unpitched.info.nlba) {
         case NLBA_BEGINNING:
-            fprintf(f, "<nlba>");
+            fputs("<nlba>", f);
             break;
         case NLBA_END:
-            fprintf(f, "</nlba>");
+            fputs("</nlba>", f);
             break;
         default:
             /* not reachable unless there's a programming error */
@@ -1137,19 +1153,60 @@ static void gabc_write_gregorio_element(FILE *f, gregorio_element *element,
  *
  */
 
+/* writes the nabc lines of an element, each after a "|" */
+static void gabc_write_nabc(FILE *f, const gregorio_element *const element)
+{
+    size_t i;
+    for (i = 0; i < element->nabc_lines; ++i) {
+        fputc('|', f);
+        if (element->nabc[i]) {
+            fputs(element->nabc[i], f);
+        }
+    }
+}
+
+/*
+ * A note which could not be fused to the glyph before it begins a new
+ * element; written as "@" right after that glyph, it reads the same again,
+ * whereas "/@" would fuse the glyph it begins.
+ */
+static bool starts_with_unfused_note(const gregorio_element *const element)
+{
+    const gregorio_glyph *const glyph = element->u.first_glyph;
+    return glyph && glyph->type == GRE_GLYPH
+        && !is_fused(glyph->u.notes.liquescentia)
+        && is_fused(glyph->u.notes.first_note->u.note.liquescentia);
+}
+
+/*
+ * The parser gives the nabc of a part of the notes to the first element of
+ * that part, so the nabc of an element is written after the elements which
+ * follow it up to the next element with nabc, and a "|" then leads back to
+ * the notes.
+ */
 static bool gabc_write_gregorio_elements(FILE *f, gregorio_element *element,
         glyph_context *context)
 {
     bool linebreak_or_bar_in_element = false;
+    const gregorio_element *with_nabc = NULL;
     while (element) {
         context->element = element;
+        if (element->nabc_lines) {
+            if (with_nabc) {
+                gabc_write_nabc(f, with_nabc);
+                fputc('|', f);
+            }
+            with_nabc = element;
+        }
         gabc_write_gregorio_element(f, element, context);
         /* we don't want a bar after an end of line */
         if (element->type != GRE_END_OF_LINE
             && (element->type != GRE_SPACE
                 || element->u.misc.unpitched.info.space == SP_NEUMATIC_CUT)
-            && element->next && element->next->type == GRE_ELEMENT) {
-            fprintf(f, "/");
+            && element->next && element->next->type == GRE_ELEMENT
+            && !(with_nabc && element->next->nabc_lines)
+            && !starts_with_unfused_note(element->next)) {
+            fputc('/', f);
         }
         if (element->type == GRE_END_OF_LINE || element->type == GRE_BAR)
         {
@@ -1157,30 +1214,24 @@ static bool gabc_write_gregorio_elements(FILE *f, gregorio_element *element,
         }
         element = element->next;
     }
+    if (with_nabc) {
+        gabc_write_nabc(f, with_nabc);
+    }
     return linebreak_or_bar_in_element;
 }
 
-/*
- *
- * Here it goes, we are writing a gregorio_syllable.
- *
- */
-
-static void gabc_write_gregorio_syllable(FILE *f, gregorio_syllable *syllable,
-        glyph_context *context)
+/* writes what comes before the notes of a syllable */
+void gabc_write_syllable_text(FILE *f, gregorio_syllable *syllable)
 {
-    bool linebreak_or_bar_in_element;
-    gregorio_assert(syllable, gabc_write_gregorio_syllable,
-            "call with NULL argument", return);
     write_state = GABC_NORMAL;
     if (syllable->no_linebreak_area == NLBA_BEGINNING) {
-        fprintf(f, "<nlba>");
+        fputs("<nlba>", f);
     }
     if (syllable->euouae == EUOUAE_BEGINNING) {
-        fprintf(f, "<eu>");
+        fputs("<eu>", f);
     }
     if (syllable->clear) {
-        fprintf(f, "<clear>");
+        fputs("<clear>", f);
     }
     if (syllable->text) {
         /* we call the magic function (defined in struct_utils.c), that will
@@ -1190,78 +1241,239 @@ static void gabc_write_gregorio_syllable(FILE *f, gregorio_syllable *syllable,
                 &gabc_write_special_char);
     }
     if (syllable->translation) {
-        fprintf(f, "[");
+        fputc('[', f);
         gregorio_write_text(WTP_NORMAL, syllable->translation, f,
                 &gabc_write_verb, &gabc_print_char, &gabc_write_begin,
                 &gabc_write_end, &gabc_write_special_char);
-        fprintf(f, "]");
+        fputc(']', f);
     } else if (syllable->translation_type == TR_WITH_CENTER_END) {
-        fprintf(f, "[/]");
+        fputs("[/]", f);
     }
     if (syllable->euouae == EUOUAE_END) {
-        fprintf(f, "</eu>");
+        fputs("</eu>", f);
     }
     if (syllable->no_linebreak_area == NLBA_END) {
-        fprintf(f, "</nlba>");
+        fputs("</nlba>", f);
     }
-    fprintf(f, "(");
+}
+
+/*
+ *
+ * Here it goes, we are writing a gregorio_syllable.  What separates it from
+ * the next one (a space, a newline or nothing) is returned rather than
+ * written, so that the canonical form can leave no trailing space.
+ *
+ */
+
+static char gabc_write_gregorio_syllable(FILE *f, gregorio_syllable *syllable,
+        glyph_context *context)
+{
+    bool linebreak_or_bar_in_element;
+    gregorio_assert(syllable, gabc_write_gregorio_syllable,
+            "call with NULL argument", return '\0');
+    gabc_write_syllable_text(f, syllable);
+    fputc('(', f);
     /* we write all the elements of the syllable. */
     linebreak_or_bar_in_element = gabc_write_gregorio_elements(f, syllable->elements[0], context);
-    if (linebreak_or_bar_in_element)
-    {
-        fprintf(f, ")\n");
-    } else {
-        if (syllable->position == WORD_END
+    fputc(')', f);
+    /* a newline in a word would end it */
+    if (syllable->position == WORD_END
             || syllable->position == WORD_ONE_SYLLABLE
-            || gregorio_is_only_special(syllable->elements[0]))
-        {
-            fprintf(f, ") ");
-        } else {
-            fprintf(f, ")");
-        }
+            || gregorio_is_only_special(syllable->elements[0])) {
+        return linebreak_or_bar_in_element? '\n' : ' ';
     }
+    return '\0';
 }
 
 /*
- *
- * This is the top function, the one called when we want to write a
- * gregorio_score in gabc.
- *
+ * The headers of the canonical form, in their order there.  The others follow
+ * them in the order of the file.
  */
+static const char *const canonical_headers[] = {
+    "name",
+    "gabc-copyright",
+    "score-copyright",
+    "author",
+    "language",
+    "mode",
+    "mode-modifier",
+    "mode-differentia",
+    "annotation",
+    "staff-lines",
+    "nabc-lines",
+    "oriscus-orientation",
+    NULL
+};
 
-void gabc_write_score(FILE *f, gregorio_score *score)
+static bool is_canonical_header(const char *const name)
+{
+    const char *const *header;
+    for (header = canonical_headers; *header; ++header) {
+        if (strcmp(name, *header) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void gabc_write_headers(FILE *f, gregorio_score *score,
+        const bool canonical)
+{
+    gregorio_header *header;
+    const char *const *name;
+
+    if (!canonical) {
+        for (header = score->headers; header; header = header->next) {
+            gabc_write_str_attribute(f, header->name, header->value);
+        }
+        /* And since the gabc is generated by this program, note this. */
+        fprintf(f, "generated-by: %s %s;\n", "gregorio", GREGORIO_VERSION);
+        return;
+    }
+
+    for (name = canonical_headers; *name; ++name) {
+        for (header = score->headers; header; header = header->next) {
+            if (strcmp(header->name, *name) == 0) {
+                gabc_write_str_attribute(f, header->name, header->value);
+            }
+        }
+    }
+    for (header = score->headers; header; header = header->next) {
+        /* generated-by would make the form depend on the version */
+        if (!is_canonical_header(header->name)
+                && strcmp(header->name, "generated-by") != 0) {
+            gabc_write_str_attribute(f, header->name, header->value);
+        }
+    }
+}
+
+static void gabc_write_any_score(FILE *f, gregorio_score *score,
+        const bool canonical)
 {
     glyph_context context;
     gregorio_syllable *syllable;
-    gregorio_header *header;
+    char separator = '\0';
 
     gregorio_assert(f, gabc_write_score, "call with NULL file", return);
 
     context.he_adjustment_index[0] = 0;
     context.he_adjustment_index[1] = 0;
 
-    for (header = score->headers; header; header = header->next) {
-        gabc_write_str_attribute(f, header->name, header->value);
-    }
-    /* And since the gabc is generated by this program, note this. */
-    fprintf(f, "generated-by: %s %s;\n", "gregorio", GREGORIO_VERSION);
+    gabc_write_headers(f, score, canonical);
     gregorio_assert(score->number_of_voices == 1, gabc_write_score,
             "gregorio_score seems to be empty", return);
-    fprintf(f, "%%%%\n");
+    fputs("%%\n", f);
     /* at present we only allow for one clef at the start of the gabc */
     if (score->first_voice_info) {
-        fprintf(f, "(");
+        fputc('(', f);
         gabc_write_clef(f, score->first_voice_info->initial_clef);
-        fprintf(f, ")");
+        fputc(')', f);
+        /* a space there makes the first syllable begin a word */
+        if (canonical && score->first_syllable
+                && (score->first_syllable->position == WORD_BEGINNING
+                    || score->first_syllable->position == WORD_ONE_SYLLABLE)) {
+            fputc(' ', f);
+        }
     }
-    syllable = score->first_syllable;
     /* the we write every syllable */
-    while (syllable) {
+    for (syllable = score->first_syllable; syllable;
+            syllable = syllable->next_syllable) {
+        if (separator) {
+            fputc(separator, f);
+        }
         context.syllable = syllable;
-        gabc_write_gregorio_syllable(f, syllable, &context);
-        syllable = syllable->next_syllable;
+        separator = gabc_write_gregorio_syllable(f, syllable, &context);
+        if (!canonical && separator) {
+            fputc(separator, f);
+            separator = '\0';
+        }
     }
-    fprintf(f, "\n");
+    /* in the canonical form, this replaces the last separator */
+    fputc('\n', f);
+}
+
+/*
+ *
+ * This is the top function, the one called when we want to write a
+ * gregorio_score in gabc.
+ *
+ */
+
+void gabc_write_score(FILE *f, gregorio_score *score)
+{
+    gabc_write_any_score(f, score, false);
+}
+
+/*
+ * Writes the canonical form of a score read by gabc_read_canonical_score, in
+ * which a gabc file has one spelling only, so that it is written back as it
+ * was read when it is already in this form:
+ *
+ * - the headers come first, one per line as "name: value;", in the order of
+ *   canonical_headers, then the other headers in the order of the file; the
+ *   generated-by header is left out;
+ * - the notes follow "%%" on a line of its own and begin with the initial
+ *   clef, followed by a space unless the first syllable continues a word;
+ * - a syllable ending a word is followed by a space, or by a newline if it
+ *   has a bar or a line break, except at the end of the file, which ends
+ *   with a single newline; there is no other space between syllables;
+ * - within a syllable, the elements are separated by "/", the nabc of an
+ *   element follows the elements up to the next one with nabc, and the text
+ *   comes as nested styles and escapes, as gabc_write_score writes them;
+ * - a note is its pitch letter and shape, then cavum, mora and vertical
+ *   episema, special sign (r1 to r8), horizontal episema, ledger lines, and
+ *   the [nv:], [cs:] and [shape:] attributes, in this order;
+ * - what the file leaves to gregorio (the orientation of an oriscus or a
+ *   punctum inclinatum, a custos before a line break) is left to it.
+ */
+
+void gabc_write_canonical_score(FILE *f, gregorio_score *score)
+{
+    gabc_write_any_score(f, score, true);
+}
+
+/*
+ * The other parts of a syllable as the canonical form writes them, for
+ * gregorio --diff to compare.  A glyph is written with the adjustments of its
+ * horizontal episemas, as if they began and ended with it.
+ */
+
+void gabc_write_syllable_notes(FILE *f, gregorio_syllable *syllable)
+{
+    glyph_context context;
+    context.syllable = syllable;
+    context.he_adjustment_index[0] = 0;
+    context.he_adjustment_index[1] = 0;
+    gabc_write_gregorio_elements(f, syllable->elements[0], &context);
+}
+
+void gabc_write_element(FILE *f, gregorio_syllable *syllable,
+        gregorio_element *element)
+{
+    glyph_context context;
+    context.syllable = syllable;
+    context.element = element;
+    context.he_adjustment_index[0] = 0;
+    context.he_adjustment_index[1] = 0;
+    gabc_write_gregorio_element(f, element, &context);
+}
+
+void gabc_write_glyph(FILE *f, gregorio_syllable *syllable,
+        gregorio_element *element, gregorio_glyph *glyph)
+{
+    glyph_context context;
+    context.syllable = syllable;
+    context.element = element;
+    context.he_adjustment_index[0] = 0;
+    context.he_adjustment_index[1] = 0;
+    gabc_write_gregorio_glyph(f, glyph, &context);
+}
+
+void gabc_write_note(FILE *f, gregorio_glyph *glyph, gregorio_note *note)
+{
+    gabc_write_gregorio_note(f, note,
+            glyph->u.notes.glyph_type == G_PES_QUADRATUM
+            && note == glyph->u.notes.first_note);
 }
 
 /* And that's it... not really hard isn't it? */
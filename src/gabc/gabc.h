@@ -29,6 +29,8 @@
 gregorio_note *gabc_det_notes_from_string(char *str, char *macros[10],
         gregorio_scanner_location *loc, const gregorio_score *score);
 void gabc_det_notes_finish(void);
+bool gabc_det_notes_pending(void);
+const gregorio_scanner_location *gabc_det_notes_location(void);
 gregorio_element *gabc_det_elements_from_string(char *str, int *current_key,
         char *macros[10], gregorio_scanner_location *loc,
         gregorio_shape *punctum_inclinatum_orientation,
@@ -41,6 +43,52 @@ int gabc_score_determination_lex_destroy(void);
 int gabc_notes_determination_lex_destroy(void);
 char *gabc_unescape(const char *string);
 
+/* the state of the parser which a syllable leaves to the next one */
+typedef struct gabc_syllable_state {
+    int current_key;
+    gregorio_shape punctum_inclinatum_orientation;
+    /* the styles which stay open */
+    unsigned char styles;
+    /* whether a brace, slur, ledger line, horizontal episema adjustment or
+     * left bracket stays open */
+    bool notes_pending;
+} gabc_syllable_state;
+
+/* start is the location of the start of the syllable */
+typedef void (*gabc_syllable_handler)(void *data,
+        const gregorio_scanner_location *start,
+        const gabc_syllable_state *state);
+
+gregorio_score *gabc_read_score_part(FILE *f_in, bool point_and_click,
+        gregorio_digest_algorithm algorithm, const gregorio_clef_info *clef,
+        const gabc_syllable_state *state, gabc_syllable_handler handler,
+        void *handler_data);
+const gregorio_scanner_location *gabc_current_location(void);
+
+/* incremental parsing, see gabc-incremental.c */
+typedef struct gabc_session gabc_session;
+
+gabc_session *gabc_session_new(const char *text, size_t length,
+        bool point_and_click, gregorio_digest_algorithm algorithm);
+bool gabc_session_edit(gabc_session *session, size_t start, size_t end,
+        const char *replacement, size_t replacement_length,
+        gregorio_syllable **first_changed, gregorio_syllable **last_changed);
+void gabc_session_reparse(gabc_session *session);
+gregorio_score *gabc_session_score(const gabc_session *session);
+const char *gabc_session_text(const gabc_session *session, size_t *length);
+void gabc_session_changed_range(const gabc_session *session, size_t *start,
+        size_t *end);
+void gabc_session_free(gabc_session *session);
+
+/* the canonical gabc of the parts of a score, see gabc-write.c */
+void gabc_write_syllable_text(FILE *f, gregorio_syllable *syllable);
+void gabc_write_syllable_notes(FILE *f, gregorio_syllable *syllable);
+void gabc_write_element(FILE *f, gregorio_syllable *syllable,
+        gregorio_element *element);
+void gabc_write_glyph(FILE *f, gregorio_syllable *syllable,
+        gregorio_element *element, gregorio_glyph *glyph);
+void gabc_write_note(FILE *f, gregorio_glyph *glyph, gregorio_note *note);
+
 /* see comments on gregorio_add_note_to_a_glyph for meaning of these
  * variables */
 typedef enum gabc_determination {
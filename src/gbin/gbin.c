@@ -0,0 +1,1318 @@
+/*
+ * Gregorio is a program that translates gabc files to GregorioTeX.
+ * This file writes and reads the analyzed score in the gbin binary format.
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A gbin file holds a score as gabc_read_score leaves it, so that it can be
+ * written in several formats without parsing its gabc again.
+ *
+ * The file starts with the magic "GBIN", the version of the format (16 bits)
+ * and the number of sections (16 bits), followed by the offset and the count
+ * (32 bits each) of every section.  A section is an array of records of a
+ * fixed size for its kind, so that the record of index i is found directly;
+ * the strings section is a sequence of NUL-terminated strings.  All numbers
+ * are little-endian, and the sections start on four bytes.
+ *
+ * The records link to each other with indexes instead of pointers: a link to a
+ * node is its index plus one in the section of its kind, and a link to a
+ * string is its offset plus one in the strings section, 0 being NULL in both
+ * cases.  The links to the next node of a list always go forward, which
+ * guarantees that the lists of a file end.
+ *
+ * A score is read into a single block holding the score, all its nodes in one
+ * array by kind, and the strings, so that it is loaded with no allocation per
+ * node and freed at once (see gregorio_free_score).  Its texverbs and
+ * horizontal episema adjustments are registered like those of a parsed score.
+ *
+ * As the file records what gregorio computed, it is only read by the version
+ * of gregorio which wrote it.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include "bool.h"
+#include "struct.h"
+#include "messages.h"
+#include "plugins.h"
+#include "support.h"
+#include "stats.h"
+
+#define GBIN_MAGIC "GBIN"
+#define GBIN_VERSION 1
+
+typedef enum gbin_section {
+    GBIN_STRINGS = 0,
+    GBIN_SCORE,
+    GBIN_HEADERS,
+    GBIN_VOICES,
+    GBIN_ADJUSTMENTS,
+    GBIN_SYLLABLES,
+    /* the first element of each voice, number_of_voices links by syllable */
+    GBIN_ELEMENT_LISTS,
+    GBIN_ELEMENTS,
+    /* the nabc strings, nabc_lines string links by element */
+    GBIN_NABC,
+    GBIN_GLYPHS,
+    GBIN_NOTES,
+    GBIN_CHARACTERS,
+    GBIN_NUMBER_OF_SECTIONS
+} gbin_section;
+
+#define HEADER_SIZE (8 + 8 * GBIN_NUMBER_OF_SECTIONS)
+
+/* the sizes of the records (and of their parts) */
+#define CLEF_SIZE 4
+#define EXTRA_INFO_SIZE 8
+#define MISC_SIZE 9
+#define NEXT_PITCH_SIZE 10
+#define SCORE_SIZE (4 + SHA1_DIGEST_SIZE + 8 + 4 * (7 + MAX_ANNOTATIONS) + 8 \
+        + 7)
+#define HEADER_RECORD_SIZE 8
+#define VOICE_SIZE CLEF_SIZE
+#define ADJUSTMENT_SIZE 6
+#define SYLLABLE_SIZE 33
+#define LINK_SIZE 4
+#define ELEMENT_SIZE (8 + 8 + MISC_SIZE + NEXT_PITCH_SIZE + 4 + 1)
+#define GLYPH_SIZE (8 + MISC_SIZE + NEXT_PITCH_SIZE + 4 + 1)
+#define NOTE_SIZE (8 + 8 + EXTRA_INFO_SIZE + 4 + 10 + 3 + 3 + 4)
+#define CHARACTER_SIZE 13
+
+static const size_t record_size[GBIN_NUMBER_OF_SECTIONS] = {
+    1, SCORE_SIZE, HEADER_RECORD_SIZE, VOICE_SIZE, ADJUSTMENT_SIZE,
+    SYLLABLE_SIZE, LINK_SIZE, ELEMENT_SIZE, LINK_SIZE, GLYPH_SIZE, NOTE_SIZE,
+    CHARACTER_SIZE
+};
+
+/*
+ * Writing
+ */
+
+typedef struct gbin_buffer {
+    unsigned char *data;
+    size_t length, capacity;
+} gbin_buffer;
+
+/* maps the nodes of a kind to their indexes, by binary search on a copy sorted
+ * by address */
+typedef struct gbin_map_entry {
+    uintptr_t node;
+    uint32_t link;
+} gbin_map_entry;
+
+typedef struct gbin_map {
+    gbin_map_entry *entries;
+    size_t count, capacity;
+} gbin_map;
+
+typedef struct gbin_writer {
+    gbin_buffer section[GBIN_NUMBER_OF_SECTIONS];
+    uint32_t count[GBIN_NUMBER_OF_SECTIONS];
+    gbin_map syllables, elements, glyphs, notes, characters;
+    /* the (global) indexes of the adjustments written, in order */
+    unsigned short *adjustments;
+    size_t adjustments_capacity;
+} gbin_writer;
+
+static void put_bytes(gbin_buffer *const buffer, const void *const bytes,
+        const size_t size)
+{
+    if (!buffer->data) {
+        buffer->capacity = 1024;
+        buffer->data = gregorio_grow_buffer(NULL, &buffer->capacity,
+                unsigned char);
+    }
+    while (buffer->length + size > buffer->capacity) {
+        buffer->data = gregorio_grow_buffer(buffer->data, &buffer->capacity,
+                unsigned char);
+    }
+    memcpy(buffer->data + buffer->length, bytes, size);
+    buffer->length += size;
+}
+
+static void put_u8(gbin_buffer *const buffer, const unsigned int value)
+{
+    unsigned char byte = (unsigned char)value;
+    put_bytes(buffer, &byte, 1);
+}
+
+static void put_u16(gbin_buffer *const buffer, const unsigned int value)
+{
+    unsigned char bytes[2];
+    bytes[0] = (unsigned char)value;
+    bytes[1] = (unsigned char)(value >> 8);
+    put_bytes(buffer, bytes, 2);
+}
+
+static void put_u32(gbin_buffer *const buffer, const uint32_t value)
+{
+    unsigned char bytes[4];
+    bytes[0] = (unsigned char)value;
+    bytes[1] = (unsigned char)(value >> 8);
+    bytes[2] = (unsigned char)(value >> 16);
+    bytes[3] = (unsigned char)(value >> 24);
+    put_bytes(buffer, bytes, 4);
+}
+
+static void put_zeros(gbin_buffer *const buffer, size_t count)
+{
+    while (count--) {
+        put_u8(buffer, 0);
+    }
+}
+
+static uint32_t string_link(gbin_writer *const writer, const char *const string)
+{
+    gbin_buffer *const strings = &writer->section[GBIN_STRINGS];
+    uint32_t link;
+    if (!string) {
+        return 0;
+    }
+    link = (uint32_t)strings->length + 1;
+    put_bytes(strings, string, strlen(string) + 1);
+    return link;
+}
+
+static void put_string(gbin_writer *const writer, gbin_buffer *const buffer,
+        const char *const string)
+{
+    put_u32(buffer, string_link(writer, string));
+}
+
+static void map_add(gbin_map *const map, const void *const node)
+{
+    if (!map->entries) {
+        map->capacity = 256;
+        map->entries = gregorio_grow_buffer(NULL, &map->capacity,
+                gbin_map_entry);
+    } else if (map->count >= map->capacity) {
+        map->entries = gregorio_grow_buffer(map->entries, &map->capacity,
+                gbin_map_entry);
+    }
+    map->entries[map->count].node = (uintptr_t)node;
+    map->entries[map->count].link = (uint32_t)(map->count + 1);
+    ++map->count;
+}
+
+static int compare_map_entries(const void *const a, const void *const b)
+{
+    const uintptr_t node_a = ((const gbin_map_entry *)a)->node;
+    const uintptr_t node_b = ((const gbin_map_entry *)b)->node;
+    return node_a < node_b ? -1 : node_a > node_b;
+}
+
+static void map_sort(gbin_map *const map)
+{
+    if (map->count) {
+        qsort(map->entries, map->count, sizeof(gbin_map_entry),
+                compare_map_entries);
+    }
+}
+
+static uint32_t map_link(const gbin_map *const map, const void *const node)
+{
+    gbin_map_entry key;
+    const gbin_map_entry *entry;
+    if (!node || !map->count) {
+        return 0;
+    }
+    key.node = (uintptr_t)node;
+    entry = bsearch(&key, map->entries, map->count, sizeof(gbin_map_entry),
+            compare_map_entries);
+    return entry? entry->link : 0;
+}
+
+static void put_link(gbin_buffer *const buffer, const gbin_map *const map,
+        const void *const node)
+{
+    put_u32(buffer, map_link(map, node));
+}
+
+/* returns the index plus one, in the file, of a global adjustment index */
+static unsigned int adjustment_link(gbin_writer *const writer,
+        const unsigned short index)
+{
+    uint32_t i;
+    if (!index) {
+        return 0;
+    }
+    for (i = 0; i < writer->count[GBIN_ADJUSTMENTS]; ++i) {
+        if (writer->adjustments[i] == index) {
+            return i + 1;
+        }
+    }
+    if (!writer->adjustments) {
+        writer->adjustments_capacity = 8;
+        writer->adjustments = gregorio_grow_buffer(NULL,
+                &writer->adjustments_capacity, unsigned short);
+    } else if (i >= writer->adjustments_capacity) {
+        writer->adjustments = gregorio_grow_buffer(writer->adjustments,
+                &writer->adjustments_capacity, unsigned short);
+    }
+    writer->adjustments[i] = index;
+    return ++writer->count[GBIN_ADJUSTMENTS];
+}
+
+static void put_clef(gbin_buffer *const buffer,
+        const gregorio_clef_info *const clef)
+{
+    put_u8(buffer, (unsigned char)clef->line);
+    put_u8(buffer, (unsigned char)clef->secondary_line);
+    put_u8(buffer, (unsigned char)clef->pitch_difference);
+    put_u8(buffer, clef->clef | clef->flatted << 1
+            | clef->secondary_clef << 2 | clef->secondary_flatted << 3);
+}
+
+static void put_extra_info(gbin_writer *const writer,
+        gbin_buffer *const buffer, const gregorio_extra_info *const info)
+{
+    put_string(writer, buffer, info->ad_hoc_space_factor);
+    put_u8(buffer, info->bar);
+    put_u8(buffer, info->space);
+    put_u8(buffer, info->nlba);
+    put_u8(buffer, info->eol_ragged | info->eol_forces_custos << 1
+            | info->eol_forces_custos_on << 2);
+}
+
+static void put_misc(gbin_writer *const writer, gbin_buffer *const buffer,
+        const gregorio_type type, const gregorio_misc_element_info *const misc)
+{
+    switch (type) {
+    case GRE_CLEF:
+        put_clef(buffer, &misc->clef);
+        put_zeros(buffer, MISC_SIZE - CLEF_SIZE);
+        break;
+    case GRE_CUSTOS:
+        put_u8(buffer, (unsigned char)misc->pitched.pitch);
+        put_u8(buffer, misc->pitched.force_pitch);
+        put_zeros(buffer, MISC_SIZE - 2);
+        break;
+    default:
+        put_extra_info(writer, buffer, &misc->unpitched.info);
+        put_u8(buffer, misc->unpitched.special_sign);
+        break;
+    }
+}
+
+static void put_next_pitch(gbin_writer *const writer,
+        gbin_buffer *const buffer, const gregorio_next_pitch *const next)
+{
+    put_link(buffer, &writer->notes, next->note);
+    put_link(buffer, &writer->elements, next->custos);
+    put_u8(buffer, next->alteration);
+    put_u8(buffer, next->determined);
+}
+
+static void put_note(gbin_writer *const writer,
+        const gregorio_note *const note)
+{
+    gbin_buffer *const buffer = &writer->section[GBIN_NOTES];
+
+    put_link(buffer, &writer->notes, note->previous);
+    put_link(buffer, &writer->notes, note->next);
+    put_string(writer, buffer, note->choral_sign);
+    put_string(writer, buffer, note->shape_hint);
+    switch (note->type) {
+    case GRE_CLEF:
+        put_clef(buffer, &note->u.clef);
+        put_zeros(buffer, EXTRA_INFO_SIZE - CLEF_SIZE);
+        break;
+    case GRE_NOTE:
+    case GRE_CUSTOS:
+    case GRE_MANUAL_CUSTOS:
+        put_u8(buffer, (unsigned char)note->u.note.pitch);
+        put_u8(buffer, note->u.note.shape);
+        put_u8(buffer, note->u.note.liquescentia);
+        put_u8(buffer, note->u.note.is_cavum);
+        put_zeros(buffer, EXTRA_INFO_SIZE - 4);
+        break;
+    default:
+        put_extra_info(writer, buffer, &note->u.other);
+        break;
+    }
+    put_string(writer, buffer, gregorio_texverb(note->texverb));
+    put_u16(buffer, note->src_line);
+    put_u16(buffer, note->src_column);
+    put_u16(buffer, note->src_offset);
+    put_u16(buffer, adjustment_link(writer, note->he_adjustment_index[SO_OVER]));
+    put_u16(buffer,
+            adjustment_link(writer, note->he_adjustment_index[SO_UNDER]));
+    put_u8(buffer, note->type);
+    put_u8(buffer, note->signs);
+    put_u8(buffer, note->special_sign);
+    put_u8(buffer, (unsigned char)note->v_episema_height);
+    put_u8(buffer, (unsigned char)note->h_episema_above);
+    put_u8(buffer, (unsigned char)note->h_episema_below);
+    put_u32(buffer, (uint32_t)note->h_episema_above_size
+            | (uint32_t)note->h_episema_below_size << 2
+            | (uint32_t)note->h_episema_above_connect << 4
+            | (uint32_t)note->h_episema_below_connect << 5
+            | (uint32_t)note->high_ledger_line << 6
+            | (uint32_t)note->high_ledger_specificity << 7
+            | (uint32_t)note->low_ledger_line << 9
+            | (uint32_t)note->low_ledger_specificity << 10
+            | (uint32_t)note->is_lower_note << 12
+            | (uint32_t)note->is_upper_note << 13
+            | (uint32_t)note->mora_vposition << 14
+            | (uint32_t)note->choral_sign_is_nabc << 16);
+}
+
+static void put_glyph(gbin_writer *const writer,
+        const gregorio_glyph *const glyph)
+{
+    gbin_buffer *const buffer = &writer->section[GBIN_GLYPHS];
+
+    put_link(buffer, &writer->glyphs, glyph->previous);
+    put_link(buffer, &writer->glyphs, glyph->next);
+    if (glyph->type == GRE_GLYPH) {
+        put_link(buffer, &writer->notes, glyph->u.notes.first_note);
+        put_u8(buffer, (unsigned char)glyph->u.notes.fuse_to_next_glyph);
+        put_u8(buffer, glyph->u.notes.glyph_type);
+        put_u8(buffer, glyph->u.notes.liquescentia);
+        put_u8(buffer, glyph->u.notes.is_cavum);
+        put_zeros(buffer, MISC_SIZE - 8);
+    } else {
+        put_misc(writer, buffer, glyph->type, &glyph->u.misc);
+    }
+    put_next_pitch(writer, buffer, &glyph->next_pitch);
+    put_string(writer, buffer, gregorio_texverb(glyph->texverb));
+    put_u8(buffer, glyph->type);
+}
+
+static void put_element(gbin_writer *const writer,
+        const gregorio_element *const element)
+{
+    gbin_buffer *const buffer = &writer->section[GBIN_ELEMENTS];
+    size_t i;
+
+    put_link(buffer, &writer->elements, element->previous);
+    put_link(buffer, &writer->elements, element->next);
+    put_u32(buffer, writer->count[GBIN_NABC]);
+    put_u32(buffer, (uint32_t)element->nabc_lines);
+    for (i = 0; i < element->nabc_lines; ++i) {
+        put_string(writer, &writer->section[GBIN_NABC], element->nabc[i]);
+    }
+    writer->count[GBIN_NABC] += (uint32_t)element->nabc_lines;
+    if (element->type == GRE_ELEMENT) {
+        put_link(buffer, &writer->glyphs, element->u.first_glyph);
+        put_zeros(buffer, MISC_SIZE - 4);
+    } else {
+        put_misc(writer, buffer, element->type, &element->u.misc);
+    }
+    put_next_pitch(writer, buffer, &element->next_pitch);
+    put_string(writer, buffer, gregorio_texverb(element->texverb));
+    put_u8(buffer, element->type);
+}
+
+static void put_character(gbin_writer *const writer,
+        const gregorio_character *const character)
+{
+    gbin_buffer *const buffer = &writer->section[GBIN_CHARACTERS];
+
+    put_u8(buffer, character->is_character);
+    put_link(buffer, &writer->characters, character->next_character);
+    put_link(buffer, &writer->characters, character->previous_character);
+    if (character->is_character) {
+        put_u32(buffer, character->cos.character);
+    } else {
+        put_u8(buffer, character->cos.s.style);
+        put_u8(buffer, character->cos.s.type);
+        put_u16(buffer, 0);
+    }
+}
+
+static void put_syllable(gbin_writer *const writer,
+        const gregorio_syllable *const syllable)
+{
+    gbin_buffer *const buffer = &writer->section[GBIN_SYLLABLES];
+
+    put_link(buffer, &writer->characters, syllable->text);
+    put_link(buffer, &writer->characters, syllable->translation);
+    put_string(writer, buffer, syllable->abovelinestext);
+    put_link(buffer, &writer->syllables, syllable->next_syllable);
+    put_link(buffer, &writer->syllables, syllable->previous_syllable);
+    put_u16(buffer, syllable->euouae_id);
+    put_u16(buffer, syllable->src_line);
+    put_u16(buffer, syllable->src_column);
+    put_u16(buffer, syllable->src_offset);
+    put_u8(buffer, syllable->translation_type);
+    put_u8(buffer, syllable->no_linebreak_area);
+    put_u8(buffer, syllable->euouae);
+    put_u8(buffer, syllable->position);
+    put_u8(buffer, syllable->first_word | syllable->forced_center << 1
+            | syllable->clear << 2);
+}
+
+/* visits the nodes of the score in the order of their indexes, numbering them
+ * if number is true and writing them otherwise */
+static void visit_nodes(gbin_writer *const writer,
+        const gregorio_score *const score, const bool number)
+{
+    const gregorio_syllable *syllable;
+    const gregorio_element *element;
+    const gregorio_glyph *glyph;
+    const gregorio_note *note;
+    const gregorio_character *character;
+    int voice;
+
+    for (syllable = score->first_syllable; syllable;
+            syllable = syllable->next_syllable) {
+        if (number) {
+            map_add(&writer->syllables, syllable);
+        } else {
+            put_syllable(writer, syllable);
+        }
+        for (character = syllable->text; character;
+                character = character->next_character) {
+            if (number) {
+                map_add(&writer->characters, character);
+            } else {
+                put_character(writer, character);
+            }
+        }
+        for (character = syllable->translation; character;
+                character = character->next_character) {
+            if (number) {
+                map_add(&writer->characters, character);
+            } else {
+                put_character(writer, character);
+            }
+        }
+        for (voice = 0; voice < score->number_of_voices; ++voice) {
+            element = syllable->elements? syllable->elements[voice] : NULL;
+            if (!number) {
+                put_link(&writer->section[GBIN_ELEMENT_LISTS],
+                        &writer->elements, element);
+            }
+            for (; element; element = element->next) {
+                if (number) {
+                    map_add(&writer->elements, element);
+                } else {
+                    put_element(writer, element);
+                }
+                if (element->type != GRE_ELEMENT) {
+                    continue;
+                }
+                for (glyph = element->u.first_glyph; glyph;
+                        glyph = glyph->next) {
+                    if (number) {
+                        map_add(&writer->glyphs, glyph);
+                    } else {
+                        put_glyph(writer, glyph);
+                    }
+                    if (glyph->type != GRE_GLYPH) {
+                        continue;
+                    }
+                    for (note = glyph->u.notes.first_note; note;
+                            note = note->next) {
+                        if (number) {
+                            map_add(&writer->notes, note);
+                        } else {
+                            put_note(writer, note);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* the string fields of the score are usually the values of its headers, which
+ * they share in the file too */
+static void put_score_string(gbin_writer *const writer,
+        const gregorio_score *const score, const uint32_t *const value_links,
+        const char *const string)
+{
+    const gregorio_header *header;
+    uint32_t i;
+    for (header = score->headers, i = 0; header; header = header->next, ++i) {
+        if (header->value == string) {
+            put_u32(&writer->section[GBIN_SCORE], value_links[i]);
+            return;
+        }
+    }
+    put_string(writer, &writer->section[GBIN_SCORE], string);
+}
+
+static void put_score(gbin_writer *const writer,
+        const gregorio_score *const score)
+{
+    gbin_buffer *const buffer = &writer->section[GBIN_SCORE];
+    const gregorio_header *header;
+    const gregorio_voice_info *voice_info;
+    uint32_t *value_links;
+    size_t capacity = 16, i;
+    int annotation;
+
+    value_links = gregorio_grow_buffer(NULL, &capacity, uint32_t);
+    for (header = score->headers, i = 0; header; header = header->next, ++i) {
+        if (i >= capacity) {
+            value_links = gregorio_grow_buffer(value_links, &capacity,
+                    uint32_t);
+        }
+        put_string(writer, &writer->section[GBIN_HEADERS], header->name);
+        value_links[i] = string_link(writer, header->value);
+        put_u32(&writer->section[GBIN_HEADERS], value_links[i]);
+    }
+    writer->count[GBIN_HEADERS] = (uint32_t)i;
+
+    for (voice_info = score->first_voice_info, i = 0; voice_info;
+            voice_info = voice_info->next_voice_info, ++i) {
+        put_clef(&writer->section[GBIN_VOICES], &voice_info->initial_clef);
+    }
+    writer->count[GBIN_VOICES] = (uint32_t)i;
+
+    put_string(writer, buffer, GREGORIO_VERSION);
+    put_bytes(buffer, score->digest, SHA1_DIGEST_SIZE);
+    put_link(buffer, &writer->syllables, score->first_syllable);
+    put_u32(buffer, (uint32_t)score->number_of_voices);
+    put_score_string(writer, score, value_links, score->name);
+    put_score_string(writer, score, value_links, score->gabc_copyright);
+    put_score_string(writer, score, value_links, score->score_copyright);
+    put_score_string(writer, score, value_links, score->mode);
+    put_score_string(writer, score, value_links, score->mode_modifier);
+    put_score_string(writer, score, value_links, score->mode_differentia);
+    put_score_string(writer, score, value_links, score->author);
+    for (annotation = 0; annotation < MAX_ANNOTATIONS; ++annotation) {
+        put_score_string(writer, score, value_links,
+                score->annotation[annotation]);
+    }
+    put_u32(buffer, (uint32_t)score->nabc_lines);
+    put_score_string(writer, score, value_links, score->user_notes);
+    put_u8(buffer, score->det_method);
+    put_u8(buffer, score->staff_lines);
+    put_u8(buffer, (unsigned char)score->highest_pitch);
+    put_u8(buffer, (unsigned char)score->high_ledger_line_pitch);
+    put_u8(buffer, (unsigned char)score->virgula_far_pitch);
+    put_u8(buffer, score->legacy_oriscus_orientation);
+    put_u8(buffer, score->digest_algorithm);
+    writer->count[GBIN_SCORE] = 1;
+    free(value_links);
+}
+
+static void put_adjustments(gbin_writer *const writer)
+{
+    gbin_buffer *const buffer = &writer->section[GBIN_ADJUSTMENTS];
+    uint32_t i;
+    for (i = 0; i < writer->count[GBIN_ADJUSTMENTS]; ++i) {
+        const gregorio_hepisema_adjustment *const adjustment =
+                gregorio_get_hepisema_adjustment(writer->adjustments[i]);
+        put_u8(buffer, adjustment->vbasepos);
+        put_string(writer, buffer, adjustment->nudge);
+        put_u8(buffer, (unsigned char)adjustment->pitch_extremum);
+    }
+}
+
+void gbin_write_score(FILE *const f, gregorio_score *const score)
+{
+    gbin_writer writer;
+    gbin_buffer header;
+    uint32_t offset;
+    int i;
+
+    memset(&writer, 0, sizeof writer);
+    memset(&header, 0, sizeof header);
+
+    visit_nodes(&writer, score, true);
+    map_sort(&writer.syllables);
+    map_sort(&writer.elements);
+    map_sort(&writer.glyphs);
+    map_sort(&writer.notes);
+    map_sort(&writer.characters);
+    writer.count[GBIN_SYLLABLES] = (uint32_t)writer.syllables.count;
+    writer.count[GBIN_ELEMENT_LISTS] = (uint32_t)(writer.syllables.count
+            * score->number_of_voices);
+    writer.count[GBIN_ELEMENTS] = (uint32_t)writer.elements.count;
+    writer.count[GBIN_GLYPHS] = (uint32_t)writer.glyphs.count;
+    writer.count[GBIN_NOTES] = (uint32_t)writer.notes.count;
+    writer.count[GBIN_CHARACTERS] = (uint32_t)writer.characters.count;
+
+    put_score(&writer, score);
+    visit_nodes(&writer, score, false);
+    put_adjustments(&writer);
+    writer.count[GBIN_STRINGS] = (uint32_t)writer.section[GBIN_STRINGS].length;
+
+    put_bytes(&header, GBIN_MAGIC, 4);
+    put_u16(&header, GBIN_VERSION);
+    put_u16(&header, GBIN_NUMBER_OF_SECTIONS);
+    offset = HEADER_SIZE;
+    for (i = 0; i < GBIN_NUMBER_OF_SECTIONS; ++i) {
+        /* the sections start on four bytes */
+        put_zeros(&writer.section[i], (4 - writer.section[i].length % 4) % 4);
+        put_u32(&header, offset);
+        put_u32(&header, writer.count[i]);
+        offset += (uint32_t)writer.section[i].length;
+    }
+    fwrite(header.data, 1, header.length, f);
+    for (i = 0; i < GBIN_NUMBER_OF_SECTIONS; ++i) {
+        if (writer.section[i].length) {
+            fwrite(writer.section[i].data, 1, writer.section[i].length, f);
+        }
+        free(writer.section[i].data);
+    }
+    free(header.data);
+    free(writer.syllables.entries);
+    free(writer.elements.entries);
+    free(writer.glyphs.entries);
+    free(writer.notes.entries);
+    free(writer.characters.entries);
+    free(writer.adjustments);
+}
+
+/*
+ * Reading
+ */
+
+typedef struct gbin_reader {
+    const unsigned char *data;
+    size_t length;
+    const unsigned char *section[GBIN_NUMBER_OF_SECTIONS];
+    uint32_t count[GBIN_NUMBER_OF_SECTIONS];
+    /* the nodes, in the block of the score */
+    gregorio_syllable *syllables;
+    gregorio_element **element_lists;
+    gregorio_element *elements;
+    char **nabc;
+    gregorio_glyph *glyphs;
+    gregorio_note *notes;
+    gregorio_character *characters;
+    char *strings;
+    /* the (global) indexes of the adjustments of the file */
+    unsigned short *adjustments;
+    /* false once something invalid is found */
+    bool valid;
+} gbin_reader;
+
+static __inline unsigned int get_u8(const unsigned char **const p)
+{
+    return *(*p)++;
+}
+
+static __inline unsigned int get_u16(const unsigned char **const p)
+{
+    unsigned int value = (*p)[0] | (unsigned int)(*p)[1] << 8;
+    *p += 2;
+    return value;
+}
+
+static __inline uint32_t get_u32(const unsigned char **const p)
+{
+    uint32_t value = (uint32_t)(*p)[0] | (uint32_t)(*p)[1] << 8
+            | (uint32_t)(*p)[2] << 16 | (uint32_t)(*p)[3] << 24;
+    *p += 4;
+    return value;
+}
+
+static __inline signed char get_s8(const unsigned char **const p)
+{
+    unsigned int value = get_u8(p);
+    return (signed char)(value > SCHAR_MAX ? (int)value - 256 : (int)value);
+}
+
+/* the index of a link to the records of a section, or -1 for NULL */
+static long get_index(gbin_reader *const reader, const unsigned char **const p,
+        const gbin_section section)
+{
+    const uint32_t link = get_u32(p);
+    if (link > reader->count[section]) {
+        reader->valid = false;
+        return -1;
+    }
+    return (long)link - 1;
+}
+
+/* a link which must go forward, to the next node of a list */
+static long get_next_index(gbin_reader *const reader,
+        const unsigned char **const p, const gbin_section section,
+        const uint32_t index)
+{
+    const long next = get_index(reader, p, section);
+    if (next >= 0 && next <= (long)index) {
+        reader->valid = false;
+        return -1;
+    }
+    return next;
+}
+
+#define NODE(READER,ARRAY,INDEX) ((INDEX) < 0? NULL : &(READER)->ARRAY[INDEX])
+
+static char *get_string(gbin_reader *const reader,
+        const unsigned char **const p)
+{
+    const uint32_t link = get_u32(p);
+    if (!link) {
+        return NULL;
+    }
+    if (link > reader->count[GBIN_STRINGS]) {
+        reader->valid = false;
+        return NULL;
+    }
+    return reader->strings + link - 1;
+}
+
+static unsigned short get_texverb(gbin_reader *const reader,
+        const unsigned char **const p)
+{
+    const char *const texverb = get_string(reader, p);
+    return texverb? gregorio_add_texverb(gregorio_strdup(texverb)) : 0;
+}
+
+static unsigned short get_adjustment(gbin_reader *const reader,
+        const unsigned char **const p)
+{
+    const unsigned int link = get_u16(p);
+    if (!link) {
+        return 0;
+    }
+    if (link > reader->count[GBIN_ADJUSTMENTS]) {
+        reader->valid = false;
+        return 0;
+    }
+    return reader->adjustments[link - 1];
+}
+
+static void get_clef(const unsigned char **const p,
+        gregorio_clef_info *const clef)
+{
+    unsigned int bits;
+    clef->line = get_s8(p);
+    clef->secondary_line = get_s8(p);
+    clef->pitch_difference = get_s8(p);
+    bits = get_u8(p);
+    clef->clef = bits & 1;
+    clef->flatted = (bits >> 1) & 1;
+    clef->secondary_clef = (bits >> 2) & 1;
+    clef->secondary_flatted = (bits >> 3) & 1;
+}
+
+static void get_extra_info(gbin_reader *const reader,
+        const unsigned char **const p, gregorio_extra_info *const info)
+{
+    unsigned int bits;
+    info->ad_hoc_space_factor = get_string(reader, p);
+    info->bar = get_u8(p);
+    info->space = get_u8(p);
+    info->nlba = get_u8(p);
+    bits = get_u8(p);
+    info->eol_ragged = bits & 1;
+    info->eol_forces_custos = (bits >> 1) & 1;
+    info->eol_forces_custos_on = (bits >> 2) & 1;
+}
+
+static void get_misc(gbin_reader *const reader, const unsigned char **const p,
+        const gregorio_type type, gregorio_misc_element_info *const misc)
+{
+    const unsigned char *const end = *p + MISC_SIZE;
+    switch (type) {
+    case GRE_CLEF:
+        get_clef(p, &misc->clef);
+        break;
+    case GRE_CUSTOS:
+        misc->pitched.pitch = get_s8(p);
+        misc->pitched.force_pitch = get_u8(p) & 1;
+        break;
+    default:
+        get_extra_info(reader, p, &misc->unpitched.info);
+        misc->unpitched.special_sign = get_u8(p);
+        break;
+    }
+    *p = end;
+}
+
+static void get_next_pitch(gbin_reader *const reader,
+        const unsigned char **const p, gregorio_next_pitch *const next)
+{
+    const long note = get_index(reader, p, GBIN_NOTES);
+    const long custos = get_index(reader, p, GBIN_ELEMENTS);
+    next->note = NODE(reader, notes, note);
+    next->custos = NODE(reader, elements, custos);
+    next->alteration = get_u8(p);
+    next->determined = get_u8(p) & 1;
+}
+
+static void get_note(gbin_reader *const reader, const uint32_t index)
+{
+    gregorio_note *const note = &reader->notes[index];
+    const unsigned char *p = reader->section[GBIN_NOTES] + index * NOTE_SIZE;
+    const unsigned char *u;
+    long link;
+    uint32_t bits;
+
+    link = get_index(reader, &p, GBIN_NOTES);
+    note->previous = NODE(reader, notes, link);
+    link = get_next_index(reader, &p, GBIN_NOTES, index);
+    note->next = NODE(reader, notes, link);
+    note->choral_sign = get_string(reader, &p);
+    note->shape_hint = get_string(reader, &p);
+    /* the type, which tells how to read the union, comes later */
+    u = p;
+    p += EXTRA_INFO_SIZE;
+    note->texverb = get_texverb(reader, &p);
+    note->src_line = get_u16(&p);
+    note->src_column = get_u16(&p);
+    note->src_offset = get_u16(&p);
+    note->he_adjustment_index[SO_OVER] = get_adjustment(reader, &p);
+    note->he_adjustment_index[SO_UNDER] = get_adjustment(reader, &p);
+    note->type = get_u8(&p);
+    note->signs = get_u8(&p);
+    note->special_sign = get_u8(&p);
+    note->v_episema_height = get_s8(&p);
+    note->h_episema_above = get_s8(&p);
+    note->h_episema_below = get_s8(&p);
+    bits = get_u32(&p);
+    note->h_episema_above_size = bits & 3;
+    note->h_episema_below_size = (bits >> 2) & 3;
+    note->h_episema_above_connect = (bits >> 4) & 1;
+    note->h_episema_below_connect = (bits >> 5) & 1;
+    note->high_ledger_line = (bits >> 6) & 1;
+    note->high_ledger_specificity = (bits >> 7) & 3;
+    note->low_ledger_line = (bits >> 9) & 1;
+    note->low_ledger_specificity = (bits >> 10) & 3;
+    note->is_lower_note = (bits >> 12) & 1;
+    note->is_upper_note = (bits >> 13) & 1;
+    note->mora_vposition = (bits >> 14) & 3;
+    note->choral_sign_is_nabc = (bits >> 16) & 1;
+
+    switch (note->type) {
+    case GRE_CLEF:
+        get_clef(&u, &note->u.clef);
+        break;
+    case GRE_NOTE:
+    case GRE_CUSTOS:
+    case GRE_MANUAL_CUSTOS:
+        note->u.note.pitch = get_s8(&u);
+        note->u.note.shape = get_u8(&u);
+        note->u.note.liquescentia = get_u8(&u);
+        note->u.note.is_cavum = get_u8(&u) & 1;
+        break;
+    default:
+        get_extra_info(reader, &u, &note->u.other);
+        break;
+    }
+}
+
+static void get_glyph(gbin_reader *const reader, const uint32_t index)
+{
+    gregorio_glyph *const glyph = &reader->glyphs[index];
+    const unsigned char *p = reader->section[GBIN_GLYPHS] + index * GLYPH_SIZE;
+    const unsigned char *u;
+    long link;
+
+    link = get_index(reader, &p, GBIN_GLYPHS);
+    glyph->previous = NODE(reader, glyphs, link);
+    link = get_next_index(reader, &p, GBIN_GLYPHS, index);
+    glyph->next = NODE(reader, glyphs, link);
+    u = p;
+    p += MISC_SIZE;
+    get_next_pitch(reader, &p, &glyph->next_pitch);
+    glyph->texverb = get_texverb(reader, &p);
+    glyph->type = get_u8(&p);
+
+    if (glyph->type == GRE_GLYPH) {
+        link = get_index(reader, &u, GBIN_NOTES);
+        glyph->u.notes.first_note = NODE(reader, notes, link);
+        glyph->u.notes.fuse_to_next_glyph = get_s8(&u);
+        glyph->u.notes.glyph_type = get_u8(&u);
+        glyph->u.notes.liquescentia = get_u8(&u);
+        glyph->u.notes.is_cavum = get_u8(&u) & 1;
+    } else {
+        get_misc(reader, &u, glyph->type, &glyph->u.misc);
+    }
+}
+
+static void get_element(gbin_reader *const reader, const uint32_t index)
+{
+    gregorio_element *const element = &reader->elements[index];
+    const unsigned char *p = reader->section[GBIN_ELEMENTS]
+            + index * ELEMENT_SIZE;
+    const unsigned char *u;
+    long link;
+    uint32_t nabc, nabc_lines, i;
+
+    link = get_index(reader, &p, GBIN_ELEMENTS);
+    element->previous = NODE(reader, elements, link);
+    link = get_next_index(reader, &p, GBIN_ELEMENTS, index);
+    element->next = NODE(reader, elements, link);
+    nabc = get_u32(&p);
+    nabc_lines = get_u32(&p);
+    if (nabc_lines) {
+        if (nabc > reader->count[GBIN_NABC]
+                || nabc_lines > reader->count[GBIN_NABC] - nabc) {
+            reader->valid = false;
+        } else {
+            const unsigned char *q = reader->section[GBIN_NABC]
+                    + nabc * LINK_SIZE;
+            element->nabc = reader->nabc + nabc;
+            element->nabc_lines = nabc_lines;
+            for (i = 0; i < nabc_lines; ++i) {
+                element->nabc[i] = get_string(reader, &q);
+            }
+        }
+    }
+    u = p;
+    p += MISC_SIZE;
+    get_next_pitch(reader, &p, &element->next_pitch);
+    element->texverb = get_texverb(reader, &p);
+    element->type = get_u8(&p);
+
+    if (element->type == GRE_ELEMENT) {
+        link = get_index(reader, &u, GBIN_GLYPHS);
+        element->u.first_glyph = NODE(reader, glyphs, link);
+    } else {
+        get_misc(reader, &u, element->type, &element->u.misc);
+    }
+}
+
+static void get_character(gbin_reader *const reader, const uint32_t index)
+{
+    gregorio_character *const character = &reader->characters[index];
+    const unsigned char *p = reader->section[GBIN_CHARACTERS]
+            + index * CHARACTER_SIZE;
+    long link;
+
+    character->is_character = get_u8(&p) & 1;
+    link = get_next_index(reader, &p, GBIN_CHARACTERS, index);
+    character->next_character = NODE(reader, characters, link);
+    link = get_index(reader, &p, GBIN_CHARACTERS);
+    character->previous_character = NODE(reader, characters, link);
+    if (character->is_character) {
+        character->cos.character = get_u32(&p);
+    } else {
+        character->cos.s.style = get_u8(&p);
+        character->cos.s.type = get_u8(&p);
+    }
+}
+
+static void get_syllable(gbin_reader *const reader, const uint32_t index,
+        const int number_of_voices)
+{
+    gregorio_syllable *const syllable = &reader->syllables[index];
+    const unsigned char *p = reader->section[GBIN_SYLLABLES]
+            + index * SYLLABLE_SIZE;
+    const unsigned char *q = reader->section[GBIN_ELEMENT_LISTS]
+            + index * number_of_voices * LINK_SIZE;
+    long link;
+    unsigned int bits;
+    int voice;
+
+    link = get_index(reader, &p, GBIN_CHARACTERS);
+    syllable->text = NODE(reader, characters, link);
+    link = get_index(reader, &p, GBIN_CHARACTERS);
+    syllable->translation = NODE(reader, characters, link);
+    syllable->abovelinestext = get_string(reader, &p);
+    link = get_next_index(reader, &p, GBIN_SYLLABLES, index);
+    syllable->next_syllable = NODE(reader, syllables, link);
+    link = get_index(reader, &p, GBIN_SYLLABLES);
+    syllable->previous_syllable = NODE(reader, syllables, link);
+    syllable->euouae_id = get_u16(&p);
+    syllable->src_line = get_u16(&p);
+    syllable->src_column = get_u16(&p);
+    syllable->src_offset = get_u16(&p);
+    syllable->translation_type = get_u8(&p);
+    syllable->no_linebreak_area = get_u8(&p);
+    syllable->euouae = get_u8(&p);
+    syllable->position = get_u8(&p);
+    bits = get_u8(&p);
+    syllable->first_word = bits & 1;
+    syllable->forced_center = (bits >> 1) & 1;
+    syllable->clear = (bits >> 2) & 1;
+
+    syllable->elements = reader->element_lists + index * number_of_voices;
+    for (voice = 0; voice < number_of_voices; ++voice) {
+        link = get_index(reader, &q, GBIN_ELEMENTS);
+        syllable->elements[voice] = NODE(reader, elements, link);
+    }
+}
+
+static void get_score(gbin_reader *const reader, gregorio_score *const score,
+        gregorio_header *const headers, gregorio_voice_info *const voices)
+{
+    const unsigned char *p = reader->section[GBIN_SCORE];
+    uint32_t i;
+    long link;
+    int annotation;
+
+    for (i = 0; i < reader->count[GBIN_HEADERS]; ++i) {
+        const unsigned char *q = reader->section[GBIN_HEADERS]
+                + i * HEADER_RECORD_SIZE;
+        headers[i].name = get_string(reader, &q);
+        headers[i].value = get_string(reader, &q);
+        headers[i].next = i + 1 < reader->count[GBIN_HEADERS]
+                ? &headers[i + 1] : NULL;
+    }
+    if (reader->count[GBIN_HEADERS]) {
+        score->headers = headers;
+        score->last_header = &headers[reader->count[GBIN_HEADERS] - 1];
+    }
+    for (i = 0; i < reader->count[GBIN_VOICES]; ++i) {
+        const unsigned char *q = reader->section[GBIN_VOICES] + i * VOICE_SIZE;
+        get_clef(&q, &voices[i].initial_clef);
+        voices[i].next_voice_info = i + 1 < reader->count[GBIN_VOICES]
+                ? &voices[i + 1] : NULL;
+    }
+    if (reader->count[GBIN_VOICES]) {
+        score->first_voice_info = voices;
+    }
+
+    /* the version was checked by locate_sections */
+    p += 4;
+    memcpy(score->digest, p, SHA1_DIGEST_SIZE);
+    p += SHA1_DIGEST_SIZE;
+    link = get_index(reader, &p, GBIN_SYLLABLES);
+    score->first_syllable = NODE(reader, syllables, link);
+    score->number_of_voices = (int)get_u32(&p);
+    score->name = get_string(reader, &p);
+    score->gabc_copyright = get_string(reader, &p);
+    score->score_copyright = get_string(reader, &p);
+    score->mode = get_string(reader, &p);
+    score->mode_modifier = get_string(reader, &p);
+    score->mode_differentia = get_string(reader, &p);
+    score->author = get_string(reader, &p);
+    for (annotation = 0; annotation < MAX_ANNOTATIONS; ++annotation) {
+        score->annotation[annotation] = get_string(reader, &p);
+    }
+    score->nabc_lines = get_u32(&p);
+    score->user_notes = get_string(reader, &p);
+    score->det_method = get_u8(&p);
+    score->staff_lines = get_u8(&p);
+    score->highest_pitch = get_s8(&p);
+    score->high_ledger_line_pitch = get_s8(&p);
+    score->virgula_far_pitch = get_s8(&p);
+    score->legacy_oriscus_orientation = get_u8(&p) & 1;
+    score->digest_algorithm = get_u8(&p) & 1;
+}
+
+/* checks the header of the file and locates its sections */
+static bool locate_sections(gbin_reader *const reader)
+{
+    const unsigned char *p = reader->data + 4;
+    const char *version;
+    uint32_t link;
+    int i;
+
+    if (reader->length < HEADER_SIZE
+            || memcmp(reader->data, GBIN_MAGIC, 4) != 0) {
+        gregorio_message(_("not a gbin file"), "gbin_read_score",
+                VERBOSITY_ERROR, 0);
+        return false;
+    }
+    if (get_u16(&p) != GBIN_VERSION
+            || get_u16(&p) != GBIN_NUMBER_OF_SECTIONS) {
+        gregorio_message(_("unsupported version of the gbin format"),
+                "gbin_read_score", VERBOSITY_ERROR, 0);
+        return false;
+    }
+    for (i = 0; i < GBIN_NUMBER_OF_SECTIONS; ++i) {
+        const uint32_t offset = get_u32(&p);
+        const uint32_t count = get_u32(&p);
+        if (offset > reader->length
+                || count > (reader->length - offset) / record_size[i]) {
+            gregorio_message(_("truncated gbin file"), "gbin_read_score",
+                    VERBOSITY_ERROR, 0);
+            return false;
+        }
+        reader->section[i] = reader->data + offset;
+        reader->count[i] = count;
+    }
+    if (reader->count[GBIN_SCORE] != 1 || (reader->count[GBIN_STRINGS]
+                && reader->section[GBIN_STRINGS][reader->count[GBIN_STRINGS]
+                - 1] != '\0')) {
+        gregorio_message(_("invalid gbin file"), "gbin_read_score",
+                VERBOSITY_ERROR, 0);
+        return false;
+    }
+    p = reader->section[GBIN_SCORE];
+    link = get_u32(&p);
+    version = link && link <= reader->count[GBIN_STRINGS]
+            ? (const char *)reader->section[GBIN_STRINGS] + link - 1 : NULL;
+    if (!version || strcmp(version, GREGORIO_VERSION) != 0) {
+        gregorio_messagef("gbin_read_score", VERBOSITY_ERROR, 0,
+                _("the gbin file was written by another version of gregorio "
+                "(%s), write it again"), version? version : "?");
+        return false;
+    }
+    return true;
+}
+
+/* the offset at which an array of count items of the given size is put in the
+ * block, whose size is updated */
+static size_t reserve(size_t *const size, const size_t count,
+        const size_t item_size)
+{
+    const size_t align = sizeof(union { void *p; double d; long l; });
+    const size_t offset = (*size + align - 1) / align * align;
+    *size = offset + count * item_size;
+    return offset;
+}
+
+/* reads the whole file, which can be a pipe */
+static unsigned char *read_file(FILE *const f, size_t *const length)
+{
+    size_t capacity = 65536, read;
+    unsigned char *data = gregorio_grow_buffer(NULL, &capacity,
+            unsigned char);
+    *length = 0;
+    while ((read = fread(data + *length, 1, capacity - *length, f)) > 0) {
+        *length += read;
+        if (*length == capacity) {
+            data = gregorio_grow_buffer(data, &capacity, unsigned char);
+        }
+    }
+    return data;
+}
+
+gregorio_score *gbin_read_score(FILE *const f)
+{
+    gbin_reader reader;
+    unsigned char *data, *block;
+    gregorio_score *score;
+    size_t size = 0, syllables, element_lists, elements, nabc, glyphs, notes,
+            characters, headers, voices, strings;
+    int number_of_voices;
+    uint32_t i;
+
+    gregorio_assert(f, gbin_read_score, "can't read stream from NULL",
+            return NULL);
+    gregorio_stats_start(STATS_READ);
+    memset(&reader, 0, sizeof reader);
+    reader.valid = true;
+    data = read_file(f, &reader.length);
+    reader.data = data;
+    if (!locate_sections(&reader)) {
+        free(data);
+        gregorio_stats_stop(STATS_READ);
+        return NULL;
+    }
+    {
+        const unsigned char *p = reader.section[GBIN_SCORE] + 4
+                + SHA1_DIGEST_SIZE + 4;
+        number_of_voices = (int)get_u32(&p);
+    }
+    if (number_of_voices < 1 || number_of_voices > MAX_NUMBER_OF_VOICES
+            || reader.count[GBIN_ELEMENT_LISTS]
+            != reader.count[GBIN_SYLLABLES] * (uint32_t)number_of_voices) {
+        gregorio_message(_("invalid gbin file"), "gbin_read_score",
+                VERBOSITY_ERROR, 0);
+        free(data);
+        gregorio_stats_stop(STATS_READ);
+        return NULL;
+    }
+
+    /* the score starts the block */
+    reserve(&size, 1, sizeof(gregorio_score));
+    syllables = reserve(&size, reader.count[GBIN_SYLLABLES],
+            sizeof(gregorio_syllable));
+    element_lists = reserve(&size, reader.count[GBIN_ELEMENT_LISTS],
+            sizeof(gregorio_element *));
+    elements = reserve(&size, reader.count[GBIN_ELEMENTS],
+            sizeof(gregorio_element));
+    nabc = reserve(&size, reader.count[GBIN_NABC], sizeof(char *));
+    glyphs = reserve(&size, reader.count[GBIN_GLYPHS], sizeof(gregorio_glyph));
+    notes = reserve(&size, reader.count[GBIN_NOTES], sizeof(gregorio_note));
+    characters = reserve(&size, reader.count[GBIN_CHARACTERS],
+            sizeof(gregorio_character));
+    headers = reserve(&size, reader.count[GBIN_HEADERS],
+            sizeof(gregorio_header));
+    voices = reserve(&size, reader.count[GBIN_VOICES],
+            sizeof(gregorio_voice_info));
+    strings = reserve(&size, reader.count[GBIN_STRINGS], 1);
+
+    block = gregorio_calloc(1, size);
+    score = (gregorio_score *)block;
+    score->single_block = true;
+    reader.syllables = (gregorio_syllable *)(block + syllables);
+    reader.element_lists = (gregorio_element **)(block + element_lists);
+    reader.elements = (gregorio_element *)(block + elements);
+    reader.nabc = (char **)(block + nabc);
+    reader.glyphs = (gregorio_glyph *)(block + glyphs);
+    reader.notes = (gregorio_note *)(block + notes);
+    reader.characters = (gregorio_character *)(block + characters);
+    reader.strings = (char *)(block + strings);
+    if (reader.count[GBIN_STRINGS]) {
+        memcpy(reader.strings, reader.section[GBIN_STRINGS],
+                reader.count[GBIN_STRINGS]);
+    }
+
+    get_score(&reader, score, (gregorio_header *)(block + headers),
+            (gregorio_voice_info *)(block + voices));
+    if (reader.valid) {
+        reader.adjustments = gregorio_malloc((reader.count[GBIN_ADJUSTMENTS]
+                    + 1) * sizeof(unsigned short));
+        for (i = 0; i < reader.count[GBIN_ADJUSTMENTS]; ++i) {
+            const unsigned char *p = reader.section[GBIN_ADJUSTMENTS]
+                    + i * ADJUSTMENT_SIZE;
+            const gregorio_hepisema_vbasepos vbasepos = get_u8(&p);
+            const char *const nudge = get_string(&reader, &p);
+            gregorio_hepisema_adjustment *adjustment;
+            reader.adjustments[i] = gregorio_add_hepisema_adjustment(vbasepos,
+                    nudge? gregorio_strdup(nudge) : NULL);
+            adjustment = gregorio_get_hepisema_adjustment(
+                    reader.adjustments[i]);
+            adjustment->pitch_extremum = get_s8(&p);
+        }
+        for (i = 0; i < reader.count[GBIN_SYLLABLES]; ++i) {
+            get_syllable(&reader, i, number_of_voices);
+        }
+        for (i = 0; i < reader.count[GBIN_ELEMENTS]; ++i) {
+            get_element(&reader, i);
+        }
+        for (i = 0; i < reader.count[GBIN_GLYPHS]; ++i) {
+            get_glyph(&reader, i);
+        }
+        for (i = 0; i < reader.count[GBIN_NOTES]; ++i) {
+            get_note(&reader, i);
+        }
+        for (i = 0; i < reader.count[GBIN_CHARACTERS]; ++i) {
+            get_character(&reader, i);
+        }
+        free(reader.adjustments);
+    }
+    free(data);
+
+    if (!reader.valid) {
+        /* the lists may be broken, so the texverbs are found in the arrays */
+        for (i = 0; i < reader.count[GBIN_ELEMENTS]; ++i) {
+            if (reader.elements[i].texverb) {
+                gregorio_change_texverb(reader.elements[i].texverb, NULL);
+            }
+        }
+        for (i = 0; i < reader.count[GBIN_GLYPHS]; ++i) {
+            if (reader.glyphs[i].texverb) {
+                gregorio_change_texverb(reader.glyphs[i].texverb, NULL);
+            }
+        }
+        for (i = 0; i < reader.count[GBIN_NOTES]; ++i) {
+            if (reader.notes[i].texverb) {
+                gregorio_change_texverb(reader.notes[i].texverb, NULL);
+            }
+        }
+        gregorio_message(_("invalid gbin file"), "gbin_read_score",
+                VERBOSITY_ERROR, 0);
+        free(block);
+        gregorio_stats_stop(STATS_READ);
+        return NULL;
+    }
+    gregorio_stats_stop(STATS_READ);
+    return score;
+}
@@ -37,11 +37,18 @@ static const char *copyright =
 #include <limits.h>
 #include <errno.h>
 #include <assert.h>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
 #include "struct.h"
 #include "plugins.h"
 #include "messages.h"
 #include "characters.h"
 #include "support.h"
+#include "stats.h"
+#include "lsp.h"
+#include "diff.h"
 #include "gabc/gabc.h"
 #include "vowel/vowel.h"
 
@@ -53,12 +60,21 @@ typedef enum gregorio_file_format {
     FORMAT_UNSET = 0,
     GABC,
     GTEX,
-    DUMP
+    DUMP,
+    GBIN,
+    JSON
 } gregorio_file_format;
 
 #define GABC_STR "gabc"
 #define GTEX_STR "gtex"
 #define DUMP_STR "dump"
+#define GBIN_STR "gbin"
+
+#define SHA1_STR "sha1"
+#define XXH3_STR "xxh3"
+
+#define TEXT_STR "text"
+#define JSON_STR "json"
 
 #define DEFAULT_INPUT_FORMAT    GABC
 #define DEFAULT_OUTPUT_FORMAT   GTEX
@@ -203,12 +219,44 @@ printf(_("  -f, --input-format FORMAT\n\
   -v, --verbose             verbose mode\n\
   -W, --all-warnings        output warnings\n\
   -D, --deprecation-errors  treat deprecation warnings as errors\n\
-  -d, --debug               output debug information\n\
-\n\
+  -d, --debug               output debug information\n"));
+    printf(_("\
+  -H, --digest ALGORITHM    specify the algorithm of the score digest\n\
+                            (default: sha1)\n"));
+    printf(_("\
+  -t, --stats[=FORMAT]      print timing, allocation and size statistics\n\
+                            as text (default) or json, on stdout unless\n\
+                            the output is written there, then on stderr\n"));
+    printf(_("\
+      --canonical           write the canonical form of the gabc input,\n\
+                            over INPUT_FILE (each one with -B) if it is\n\
+                            not in this form, unless -o or -S is given\n\
+      --check               with --canonical, write nothing but fail if\n\
+                            an INPUT_FILE is not in canonical form\n\
+      --diff                compare two gabc files as scores, by header,\n\
+                            syllable, glyph and note, ignoring layout\n\
+"));
+    printf(_("\
+  -B, --batch               compile each of several INPUT_FILEs as if\n\
+                            gregorio was run on it alone, writing its\n\
+                            messages to basename(INPUT_FILE).glog\n\
+      --probe               only write the version to the output file\n\
+      --lsp                 serve the Language Server Protocol on stdin\n\
+                            and stdout, for the editors\n\
+\n"));
+    printf(_("\
 Formats:\n\
   gabc      gabc\n\
   gtex      GregorioTeX\n\
   dump      plain text dump (for debugging purpose)\n\
+  gbin      binary analyzed score, written once to be read by\n\
+            gregorio -f gbin to produce the other formats\n\
+  json      JSON analyzed score, for other tools\n\
+\n"));
+    printf(_("\
+Digest algorithms:\n\
+  sha1      SHA-1\n\
+  xxh3      XXH3 128-bit, faster but not cryptographic\n\
 \n\
 See <" PACKAGE_URL "> for general documentation,\n\
 GregorioRef.pdf and GregorioNabcRef.pdf for full documentation.\
@@ -311,6 +359,307 @@ static char *encode_point_and_click_filename(char *input_file_name)
     return result;
 }
 
+static const char *format_extension(const gregorio_file_format format)
+{
+    switch (format) {
+    case GABC:
+        return GABC_STR;
+    case GTEX:
+        return GTEX_STR;
+    case DUMP:
+        return DUMP_STR;
+    case GBIN:
+        return GBIN_STR;
+    case JSON:
+        return JSON_STR;
+    default:
+        /* not reachable unless there's a programming error */
+        /* LCOV_EXCL_START */
+        fprintf(stderr, "error: unsupported format");
+        gregorio_exit(1);
+        return NULL;
+        /* LCOV_EXCL_STOP */
+    }
+}
+
+static bool write_score(FILE *const output_file, gregorio_score *const score,
+        const gregorio_file_format output_format,
+        char *const point_and_click_filename)
+{
+    switch (output_format) {
+    case GABC:
+        gabc_write_score(output_file, score);
+        return true;
+    case GTEX:
+        gregoriotex_write_score(output_file, score, point_and_click_filename);
+        return true;
+    case DUMP:
+        dump_write_score(output_file, score);
+        return true;
+    case GBIN:
+        gbin_write_score(output_file, score);
+        return true;
+    case JSON:
+        json_write_score(output_file, score);
+        return true;
+    default:
+        /* not reachable unless there's a programming error */
+        /* LCOV_EXCL_START */
+        return false;
+        /* LCOV_EXCL_STOP */
+    }
+}
+
+static void free_lexers(void)
+{
+    gregorio_vowel_tables_free();
+    gabc_score_determination_lex_destroy();
+    gabc_notes_determination_lex_destroy();
+    gregorio_vowel_rulefile_lex_destroy();
+}
+
+/* Compiles each of the given files as if gregorio had been run on it alone,
+ * writing its output to its base name with the extension of the output
+ * format and its messages to its base name with the glog extension.  This
+ * saves starting a process per file when there are many small ones, as
+ * GregorioTeX does for the gabc snippets of a document.  The output of a file
+ * with errors is removed, so that the failure of each file can be told; a
+ * fatal error in a file only fails that file.  Returns false if a file could
+ * not be compiled. */
+static bool compile_batch(char **const input_file_names, const int count,
+        const gregorio_file_format output_format, const bool point_and_click,
+        const gregorio_digest_algorithm digest_algorithm)
+{
+    bool ok = true;
+    int i;
+
+    gregorio_set_fatal_exit(false);
+    for (i = 0; i < count; ++i) {
+        char *const input_file_name = input_file_names[i];
+        char *const basename = get_base_filename(input_file_name);
+        char *const output_file_name = get_output_filename(basename,
+                format_extension(output_format));
+        char *const error_file_name = get_output_filename(basename, "glog");
+        char *point_and_click_filename = NULL;
+        FILE *input_file = NULL;
+        FILE *output_file, *error_file;
+        gregorio_score *score;
+
+        free(basename);
+        check_input_clobber(input_file_name, output_file_name);
+        check_input_clobber(input_file_name, error_file_name);
+        gregorio_check_file_access(write, error_file_name, ERROR,
+                gregorio_exit(1));
+        /* as in main, first test if the file can be opened, so that the
+         * error can still go to the current stderr */
+        error_file = fopen(error_file_name, "w");
+        if (!error_file) {
+            fprintf(stderr, "error: can't open file %s for writing\n",
+                    error_file_name);
+            gregorio_exit(1);
+        }
+        fclose(error_file);
+        if (!freopen(error_file_name, "w", stderr)) {
+            gregorio_exit(1);
+        }
+        free(error_file_name);
+
+        gregorio_check_file_access(write, output_file_name, ERROR,
+                gregorio_exit(1));
+        output_file = fopen(output_file_name, "wb");
+        if (output_file) {
+            gregorio_check_file_access(read, input_file_name, ERROR,
+                    gregorio_exit(1));
+            input_file = fopen(input_file_name, "r");
+        } else {
+            fprintf(stderr, "error: can't write in file %s\n",
+                    output_file_name);
+        }
+        if (!input_file) {
+            if (output_file) {
+                fprintf(stderr, "error: can't open file %s for reading\n",
+                        input_file_name);
+                fclose(output_file);
+                remove(output_file_name);
+            }
+            free(output_file_name);
+            ok = false;
+            continue;
+        }
+
+        if (point_and_click) {
+            point_and_click_filename = encode_point_and_click_filename(
+                    input_file_name);
+        }
+        gregorio_reset_return_value();
+        score = gabc_read_score(input_file, point_and_click,
+                digest_algorithm);
+        fclose(input_file);
+        write_score(output_file, score, output_format,
+                point_and_click_filename);
+        fclose(output_file);
+        if (gregorio_get_return_value()) {
+            remove(output_file_name);
+            ok = false;
+        }
+        free(output_file_name);
+        if (point_and_click_filename) {
+            free(point_and_click_filename);
+        }
+        gregorio_free_score(score);
+        /* the lexers start afresh, which resets the state of the parser at
+         * the end of the file, and so do the ids of the score */
+        free_lexers();
+        gregorio_struct_reset();
+    }
+    gregorio_set_fatal_exit(true);
+    return ok;
+}
+
+/* Reads the whole of f, which need not be seekable, into a buffer whose size
+ * is stored in *size.  Returns NULL if f can't be read. */
+static char *read_whole_file(FILE *const f, size_t *const size)
+{
+    size_t capacity = 65536;
+    char *buf = (char *) gregorio_malloc(capacity);
+    size_t n;
+
+    *size = 0;
+    while ((n = fread(buf + *size, 1, capacity - *size, f)) > 0) {
+        *size += n;
+        if (*size == capacity) {
+            capacity <<= 1;
+            buf = (char *) gregorio_realloc(buf, capacity);
+        }
+    }
+    if (ferror(f)) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+/* Puts a gabc file in the canonical form of gabc_write_canonical_score.  The
+ * file is read whole from input, or from input_file_name if input is NULL,
+ * and compared with its canonical form, which is built in a temporary file.
+ * With check, nothing is written and a file which is not in the canonical
+ * form is reported.  Otherwise the canonical form is written to output, or to
+ * output_file_name, or else over the input file if it differs from it.
+ * Nothing is written for a file with errors.  Returns false if the file has
+ * errors or, with check, if it is not in the canonical form. */
+static bool canonicalize(const char *const input_file_name, FILE *input,
+        const char *output_file_name, FILE *output, const bool check)
+{
+    const char *const name = input_file_name? input_file_name : "stdin";
+    char *original, *formatted;
+    size_t original_size, formatted_size;
+    FILE *source, *temp;
+    gregorio_score *score;
+    bool changed, ok;
+
+    if (!input) {
+        gregorio_check_file_access(read, input_file_name, ERROR,
+                return false);
+        input = fopen(input_file_name, "rb");
+        if (!input) {
+            fprintf(stderr, "error: can't open file %s for reading\n",
+                    input_file_name);
+            return false;
+        }
+    }
+    original = read_whole_file(input, &original_size);
+    source = NULL;
+    if (original) {
+        if (input != stdin && fseek(input, 0, SEEK_SET) == 0) {
+            /* a file is parsed where it is */
+            source = input;
+        } else if ((source = tmpfile()) != NULL
+                && (fwrite(original, 1, original_size, source)
+                    != original_size || fseek(source, 0, SEEK_SET))) {
+            /* stdin is parsed from a copy */
+            fclose(source);
+            source = NULL;
+        }
+    }
+    if (input != stdin && input != source) {
+        fclose(input);
+    }
+    if (!source) {
+        fprintf(stderr, "error: can't read %s\n", name);
+        free(original);
+        return false;
+    }
+
+    gregorio_reset_return_value();
+    score = gabc_read_canonical_score(source);
+    fclose(source);
+    free_lexers();
+    temp = tmpfile();
+    if (!temp) {
+        fprintf(stderr, "error: can't create a temporary file\n");
+        gregorio_free_score(score);
+        free(original);
+        return false;
+    }
+    gabc_write_canonical_score(temp, score);
+    gregorio_free_score(score);
+    if (gregorio_get_return_value()) {
+        fprintf(stderr, "error: %s left unchanged because of errors\n", name);
+        fclose(temp);
+        free(original);
+        return false;
+    }
+    rewind(temp);
+    formatted = read_whole_file(temp, &formatted_size);
+    fclose(temp);
+    if (!formatted) {
+        fprintf(stderr, "error: can't read a temporary file\n");
+        free(original);
+        return false;
+    }
+    changed = formatted_size != original_size
+            || memcmp(formatted, original, formatted_size) != 0;
+    free(original);
+
+    if (check) {
+        if (changed) {
+            fprintf(stderr, "%s is not in canonical form\n", name);
+        }
+        free(formatted);
+        return !changed;
+    }
+    if (!output) {
+        if (!output_file_name && !changed) {
+            free(formatted);
+            return true;
+        }
+        if (!output_file_name) {
+            /* the input is rewritten in place */
+            output_file_name = input_file_name;
+        }
+        gregorio_check_file_access(write, output_file_name, ERROR, {
+            free(formatted);
+            return false;
+        });
+        output = fopen(output_file_name, "wb");
+        if (!output) {
+            fprintf(stderr, "error: can't write in file %s\n",
+                    output_file_name);
+            free(formatted);
+            return false;
+        }
+    }
+    ok = fwrite(formatted, 1, formatted_size, output) == formatted_size;
+    if (!ok) {
+        fprintf(stderr, "error: can't write the canonical form of %s\n", name);
+    }
+    if (output != stdout) {
+        fclose(output);
+    }
+    free(formatted);
+    return ok;
+}
+
 int main(int argc, char **argv)
 {
     int c;
@@ -329,9 +678,19 @@ int main(int argc, char **argv)
     bool point_and_click = false;
     char *point_and_click_filename = NULL;
     bool debug = false;
+    gregorio_digest_algorithm digest_algorithm = DIGEST_SHA1;
+    bool digest_algorithm_set = false;
+    bool stats = false;
+    gregorio_stats_format stats_format = STATS_TEXT;
+    bool batch = false;
+    bool probe = false;
+    bool lsp = false;
+    bool canonical = false;
+    bool check = false;
+    bool diff = false;
     bool must_print_short_usage = false;
     int option_index = 0;
-    static const char *const options = "o:SF:l:f:shOLVvWDpd";
+    static const char *const options = "o:SF:l:f:shOLVvWDpdH:t::B";
     static const struct option long_options[] = {
         {"output-file", 1, 0, 'o'},
         {"stdout", 0, 0, 'S'},
@@ -347,6 +706,16 @@ int main(int argc, char **argv)
         {"deprecation-errors", 0, 0, 'D'},
         {"point-and-click", 0, 0, 'p'},
         {"debug", 0, 0, 'd'},
+        {"digest", 1, 0, 'H'},
+        {"stats", 2, 0, 't'},
+        {"batch", 0, 0, 'B'},
+        /* long only, see the probe, lsp, canonical, check and diff cases below */
+        {"probe", 0, 0, 'P'},
+        {"lsp", 0, 0, 'R'},
+        {"canonical", 0, 0, 'N'},
+        {"check", 0, 0, 'K'},
+        {"diff", 0, 0, 'X'},
+        {0, 0, 0, 0}
     };
     gregorio_score *score = NULL;
 
@@ -447,6 +816,14 @@ int main(int argc, char **argv)
             if (!strcmp(optarg, DUMP_STR)) {
                 output_format = DUMP;
                 break;
+            }
+            if (!strcmp(optarg, GBIN_STR)) {
+                output_format = GBIN;
+                break;
+            }
+            if (!strcmp(optarg, JSON_STR)) {
+                output_format = JSON;
+                break;
             } else {
                 fprintf(stderr, "error: unknown output format: %s\n", optarg);
                 print_short_usage(argv[0]);
@@ -465,6 +842,10 @@ int main(int argc, char **argv)
             if (!strcmp(optarg, GABC_STR)) {
                 input_format = GABC;
                 break;
+            }
+            if (!strcmp(optarg, GBIN_STR)) {
+                input_format = GBIN;
+                break;
             } else {
                 fprintf(stderr, "error: unknown input format: %s\n", optarg);
                 print_short_usage(argv[0]);
@@ -540,6 +921,74 @@ int main(int argc, char **argv)
             }
             debug = true;
             break;
+        case 'H':
+            if (digest_algorithm_set) {
+                fprintf(stderr,
+                        "warning: several digest algorithms declared, first taken\n");
+                must_print_short_usage = true;
+                break;
+            }
+            digest_algorithm_set = true;
+            if (!strcmp(optarg, SHA1_STR)) {
+                digest_algorithm = DIGEST_SHA1;
+                break;
+            }
+            if (!strcmp(optarg, XXH3_STR)) {
+                digest_algorithm = DIGEST_XXH3;
+                break;
+            } else {
+                fprintf(stderr, "error: unknown digest algorithm: %s\n",
+                        optarg);
+                print_short_usage(argv[0]);
+                gregorio_exit(1);
+            }
+            break;
+        case 't':
+            if (stats) {
+                fprintf(stderr,
+                        "warning: stats option passed several times\n");
+                must_print_short_usage = true;
+                break;
+            }
+            stats = true;
+            if (!optarg || !strcmp(optarg, TEXT_STR)) {
+                stats_format = STATS_TEXT;
+                break;
+            }
+            if (!strcmp(optarg, JSON_STR)) {
+                stats_format = STATS_JSON;
+                break;
+            } else {
+                fprintf(stderr, "error: unknown stats format: %s\n", optarg);
+                print_short_usage(argv[0]);
+                gregorio_exit(1);
+            }
+            break;
+        case 'B':
+            if (batch) {
+                fprintf(stderr,
+                        "warning: batch option passed several times\n");
+                must_print_short_usage = true;
+                break;
+            }
+            batch = true;
+            break;
+        case 'P':
+            probe = true;
+            break;
+        case 'R':
+            lsp = true;
+            break;
+        case 'N':
+            canonical = true;
+            break;
+        case 'K':
+            /* checking is only meaningful for the canonical form */
+            canonical = check = true;
+            break;
+        case 'X':
+            diff = true;
+            break;
         case '?':
             must_print_short_usage = true;
             break;
@@ -553,7 +1002,70 @@ int main(int argc, char **argv)
             /* LCOV_EXCL_STOP */
         }
     } /* end of for */
-    if (optind == argc) {
+    if (probe) {
+        /* The cheapest way for GregorioTeX to find out whether an executable
+         * is a gregorio, and of which version: print the version alone and
+         * exit, without reading any input. */
+        if (output_file_name) {
+            gregorio_check_file_access(write, output_file_name, ERROR,
+                    gregorio_exit(1));
+            output_file = fopen(output_file_name, "wb");
+            if (!output_file) {
+                fprintf(stderr, "error: can't write in file %s",
+                        output_file_name);
+                gregorio_exit(1);
+            }
+        } else if (!output_file) {
+            output_file = stdout;
+        }
+        fprintf(output_file, "%s\n", GREGORIO_VERSION);
+        if (output_file != stdout) {
+            fclose(output_file);
+        }
+        gregorio_exit(0);
+    }
+    if (lsp) {
+        /* the messages go to the client, which may read stderr as a log */
+        if (!verb_mode) {
+            verb_mode = VERBOSITY_WARNING;
+        }
+        gregorio_set_verbosity_mode(verb_mode);
+        gregorio_set_deprecation_errors(deprecation_errors);
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        gregorio_exit(gregorio_lsp(stdin, stdout));
+    }
+    if (diff) {
+        /* like diff(1): 0 if the scores are the same, 1 if they differ and 2
+         * if either cannot be read */
+        if (argc - optind != 2) {
+            fprintf(stderr, "%s: --diff needs two file operands.\n", argv[0]);
+            print_short_usage(argv[0]);
+            gregorio_exit(2);
+        }
+        if (!verb_mode) {
+            verb_mode = VERBOSITY_WARNING;
+        }
+        gregorio_set_verbosity_mode(verb_mode);
+        gregorio_set_deprecation_errors(deprecation_errors);
+        gregorio_exit(gregorio_diff(argv[optind], argv[optind + 1], stdout));
+    }
+    if (batch) {
+        if (optind == argc) {
+            fprintf(stderr, "%s: missing file operand.\n", argv[0]);
+            print_short_usage(argv[0]);
+            gregorio_exit(1);
+        }
+        if (input_file || output_file || output_file_name || error_file_name
+                || stats) {
+            fprintf(stderr, "warning: the stdin, stdout, output-file, "
+                    "messages-file and stats options are ignored in batch "
+                    "mode\n");
+            must_print_short_usage = true;
+        }
+    } else if (optind == argc) {
         if (!input_file) { /* input not undefined (could be stdin) */
             fprintf(stderr, "%s: missing file operand.\n", argv[0]);
             print_short_usage(argv[0]);
@@ -570,7 +1082,7 @@ int main(int argc, char **argv)
             must_print_short_usage = true;
         }
     }
-    if (optind < argc) {
+    if (!batch && optind < argc) {
         must_print_short_usage = true;
         fprintf(stderr, "ignored arguments:");
         for (; optind < argc; ++optind) {
@@ -587,6 +1099,13 @@ int main(int argc, char **argv)
     gregorio_set_debug_messages(debug);
     gregorio_set_deprecation_errors(deprecation_errors);
 
+    if (canonical && ((output_format && output_format != GABC)
+                || (input_format && input_format != GABC))) {
+        fprintf(stderr, "error: the canonical form is only for gabc\n");
+        print_short_usage(argv[0]);
+        gregorio_exit(1);
+    }
+
     if (!input_format) {
         input_format = DEFAULT_INPUT_FORMAT;
     }
@@ -595,33 +1114,53 @@ int main(int argc, char **argv)
         output_format = DEFAULT_OUTPUT_FORMAT;
     }
 
+    if (!verb_mode) {
+        verb_mode = VERBOSITY_DEPRECATION;
+    }
+
+    gregorio_set_verbosity_mode(verb_mode);
+
     /* then we act... */
 
+    if (canonical) {
+        bool ok = true;
+        if (batch) {
+            /* the messages stay on stderr, as no file is to be written
+             * beside the ones formatted; as in compile_batch, a fatal error
+             * only fails its file, and each file is read afresh */
+            int i;
+            gregorio_set_fatal_exit(false);
+            for (i = optind; i < argc; ++i) {
+                if (!canonicalize(argv[i], NULL, NULL, NULL, check)) {
+                    ok = false;
+                }
+                gregorio_struct_reset();
+            }
+            gregorio_set_fatal_exit(true);
+        } else {
+            if (!output_file && !output_file_name && input_file) {
+                output_file = stdout;
+            }
+            ok = canonicalize(input_file_name, input_file, output_file_name,
+                    output_file, check);
+        }
+        if (output_basename) {
+            free(output_basename);
+        }
+        gregorio_exit(ok? 0 : 1);
+    }
+
+    if (batch) {
+        gregorio_exit(compile_batch(argv + optind, argc - optind,
+                    output_format, point_and_click, digest_algorithm) ? 0 : 1);
+    }
+
     if (!output_file_name && !output_file) {
         if (!output_basename) {
             output_file = stdout;
         } else {
-            switch (output_format) {
-            case GABC:
-                output_file_name =
-                    get_output_filename(output_basename, "gabc");
-                break;
-            case GTEX:
-                output_file_name =
-                    get_output_filename(output_basename, "gtex");
-                break;
-            case DUMP:
-                output_file_name =
-                    get_output_filename(output_basename, "dump");
-                break;
-            default:
-                /* not reachable unless there's a programming error */
-                /* LCOV_EXCL_START */
-                fprintf(stderr, "error: unsupported format");
-                print_short_usage(argv[0]);
-                gregorio_exit(1);
-                /* LCOV_EXCL_STOP */
-            }
+            output_file_name = get_output_filename(output_basename,
+                    format_extension(output_format));
         }
     }
 
@@ -642,6 +1181,16 @@ int main(int argc, char **argv)
         }
     }
 
+#ifdef _WIN32
+    /* gbin is binary */
+    if (input_format == GBIN && input_file == stdin) {
+        _setmode(_fileno(stdin), _O_BINARY);
+    }
+    if (output_format == GBIN && output_file == stdout) {
+        _setmode(_fileno(stdout), _O_BINARY);
+    }
+#endif
+
     /* we always have input_file or input_file_name */
     if (input_file) {
         if (point_and_click) {
@@ -651,7 +1200,7 @@ int main(int argc, char **argv)
     } else {
         gregorio_check_file_access(read, input_file_name, ERROR,
                 gregorio_exit(1));
-        input_file = fopen(input_file_name, "r");
+        input_file = fopen(input_file_name, input_format == GBIN ? "rb" : "r");
         if (!input_file) {
             fprintf(stderr, "error: can't open file %s for reading\n",
                     input_file_name);
@@ -663,15 +1212,17 @@ int main(int argc, char **argv)
         }
     }
 
-    if (!verb_mode) {
-        verb_mode = VERBOSITY_DEPRECATION;
+    if (stats) {
+        gregorio_stats_enable();
     }
 
-    gregorio_set_verbosity_mode(verb_mode);
-
     switch (input_format) {
     case GABC:
-        score = gabc_read_score(input_file, point_and_click);
+        score = gabc_read_score(input_file, point_and_click,
+                digest_algorithm);
+        break;
+    case GBIN:
+        score = gbin_read_score(input_file);
         break;
     default:
         /* not reachable unless there's a programming error */
@@ -686,43 +1237,35 @@ int main(int argc, char **argv)
 
     fclose(input_file);
     if (score == NULL) {
-        /* score should never be NULL on return from gabc_read_score */
-        /* LCOV_EXCL_START */
+        /* score is never NULL on return from gabc_read_score, but it is when
+         * a gbin file can't be read */
         fclose(output_file);
         fprintf(stderr, "error in file parsing\n");
         gregorio_exit(1);
-        /* LCOV_EXCL_STOP */
     }
 
-    switch (output_format) {
-    case GABC:
-        gabc_write_score(output_file, score);
-        break;
-    case GTEX:
-        gregoriotex_write_score(output_file, score, point_and_click_filename);
-        break;
-    case DUMP:
-        dump_write_score(output_file, score);
-        break;
-    default:
+    gregorio_stats_start(STATS_WRITE);
+    if (!write_score(output_file, score, output_format,
+                point_and_click_filename)) {
         /* not reachable unless there's a programming error */
         /* LCOV_EXCL_START */
         fprintf(stderr, "error : invalid output format\n");
         gregorio_free_score(score);
         fclose(output_file);
         gregorio_exit(1);
-        break;
         /* LCOV_EXCL_STOP */
     }
+    gregorio_stats_stop(STATS_WRITE);
+    if (stats) {
+        gregorio_stats_print(output_file == stdout ? stderr : stdout, score,
+                stats_format);
+    }
     fclose(output_file);
     if (point_and_click_filename) {
         free(point_and_click_filename);
     }
     gregorio_free_score(score);
-    gregorio_vowel_tables_free();
-    gabc_score_determination_lex_destroy();
-    gabc_notes_determination_lex_destroy();
-    gregorio_vowel_rulefile_lex_destroy();
+    free_lexers();
     if (error_file_name) {
         fclose(error_file);
     }
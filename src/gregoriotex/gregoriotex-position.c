@@ -27,77 +27,6 @@
 
 #include "gregoriotex.h"
 
-/* (loose) naming convention, employing camel case to be TeX-csname-compliant:
- * {specific-glyph-shape}{note-position}{note-shape}{first-ambitus}{second-ambitus}
- */
-OFFSET_CASE(FinalPunctum);
-OFFSET_CASE(FinalDeminutus);
-OFFSET_CASE(PenultBeforePunctumWide);
-OFFSET_CASE(PenultBeforeDeminutus);
-OFFSET_CASE(AntepenultBeforePunctum);
-OFFSET_CASE(AntepenultBeforeDeminutus);
-OFFSET_CASE(InitialPunctum);
-OFFSET_CASE(InitioDebilis);
-OFFSET_CASE(PorrNonAuctusInitialWide);
-OFFSET_CASE(PorrNonAuctusInitialOne);
-OFFSET_CASE(PorrAuctusInitialAny);
-OFFSET_CASE(FinalInclinatum);
-OFFSET_CASE(FinalInclinatumDeminutus);
-OFFSET_CASE(FinalStropha);
-OFFSET_CASE(FinalQuilisma);
-OFFSET_CASE(FinalOriscus);
-OFFSET_CASE(PenultBeforePunctumOne);
-OFFSET_CASE(FinalUpperPunctum);
-OFFSET_CASE(InitialOriscus);
-OFFSET_CASE(InitialQuilisma);
-OFFSET_CASE(TorcResNonAuctusSecondWideWide);
-OFFSET_CASE(TorcResNonAuctusSecondOneWide);
-OFFSET_CASE(TorcResDebilisNonAuctusSecondAnyWide);
-OFFSET_CASE(FinalLineaPunctum);
-OFFSET_CASE(TorcResQuilismaNonAuctusSecondWideWide);
-OFFSET_CASE(TorcResOriscusNonAuctusSecondWideWide);
-OFFSET_CASE(TorcResQuilismaNonAuctusSecondOneWide);
-OFFSET_CASE(TorcResOriscusNonAuctusSecondOneWide);
-OFFSET_CASE(TorcResNonAuctusSecondWideOne);
-OFFSET_CASE(TorcResDebilisNonAuctusSecondAnyOne);
-OFFSET_CASE(TorcResQuilismaNonAuctusSecondWideOne);
-OFFSET_CASE(TorcResOriscusNonAuctusSecondWideOne);
-OFFSET_CASE(TorcResNonAuctusSecondOneOne);
-OFFSET_CASE(TorcResQuilismaNonAuctusSecondOneOne);
-OFFSET_CASE(TorcResOriscusNonAuctusSecondOneOne);
-OFFSET_CASE(TorcResAuctusSecondWideAny);
-OFFSET_CASE(TorcResDebilisAuctusSecondAnyAny);
-OFFSET_CASE(TorcResQuilismaAuctusSecondWideAny);
-OFFSET_CASE(TorcResOriscusAuctusSecondWideAny);
-OFFSET_CASE(TorcResAuctusSecondOneAny);
-OFFSET_CASE(TorcResQuilismaAuctusSecondOneAny);
-OFFSET_CASE(TorcResOriscusAuctusSecondOneAny);
-OFFSET_CASE(ConnectedPenultBeforePunctumWide);
-OFFSET_CASE(ConnectedPenultBeforePunctumOne);
-OFFSET_CASE(InitialConnectedPunctum);
-OFFSET_CASE(InitialConnectedVirga);
-OFFSET_CASE(InitialConnectedQuilisma);
-OFFSET_CASE(InitialConnectedOriscus);
-OFFSET_CASE(FinalConnectedPunctum);
-OFFSET_CASE(FinalConnectedAuctus);
-OFFSET_CASE(FinalVirgaAuctus);
-OFFSET_CASE(FinalConnectedVirga);
-OFFSET_CASE(InitialVirga);
-OFFSET_CASE(SalicusOriscusWide);
-OFFSET_CASE(SalicusOriscusOne);
-OFFSET_CASE(LeadingPunctum);
-OFFSET_CASE(LeadingQuilisma);
-OFFSET_CASE(LeadingOriscus);
-OFFSET_CASE(Flat);
-OFFSET_CASE(FlatParen);
-OFFSET_CASE(FlatSoft);
-OFFSET_CASE(Sharp);
-OFFSET_CASE(SharpParen);
-OFFSET_CASE(SharpSoft);
-OFFSET_CASE(Natural);
-OFFSET_CASE(NaturalParen);
-OFFSET_CASE(NaturalSoft);
-
 static __inline const char *note_before_last_note_case_ignoring_deminutus(
         const gregorio_note *const current_note)
 {
@@ -1647,6 +1576,29 @@ static __inline int compute_fused_shift(const gregorio_glyph *glyph)
     return shift;
 }
 
+/* the name of a glyph, which depends on its fusion with the glyphs around it;
+ * the positioning keeps it in the fuse_to_next_glyph of the glyphs, so it is
+ * determined here on copies of them, leaving the score as the writer expects
+ * it */
+const char *gregoriotex_fused_glyph_name(const gregorio_glyph *const glyph,
+        gtex_alignment *const type, gtex_type *const gtype)
+{
+    gregorio_glyph named, previous;
+    const gregorio_glyph *const before =
+            gregorio_previous_non_texverb_glyph(glyph);
+
+    named = *glyph;
+    named.previous = NULL;
+    named.u.notes.fuse_to_next_glyph = compute_fused_shift(
+            gregorio_next_non_texverb_glyph(glyph));
+    if (before && before->type == GRE_GLYPH) {
+        previous = *before;
+        previous.u.notes.fuse_to_next_glyph = compute_fused_shift(glyph);
+        named.previous = &previous;
+    }
+    return gregoriotex_determine_glyph_name(&named, type, gtype);
+}
+
 void gregoriotex_compute_positioning(
         const gregorio_element *const param_element,
         const gregorio_score *const score)
@@ -1743,11 +1695,14 @@ static __inline void adjust_hepisema(gregorio_note *const note,
     }
 }
 
+/* from first to the syllable before end, which is NULL for the end of the
+ * score */
 void gregoriotex_compute_cross_syllable_positioning(
-        const gregorio_score *const score)
+        const gregorio_score *const score, gregorio_syllable *const first,
+        const gregorio_syllable *const end)
 {
     gregorio_syllable *syllable;
-    for (syllable = score->first_syllable; syllable;
+    for (syllable = first; syllable != end;
             syllable = syllable->next_syllable) {
         int voice;
         for (voice = 0; voice < score->number_of_voices; ++voice) {
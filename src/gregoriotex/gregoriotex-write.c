@@ -37,6 +37,8 @@
 #include "characters.h"
 #include "plugins.h"
 #include "support.h"
+#include "stats.h"
+#include "nabc.h"
 #include "utf8strings.h"
 
 #include "gregoriotex.h"
@@ -62,6 +64,9 @@ typedef struct gregoriotex_status {
     bool abovelinestext;
 
     bool suppressed_custos;
+
+    /* the status of each voice after the first one, in polyphony */
+    struct gregoriotex_status *other_voices;
 } gregoriotex_status;
 
 #define UNDETERMINED_HEIGHT -127
@@ -1236,16 +1241,6 @@ const char *gregoriotex_determine_glyph_name(const gregorio_glyph *const glyph,
     return shape;
 }
 
-/**
- * This now does nothing useful, but we keep it here in case it may
- * be needed in future.
- */
-static void gregoriotex_write_voice_info(FILE *f, gregorio_voice_info *voice_info)
-{
-    gregorio_assert(f && voice_info, gregoriotex_write_voice_info,
-            "file or voice_info passed as NULL", return);
-}
-
 /* this function indicates if the syllable is the last of the line or score. */
 static bool is_last_of_line(gregorio_syllable *syllable)
 {
@@ -1350,40 +1345,149 @@ static void gtex_write_end(FILE *f, grestyle_style style)
     }
 }
 
+/* Returns the escape of c, written in buf (which holds at least 12
+ * characters) when needed, or NULL if c is to be written as it is.
+ *
+ * We escape these characters into \string\ddd (where ddd is the decimal ASCII
+ * value of the character) for most escapes, and into \string\n for newlines.
+ * We do it this way to get the "raw" string values through TeX and into Lua,
+ * where the sequences become \ddd and \n respectively and are translated into
+ * their byte values. Lua can then decide whether the full strings should be
+ * evaluated by TeX as TeX or as strings */
+static __inline const char *tex_escape(const char c, char *const buf)
+{
+    switch (c) {
+    case '\\':
+    case '{':
+    case '}':
+    case '~':
+    case '%': /* currently, we'll never get %, but handle it anyway */
+    case '#':
+    case '"':
+        /* these characters have special meaning to TeX */
+        gregorio_snprintf(buf, 12, "\\string\\%03d", c);
+        return buf;
+    case '\n':
+        return "\\string\\n";
+    case '\r':
+        /* ignore */
+        return "";
+    default:
+        /* UTF-8 multibyte sequences will fall into here, which is fine */
+        return NULL;
+    }
+}
+
 static __inline void tex_escape_text(FILE *const f, const char *text)
 {
-    /* We escape these characters into \string\ddd (where ddd is the decimal
-     * ASCII value of the character) for most escapes, and into \string\n for
-     * newlines. We do it this way to get the "raw" string values through TeX
-     * and into Lua, where the sequences become \ddd and \n respectively and
-     * are translated into their byte values. Lua can then decide whether the
-     * full strings should be evaluated by TeX as TeX or as strings */
+    char buf[12];
+    const char *escape;
+
     for (; *text; ++text) {
-        switch (*text) {
-        case '\\':
-        case '{':
-        case '}':
-        case '~':
-        case '%': /* currently, we'll never get %, but handle it anyway */
-        case '#':
-        case '"':
-            /* these characters have special meaning to TeX */
-            fprintf(f, "\\string\\%03d", *text);
-            break;
-        case '\n':
-            fprintf(f, "\\string\\n");
-            break;
-        case '\r':
-            /* ignore */
-            break;
-        default:
-            /* UTF-8 multibyte sequences will fall into here, which is fine */
+        escape = tex_escape(*text, buf);
+        if (escape) {
+            fputs(escape, f);
+        } else {
             fputc(*text, f);
-            break;
         }
     }
 }
 
+/* The TeX of the neumes of a nabc string, built while the string is parsed,
+ * since it is only written if the whole string can be parsed.  It is kept
+ * from one string to the next, and freed at the end of the score. */
+static struct {
+    char *text;
+    size_t length, capacity;
+} nabc_tex = { NULL, 0, 0 };
+
+static void nabc_tex_append(const char *const text, const size_t length)
+{
+    if (nabc_tex.length + length >= nabc_tex.capacity) {
+        if (!nabc_tex.capacity) {
+            nabc_tex.capacity = 256;
+        }
+        while (nabc_tex.length + length >= nabc_tex.capacity) {
+            nabc_tex.capacity <<= 1;
+        }
+        nabc_tex.text = (char *)gregorio_realloc(nabc_tex.text,
+                nabc_tex.capacity);
+    }
+    memcpy(nabc_tex.text + nabc_tex.length, text, length);
+    nabc_tex.length += length;
+}
+
+static __inline void nabc_tex_puts(const char *const text)
+{
+    nabc_tex_append(text, strlen(text));
+}
+
+static void nabc_tex_escape_text(const char *text)
+{
+    char buf[12];
+    const char *escape;
+
+    for (; *text; ++text) {
+        escape = tex_escape(*text, buf);
+        if (escape) {
+            nabc_tex_puts(escape);
+        } else {
+            nabc_tex_append(text, 1);
+        }
+    }
+}
+
+static void write_nabc_space(void *const ignored __attribute__((unused)),
+        const gregorio_nabc_space space)
+{
+    char buf[32];
+    gregorio_snprintf(buf, sizeof buf, "\\GreNABCSpace{%d}", (int)space);
+    nabc_tex_puts(buf);
+}
+
+static void write_nabc_neume(void *const ignored __attribute__((unused)),
+        const gregorio_nabc_neume *const neume)
+{
+    char buf[32];
+
+    nabc_tex_puts("\\GreNABCNeume{");
+    nabc_tex_escape_text(neume->glyph);
+    gregorio_snprintf(buf, sizeof buf, "}{%d}{", neume->height);
+    nabc_tex_puts(buf);
+    nabc_tex_escape_text(neume->letters);
+    nabc_tex_puts("}{");
+    nabc_tex_escape_text(neume->prepunctis);
+    nabc_tex_puts("}{");
+    nabc_tex_escape_text(neume->subpunctis);
+    nabc_tex_puts("}");
+}
+
+/* writes the nabc neumes parsed here; a string which could not be parsed
+ * (the error has been reported when reading the score) is left to
+ * \GreNABCChar, which typesets what it can */
+static void write_nabc(FILE *const f, const char *const nabc)
+{
+    nabc_tex.length = 0;
+    if (gregorio_nabc_parse(nabc, write_nabc_space, write_nabc_neume, NULL,
+            NULL, NULL)) {
+        if (nabc_tex.length) {
+            fwrite(nabc_tex.text, 1, nabc_tex.length, f);
+        }
+    } else {
+        fprintf(f, "\\GreNABCChar{");
+        tex_escape_text(f, nabc);
+        fprintf(f, "}");
+    }
+}
+
+static void free_nabc_tex(void)
+{
+    free(nabc_tex.text);
+    nabc_tex.text = NULL;
+    nabc_tex.length = 0;
+    nabc_tex.capacity = 0;
+}
+
 static __inline void tex_escape_wtext(FILE *const f, const grewchar *text)
 {
     /* We escape these characters into \string\ddd (where ddd is the decimal
@@ -1706,12 +1810,6 @@ static __inline bool is_manual_custos(const gregorio_element *const element)
     return element->type == GRE_CUSTOS && element->u.misc.pitched.force_pitch;
 }
 
-OFFSET_CASE(BarStandard);
-OFFSET_CASE(BarVirgula);
-OFFSET_CASE(BarDivisioFinalis);
-OFFSET_CASE(BarParen);
-OFFSET_CASE(BarVirgulaParen);
-
 static void write_bar(FILE *f, const gregorio_score *const score,
         const gregorio_syllable *const syllable,
         const gregorio_element *const element,
@@ -3847,7 +3945,11 @@ static __inline void anticipate_event(gregorio_syllable *syllable,
             scan_syllable_for_eol(syllable, eol_forces_custos);
 
             if (syllable->euouae == EUOUAE_BEGINNING) {
-                *next_euouae_id = syllable->euouae_id = ++tex_position_id;
+                /* keep the identifier when the syllable is written again */
+                if (!syllable->euouae_id) {
+                    syllable->euouae_id = ++tex_position_id;
+                }
+                *next_euouae_id = syllable->euouae_id;
                 *euouae_follows = has_intervening_linebreak? '1' : '0';
             }
         }
@@ -4010,6 +4112,236 @@ static void write_default_end_of_element(FILE *f,
     }
 }
 
+/*
+ * Writes the elements of a voice (numbered from 0) of a syllable, from first.
+ * Returns true if the anticipated event was written, with a line break.
+ */
+static bool write_elements(FILE *const f, gregorio_syllable *const syllable,
+        const int voice, const gregorio_element *const first,
+        const unsigned char first_of_disc, gregoriotex_status *const status,
+        const gregorio_score *const score,
+        const gregorio_element *const last_of_voice, const char euouae_follows,
+        const char eol_forces_custos, const unsigned short next_euouae_id)
+{
+    const gregorio_element *element;
+    unsigned int note_unit_count = 0;
+    bool anticipated_event_written = false;
+
+    for (element = first; element; element = element->next) {
+        if (element->nabc_lines && element->nabc) {
+            signed char high_pitch = UNDETERMINED_HEIGHT;
+            signed char low_pitch = UNDETERMINED_HEIGHT;
+            size_t i;
+            compute_element_height_extrema(element, &high_pitch,
+                    &low_pitch);
+            fixup_height_extrema(&high_pitch, &low_pitch);
+            for (i = 0; i < element->nabc_lines; i++) {
+                if (element->nabc[i]) {
+                    fprintf(f, "\\GreNABCNeumes{%d}{", (int)(i+1));
+                    write_nabc(f, element->nabc[i]);
+                    fprintf(f, "}{%d}{%d}%%\n", pitch_value(high_pitch),
+                            pitch_value(low_pitch));
+                }
+            }
+        }
+        switch (element->type) {
+        case GRE_SPACE:
+            switch (element->u.misc.unpitched.info.space) {
+            case SP_LARGER_SPACE:
+                fprintf(f, "\\GreEndOfElement{1}{0}{%u}%%\n",
+                        note_unit_count);
+                break;
+            case SP_GLYPH_SPACE:
+                fprintf(f, "\\GreEndOfElement{2}{0}{%u}%%\n",
+                        note_unit_count);
+                break;
+            case SP_NEUMATIC_CUT:
+                fprintf(f, "\\GreEndOfElement{0}{0}{%u}%%\n",
+                        note_unit_count);
+                break;
+            case SP_AD_HOC_SPACE:
+                fprintf(f, "\\GreAdHocSpaceEndOfElement{%s}{0}{%u}%%\n",
+                        element->u.misc.unpitched.info.ad_hoc_space_factor,
+                        note_unit_count);
+                break;
+            case SP_GLYPH_SPACE_NB:
+                fprintf(f, "\\GreEndOfElement{2}{1}{%u}%%\n",
+                        note_unit_count);
+                break;
+            case SP_LARGER_SPACE_NB:
+                fprintf(f, "\\GreEndOfElement{1}{1}{%u}%%\n",
+                        note_unit_count);
+                break;
+            case SP_NEUMATIC_CUT_NB:
+                fprintf(f, "\\GreEndOfElement{0}{1}{%u}%%\n",
+                        note_unit_count);
+                break;
+            case SP_AD_HOC_SPACE_NB:
+                fprintf(f, "\\GreAdHocSpaceEndOfElement{%s}{1}{%u}%%\n",
+                        element->u.misc.unpitched.info.ad_hoc_space_factor,
+                        note_unit_count);
+                break;
+            default:
+                /* not reachable unless there's a programming error */
+                /* LCOV_EXCL_START */
+                gregorio_fail(write_syllable,
+                        "encountered an unexpected element-level space");
+                break;
+                /* LCOV_EXCL_STOP */
+            }
+            break;
+
+        case GRE_TEXVERB_ELEMENT:
+            if (element->texverb) {
+                fprintf(f, "%% verbatim text at element level:\n%s%%\n"
+                        "%% end of verbatim text\n",
+                        gregorio_texverb(element->texverb));
+            }
+            break;
+
+        case GRE_NLBA:
+            if (element->u.misc.unpitched.info.nlba == NLBA_BEGINNING) {
+                fprintf(f, "\\GreBeginNLBArea{0}{0}%%\n");
+            } else {
+                fprintf(f, "\\GreEndNLBArea{%d}{0}%%\n",
+                        next_is_bar(syllable, element)? 3 : 0);
+            }
+            break;
+
+        case GRE_ALT:
+            if (element->texverb) {
+                fprintf(f, "\\GreSetTextAboveLines{%s}%%\n",
+                        gregorio_texverb(element->texverb));
+            }
+            break;
+
+        case GRE_CLEF:
+            /* We don't print clef changes at the end of a line */
+            if (first_of_disc != 1) {
+                if (is_before_linebreak(syllable, element)) {
+                    signed char next_note_pitch;
+                    gregorio_shape next_note_alteration;
+
+                    next_note_pitch = gregorio_adjust_pitch_into_staff(
+                            score, gregorio_determine_next_pitch(
+                            syllable, element, NULL, &next_note_alteration)
+                            - element->u.misc.clef.pitch_difference);
+
+                    fputs(next_custos(next_note_pitch, next_note_alteration,
+                            status), f);
+                    gregoriotex_print_change_line_clef(f, element);
+                } else {
+                    /* the third argument is 0 or 1 according to the need
+                     * for a space before the clef */
+                    fprintf(f, "\\GreChangeClef{%c}{%d}{%c}{%d}{%c}{%d}{%d}%%\n",
+                            gregorio_clef_to_char(element->u.misc.clef.clef),
+                            element->u.misc.clef.line,
+                            (!element->previous || element->previous->type
+                             == GRE_BAR)? '0' : '1',
+                            clef_flat_height(element->u.misc.clef.clef,
+                                    element->u.misc.clef.line,
+                                    element->u.misc.clef.flatted),
+                            gregorio_clef_to_char(
+                                    element->u.misc.clef.secondary_clef),
+                            element->u.misc.clef.secondary_line,
+                            clef_flat_height(
+                                    element->u.misc.clef.secondary_clef,
+                                    element->u.misc.clef.secondary_line,
+                                    element->u.misc.clef.secondary_flatted));
+                }
+            }
+            break;
+
+        case GRE_CUSTOS:
+            if (first_of_disc != 1) {
+                signed char next_note_pitch;
+                gregorio_shape next_note_alteration;
+                const char *alteration = "";
+                /* We don't print custos before a bar at the end of a line.
+                 * We also print an unbreakable larger space before the
+                 * custos */
+                handle_last_of_voice(f, syllable, element, last_of_voice);
+                next_note_pitch = gregorio_determine_next_pitch(syllable,
+                        element, NULL, &next_note_alteration);
+                if (!element->u.misc.pitched.force_pitch) {
+                    alteration = alteration_name(next_note_alteration);
+                }
+                fprintf(f, "\\GreCustos{%d}{%s}%s%%\n",
+                        pitch_value(element->u.misc.pitched.pitch), alteration,
+                        next_custos(next_note_pitch, next_note_alteration,
+                        status));
+                ++note_unit_count;
+            }
+            break;
+
+        case GRE_SUPPRESS_CUSTOS:
+            handle_last_of_voice(f, syllable, element, last_of_voice);
+            fprintf(f, "\\GreSuppressEolCustos %%\n");
+            status->suppressed_custos = true;
+            break;
+
+        case GRE_BAR:
+            handle_last_of_voice(f, syllable, element, last_of_voice);
+            write_bar(f, score, syllable, element, first_of_disc);
+            break;
+
+        case GRE_END_OF_LINE:
+            /* the line breaks are those of the first voice */
+            if (voice) {
+                break;
+            }
+            if (!element->next) {
+                write_anticipated_event(f, euouae_follows,
+                        eol_forces_custos, next_euouae_id);
+                anticipated_event_written = true;
+            }
+            /* here we suppose we don't have two linebreaks in the same
+             * syllable */
+            if (element->u.misc.unpitched.info.eol_ragged) {
+                fprintf(f, "%%\n%%\n\\GreNewParLine %%\n%%\n%%\n");
+            } else {
+                fprintf(f, "%%\n%%\n\\GreNewLine %%\n%%\n%%\n");
+            }
+            break;
+
+        default:
+            /* here element->type is GRE_ELEMENT */
+            assert(element->type == GRE_ELEMENT);
+            handle_last_of_voice(f, syllable, element, last_of_voice);
+            note_unit_count += write_element(f, syllable, element, status,
+                    score);
+            write_default_end_of_element(f, element, note_unit_count);
+            break;
+        }
+    }
+    return anticipated_event_written;
+}
+
+/*
+ * Writes the voices of a syllable after the first one, each in a \GreVoice
+ * of its own after the notes of the first one, with the number of the voice
+ * (the first one being 1) and its number of note units.
+ */
+static void write_other_voices(FILE *const f,
+        gregorio_syllable *const syllable, const unsigned char first_of_disc,
+        gregoriotex_status *const status, const gregorio_score *const score,
+        const gregorio_element *const *const last_of_voice)
+{
+    int voice;
+
+    for (voice = 1; voice < score->number_of_voices; ++voice) {
+        const gregorio_element *const first = syllable->elements[voice];
+        fprintf(f, "\\GreVoice{%d}{%u}{%%\n", voice + 1,
+                first? count_note_units(first) : 0);
+        if (first) {
+            write_elements(f, syllable, voice, first, first_of_disc,
+                    status->other_voices + voice - 1, score,
+                    last_of_voice[voice], '\0', '\0', 0);
+        }
+        fprintf(f, "}%%\n");
+    }
+}
+
 /*
  * Arguments are relatively obvious. The most obscure is certainly first_of_disc
  * which is 0 all the time, except in the case of a "clef change syllable". In
@@ -4030,7 +4362,7 @@ static void write_syllable(FILE *f, gregorio_syllable *syllable,
         void (*const write_this_syllable_text)
         (FILE *, const char *, const gregorio_syllable *, bool))
 {
-    const gregorio_element *clef_change_element = NULL, *element;
+    const gregorio_element *clef_change_element = NULL;
     const char *syllable_type = NULL;
     bool anticipated_event_written = false;
     bool end_of_word;
@@ -4038,7 +4370,6 @@ static void write_syllable(FILE *f, gregorio_syllable *syllable,
     char euouae_follows;
     char eol_forces_custos;
     unsigned short next_euouae_id;
-    unsigned int note_unit_count;
     gtex_alignment alignment = AT_ONE_NOTE;
     gtex_alteration alteration = ALT_NONE;
 
@@ -4191,196 +4522,21 @@ static void write_syllable(FILE *f, gregorio_syllable *syllable,
     fprintf(f, "\\GreSyllableNoteCount{%u}%%\n", syllable->elements?
             count_note_units(*syllable->elements) : 0);
 
-    note_unit_count = 0;
     if (syllable->elements) {
-        for (element = *syllable->elements; element; element = element->next) {
-            if (element->nabc_lines && element->nabc) {
-                signed char high_pitch = UNDETERMINED_HEIGHT;
-                signed char low_pitch = UNDETERMINED_HEIGHT;
-                size_t i;
-                compute_element_height_extrema(element, &high_pitch,
-                        &low_pitch);
-                fixup_height_extrema(&high_pitch, &low_pitch);
-                for (i = 0; i < element->nabc_lines; i++) {
-                    if (element->nabc[i]) {
-                        fprintf(f, "\\GreNABCNeumes{%d}{", (int)(i+1));
-                        tex_escape_text(f, element->nabc[i]);
-                        fprintf(f, "}{%d}{%d}%%\n", pitch_value(high_pitch),
-                                pitch_value(low_pitch));
-                    }
-                }
-            }
-            switch (element->type) {
-            case GRE_SPACE:
-                switch (element->u.misc.unpitched.info.space) {
-                case SP_LARGER_SPACE:
-                    fprintf(f, "\\GreEndOfElement{1}{0}{%u}%%\n",
-                            note_unit_count);
-                    break;
-                case SP_GLYPH_SPACE:
-                    fprintf(f, "\\GreEndOfElement{2}{0}{%u}%%\n",
-                            note_unit_count);
-                    break;
-                case SP_NEUMATIC_CUT:
-                    fprintf(f, "\\GreEndOfElement{0}{0}{%u}%%\n",
-                            note_unit_count);
-                    break;
-                case SP_AD_HOC_SPACE:
-                    fprintf(f, "\\GreAdHocSpaceEndOfElement{%s}{0}{%u}%%\n",
-                            element->u.misc.unpitched.info.ad_hoc_space_factor,
-                            note_unit_count);
-                    break;
-                case SP_GLYPH_SPACE_NB:
-                    fprintf(f, "\\GreEndOfElement{2}{1}{%u}%%\n",
-                            note_unit_count);
-                    break;
-                case SP_LARGER_SPACE_NB:
-                    fprintf(f, "\\GreEndOfElement{1}{1}{%u}%%\n",
-                            note_unit_count);
-                    break;
-                case SP_NEUMATIC_CUT_NB:
-                    fprintf(f, "\\GreEndOfElement{0}{1}{%u}%%\n",
-                            note_unit_count);
-                    break;
-                case SP_AD_HOC_SPACE_NB:
-                    fprintf(f, "\\GreAdHocSpaceEndOfElement{%s}{1}{%u}%%\n",
-                            element->u.misc.unpitched.info.ad_hoc_space_factor,
-                            note_unit_count);
-                    break;
-                default:
-                    /* not reachable unless there's a programming error */
-                    /* LCOV_EXCL_START */
-                    gregorio_fail(write_syllable,
-                            "encountered an unexpected element-level space");
-                    break;
-                    /* LCOV_EXCL_STOP */
-                }
-                break;
-
-            case GRE_TEXVERB_ELEMENT:
-                if (element->texverb) {
-                    fprintf(f, "%% verbatim text at element level:\n%s%%\n"
-                            "%% end of verbatim text\n",
-                            gregorio_texverb(element->texverb));
-                }
-                break;
-
-            case GRE_NLBA:
-                if (element->u.misc.unpitched.info.nlba == NLBA_BEGINNING) {
-                    fprintf(f, "\\GreBeginNLBArea{0}{0}%%\n");
-                } else {
-                    fprintf(f, "\\GreEndNLBArea{%d}{0}%%\n",
-                            next_is_bar(syllable, element)? 3 : 0);
-                }
-                break;
-
-            case GRE_ALT:
-                if (element->texverb) {
-                    fprintf(f, "\\GreSetTextAboveLines{%s}%%\n",
-                            gregorio_texverb(element->texverb));
-                }
-                break;
-
-            case GRE_CLEF:
-                /* We don't print clef changes at the end of a line */
-                if (first_of_disc != 1) {
-                    if (is_before_linebreak(syllable, element)) {
-                        signed char next_note_pitch;
-                        gregorio_shape next_note_alteration;
-
-                        next_note_pitch = gregorio_adjust_pitch_into_staff(
-                                score, gregorio_determine_next_pitch(
-                                syllable, element, NULL, &next_note_alteration)
-                                - element->u.misc.clef.pitch_difference);
-
-                        fputs(next_custos(next_note_pitch, next_note_alteration,
-                                status), f);
-                        gregoriotex_print_change_line_clef(f, element);
-                    } else {
-                        /* the third argument is 0 or 1 according to the need
-                         * for a space before the clef */
-                        fprintf(f, "\\GreChangeClef{%c}{%d}{%c}{%d}{%c}{%d}{%d}%%\n",
-                                gregorio_clef_to_char(element->u.misc.clef.clef),
-                                element->u.misc.clef.line,
-                                (!element->previous || element->previous->type
-                                 == GRE_BAR)? '0' : '1',
-                                clef_flat_height(element->u.misc.clef.clef,
-                                        element->u.misc.clef.line,
-                                        element->u.misc.clef.flatted),
-                                gregorio_clef_to_char(
-                                        element->u.misc.clef.secondary_clef),
-                                element->u.misc.clef.secondary_line,
-                                clef_flat_height(
-                                        element->u.misc.clef.secondary_clef,
-                                        element->u.misc.clef.secondary_line,
-                                        element->u.misc.clef.secondary_flatted));
-                    }
-                }
-                break;
-
-            case GRE_CUSTOS:
-                if (first_of_disc != 1) {
-                    signed char next_note_pitch;
-                    gregorio_shape next_note_alteration;
-                    const char *alteration = "";
-                    /* We don't print custos before a bar at the end of a line.
-                     * We also print an unbreakable larger space before the
-                     * custos */
-                    handle_last_of_voice(f, syllable, element, *last_of_voice);
-                    next_note_pitch = gregorio_determine_next_pitch(syllable,
-                            element, NULL, &next_note_alteration);
-                    if (!element->u.misc.pitched.force_pitch) {
-                        alteration = alteration_name(next_note_alteration);
-                    }
-                    fprintf(f, "\\GreCustos{%d}{%s}%s%%\n",
-                            pitch_value(element->u.misc.pitched.pitch), alteration,
-                            next_custos(next_note_pitch, next_note_alteration,
-                            status));
-                    ++note_unit_count;
-                }
-                break;
-
-            case GRE_SUPPRESS_CUSTOS:
-                handle_last_of_voice(f, syllable, element, *last_of_voice);
-                fprintf(f, "\\GreSuppressEolCustos %%\n");
-                status->suppressed_custos = true;
-                break;
-
-            case GRE_BAR:
-                handle_last_of_voice(f, syllable, element, *last_of_voice);
-                write_bar(f, score, syllable, element, first_of_disc);
-                break;
-
-            case GRE_END_OF_LINE:
-                if (!element->next) {
-                    write_anticipated_event(f, euouae_follows,
-                            eol_forces_custos, next_euouae_id);
-                    anticipated_event_written = true;
-                }
-                /* here we suppose we don't have two linebreaks in the same
-                 * syllable */
-                if (element->u.misc.unpitched.info.eol_ragged) {
-                    fprintf(f, "%%\n%%\n\\GreNewParLine %%\n%%\n%%\n");
-                } else {
-                    fprintf(f, "%%\n%%\n\\GreNewLine %%\n%%\n%%\n");
-                }
-                break;
-
-            default:
-                /* here element->type is GRE_ELEMENT */
-                assert(element->type == GRE_ELEMENT);
-                handle_last_of_voice(f, syllable, element, *last_of_voice);
-                note_unit_count += write_element(f, syllable, element, status,
-                        score);
-                write_default_end_of_element(f, element, note_unit_count);
-                break;
-            }
-        }
+        anticipated_event_written = write_elements(f, syllable, 0,
+                *syllable->elements, first_of_disc, status, score,
+                last_of_voice[0], euouae_follows, eol_forces_custos,
+                next_euouae_id);
     }
     if (!anticipated_event_written) {
         write_anticipated_event(f, euouae_follows, eol_forces_custos,
                 next_euouae_id);
     }
+    /* the monophonic scores, the usual case, stop here */
+    if (score->number_of_voices > 1) {
+        write_other_voices(f, syllable, first_of_disc, status, score,
+                last_of_voice);
+    }
     fprintf(f, "}%%\n");
     if (syllable->position == WORD_END
             || syllable->position == WORD_ONE_SYLLABLE || !syllable->text) {
@@ -4389,16 +4545,26 @@ static void write_syllable(FILE *f, gregorio_syllable *syllable,
     finish_syllable(f, syllable);
 }
 
-static char *digest_to_hex(const unsigned char digest[SHA1_DIGEST_SIZE])
+/* SHA-1 digests are written as bare hexadecimal for compatibility; other
+ * digests get a prefix so that the Lua code can tell which one it got */
+static char *digest_to_hex(const gregorio_score *const score)
 {
     static const char *const hex = "0123456789abcdef";
-    static char result[41];
+    static const char *const xxh3_prefix = "xxh3-";
+    static char result[2 * SHA1_DIGEST_SIZE + 6];
 
+    const unsigned char *const digest = score->digest;
     char *p = result;
     unsigned char byte;
+    int size = SHA1_DIGEST_SIZE;
 
     int i;
-    for (i = 0; i < SHA1_DIGEST_SIZE; ++i) {
+    if (score->digest_algorithm == DIGEST_XXH3) {
+        strcpy(p, xxh3_prefix);
+        p += strlen(xxh3_prefix);
+        size = XXH3_128_DIGEST_SIZE;
+    }
+    for (i = 0; i < size; ++i) {
         byte = digest[i];
 
         *(p++) = hex[(byte >> 4) & 0x0FU];
@@ -4410,19 +4576,14 @@ static char *digest_to_hex(const unsigned char digest[SHA1_DIGEST_SIZE])
     return result;
 }
 
-static void initialize_score(gregoriotex_status *const status,
-        gregorio_score *score, const bool point_and_click,
-        const gregorio_element **const last_of_voice)
+/* computes the positioning of the syllables from first to the syllable
+ * before end, which is NULL for the end of the score */
+static void compute_positioning(gregorio_score *const score,
+        gregorio_syllable *const first, const gregorio_syllable *const end)
 {
     gregorio_syllable *syllable;
 
-    status->bottom_line = false;
-    status->top_height = status->bottom_height = UNDETERMINED_HEIGHT;
-    status->abovelinestext = status->translation = false;
-    status->suppressed_custos = false;
-
-    /* first pass to compute positioning */
-    for (syllable = score->first_syllable; syllable;
+    for (syllable = first; syllable != end;
             syllable = syllable->next_syllable) {
         int voice;
 
@@ -4431,7 +4592,19 @@ static void initialize_score(gregoriotex_status *const status,
         }
     }
 
-    gregoriotex_compute_cross_syllable_positioning(score);
+    gregoriotex_compute_cross_syllable_positioning(score, first, end);
+}
+
+static void initialize_status(gregoriotex_status *const status,
+        gregorio_score *score, const bool point_and_click,
+        const gregorio_element **const last_of_voice)
+{
+    gregorio_syllable *syllable;
+
+    status->bottom_line = false;
+    status->top_height = status->bottom_height = UNDETERMINED_HEIGHT;
+    status->abovelinestext = status->translation = false;
+    status->suppressed_custos = false;
 
     for (syllable = score->first_syllable; syllable;
             syllable = syllable->next_syllable) {
@@ -4491,6 +4664,25 @@ static void initialize_score(gregoriotex_status *const status,
     fixup_height_extrema(&(status->top_height), &(status->bottom_height));
 
     status->point_and_click = point_and_click;
+    status->other_voices = NULL;
+}
+
+/* gives each voice after the first one a status of its own, starting as that
+ * of the first one; free status->other_voices afterwards */
+static void initialize_other_voices(gregoriotex_status *const status,
+        const gregorio_score *const score)
+{
+    int voice;
+
+    if (score->number_of_voices > 1) {
+        gregoriotex_status *const other_voices = (gregoriotex_status *)
+                gregorio_malloc((score->number_of_voices - 1)
+                        * sizeof(gregoriotex_status));
+        for (voice = 1; voice < score->number_of_voices; ++voice) {
+            other_voices[voice - 1] = *status;
+        }
+        status->other_voices = other_voices;
+    }
 }
 
 static void write_header(FILE *const f, const char *const name,
@@ -4622,7 +4814,7 @@ static int clef_size(const gregorio_clef_info *const clef)
     return size;
 }
 
-static void write_largest_clef(FILE *const f, gregorio_score *const score)
+static gregorio_clef_info largest_clef(const gregorio_score *const score)
 {
     const gregorio_syllable *syllable;
     const gregorio_element *element;
@@ -4650,6 +4842,34 @@ static void write_largest_clef(FILE *const f, gregorio_score *const score)
         }
     }
 
+    return clef;
+}
+
+/**
+ * Writes the initial clefs of the voices after the first one (whose initial
+ * clef is set by \GreSetInitialClef), numbering the voices from 1.
+ */
+static void gregoriotex_write_voice_info(FILE *f, gregorio_voice_info *voice_info)
+{
+    int voice = 1;
+
+    gregorio_assert(f && voice_info, gregoriotex_write_voice_info,
+            "file or voice_info passed as NULL", return);
+    while ((voice_info = voice_info->next_voice_info)) {
+        const gregorio_clef_info *const clef = &voice_info->initial_clef;
+        fprintf(f, "\\GreVoiceInitialClef{%d}{%c}{%d}{%d}{%c}{%d}{%d}%%\n",
+                ++voice, gregorio_clef_to_char(clef->clef), clef->line,
+                clef_flat_height(clef->clef, clef->line, clef->flatted),
+                gregorio_clef_to_char(clef->secondary_clef),
+                clef->secondary_line, clef_flat_height(clef->secondary_clef,
+                        clef->secondary_line, clef->secondary_flatted));
+    }
+}
+
+static void write_largest_clef(FILE *const f, gregorio_score *const score)
+{
+    const gregorio_clef_info clef = largest_clef(score);
+
     fprintf(f, "\\GreSetLargestClef{%c}{%d}{%d}{%c}{%d}{%d}%%\n",
             gregorio_clef_to_char(clef.clef), clef.line,
             clef_flat_height(clef.clef, clef.line, clef.flatted),
@@ -4668,13 +4888,15 @@ void gregoriotex_write_score(FILE *const f, gregorio_score *const score,
     const gregorio_element *last_of_voice[MAX_NUMBER_OF_VOICES];
 
     memset(last_of_voice, 0, sizeof last_of_voice);
-    initialize_score(&status, score, point_and_click_filename != NULL,
+    gregorio_stats_start(STATS_POSITIONING);
+    compute_positioning(score, score->first_syllable, NULL);
+    initialize_status(&status, score, point_and_click_filename != NULL,
             last_of_voice);
+    gregorio_stats_stop(STATS_POSITIONING);
 
     gregorio_assert(f, gregoriotex_write_score, "call with NULL file", return);
 
-    gregorio_assert_only(score->number_of_voices == 1, gregoriotex_write_score,
-            "gregoriotex only works in monophony (for the moment)");
+    initialize_other_voices(&status, score);
 
     fprintf(f, "%% File generated by gregorio %s\n", GREGORIO_VERSION);
     fprintf(f, "\\GregorioTeXAPIVersion{%s}%%\n", VERSION);
@@ -4701,7 +4923,7 @@ void gregoriotex_write_score(FILE *const f, gregorio_score *const score,
     }
     fprintf(f, "\\GreBeginScore{%s}{%d}{%d}{%d}{%d}{%s}{%u}"
             "{\\GreInitialClefPosition{%d}{%d}}%%\n",
-            digest_to_hex(score->digest), status.top_height,
+            digest_to_hex(score), status.top_height,
             status.bottom_height, bool_to_int(status.translation),
             bool_to_int(status.abovelinestext),
             point_and_click_filename? point_and_click_filename : "",
@@ -4766,4 +4988,129 @@ void gregoriotex_write_score(FILE *const f, gregorio_score *const score,
         current_syllable = current_syllable->next_syllable;
     }
     fprintf(f, "\\GreEndScore %%\n\\endinput %%\n");
+    free(status.other_voices);
+    free_nabc_tex();
+}
+
+static bool same_clef(const gregorio_clef_info *const a,
+        const gregorio_clef_info *const b)
+{
+    return a->clef == b->clef && a->line == b->line && a->flatted == b->flatted
+        && a->secondary_clef == b->secondary_clef
+        && a->secondary_line == b->secondary_line
+        && a->secondary_flatted == b->secondary_flatted;
+}
+
+/* whether an end of line custos must be reset in a voice before the
+ * syllable */
+static bool is_custos_suppressed_before(const gregorio_syllable *syllable,
+        const int voice)
+{
+    for (syllable = syllable->previous_syllable; syllable;
+            syllable = syllable->previous_syllable) {
+        const gregorio_element *element, *last = NULL;
+        const gregorio_glyph *glyph;
+        if (!syllable->elements) {
+            continue;
+        }
+        for (element = syllable->elements[voice]; element;
+                element = element->next) {
+            last = element;
+        }
+        /* the last element setting or resetting it wins */
+        for (element = last; element; element = element->previous) {
+            switch (element->type) {
+            case GRE_SUPPRESS_CUSTOS:
+                return true;
+            case GRE_CUSTOS:
+                return false;
+            case GRE_CLEF:
+                if (is_before_linebreak(syllable, element)) {
+                    return false;
+                }
+                break;
+            case GRE_ELEMENT:
+                /* a glyph writes the next custos, which resets it */
+                for (glyph = element->u.first_glyph; glyph;
+                        glyph = glyph->next) {
+                    if (glyph->type == GRE_GLYPH) {
+                        return false;
+                    }
+                }
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+/*
+ * Writes the syllables from first to last of a score already written, for an
+ * editor which has changed them and replaces their part of the output.  The
+ * output of a syllable starts on a line starting with \GreSyllable (or one of
+ * its variants) or \GreBarSyllable.  Returns false and writes nothing if the
+ * whole score must be written again, that is if first is the first syllable
+ * of the score or if the opening of the score, which the caller keeps in
+ * *opening (zeroed before the first call), changed.
+ */
+bool gregoriotex_write_syllables(FILE *const f, gregorio_score *const score,
+        gregorio_syllable *const first, const gregorio_syllable *const last,
+        const bool point_and_click, gregoriotex_opening *const opening)
+{
+    gregorio_syllable *syllable;
+    gregoriotex_status status;
+    const gregorio_element *last_of_voice[MAX_NUMBER_OF_VOICES];
+    gregoriotex_opening new_opening;
+    int voice;
+
+    gregorio_assert(f, gregoriotex_write_syllables, "call with NULL file",
+            return false);
+
+    memset(last_of_voice, 0, sizeof last_of_voice);
+    gregorio_stats_start(STATS_POSITIONING);
+    if (first) {
+        compute_positioning(score, first, last->next_syllable);
+    }
+    initialize_status(&status, score, point_and_click, last_of_voice);
+    gregorio_stats_stop(STATS_POSITIONING);
+
+    memset(&new_opening, 0, sizeof new_opening);
+    new_opening.largest_clef = largest_clef(score);
+    new_opening.top_height = status.top_height;
+    new_opening.bottom_height = status.bottom_height;
+    new_opening.translation = status.translation;
+    new_opening.abovelinestext = status.abovelinestext;
+    if (!same_clef(&new_opening.largest_clef, &opening->largest_clef)
+            || new_opening.top_height != opening->top_height
+            || new_opening.bottom_height != opening->bottom_height
+            || new_opening.translation != opening->translation
+            || new_opening.abovelinestext != opening->abovelinestext) {
+        *opening = new_opening;
+        return false;
+    }
+    if (!first) {
+        return true;
+    }
+    if (first == score->first_syllable) {
+        return false;
+    }
+
+    status.suppressed_custos = is_custos_suppressed_before(first, 0);
+    initialize_other_voices(&status, score);
+    for (voice = 1; voice < score->number_of_voices; ++voice) {
+        status.other_voices[voice - 1].suppressed_custos =
+                is_custos_suppressed_before(first, voice);
+    }
+    for (syllable = first; syllable; syllable = syllable->next_syllable) {
+        write_syllable(f, syllable, 0, &status, score, last_of_voice,
+                write_syllable_text);
+        if (syllable == last) {
+            break;
+        }
+    }
+    free(status.other_voices);
+    free_nabc_tex();
+    return true;
 }
@@ -25,7 +25,10 @@
 
 #include "bool.h"
 
-#define OFFSET_CASE(name) static const char *const name = #name
+/* the note offset cases, written as \GreOCase<name> */
+#define OFFSET_CASE(name, v, h) static const char *const name = #name;
+#include "gregoriotex-offset-cases.def"
+#undef OFFSET_CASE
 
 /*
  * Here are the different types, they must be the same as in squarize.py 
@@ -165,9 +168,12 @@ bool gtex_is_h_episema_above_shown(const gregorio_note *const note);
 bool gtex_is_h_episema_below_shown(const gregorio_note *const note);
 const char *gregoriotex_determine_glyph_name(const gregorio_glyph *const glyph,
         gtex_alignment *const  type, gtex_type *const gtype);
+const char *gregoriotex_fused_glyph_name(const gregorio_glyph *glyph,
+        gtex_alignment *type, gtex_type *gtype);
 void gregoriotex_compute_positioning(const gregorio_element *element,
         const gregorio_score *score);
 void gregoriotex_compute_cross_syllable_positioning(
-        const gregorio_score *score);
+        const gregorio_score *score, gregorio_syllable *first,
+        const gregorio_syllable *end);
 
 #endif
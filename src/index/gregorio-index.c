@@ -0,0 +1,2151 @@
+/*
+ * Gregorio is a program that translates gabc files to GregorioTeX
+ * This program indexes a corpus of gabc files and searches the index.
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * Gregorio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Gregorio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gregorio.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * gregorio-index builds an inverted index of the gabc files under some
+ * directories and answers queries from it.  The terms of the index are
+ *
+ * - "w:" and a word of the lyrics, in lowercase and without its accents
+ *   (so that "Allelúja" is "w:alleluja"),
+ * - "t:" and the type of a glyph as gregorio names it, in lowercase and
+ *   without its "G_" (e.g. "t:torculus_resupinus"),
+ * - "g:" and the name of the glyph in the GregorioTeX fonts, as
+ *   gregoriotex_determine_glyph_name gives it (e.g. "g:PesTwo"), for the
+ *   glyphs of more than one note,
+ * - "i:" and the intervals, in steps, between 3 or 5 successive notes (e.g.
+ *   "i:+2+1" for d-f-g), with the clef changes applied, so that the intervals
+ *   are those which are sung.  A melody goes on across syllables and bars.
+ *
+ * A posting gives the file, word, syllable and note (each numbered from 0 in
+ * its file) where a term occurs, and the line of its syllable; the word of a
+ * syllable without text is the last word.  For a glyph or a melody, the note is
+ * its first one, and for a melody, the gabc letter of that note, as written in
+ * its clef, is kept in the high byte of the line.  A query finds the files,
+ * words or syllables where all of its terms occur.  A melody longer than those
+ * indexed is found by chaining the melodies of 4 intervals it is made of, and
+ * one of 3 intervals by chaining two of 2.
+ *
+ * The index file starts with the magic "GIDX", the version of the format (16
+ * bits) and the number of sections (16 bits), followed by the offset and the
+ * count (32 bits each) of every section, like a gbin file.  The strings
+ * section holds the NUL-terminated paths and terms; the files section, the
+ * path and the XXH3 digest of each file, sorted by path; the terms section,
+ * the term, first posting and number of postings of each term, sorted by term;
+ * and the postings section, the postings of each term in turn, sorted by file,
+ * word, syllable and note.  All numbers are little-endian and the sections
+ * start on four bytes.  The index is mapped in memory to be queried, so that
+ * a query only reads the pages of the terms it looks for.
+ *
+ * The parser of gregorio is not reentrant, so the files are parsed by several
+ * processes (where fork is available), each one writing the postings it finds
+ * to a temporary file.  A rebuild only parses the files whose digest changed,
+ * and takes the postings of the others from the previous index; a file with
+ * errors is indexed as far as it could be read, and parsed again by the next
+ * build.
+ *
+ * The ngrams command does without the index: its parsing processes write the
+ * pitches of each melody (see melody.h), and the n-grams of their intervals,
+ * or of their contour classes, are counted at once.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#endif
+#include "bool.h"
+#include "struct.h"
+#include "plugins.h"
+#include "messages.h"
+#include "support.h"
+#include "unicode.h"
+#include "xxh3.h"
+#include "melody.h"
+#include "gabc/gabc.h"
+#include "gregoriotex/gregoriotex.h"
+#include "vowel/vowel.h"
+
+#define INDEX_MAGIC "GIDX"
+#define INDEX_VERSION 1
+#define DEFAULT_INDEX "gregorio.gidx"
+
+/* the lengths, in intervals, of the melodies indexed */
+#define SHORT_MELODY 2
+#define LONG_MELODY 4
+
+/* a longer term is cut */
+#define MAX_TERM_LENGTH 255
+
+#define LINE_MASK 0xffffffu
+#define LETTER_SHIFT 24
+#define NO_FILE 0xffffffffu
+
+typedef enum index_section {
+    INDEX_STRINGS = 0,
+    INDEX_FILES,
+    INDEX_TERMS,
+    INDEX_POSTINGS,
+    INDEX_NUMBER_OF_SECTIONS
+} index_section;
+
+#define HEADER_SIZE (8 + 8 * INDEX_NUMBER_OF_SECTIONS)
+#define FILE_RECORD_SIZE (4 + XXH3_128_DIGEST_SIZE)
+#define TERM_RECORD_SIZE 12
+#define POSTING_SIZE 20
+
+static const size_t record_size[INDEX_NUMBER_OF_SECTIONS] = {
+    1, FILE_RECORD_SIZE, TERM_RECORD_SIZE, POSTING_SIZE
+};
+
+typedef struct index_posting {
+    uint32_t file, word, syllable, note;
+    /* the line of the syllable, and the letter of a melody (see above) */
+    uint32_t line;
+} index_posting;
+
+static void put_u16(unsigned char *const p, const unsigned int value)
+{
+    p[0] = (unsigned char) (value & 0xff);
+    p[1] = (unsigned char) ((value >> 8) & 0xff);
+}
+
+static void put_u32(unsigned char *const p, const uint32_t value)
+{
+    p[0] = (unsigned char) (value & 0xff);
+    p[1] = (unsigned char) ((value >> 8) & 0xff);
+    p[2] = (unsigned char) ((value >> 16) & 0xff);
+    p[3] = (unsigned char) ((value >> 24) & 0xff);
+}
+
+static unsigned int get_u16(const unsigned char *const p)
+{
+    return p[0] | ((unsigned int) p[1] << 8);
+}
+
+static uint32_t get_u32(const unsigned char *const p)
+{
+    return p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16)
+            | ((uint32_t) p[3] << 24);
+}
+
+static void put_posting(unsigned char *const p,
+        const index_posting *const posting)
+{
+    put_u32(p, posting->file);
+    put_u32(p + 4, posting->word);
+    put_u32(p + 8, posting->syllable);
+    put_u32(p + 12, posting->note);
+    put_u32(p + 16, posting->line);
+}
+
+static void get_posting(const unsigned char *const p,
+        index_posting *const posting)
+{
+    posting->file = get_u32(p);
+    posting->word = get_u32(p + 4);
+    posting->syllable = get_u32(p + 8);
+    posting->note = get_u32(p + 12);
+    posting->line = get_u32(p + 16);
+}
+
+/*
+ * The index, mapped in memory
+ */
+
+typedef enum index_status {
+    INDEX_OK = 0,
+    INDEX_MISSING,
+    INDEX_OTHER_VERSION,
+    INDEX_INVALID
+} index_status;
+
+typedef struct index_map {
+    unsigned char *data;
+    size_t size;
+    const unsigned char *section[INDEX_NUMBER_OF_SECTIONS];
+    uint32_t count[INDEX_NUMBER_OF_SECTIONS];
+} index_map;
+
+static void index_close(index_map *const map)
+{
+    if (map->data) {
+#ifdef _WIN32
+        free(map->data);
+#else
+        munmap(map->data, map->size);
+#endif
+    }
+    memset(map, 0, sizeof *map);
+}
+
+/* maps the index in memory, with no message */
+static index_status index_open(index_map *const map, const char *const name)
+{
+    int i;
+
+    memset(map, 0, sizeof *map);
+    {
+#ifdef _WIN32
+        FILE *const f = fopen(name, "rb");
+        long size;
+        if (!f) {
+            return errno == ENOENT? INDEX_MISSING : INDEX_INVALID;
+        }
+        if (fseek(f, 0, SEEK_END) || (size = ftell(f)) < HEADER_SIZE
+                || fseek(f, 0, SEEK_SET)) {
+            fclose(f);
+            return INDEX_INVALID;
+        }
+        map->size = (size_t) size;
+        map->data = (unsigned char *) gregorio_malloc(map->size);
+        if (fread(map->data, 1, map->size, f) != map->size) {
+            fclose(f);
+            index_close(map);
+            return INDEX_INVALID;
+        }
+        fclose(f);
+#else
+        struct stat st;
+        void *data;
+        const int fd = open(name, O_RDONLY);
+        if (fd < 0) {
+            return errno == ENOENT? INDEX_MISSING : INDEX_INVALID;
+        }
+        if (fstat(fd, &st) || st.st_size < HEADER_SIZE) {
+            close(fd);
+            return INDEX_INVALID;
+        }
+        data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            return INDEX_INVALID;
+        }
+        map->data = (unsigned char *) data;
+        map->size = (size_t) st.st_size;
+#endif
+    }
+    if (memcmp(map->data, INDEX_MAGIC, 4)) {
+        index_close(map);
+        return INDEX_INVALID;
+    }
+    if (get_u16(map->data + 4) != INDEX_VERSION
+            || get_u16(map->data + 6) != INDEX_NUMBER_OF_SECTIONS) {
+        index_close(map);
+        return INDEX_OTHER_VERSION;
+    }
+    for (i = 0; i < INDEX_NUMBER_OF_SECTIONS; ++i) {
+        const uint32_t offset = get_u32(map->data + 8 + 8 * i);
+        const uint32_t count = get_u32(map->data + 12 + 8 * i);
+        if (offset > map->size
+                || count > (map->size - offset) / record_size[i]) {
+            index_close(map);
+            return INDEX_INVALID;
+        }
+        map->section[i] = map->data + offset;
+        map->count[i] = count;
+    }
+    /* the strings end with a NUL, so that no comparison goes beyond them */
+    if (map->count[INDEX_STRINGS] == 0
+            || map->section[INDEX_STRINGS][map->count[INDEX_STRINGS] - 1]) {
+        index_close(map);
+        return INDEX_INVALID;
+    }
+    return INDEX_OK;
+}
+
+static const char *index_string(const index_map *const map,
+        const uint32_t offset)
+{
+    if (offset >= map->count[INDEX_STRINGS]) {
+        return "";
+    }
+    return (const char *) map->section[INDEX_STRINGS] + offset;
+}
+
+static const char *file_path(const index_map *const map, const uint32_t file)
+{
+    if (file >= map->count[INDEX_FILES]) {
+        return "";
+    }
+    return index_string(map, get_u32(map->section[INDEX_FILES]
+                + (size_t) file * FILE_RECORD_SIZE));
+}
+
+static const unsigned char *file_digest(const index_map *const map,
+        const uint32_t file)
+{
+    return map->section[INDEX_FILES] + (size_t) file * FILE_RECORD_SIZE + 4;
+}
+
+static const char *term_string(const index_map *const map, const uint32_t term)
+{
+    return index_string(map, get_u32(map->section[INDEX_TERMS]
+                + (size_t) term * TERM_RECORD_SIZE));
+}
+
+/* gives the postings of a term, none if they are not in the index */
+static const unsigned char *term_postings(const index_map *const map,
+        const uint32_t term, uint32_t *const count)
+{
+    const unsigned char *const record = map->section[INDEX_TERMS]
+            + (size_t) term * TERM_RECORD_SIZE;
+    const uint32_t first = get_u32(record + 4);
+    *count = get_u32(record + 8);
+    if (first > map->count[INDEX_POSTINGS]
+            || *count > map->count[INDEX_POSTINGS] - first) {
+        *count = 0;
+    }
+    return map->section[INDEX_POSTINGS] + (size_t) first * POSTING_SIZE;
+}
+
+/* finds the range [*first, *end) of the terms which are the given term, or
+ * which start with it if prefix is true */
+static void find_terms(const index_map *const map, const char *const term,
+        const bool prefix, uint32_t *const first, uint32_t *const end)
+{
+    const size_t length = strlen(term);
+    uint32_t low = 0, high = map->count[INDEX_TERMS];
+
+    while (low < high) {
+        const uint32_t middle = low + (high - low) / 2;
+        if (strcmp(term_string(map, middle), term) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    *first = low;
+    if (!prefix) {
+        *end = low < map->count[INDEX_TERMS]
+                && !strcmp(term_string(map, low), term)? low + 1 : low;
+        return;
+    }
+    high = map->count[INDEX_TERMS];
+    while (low < high) {
+        const uint32_t middle = low + (high - low) / 2;
+        if (strncmp(term_string(map, middle), term, length) <= 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    *end = low;
+}
+
+/*
+ * Building
+ */
+
+/* a posting of a term, as the index is built */
+typedef struct index_entry {
+    uint32_t term;
+    index_posting posting;
+} index_entry;
+
+typedef struct index_builder {
+    /* the terms, NUL-terminated, and where each one starts */
+    char *text;
+    size_t text_length, text_capacity;
+    uint32_t *terms;
+    size_t term_count, term_capacity;
+    /* an open-addressing hash table of the terms, of their indexes plus one */
+    uint32_t *slots;
+    size_t slot_count;
+    index_entry *entries;
+    size_t entry_count, entry_capacity;
+} index_builder;
+
+typedef struct index_file {
+    char *path;
+    unsigned char digest[XXH3_128_DIGEST_SIZE];
+    long size;
+    /* the same file, unchanged, in the previous index, or NO_FILE */
+    uint32_t previous;
+} index_file;
+
+static uint32_t hash_term(const char *const term, const size_t length)
+{
+    uint32_t hash = 2166136261u;
+    size_t i;
+    for (i = 0; i < length; ++i) {
+        hash = (hash ^ (unsigned char) term[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void rehash(index_builder *const builder)
+{
+    size_t i;
+
+    free(builder->slots);
+    builder->slot_count = builder->slot_count? builder->slot_count * 2 : 4096;
+    builder->slots = (uint32_t *) gregorio_calloc(builder->slot_count,
+            sizeof(uint32_t));
+    for (i = 0; i < builder->term_count; ++i) {
+        const char *const term = builder->text + builder->terms[i];
+        size_t slot = hash_term(term, strlen(term))
+                & (builder->slot_count - 1);
+        while (builder->slots[slot]) {
+            slot = (slot + 1) & (builder->slot_count - 1);
+        }
+        builder->slots[slot] = (uint32_t) i + 1;
+    }
+}
+
+static uint32_t intern(index_builder *const builder, const char *const term,
+        const size_t length)
+{
+    size_t slot;
+
+    if (2 * (builder->term_count + 1) > builder->slot_count) {
+        rehash(builder);
+    }
+    slot = hash_term(term, length) & (builder->slot_count - 1);
+    while (builder->slots[slot]) {
+        const uint32_t id = builder->slots[slot] - 1;
+        const char *const other = builder->text + builder->terms[id];
+        if (!strncmp(other, term, length) && !other[length]) {
+            return id;
+        }
+        slot = (slot + 1) & (builder->slot_count - 1);
+    }
+    while (builder->text_length + length + 1 > builder->text_capacity) {
+        builder->text = gregorio_grow_buffer(builder->text,
+                &builder->text_capacity, char);
+    }
+    if (builder->term_count == builder->term_capacity) {
+        builder->terms = gregorio_grow_buffer(builder->terms,
+                &builder->term_capacity, uint32_t);
+    }
+    builder->terms[builder->term_count] = (uint32_t) builder->text_length;
+    memcpy(builder->text + builder->text_length, term, length);
+    builder->text_length += length;
+    builder->text[builder->text_length++] = '\0';
+    builder->slots[slot] = (uint32_t) ++builder->term_count;
+    return (uint32_t) builder->term_count - 1;
+}
+
+static void add_entry(index_builder *const builder, const uint32_t term,
+        const index_posting *const posting)
+{
+    if (builder->entry_count == builder->entry_capacity) {
+        builder->entries = gregorio_grow_buffer(builder->entries,
+                &builder->entry_capacity, index_entry);
+    }
+    builder->entries[builder->entry_count].term = term;
+    builder->entries[builder->entry_count].posting = *posting;
+    ++builder->entry_count;
+}
+
+/* writes a posting of a term to the temporary file of a parsing process */
+static void write_entry(FILE *const out, const char *const term,
+        size_t length, const index_posting *const posting)
+{
+    unsigned char record[POSTING_SIZE + 1];
+
+    if (length > MAX_TERM_LENGTH) {
+        length = MAX_TERM_LENGTH;
+    }
+    put_posting(record, posting);
+    record[POSTING_SIZE] = (unsigned char) length;
+    fwrite(record, 1, sizeof record, out);
+    fwrite(term, 1, length, out);
+}
+
+/* reads back the postings a parsing process wrote; an empty term marks a file
+ * with errors, whose digest is cleared so that the next build parses it again
+ */
+static bool read_entries(index_builder *const builder, FILE *const in,
+        index_file *const files)
+{
+    unsigned char record[POSTING_SIZE + 1];
+    char term[MAX_TERM_LENGTH];
+    index_posting posting;
+
+    if (fflush(in) || fseek(in, 0, SEEK_SET)) {
+        return false;
+    }
+    while (fread(record, 1, sizeof record, in) == sizeof record) {
+        if (fread(term, 1, record[POSTING_SIZE], in) != record[POSTING_SIZE]) {
+            return false;
+        }
+        get_posting(record, &posting);
+        if (!record[POSTING_SIZE]) {
+            memset(files[posting.file].digest, 0, XXH3_128_DIGEST_SIZE);
+            continue;
+        }
+        add_entry(builder, intern(builder, term, record[POSTING_SIZE]),
+                &posting);
+    }
+    return !ferror(in);
+}
+
+/*
+ * The terms of a score
+ */
+
+/* the letters of the lyrics, from U+00C0 to U+00FF, without their accents,
+ * and with "*" for what is not a letter */
+static const char latin1_letters[] =
+        "aaaaaaaceeeeiiiidnooooo*ouuuuyts"
+        "aaaaaaaceeeeiiiidnooooo*ouuuuyty";
+
+/* adds a character of the lyrics to a word, in lowercase and without its
+ * accent; what is neither a letter nor a digit is left out */
+static void append_folded(char *const word, size_t *const length,
+        const grewchar c)
+{
+    const char *fold = NULL;
+    char letter[2];
+    unsigned char utf8[4];
+    size_t size = 0, i;
+
+    letter[1] = '\0';
+    if (c < 0x80) {
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) {
+            letter[0] = (char) c;
+            fold = letter;
+        } else if (c >= 'A' && c <= 'Z') {
+            letter[0] = (char) (c - 'A' + 'a');
+            fold = letter;
+        } else {
+            return;
+        }
+    } else if (c == 0xc6 || c == 0xe6 || c == 0x1fc || c == 0x1fd) {
+        fold = "ae";
+    } else if (c == 0x152 || c == 0x153) {
+        fold = "oe";
+    } else if (c == 0xdf) {
+        fold = "ss";
+    } else if (c >= 0xc0 && c <= 0xff) {
+        letter[0] = latin1_letters[c - 0xc0];
+        if (letter[0] == '*') {
+            return;
+        }
+        fold = letter;
+    } else if ((c >= 0x300 && c <= 0x36f) || (c >= 0x2000 && c <= 0x206f)
+            || c < 0xc0) {
+        /* combining accents, punctuation and the rest of Latin-1 */
+        return;
+    }
+    if (fold) {
+        size = strlen(fold);
+        if (*length + size <= MAX_TERM_LENGTH) {
+            memcpy(word + *length, fold, size);
+            *length += size;
+        }
+        return;
+    }
+    /* any other letter is kept as it is */
+    if (c < 0x800) {
+        utf8[0] = (unsigned char) (0xc0 | (c >> 6));
+        size = 1;
+    } else if (c < 0x10000) {
+        utf8[0] = (unsigned char) (0xe0 | (c >> 12));
+        utf8[1] = (unsigned char) (0x80 | ((c >> 6) & 0x3f));
+        size = 2;
+    } else {
+        utf8[0] = (unsigned char) (0xf0 | (c >> 18));
+        utf8[1] = (unsigned char) (0x80 | ((c >> 12) & 0x3f));
+        utf8[2] = (unsigned char) (0x80 | ((c >> 6) & 0x3f));
+        size = 3;
+    }
+    utf8[size++] = (unsigned char) (0x80 | (c & 0x3f));
+    if (*length + size <= MAX_TERM_LENGTH) {
+        for (i = 0; i < size; ++i) {
+            word[(*length)++] = (char) utf8[i];
+        }
+    }
+}
+
+/* adds the letters of the text of a syllable to a word, leaving out what
+ * GregorioTeX does not print as text */
+static void append_text(char *const word, size_t *const length,
+        const gregorio_character *character)
+{
+    int hidden = 0;
+
+    for (; character; character = character->next_character) {
+        if (!character->is_character) {
+            switch (character->cos.s.style) {
+            case ST_VERBATIM:
+            case ST_SPECIAL_CHAR:
+            case ST_PROTRUSION_FACTOR:
+                hidden += character->cos.s.type == ST_T_BEGIN? 1 : -1;
+                break;
+            default:
+                break;
+            }
+        } else if (hidden <= 0) {
+            append_folded(word, length, character->cos.character);
+        }
+    }
+}
+
+/* writes the postings of the melodies of a score, given the posting of each
+ * of its syllables */
+static void write_melodies(FILE *const out, const gregorio_melody *const melody,
+        const index_posting *const syllables)
+{
+    static const size_t lengths[] = { SHORT_MELODY, LONG_MELODY };
+    char term[3 + 4 * LONG_MELODY + 1];
+    signed char *const intervals = (signed char *) gregorio_malloc(
+            melody->count + 1);
+    size_t start, i, j;
+
+    gregorio_melody_intervals(melody->pitches, melody->count, intervals,
+            NULL);
+    for (start = 0; start < melody->count; ++start) {
+        const signed char pitch = melody->notes[start]->u.note.pitch;
+        index_posting posting = syllables[melody->syllables[start]];
+        posting.note = (uint32_t) start;
+        posting.line |= (uint32_t) (pitch - LOWEST_PITCH + 'a'
+                + (pitch >= LOWEST_PITCH + 14)) << LETTER_SHIFT;
+        for (i = 0; i < sizeof lengths / sizeof *lengths; ++i) {
+            size_t length = 2;
+            if (start + lengths[i] >= melody->count) {
+                continue;
+            }
+            memcpy(term, "i:", 2);
+            for (j = 0; j < lengths[i]; ++j) {
+                gregorio_snprintf(term + length, sizeof term - length, "%+d",
+                        intervals[start + j]);
+                length += strlen(term + length);
+            }
+            write_entry(out, term, length, &posting);
+        }
+    }
+    free(intervals);
+}
+
+/* writes the postings of the glyph types and names of a syllable */
+static void write_glyph(FILE *const out, const gregorio_glyph *const glyph,
+        const index_posting *const posting)
+{
+    char term[MAX_TERM_LENGTH + 1];
+    const char *name = gregorio_glyph_type_to_string(
+            glyph->u.notes.glyph_type);
+    gtex_alignment alignment;
+    gtex_type type;
+    size_t length;
+
+    if (!strncmp(name, "G_", 2)) {
+        name += 2;
+    }
+    memcpy(term, "t:", 2);
+    for (length = 2; *name && length < MAX_TERM_LENGTH; ++name) {
+        term[length++] = (*name >= 'A' && *name <= 'Z')?
+                (char) (*name - 'A' + 'a') : *name;
+    }
+    write_entry(out, term, length, posting);
+
+    name = gregoriotex_determine_glyph_name(glyph, &alignment, &type);
+    if (name && *name) {
+        gregorio_snprintf(term, sizeof term, "g:%s", name);
+        write_entry(out, term, strlen(term), posting);
+    }
+}
+
+static void write_word(FILE *const out, char *const word, const size_t length,
+        const index_posting *const posting)
+{
+    /* a word of punctuation only is not one */
+    if (length > 2) {
+        write_entry(out, word, length, posting);
+    }
+}
+
+/* writes the postings of a score to the temporary file of a parsing process,
+ * or, without a score, marks the file as having errors */
+static void write_score(FILE *const out, gregorio_score *const score,
+        const uint32_t file)
+{
+    char word[MAX_TERM_LENGTH + 1];
+    size_t word_length = 0, capacity = 256;
+    index_posting posting, word_posting;
+    index_posting *syllables = gregorio_grow_buffer(NULL, &capacity,
+            index_posting);
+    gregorio_syllable *syllable;
+    gregorio_melody melody;
+    uint32_t words = 0;
+
+    memset(&posting, 0, sizeof posting);
+    memset(&word_posting, 0, sizeof word_posting);
+    posting.file = file;
+    if (!score) {
+        write_entry(out, "", 0, &posting);
+        free(syllables);
+        return;
+    }
+    memcpy(word, "w:", 2);
+    for (syllable = score->first_syllable; syllable;
+            syllable = syllable->next_syllable, ++posting.syllable) {
+        gregorio_element *element;
+        posting.line = syllable->src_line & LINE_MASK;
+        if (syllable->text && (syllable->position == WORD_BEGINNING
+                    || syllable->position == WORD_ONE_SYLLABLE)) {
+            if (word_length) {
+                write_word(out, word, word_length, &word_posting);
+            }
+            posting.word = words++;
+            word_posting = posting;
+            word_length = 2;
+        }
+        if (word_length) {
+            append_text(word, &word_length, syllable->text);
+        }
+        if (word_length && syllable->text && (syllable->position == WORD_END
+                    || syllable->position == WORD_ONE_SYLLABLE)) {
+            write_word(out, word, word_length, &word_posting);
+            word_length = 0;
+        }
+
+        /* the glyph names depend on the fusions the positioning determines */
+        gregoriotex_compute_positioning(syllable->elements[0], score);
+        for (element = syllable->elements[0]; element;
+                element = element->next) {
+            gregorio_glyph *glyph;
+            if (element->type != GRE_ELEMENT) {
+                continue;
+            }
+            for (glyph = element->u.first_glyph; glyph; glyph = glyph->next) {
+                gregorio_note *note;
+                if (glyph->type != GRE_GLYPH) {
+                    continue;
+                }
+                write_glyph(out, glyph, &posting);
+                for (note = glyph->u.notes.first_note; note;
+                        note = note->next) {
+                    if (note->type == GRE_NOTE) {
+                        ++posting.note;
+                    }
+                }
+            }
+        }
+        if (posting.syllable == capacity) {
+            syllables = gregorio_grow_buffer(syllables, &capacity,
+                    index_posting);
+        }
+        syllables[posting.syllable] = posting;
+    }
+    if (word_length) {
+        write_word(out, word, word_length, &word_posting);
+    }
+
+    gregorio_melody_init(&melody);
+    gregorio_melody_fill(&melody, score, 0);
+    write_melodies(out, &melody, syllables);
+    gregorio_melody_free(&melody);
+    free(syllables);
+}
+
+/* the file being parsed, for the messages */
+static const char *parsed_file_name = NULL;
+
+static void print_message(void *const data, const gregorio_verbosity verbosity,
+        const char *const message)
+{
+    (void) data;
+    fprintf(stderr, "%s: %s %s\n", parsed_file_name,
+            verbosity >= VERBOSITY_ERROR? "error:" : "warning:", message);
+}
+
+static void free_lexers(void)
+{
+    gregorio_vowel_tables_free();
+    gabc_score_determination_lex_destroy();
+    gabc_notes_determination_lex_destroy();
+    gregorio_vowel_rulefile_lex_destroy();
+}
+
+/* what a parsing process writes of a score to its temporary file; it is
+ * called again without the score if the file has errors */
+typedef void (*score_writer)(FILE *out, gregorio_score *score, uint32_t file);
+
+/* parses a file and writes what writer takes of it to out; returns false if
+ * the file has errors, though what could be read of it is written */
+static bool parse_file(FILE *const out, const index_file *const file,
+        const uint32_t number, const score_writer writer)
+{
+    gregorio_score *score;
+    bool ok;
+    FILE *const f = fopen(file->path, "r");
+
+    if (!f) {
+        fprintf(stderr, "error: can't open file %s for reading\n", file->path);
+        return false;
+    }
+    parsed_file_name = file->path;
+    gregorio_reset_return_value();
+    score = gabc_read_score(f, false, DIGEST_XXH3);
+    fclose(f);
+    if (score) {
+        writer(out, score, number);
+        gregorio_free_score(score);
+    }
+    ok = score && !gregorio_get_return_value();
+    if (!ok) {
+        writer(out, NULL, number);
+    }
+    /* the next file is read as if alone */
+    free_lexers();
+    gregorio_struct_reset();
+    return ok;
+}
+
+/* parses the files of order, those of number worker modulo workers, returning
+ * false if one of them has errors */
+static bool parse_files(FILE *const out, const index_file *const files,
+        const uint32_t *const order, const size_t count, const int worker,
+        const int workers, const score_writer writer)
+{
+    bool ok = true;
+    size_t i;
+
+    for (i = (size_t) worker; i < count; i += workers) {
+        if (!parse_file(out, files + order[i], order[i], writer)) {
+            ok = false;
+        }
+    }
+    return fflush(out) == 0 && ok;
+}
+
+#ifndef _WIN32
+/* the exit status of a parsing process which parsed all its files, some of
+ * them with errors; any other failure may have left its temporary file cut */
+#define PARSED_WITH_ERRORS 2
+
+/* replaces what a parsing process which failed wrote with the mark of a file
+ * with errors for each of its files, so that none of them passes for
+ * indexed */
+static bool fail_files(FILE *const out, const index_file *const files,
+        const uint32_t *const order, const size_t count, const int worker,
+        const int workers, const score_writer writer)
+{
+    size_t i;
+
+    if (fflush(out) || ftruncate(fileno(out), 0)
+            || fseek(out, 0, SEEK_SET)) {
+        return false;
+    }
+    for (i = (size_t) worker; i < count; i += workers) {
+        fprintf(stderr, "%s: error: not indexed, as the process parsing it "
+                "failed\n", files[order[i]].path);
+        writer(out, NULL, order[i]);
+    }
+    return fflush(out) == 0;
+}
+#endif
+
+/* the files to parse, larger first */
+static const index_file *sorted_files = NULL;
+
+static int compare_sizes(const void *const a, const void *const b)
+{
+    const long size_a = sorted_files[*(const uint32_t *) a].size;
+    const long size_b = sorted_files[*(const uint32_t *) b].size;
+    if (size_a != size_b) {
+        return size_a > size_b? -1 : 1;
+    }
+    return *(const uint32_t *) a < *(const uint32_t *) b? -1 : 1;
+}
+
+/* parses the files of order, larger first, with several processes where it
+ * can; each one writes with writer to its own temporary file, and the files
+ * are returned in *temp and their number in *workers */
+static bool parse_in_parallel(const index_file *const files,
+        uint32_t *const order, const size_t count, const score_writer writer,
+        FILE ***const temp, int *const workers)
+{
+    bool ok = true;
+    int worker;
+
+    sorted_files = files;
+    qsort(order, count, sizeof *order, compare_sizes);
+    if ((size_t) *workers > count) {
+        *workers = count? (int) count : 1;
+    }
+#ifdef _WIN32
+    *workers = 1;
+#endif
+    *temp = (FILE **) gregorio_calloc(*workers, sizeof(FILE *));
+    for (worker = 0; worker < *workers; ++worker) {
+        if (!((*temp)[worker] = tmpfile())) {
+            fprintf(stderr, "error: can't create a temporary file\n");
+            ok = false;
+            *workers = worker;
+        }
+    }
+
+    /* with a handler, a fatal error only fails its file */
+    gregorio_set_message_handler(print_message, NULL);
+    if (*workers == 1) {
+        ok = parse_files((*temp)[0], files, order, count, 0, 1, writer) && ok;
+    }
+#ifndef _WIN32
+    else if (*workers > 1) {
+        pid_t *const pids = (pid_t *) gregorio_calloc(*workers,
+                sizeof(pid_t));
+        fflush(stdout);
+        fflush(stderr);
+        for (worker = 0; worker < *workers; ++worker) {
+            pids[worker] = fork();
+            if (pids[worker] == 0) {
+                _exit(parse_files((*temp)[worker], files, order, count,
+                            worker, *workers, writer)? 0 : PARSED_WITH_ERRORS);
+            }
+            if (pids[worker] < 0) {
+                /* this process parses what the missing one would have */
+                ok = parse_files((*temp)[worker], files, order, count, worker,
+                        *workers, writer) && ok;
+            }
+        }
+        for (worker = 0; worker < *workers; ++worker) {
+            int status;
+            if (pids[worker] <= 0) {
+                continue;
+            }
+            if (waitpid(pids[worker], &status, 0) < 0 || !WIFEXITED(status)
+                    || (WEXITSTATUS(status)
+                        && WEXITSTATUS(status) != PARSED_WITH_ERRORS)) {
+                if (!fail_files((*temp)[worker], files, order, count, worker,
+                            *workers, writer)) {
+                    fprintf(stderr, "error: can't write a temporary file\n");
+                }
+                ok = false;
+            } else if (WEXITSTATUS(status)) {
+                ok = false;
+            }
+        }
+        free(pids);
+    }
+#endif
+    gregorio_set_message_handler(NULL, NULL);
+    return ok;
+}
+
+/* parses the files which changed */
+static bool parse_changed_files(index_builder *const builder,
+        index_file *const files, const size_t count, int workers)
+{
+    uint32_t *const order = (uint32_t *) gregorio_malloc(
+            (count + 1) * sizeof(uint32_t));
+    size_t changed = 0, i;
+    FILE **temp;
+    bool ok;
+    int worker;
+
+    for (i = 0; i < count; ++i) {
+        if (files[i].previous == NO_FILE) {
+            order[changed++] = (uint32_t) i;
+        }
+    }
+    ok = parse_in_parallel(files, order, changed, write_score, &temp,
+            &workers);
+    for (worker = 0; worker < workers; ++worker) {
+        if (!read_entries(builder, temp[worker], files)) {
+            fprintf(stderr, "error: can't read a temporary file\n");
+            ok = false;
+        }
+    }
+    for (worker = 0; worker < workers; ++worker) {
+        fclose(temp[worker]);
+    }
+    free(temp);
+    free(order);
+    return ok;
+}
+
+/* adds the postings of the unchanged files from the previous index */
+static void add_previous_entries(index_builder *const builder,
+        const index_map *const previous, const index_file *const files,
+        const size_t count)
+{
+    uint32_t *const number = (uint32_t *) gregorio_malloc(
+            ((size_t) previous->count[INDEX_FILES] + 1) * sizeof(uint32_t));
+    uint32_t term, i;
+    size_t file;
+
+    for (i = 0; i < previous->count[INDEX_FILES]; ++i) {
+        number[i] = NO_FILE;
+    }
+    for (file = 0; file < count; ++file) {
+        if (files[file].previous != NO_FILE) {
+            number[files[file].previous] = (uint32_t) file;
+        }
+    }
+    for (term = 0; term < previous->count[INDEX_TERMS]; ++term) {
+        const char *const string = term_string(previous, term);
+        uint32_t postings;
+        const unsigned char *p = term_postings(previous, term, &postings);
+        uint32_t id = NO_FILE;
+        for (i = 0; i < postings; ++i, p += POSTING_SIZE) {
+            index_posting posting;
+            get_posting(p, &posting);
+            if (posting.file >= previous->count[INDEX_FILES]
+                    || number[posting.file] == NO_FILE) {
+                continue;
+            }
+            if (id == NO_FILE) {
+                id = intern(builder, string, strlen(string));
+            }
+            posting.file = number[posting.file];
+            add_entry(builder, id, &posting);
+        }
+    }
+    free(number);
+}
+
+static const char *sorted_text = NULL;
+static const uint32_t *sorted_terms = NULL;
+
+static int compare_terms(const void *const a, const void *const b)
+{
+    return strcmp(sorted_text + sorted_terms[*(const uint32_t *) a],
+            sorted_text + sorted_terms[*(const uint32_t *) b]);
+}
+
+static void pad(FILE *const f, size_t *const offset)
+{
+    while (*offset % 4) {
+        fputc('\0', f);
+        ++*offset;
+    }
+}
+
+/* writes the index, sorting the postings by term and then by file; as the
+ * postings of a file come in the order of the score, they end up sorted by
+ * word, syllable and note within a term */
+static bool write_index(index_builder *const builder, FILE *const f,
+        const index_file *const files, const size_t count)
+{
+    const size_t terms = builder->term_count;
+    uint32_t *const rank = (uint32_t *) gregorio_malloc(
+            (terms + 1) * sizeof(uint32_t));
+    uint32_t *const by_rank = (uint32_t *) gregorio_malloc(
+            (terms + 1) * sizeof(uint32_t));
+    size_t *const start = (size_t *) gregorio_calloc(
+            (terms > count? terms : count) + 1, sizeof(size_t));
+    index_entry *const sorted = (index_entry *) gregorio_malloc(
+            (builder->entry_count + 1) * sizeof(index_entry));
+    unsigned char header[HEADER_SIZE], record[POSTING_SIZE];
+    size_t offset[INDEX_NUMBER_OF_SECTIONS], size, strings = 0, i;
+    uint32_t *const path_offset = (uint32_t *) gregorio_malloc(
+            (count + 1) * sizeof(uint32_t));
+    uint32_t *const term_offset = (uint32_t *) gregorio_malloc(
+            (terms + 1) * sizeof(uint32_t));
+    bool ok;
+
+    for (i = 0; i < terms; ++i) {
+        by_rank[i] = (uint32_t) i;
+    }
+    sorted_text = builder->text;
+    sorted_terms = builder->terms;
+    qsort(by_rank, terms, sizeof *by_rank, compare_terms);
+    for (i = 0; i < terms; ++i) {
+        rank[by_rank[i]] = (uint32_t) i;
+    }
+
+    /* a stable counting sort by file, then one by term */
+    for (i = 0; i < builder->entry_count; ++i) {
+        ++start[builder->entries[i].posting.file + 1];
+    }
+    for (i = 1; i < count; ++i) {
+        start[i] += start[i - 1];
+    }
+    for (i = 0; i < builder->entry_count; ++i) {
+        sorted[start[builder->entries[i].posting.file]++] =
+                builder->entries[i];
+    }
+    memset(start, 0, ((terms > count? terms : count) + 1) * sizeof(size_t));
+    for (i = 0; i < builder->entry_count; ++i) {
+        ++start[rank[sorted[i].term] + 1];
+    }
+    for (i = 1; i <= terms; ++i) {
+        start[i] += start[i - 1];
+    }
+    for (i = 0; i < builder->entry_count; ++i) {
+        builder->entries[start[rank[sorted[i].term]]++] = sorted[i];
+    }
+    /* start[r] is now the end of the postings of the term of rank r */
+
+    for (i = 0; i < count; ++i) {
+        path_offset[i] = (uint32_t) strings;
+        strings += strlen(files[i].path) + 1;
+    }
+    for (i = 0; i < terms; ++i) {
+        term_offset[i] = (uint32_t) strings;
+        strings += strlen(builder->text + builder->terms[by_rank[i]]) + 1;
+    }
+
+    size = HEADER_SIZE;
+    offset[INDEX_STRINGS] = size;
+    size += strings + 3 - (strings + 3) % 4;
+    offset[INDEX_FILES] = size;
+    size += count * FILE_RECORD_SIZE;
+    offset[INDEX_TERMS] = size;
+    size += terms * TERM_RECORD_SIZE;
+    offset[INDEX_POSTINGS] = size;
+    size += builder->entry_count * POSTING_SIZE;
+    if (size > 0xffffffffu) {
+        fprintf(stderr, "error: the index would be larger than 4 GB\n");
+        ok = false;
+    } else {
+        memcpy(header, INDEX_MAGIC, 4);
+        put_u16(header + 4, INDEX_VERSION);
+        put_u16(header + 6, INDEX_NUMBER_OF_SECTIONS);
+        put_u32(header + 8, (uint32_t) offset[INDEX_STRINGS]);
+        put_u32(header + 12, (uint32_t) strings);
+        put_u32(header + 16, (uint32_t) offset[INDEX_FILES]);
+        put_u32(header + 20, (uint32_t) count);
+        put_u32(header + 24, (uint32_t) offset[INDEX_TERMS]);
+        put_u32(header + 28, (uint32_t) terms);
+        put_u32(header + 32, (uint32_t) offset[INDEX_POSTINGS]);
+        put_u32(header + 36, (uint32_t) builder->entry_count);
+        fwrite(header, 1, HEADER_SIZE, f);
+
+        size = HEADER_SIZE;
+        for (i = 0; i < count; ++i) {
+            const size_t length = strlen(files[i].path) + 1;
+            fwrite(files[i].path, 1, length, f);
+            size += length;
+        }
+        for (i = 0; i < terms; ++i) {
+            const char *const term = builder->text
+                    + builder->terms[by_rank[i]];
+            const size_t length = strlen(term) + 1;
+            fwrite(term, 1, length, f);
+            size += length;
+        }
+        pad(f, &size);
+        for (i = 0; i < count; ++i) {
+            put_u32(record, path_offset[i]);
+            fwrite(record, 1, 4, f);
+            fwrite(files[i].digest, 1, XXH3_128_DIGEST_SIZE, f);
+        }
+        for (i = 0; i < terms; ++i) {
+            const size_t first = i? start[i - 1] : 0;
+            put_u32(record, term_offset[i]);
+            put_u32(record + 4, (uint32_t) first);
+            put_u32(record + 8, (uint32_t) (start[i] - first));
+            fwrite(record, 1, TERM_RECORD_SIZE, f);
+        }
+        for (i = 0; i < builder->entry_count; ++i) {
+            put_posting(record, &builder->entries[i].posting);
+            fwrite(record, 1, POSTING_SIZE, f);
+        }
+        ok = !ferror(f);
+    }
+
+    free(term_offset);
+    free(path_offset);
+    free(sorted);
+    free(start);
+    free(by_rank);
+    free(rank);
+    return ok;
+}
+
+/*
+ * The files of the corpus
+ */
+
+typedef struct file_list {
+    index_file *files;
+    size_t count, capacity;
+} file_list;
+
+static bool has_gabc_extension(const char *const name)
+{
+    const size_t length = strlen(name);
+    return length > 5 && !strcmp(name + length - 5, ".gabc");
+}
+
+static void add_file(file_list *const list, char *const path)
+{
+    if (list->count == list->capacity) {
+        list->files = gregorio_grow_buffer(list->files, &list->capacity,
+                index_file);
+    }
+    memset(list->files + list->count, 0, sizeof *list->files);
+    list->files[list->count].path = path;
+    list->files[list->count].previous = NO_FILE;
+    ++list->count;
+}
+
+/* adds the gabc files under path, or path itself if it is a file */
+static bool collect_files(file_list *const list, const char *const path,
+        const bool given)
+{
+    struct stat st;
+    DIR *dir;
+    struct dirent *entry;
+    bool ok = true;
+
+    if (stat(path, &st)) {
+        fprintf(stderr, "error: can't find %s\n", path);
+        return false;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        if (given || has_gabc_extension(path)) {
+            add_file(list, gregorio_strdup(path));
+        }
+        return true;
+    }
+    dir = opendir(path);
+    if (!dir) {
+        fprintf(stderr, "error: can't read the directory %s\n", path);
+        return false;
+    }
+    while ((entry = readdir(dir))) {
+        const size_t length = strlen(path);
+        char *child;
+        /* the hidden files too, such as .git */
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        child = (char *) gregorio_malloc(length + strlen(entry->d_name) + 2);
+        strcpy(child, path);
+        if (length && path[length - 1] != '/') {
+            child[length] = '/';
+            child[length + 1] = '\0';
+        }
+        strcat(child, entry->d_name);
+        if (has_gabc_extension(child)) {
+            add_file(list, child);
+        } else {
+#ifdef _WIN32
+            if (stat(child, &st) == 0 && S_ISDIR(st.st_mode)) {
+#else
+            /* not through the links, which could make a cycle */
+            if (lstat(child, &st) == 0 && S_ISDIR(st.st_mode)) {
+#endif
+                ok = collect_files(list, child, false) && ok;
+            }
+            free(child);
+        }
+    }
+    closedir(dir);
+    return ok;
+}
+
+static int compare_paths(const void *const a, const void *const b)
+{
+    return strcmp(((const index_file *) a)->path,
+            ((const index_file *) b)->path);
+}
+
+/* fills the list with the gabc files under the paths, sorted by path */
+static bool collect_paths(file_list *const list, char **const paths,
+        const int number_of_paths)
+{
+    size_t i, j;
+    bool ok = true;
+    int k;
+
+    memset(list, 0, sizeof *list);
+    list->capacity = 64;
+    list->files = gregorio_grow_buffer(NULL, &list->capacity, index_file);
+    for (k = 0; k < number_of_paths; ++k) {
+        ok = collect_files(list, paths[k], true) && ok;
+    }
+    if (list->count) {
+        qsort(list->files, list->count, sizeof *list->files, compare_paths);
+    }
+    /* the same file may be under two of the paths */
+    for (i = 0, j = 0; i < list->count; ++i) {
+        if (j && !strcmp(list->files[j - 1].path, list->files[i].path)) {
+            free(list->files[i].path);
+        } else {
+            list->files[j++] = list->files[i];
+        }
+    }
+    list->count = j;
+    return ok;
+}
+
+static void free_file_list(file_list *const list)
+{
+    size_t i;
+
+    for (i = 0; i < list->count; ++i) {
+        free(list->files[i].path);
+    }
+    free(list->files);
+}
+
+static bool digest_file(index_file *const file)
+{
+    unsigned char buffer[65536];
+    struct xxh3_ctx ctx;
+    size_t n;
+    FILE *const f = fopen(file->path, "rb");
+
+    if (!f) {
+        fprintf(stderr, "error: can't open file %s for reading\n", file->path);
+        return false;
+    }
+    xxh3_init_ctx(&ctx);
+    file->size = 0;
+    while ((n = fread(buffer, 1, sizeof buffer, f)) > 0) {
+        xxh3_process_bytes(buffer, n, &ctx);
+        file->size += (long) n;
+    }
+    xxh3_finish_ctx(&ctx, file->digest);
+    if (ferror(f)) {
+        fprintf(stderr, "error: can't read file %s\n", file->path);
+        fclose(f);
+        return false;
+    }
+    fclose(f);
+    return true;
+}
+
+/* finds the unchanged file of the same path in the previous index */
+static uint32_t find_previous(const index_map *const previous,
+        const index_file *const file)
+{
+    uint32_t low = 0, high = previous->count[INDEX_FILES];
+
+    while (low < high) {
+        const uint32_t middle = low + (high - low) / 2;
+        const int order = strcmp(file_path(previous, middle), file->path);
+        if (order == 0) {
+            return memcmp(file_digest(previous, middle), file->digest,
+                    XXH3_128_DIGEST_SIZE)? NO_FILE : middle;
+        }
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return NO_FILE;
+}
+
+static int build(const char *const index_name, char **const paths,
+        const int number_of_paths, const int workers)
+{
+    file_list list;
+    index_builder builder;
+    index_map previous;
+    index_status status;
+    size_t kept = 0, i, j;
+    char *temp_name;
+    FILE *f;
+    bool ok;
+
+    status = index_open(&previous, index_name);
+    if (status == INDEX_INVALID) {
+        fprintf(stderr, "error: %s is not an index, and is left as it is\n",
+                index_name);
+        return 1;
+    }
+
+    memset(&builder, 0, sizeof builder);
+    builder.text_capacity = 65536;
+    builder.text = gregorio_grow_buffer(NULL, &builder.text_capacity, char);
+    builder.term_capacity = 4096;
+    builder.terms = gregorio_grow_buffer(NULL, &builder.term_capacity,
+            uint32_t);
+    builder.entry_capacity = 65536;
+    builder.entries = gregorio_grow_buffer(NULL, &builder.entry_capacity,
+            index_entry);
+
+    ok = collect_paths(&list, paths, number_of_paths);
+    for (i = 0, j = 0; i < list.count; ++i) {
+        if (!digest_file(list.files + i)) {
+            free(list.files[i].path);
+            ok = false;
+            continue;
+        }
+        if (status == INDEX_OK) {
+            list.files[i].previous = find_previous(&previous, list.files + i);
+            if (list.files[i].previous != NO_FILE) {
+                ++kept;
+            }
+        }
+        list.files[j++] = list.files[i];
+    }
+    list.count = j;
+
+    if (status == INDEX_OK) {
+        add_previous_entries(&builder, &previous, list.files, list.count);
+        index_close(&previous);
+    }
+    ok = parse_changed_files(&builder, list.files, list.count, workers) && ok;
+
+    /* written aside, and then renamed, so that a query never sees half an
+     * index */
+    temp_name = (char *) gregorio_malloc(strlen(index_name) + 5);
+    strcpy(temp_name, index_name);
+    strcat(temp_name, ".tmp");
+    f = fopen(temp_name, "wb");
+    if (!f) {
+        fprintf(stderr, "error: can't write in file %s\n", temp_name);
+        ok = false;
+    } else {
+        bool written = write_index(&builder, f, list.files, list.count);
+        written = fclose(f) == 0 && written;
+#ifdef _WIN32
+        if (written) {
+            remove(index_name);
+        }
+#endif
+        if (!written || rename(temp_name, index_name)) {
+            fprintf(stderr, "error: can't write in file %s\n", index_name);
+            remove(temp_name);
+            ok = false;
+        } else {
+            fprintf(stderr, "%s: %lu files (%lu parsed), %lu terms, "
+                    "%lu postings\n", index_name, (unsigned long) list.count,
+                    (unsigned long) (list.count - kept),
+                    (unsigned long) builder.term_count,
+                    (unsigned long) builder.entry_count);
+        }
+    }
+
+    free(temp_name);
+    free_file_list(&list);
+    free(builder.text);
+    free(builder.terms);
+    free(builder.slots);
+    free(builder.entries);
+    return ok? 0 : 1;
+}
+
+/*
+ * Queries
+ */
+
+typedef enum query_scope {
+    SCOPE_FILE,
+    SCOPE_WORD,
+    SCOPE_SYLLABLE
+} query_scope;
+
+/* the postings which match a term of a query */
+typedef struct match_list {
+    index_posting *postings;
+    size_t count, capacity;
+} match_list;
+
+static void add_match(match_list *const list,
+        const index_posting *const posting)
+{
+    if (list->count == list->capacity) {
+        list->postings = gregorio_grow_buffer(list->postings,
+                &list->capacity, index_posting);
+    }
+    list->postings[list->count++] = *posting;
+}
+
+static int compare_postings(const void *const a, const void *const b)
+{
+    const index_posting *const pa = (const index_posting *) a;
+    const index_posting *const pb = (const index_posting *) b;
+    if (pa->file != pb->file) {
+        return pa->file < pb->file? -1 : 1;
+    }
+    if (pa->word != pb->word) {
+        return pa->word < pb->word? -1 : 1;
+    }
+    if (pa->syllable != pb->syllable) {
+        return pa->syllable < pb->syllable? -1 : 1;
+    }
+    if (pa->note != pb->note) {
+        return pa->note < pb->note? -1 : 1;
+    }
+    return 0;
+}
+
+/* adds the postings of a term, or of all the terms starting with it */
+static void match_term(const index_map *const map, const char *const term,
+        const bool prefix, match_list *const list)
+{
+    uint32_t first, end, term_number, count, i;
+
+    find_terms(map, term, prefix, &first, &end);
+    for (term_number = first; term_number < end; ++term_number) {
+        const unsigned char *p = term_postings(map, term_number, &count);
+        for (i = 0; i < count; ++i, p += POSTING_SIZE) {
+            index_posting posting;
+            get_posting(p, &posting);
+            add_match(list, &posting);
+        }
+    }
+    if (end - first > 1) {
+        qsort(list->postings, list->count, sizeof *list->postings,
+                compare_postings);
+    }
+}
+
+/* whether a term has a posting at the given note of the given file; the
+ * postings of a melody, sorted by word, syllable and note, are sorted by note
+ * as well */
+static bool has_note(const unsigned char *const postings, const uint32_t count,
+        const uint32_t file, const uint32_t note)
+{
+    uint32_t low = 0, high = count;
+
+    while (low < high) {
+        const uint32_t middle = low + (high - low) / 2;
+        const unsigned char *const p = postings + (size_t) middle
+                * POSTING_SIZE;
+        const uint32_t other_file = get_u32(p), other_note = get_u32(p + 12);
+        if (other_file == file && other_note == note) {
+            return true;
+        }
+        if (other_file < file || (other_file == file && other_note < note)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return false;
+}
+
+static const unsigned char *melody_postings(const index_map *const map,
+        const int *const intervals, const int length, uint32_t *const count)
+{
+    char term[3 + 4 * LONG_MELODY + 1];
+    size_t size = 2;
+    uint32_t first, end;
+    int i;
+
+    memcpy(term, "i:", 2);
+    for (i = 0; i < length; ++i) {
+        gregorio_snprintf(term + size, sizeof term - size, "%+d",
+                intervals[i]);
+        size += strlen(term + size);
+    }
+    find_terms(map, term, false, &first, &end);
+    if (first == end) {
+        *count = 0;
+        return NULL;
+    }
+    return term_postings(map, first, count);
+}
+
+/* adds the postings of a melody, given by its intervals, and if letter is not
+ * 0, starting on that letter, at the start of a score if incipit is true */
+static void match_melody(const index_map *const map, const int *const intervals,
+        const int length, const char letter, const bool incipit,
+        match_list *const list)
+{
+    const int chunk = length >= LONG_MELODY? LONG_MELODY : SHORT_MELODY;
+    const unsigned char *first, *postings;
+    uint32_t first_count, count, i;
+    int offset;
+
+    first = melody_postings(map, intervals, chunk, &first_count);
+    for (i = 0; i < first_count; ++i) {
+        index_posting posting;
+        bool found = true;
+        get_posting(first + (size_t) i * POSTING_SIZE, &posting);
+        if ((incipit && posting.note) || (letter
+                    && (char) (posting.line >> LETTER_SHIFT) != letter)) {
+            continue;
+        }
+        /* the chunks from the start, and the last one, which may overlap */
+        for (offset = chunk; found && offset < length; offset += chunk) {
+            if (offset + chunk > length) {
+                offset = length - chunk;
+            }
+            postings = melody_postings(map, intervals + offset, chunk, &count);
+            found = has_note(postings, count, posting.file,
+                    posting.note + offset);
+        }
+        if (found) {
+            add_match(list, &posting);
+        }
+    }
+}
+
+static int pitch_of_letter(const char letter)
+{
+    const char lower = (letter >= 'A' && letter <= 'Z')?
+            (char) (letter - 'A' + 'a') : letter;
+    if (lower == 'p') {
+        return 'o' - 'a';
+    }
+    if (lower >= 'a' && lower <= 'n') {
+        return lower - 'a';
+    }
+    return -1;
+}
+
+/* adds the postings which match a term of a query, as the usage gives them;
+ * returns false if it is not a valid term */
+static bool match_query_term(const index_map *const map,
+        const char *const query, match_list *const list)
+{
+    const char *const colon = strchr(query, ':');
+    const char *value;
+    char term[MAX_TERM_LENGTH + 1];
+    size_t length;
+    bool prefix;
+    int intervals[MAX_TERM_LENGTH];
+    int count = 0;
+
+    if (!colon) {
+        return false;
+    }
+    value = colon + 1;
+    length = strlen(value);
+    prefix = length && value[length - 1] == '*';
+    if (prefix) {
+        --length;
+    }
+    if (!strncmp(query, "word:", 5)) {
+        grewchar *const characters = gregorio_build_grewchar_string_from_buf(
+                value);
+        grewchar *c;
+        size_t size = 2;
+        memcpy(term, "w:", 2);
+        for (c = characters; *c; ++c) {
+            append_folded(term, &size, *c);
+        }
+        free(characters);
+        term[size] = '\0';
+        match_term(map, term, prefix, list);
+        return true;
+    }
+    if (!strncmp(query, "type:", 5) || !strncmp(query, "glyph:", 6)) {
+        size_t i;
+        if (length > MAX_TERM_LENGTH - 2) {
+            length = MAX_TERM_LENGTH - 2;
+        }
+        term[0] = query[0] == 't'? 't' : 'g';
+        term[1] = ':';
+        for (i = 0; i < length; ++i) {
+            /* the types are in lowercase, the names as they are */
+            term[2 + i] = (query[0] == 't' && value[i] >= 'A'
+                    && value[i] <= 'Z')? (char) (value[i] - 'A' + 'a')
+                    : value[i];
+        }
+        term[2 + length] = '\0';
+        match_term(map, term, prefix, list);
+        return true;
+    }
+    if (prefix) {
+        return false;
+    }
+    if (!strncmp(query, "intervals:", 10)) {
+        const char *p = value;
+        while (*p && count < MAX_TERM_LENGTH) {
+            char *end;
+            const long interval = strtol(p, &end, 10);
+            if (end == p || (*end && *end != ',') || interval < -99
+                    || interval > 99) {
+                return false;
+            }
+            intervals[count++] = (int) interval;
+            p = *end? end + 1 : end;
+        }
+        if (count < SHORT_MELODY) {
+            return false;
+        }
+        match_melody(map, intervals, count, 0, false, list);
+        return true;
+    }
+    if (!strncmp(query, "notes:", 6) || !strncmp(query, "incipit:", 8)) {
+        size_t i;
+        if (length < SHORT_MELODY + 1 || length > MAX_TERM_LENGTH) {
+            return false;
+        }
+        for (i = 0; i < length; ++i) {
+            if (pitch_of_letter(value[i]) < 0) {
+                return false;
+            }
+            if (i) {
+                intervals[count++] = pitch_of_letter(value[i])
+                        - pitch_of_letter(value[i - 1]);
+            }
+        }
+        match_melody(map, intervals, count, (char) ((value[0] >= 'A'
+                        && value[0] <= 'Z')? value[0] - 'A' + 'a' : value[0]),
+                query[1] == 'n', list);
+        return true;
+    }
+    return false;
+}
+
+/* the key of the scope of a posting, in the order of the postings */
+static int compare_scopes(const index_posting *const a,
+        const index_posting *const b, const query_scope scope)
+{
+    uint32_t value_a = 0, value_b = 0;
+
+    if (a->file != b->file) {
+        return a->file < b->file? -1 : 1;
+    }
+    switch (scope) {
+    case SCOPE_WORD:
+        value_a = a->word;
+        value_b = b->word;
+        break;
+    case SCOPE_SYLLABLE:
+        value_a = a->syllable;
+        value_b = b->syllable;
+        break;
+    default:
+        break;
+    }
+    return value_a < value_b? -1 : value_a > value_b? 1 : 0;
+}
+
+static int query(const char *const index_name, char **const terms,
+        const int number_of_terms, const query_scope scope)
+{
+    index_map map;
+    match_list *lists;
+    size_t *position;
+    size_t matches = 0;
+    int i;
+    bool ok = true;
+
+    switch (index_open(&map, index_name)) {
+    case INDEX_OK:
+        break;
+    case INDEX_OTHER_VERSION:
+        fprintf(stderr, "error: %s was built by another version, build it "
+                "again\n", index_name);
+        return 2;
+    default:
+        fprintf(stderr, "error: can't read the index %s\n", index_name);
+        return 2;
+    }
+    lists = (match_list *) gregorio_calloc(number_of_terms, sizeof *lists);
+    position = (size_t *) gregorio_calloc(number_of_terms, sizeof *position);
+    for (i = 0; i < number_of_terms; ++i) {
+        lists[i].capacity = 64;
+        lists[i].postings = gregorio_grow_buffer(NULL, &lists[i].capacity,
+                index_posting);
+        if (!match_query_term(&map, terms[i], lists + i)) {
+            fprintf(stderr, "error: invalid query term: %s\n", terms[i]);
+            ok = false;
+        }
+    }
+
+    /* the scopes the postings of every term fall in, in order */
+    while (ok && position[0] < lists[0].count) {
+        const index_posting *const candidate = lists[0].postings
+                + position[0];
+        bool everywhere = true;
+        for (i = 1; i < number_of_terms && everywhere; ++i) {
+            while (position[i] < lists[i].count
+                    && compare_scopes(lists[i].postings + position[i],
+                        candidate, scope) < 0) {
+                ++position[i];
+            }
+            everywhere = position[i] < lists[i].count
+                    && compare_scopes(lists[i].postings + position[i],
+                            candidate, scope) == 0;
+        }
+        if (everywhere) {
+            printf("%s:%lu\n", file_path(&map, candidate->file),
+                    (unsigned long) (candidate->line & LINE_MASK));
+            ++matches;
+        }
+        do {
+            ++position[0];
+        } while (position[0] < lists[0].count
+                && compare_scopes(lists[0].postings + position[0], candidate,
+                    scope) == 0);
+    }
+
+    for (i = 0; i < number_of_terms; ++i) {
+        free(lists[i].postings);
+    }
+    free(lists);
+    free(position);
+    index_close(&map);
+    /* like grep */
+    return ok? matches? 0 : 1 : 2;
+}
+
+/* prints the terms which start with prefix and their number of postings */
+static int list_terms(const char *const index_name, const char *const prefix)
+{
+    index_map map;
+    uint32_t first, end, count;
+
+    if (index_open(&map, index_name) != INDEX_OK) {
+        fprintf(stderr, "error: can't read the index %s\n", index_name);
+        return 2;
+    }
+    find_terms(&map, prefix, true, &first, &end);
+    for (; first < end; ++first) {
+        term_postings(&map, first, &count);
+        printf("%s\t%lu\n", term_string(&map, first), (unsigned long) count);
+    }
+    index_close(&map);
+    return 0;
+}
+
+/*
+ * N-gram statistics
+ */
+
+/* the longest n-gram counted, whose symbols fit in 64 bits */
+#define MAX_NGRAM 8
+
+/* writes the number of notes and the pitches of a score to the temporary file
+ * of a parsing process */
+static void write_pitches(FILE *const out, gregorio_score *const score,
+        const uint32_t file)
+{
+    gregorio_melody melody;
+    unsigned char count[4];
+
+    (void) file;
+    if (!score) {
+        return;
+    }
+    gregorio_melody_init(&melody);
+    gregorio_melody_fill(&melody, score, 0);
+    put_u32(count, (uint32_t) melody.count);
+    fwrite(count, 1, sizeof count, out);
+    fwrite(melody.pitches, 1, melody.count, out);
+    gregorio_melody_free(&melody);
+}
+
+typedef struct ngram_count {
+    uint64_t ngram;
+    unsigned long count;
+} ngram_count;
+
+/* the n-grams counted, in an open hash table; an n-gram is its symbols, one
+ * per byte, the first one in the high byte */
+typedef struct ngram_table {
+    ngram_count *slots;
+    size_t size, count;
+    unsigned long total;
+} ngram_table;
+
+static size_t ngram_slot(const ngram_table *const table, const uint64_t ngram)
+{
+    const uint64_t multiplier = ((uint64_t) 0x9e3779b9u << 32) | 0x7f4a7c15u;
+    size_t slot = (size_t) ((ngram * multiplier) >> 32) & (table->size - 1);
+    while (table->slots[slot].count && table->slots[slot].ngram != ngram) {
+        slot = (slot + 1) & (table->size - 1);
+    }
+    return slot;
+}
+
+static void count_ngram(ngram_table *const table, const uint64_t ngram)
+{
+    size_t slot = ngram_slot(table, ngram);
+
+    if (!table->slots[slot].count) {
+        if (2 * (table->count + 1) > table->size) {
+            ngram_count *const slots = table->slots;
+            const size_t size = table->size;
+            size_t i;
+            table->size *= 2;
+            table->slots = (ngram_count *) gregorio_calloc(table->size,
+                    sizeof(ngram_count));
+            for (i = 0; i < size; ++i) {
+                if (slots[i].count) {
+                    table->slots[ngram_slot(table, slots[i].ngram)]
+                            = slots[i];
+                }
+            }
+            free(slots);
+            slot = ngram_slot(table, ngram);
+        }
+        table->slots[slot].ngram = ngram;
+        ++table->count;
+    }
+    ++table->slots[slot].count;
+    ++table->total;
+}
+
+/* counts the n-grams of the melodies in the temporary file of a parsing
+ * process */
+static bool count_ngrams(ngram_table *const table, FILE *const in,
+        const int length, const bool contours)
+{
+    const uint64_t mask = length == MAX_NGRAM? ~(uint64_t) 0
+            : ((uint64_t) 1 << (8 * length)) - 1;
+    /* the pitches, intervals and contours of a score, one after the other */
+    size_t capacity = 4096;
+    signed char *buffer = (signed char *) gregorio_malloc(3 * capacity);
+    unsigned char count[4];
+    bool ok = fflush(in) == 0 && fseek(in, 0, SEEK_SET) == 0;
+
+    while (ok && fread(count, 1, sizeof count, in) == sizeof count) {
+        const size_t notes = get_u32(count);
+        const signed char *symbols;
+        uint64_t ngram = 0;
+        size_t i;
+        if (notes > capacity) {
+            while (notes > capacity) {
+                capacity *= 2;
+            }
+            free(buffer);
+            buffer = (signed char *) gregorio_malloc(3 * capacity);
+        }
+        if (fread(buffer, 1, notes, in) != notes) {
+            ok = false;
+            break;
+        }
+        gregorio_melody_intervals(buffer, notes, buffer + capacity,
+                contours? buffer + 2 * capacity : NULL);
+        symbols = buffer + (contours? 2 : 1) * capacity;
+        for (i = 0; i + 1 < notes; ++i) {
+            ngram = ((ngram << 8) | (unsigned char) symbols[i]) & mask;
+            if (i + 1 >= (size_t) length) {
+                count_ngram(table, ngram);
+            }
+        }
+    }
+    free(buffer);
+    return ok && !ferror(in);
+}
+
+/* more frequent first */
+static int compare_counts(const void *const a, const void *const b)
+{
+    const ngram_count *const count_a = (const ngram_count *) a;
+    const ngram_count *const count_b = (const ngram_count *) b;
+    if (count_a->count != count_b->count) {
+        return count_a->count > count_b->count? -1 : 1;
+    }
+    if (count_a->ngram != count_b->ngram) {
+        return count_a->ngram < count_b->ngram? -1 : 1;
+    }
+    return 0;
+}
+
+static void print_ngram(const uint64_t ngram, const int length,
+        const bool contours)
+{
+    /* by contour class, from CONTOUR_LEAP_DOWN */
+    static const char contour_letters[] = "DdruU";
+    int i;
+
+    for (i = length - 1; i >= 0; --i) {
+        int symbol = (int) ((ngram >> (8 * i)) & 0xff);
+        if (symbol >= 128) {
+            symbol -= 256;
+        }
+        if (contours) {
+            putchar(contour_letters[symbol - CONTOUR_LEAP_DOWN]);
+        } else {
+            printf("%+d", symbol);
+        }
+    }
+}
+
+/* prints the most frequent n-grams of length intervals, or contour classes,
+ * in the melodies of the gabc files under the paths (all of them if top is
+ * 0) */
+static int ngrams(char **const paths, const int number_of_paths, int workers,
+        const int length, const bool contours, const unsigned long top)
+{
+    file_list list;
+    ngram_table table;
+    uint32_t *order;
+    FILE **temp;
+    size_t i, j;
+    bool ok;
+    int worker;
+
+    ok = collect_paths(&list, paths, number_of_paths);
+    for (i = 0, j = 0; i < list.count; ++i) {
+        struct stat st;
+        if (stat(list.files[i].path, &st)) {
+            fprintf(stderr, "error: can't find %s\n", list.files[i].path);
+            free(list.files[i].path);
+            ok = false;
+            continue;
+        }
+        list.files[i].size = (long) st.st_size;
+        list.files[j++] = list.files[i];
+    }
+    list.count = j;
+    order = (uint32_t *) gregorio_malloc((list.count + 1) * sizeof(uint32_t));
+    for (i = 0; i < list.count; ++i) {
+        order[i] = (uint32_t) i;
+    }
+    ok = parse_in_parallel(list.files, order, list.count, write_pitches,
+            &temp, &workers) && ok;
+
+    memset(&table, 0, sizeof table);
+    table.size = 1024;
+    table.slots = (ngram_count *) gregorio_calloc(table.size,
+            sizeof(ngram_count));
+    for (worker = 0; worker < workers; ++worker) {
+        if (!count_ngrams(&table, temp[worker], length, contours)) {
+            fprintf(stderr, "error: can't read a temporary file\n");
+            ok = false;
+        }
+        fclose(temp[worker]);
+    }
+    for (i = 0, j = 0; i < table.size; ++i) {
+        if (table.slots[i].count) {
+            table.slots[j++] = table.slots[i];
+        }
+    }
+    qsort(table.slots, j, sizeof *table.slots, compare_counts);
+    for (i = 0; i < j && (!top || i < top); ++i) {
+        print_ngram(table.slots[i].ngram, length, contours);
+        printf("\t%lu\t%.2f%%\n", table.slots[i].count,
+                100.0 * table.slots[i].count / table.total);
+    }
+    fprintf(stderr, "%lu files, %lu n-grams of %d %s, %lu distinct\n",
+            (unsigned long) list.count, table.total, length,
+            contours? "contours" : "intervals", (unsigned long) table.count);
+
+    free(table.slots);
+    free(temp);
+    free(order);
+    free_file_list(&list);
+    return ok? 0 : 1;
+}
+
+static void print_usage(const char *const name)
+{
+    printf("Usage: %s [OPTION]... build PATH...\n\
+  or:  %s [OPTION]... query TERM...\n\
+  or:  %s [OPTION]... terms [PREFIX]\n\
+  or:  %s [OPTION]... ngrams PATH...\n\
+\nIndex the gabc files under the PATHs, find where all the TERMs occur, list\n\
+the terms of the index or print the most frequent melodic n-grams of the\n\
+gabc files under the PATHs.\n\n", name, name, name, name);
+    printf("Options:\n\
+  -i FILE       the index (default: " DEFAULT_INDEX ")\n\
+  -j NUMBER     number of parsing processes (default: one per processor)\n\
+  -s SCOPE      where the TERMs must all occur: file, word (default) or\n\
+                syllable\n\
+  -n LENGTH     length of the n-grams, in intervals (1 to 8, default: 3)\n\
+  -c            count the n-grams of contours rather than of intervals\n\
+  -k NUMBER     number of n-grams to print (default: 20, 0 for all)\n\
+  -h            print this help message\n\
+\n");
+    printf("Terms:\n\
+  word:WORD         a word of the lyrics, with or without its accents\n\
+  type:TYPE         a glyph of this type, e.g. type:torculus_resupinus\n\
+  glyph:NAME        a glyph of this GregorioTeX name, e.g. glyph:PesTwo\n\
+  intervals:N,N...  a melody, by its intervals in steps, e.g. 2,1,-1\n\
+  notes:LETTERS     a melody, by its gabc letters in its first clef\n\
+  incipit:LETTERS   a melody at the start of a score\n\
+\n");
+    printf("A word, type or name ending with * is a prefix.  A melody has at least\n\
+three notes.  Each match is printed as FILE:LINE.\n\
+\nAn n-gram is printed with its count and its share of all the n-grams, as\n\
+intervals in steps, e.g. +2+1-1, or as contours: D or U for a leap (a third\n\
+or more) down or up, d or u for a step, r for a repeated note.\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *index_name = DEFAULT_INDEX;
+    query_scope scope = SCOPE_WORD;
+    unsigned long top = 20;
+    int workers = 0, length = 3, c;
+    bool contours = false;
+
+    gregorio_support_init("gregorio-index", argv[0]);
+
+    while ((c = getopt(argc, argv, "i:j:s:n:ck:h")) != -1) {
+        switch (c) {
+        case 'i':
+            index_name = optarg;
+            break;
+        case 'j':
+            workers = atoi(optarg);
+            break;
+        case 's':
+            if (!strcmp(optarg, "file")) {
+                scope = SCOPE_FILE;
+            } else if (!strcmp(optarg, "word")) {
+                scope = SCOPE_WORD;
+            } else if (!strcmp(optarg, "syllable")) {
+                scope = SCOPE_SYLLABLE;
+            } else {
+                fprintf(stderr, "error: unknown scope: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'n':
+            length = atoi(optarg);
+            if (length < 1 || length > MAX_NGRAM) {
+                fprintf(stderr, "error: the length of an n-gram is from 1 "
+                        "to %d\n", MAX_NGRAM);
+                return 2;
+            }
+            break;
+        case 'c':
+            contours = true;
+            break;
+        case 'k':
+            top = strtoul(optarg, NULL, 10);
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (workers < 1) {
+#if !defined _WIN32 && defined _SC_NPROCESSORS_ONLN
+        workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+        if (workers < 1) {
+            workers = 1;
+        }
+    }
+    if (optind < argc && !strcmp(argv[optind], "build") && optind + 1 < argc) {
+        return build(index_name, argv + optind + 1, argc - optind - 1,
+                workers);
+    }
+    if (optind < argc && !strcmp(argv[optind], "query") && optind + 1 < argc) {
+        return query(index_name, argv + optind + 1, argc - optind - 1, scope);
+    }
+    if (optind < argc && !strcmp(argv[optind], "terms")
+            && optind + 2 >= argc) {
+        return list_terms(index_name, optind + 1 < argc? argv[optind + 1]
+                : "");
+    }
+    if (optind < argc && !strcmp(argv[optind], "ngrams")
+            && optind + 1 < argc) {
+        return ngrams(argv + optind + 1, argc - optind - 1, workers, length,
+                contours, top);
+    }
+    print_usage(argv[0]);
+    return 2;
+}
@@ -0,0 +1,650 @@
+/*
+ * Gregorio is a program that translates gabc files to GregorioTeX.
+ * This file writes the analyzed score as JSON.
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The score is written as it is walked, without building a document, so that
+ * the memory used doesn't depend on the score.  The field names are stable:
+ * a field is only added to a new JSON_FORMAT_VERSION, never renamed.  The
+ * values of the enumerations are the names of their constants in struct.h
+ * (S_PUNCTUM, G_PODATUS, B_DIVISIO_MAIOR, ...), and the fields which have
+ * their default value (false, no sign, no liquescence...) are left out,
+ * except for the type of the nodes and the pitch, shape and signs of notes.
+ *
+ * {
+ *   "format_version": 2, "gregorio": VERSION, "digest": DIGEST,
+ *   "number_of_voices": N, "staff_lines": N, "nabc_lines": N,
+ *   "legacy_oriscus_orientation": true,
+ *   "headers": [{"name": NAME, "value": VALUE}, ...],
+ *   "voices": [{"initial_clef": CLEF}, ...],
+ *   "syllables": [{
+ *     "line": N, "column": N, "position": WORD_POSITION,
+ *     "first_word": true, "euouae": EUOUAE, "no_linebreak_area": NLBA,
+ *     "clear": true, "forced_center": true,
+ *     "text": PLAIN, "text_runs": RUNS,
+ *     "translation": PLAIN, "translation_runs": RUNS,
+ *     "translation_type": TR_CENTERING, "abovelinestext": STRING,
+ *     "elements": [ELEMENT, ...], "other_voices": [[ELEMENT, ...], ...]
+ *   }, ...]
+ * }
+ *
+ * The elements are those of the first voice, and other_voices, only written
+ * for a score of several voices, has those of each of the others in turn.
+ * PLAIN is the text without its styles, RUNS is an array of {"chars": STRING},
+ * {"begin": STYLE} and {"end": STYLE}, and CLEF is {"clef": "c" or "f",
+ * "line": N, "flatted": true, "secondary": CLEF}.  An element has a "type"
+ * and, according to it: "glyphs" (GRE_ELEMENT), "bar" and "special_sign"
+ * (GRE_BAR), "clef" (GRE_CLEF), "pitch" and "force_pitch" (GRE_CUSTOS),
+ * "space" and "factor" (GRE_SPACE), "nlba" (GRE_NLBA) or "ragged" and
+ * "forces_custos" (GRE_END_OF_LINE), and possibly "nabc", an array of
+ * strings.  A glyph has a "type" and either "glyph_type", "name" (the name
+ * GregorioTeX determines for the shape of a glyph of several notes, since
+ * format_version 2), "liquescentia", "is_cavum" and "notes" (GRE_GLYPH) or
+ * "space" (GRE_SPACE).  A note has "type", "line", "column", "pitch" (a gabc
+ * letter), "shape" and "signs", and possibly "special_sign", "liquescentia",
+ * "is_cavum", "h_episema_above", "h_episema_below" (the size of the
+ * episema), "high_ledger_line", "low_ledger_line", "choral_sign" and
+ * "shape_hint".  The elements, glyphs and notes with TeX verbatim (including
+ * GRE_TEXVERB_ELEMENT, GRE_TEXVERB_GLYPH and GRE_ALT) have it in "tex".
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include "bool.h"
+#include "struct.h"
+#include "unicode.h"
+#include "xxh3.h"
+#include "messages.h"
+#include "plugins.h"
+#include "support.h"
+#include "gregoriotex/gregoriotex.h"
+
+#define JSON_FORMAT_VERSION 2
+
+/* the score is never nested deeper than this */
+#define JSON_MAX_DEPTH 12
+
+typedef struct json_writer {
+    FILE *f;
+    int depth;
+    /* whether the current object or array at each depth is still empty */
+    bool empty[JSON_MAX_DEPTH];
+} json_writer;
+
+static __inline void put_raw(json_writer *const w, const char *const s)
+{
+    fputs(s, w->f);
+}
+
+/* writes the comma before a value, and its key if it is in an object */
+static void put_key(json_writer *const w, const char *const key)
+{
+    if (w->empty[w->depth]) {
+        w->empty[w->depth] = false;
+    } else {
+        putc(',', w->f);
+    }
+    if (key) {
+        putc('"', w->f);
+        fputs(key, w->f);
+        fputs("\":", w->f);
+    }
+}
+
+static void begin(json_writer *const w, const char *const key,
+        const char bracket)
+{
+    put_key(w, key);
+    putc(bracket, w->f);
+    gregorio_assert(w->depth + 1 < JSON_MAX_DEPTH, begin,
+            "JSON nested too deeply", return);
+    w->empty[++w->depth] = true;
+}
+
+static void end(json_writer *const w, const char bracket)
+{
+    putc(bracket, w->f);
+    --w->depth;
+}
+
+#define begin_object(W,KEY) begin(W, KEY, '{')
+#define end_object(W) end(W, '}')
+#define begin_array(W,KEY) begin(W, KEY, '[')
+#define end_array(W) end(W, ']')
+
+/* writes the bytes of a string, escaped, without the quotes */
+static void put_escaped(json_writer *const w, const char *s)
+{
+    static const char *const hex = "0123456789abcdef";
+    const char *run = s;
+    for (; *s; ++s) {
+        const unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        if (s > run) {
+            fwrite(run, 1, (size_t)(s - run), w->f);
+        }
+        putc('\\', w->f);
+        switch (c) {
+        case '"':
+        case '\\':
+            putc(c, w->f);
+            break;
+        case '\n':
+            putc('n', w->f);
+            break;
+        case '\t':
+            putc('t', w->f);
+            break;
+        default:
+            fputs("u00", w->f);
+            putc(hex[c >> 4], w->f);
+            putc(hex[c & 0x0F], w->f);
+            break;
+        }
+        run = s + 1;
+    }
+    if (s > run) {
+        fwrite(run, 1, (size_t)(s - run), w->f);
+    }
+}
+
+static void put_string(json_writer *const w, const char *const key,
+        const char *const value)
+{
+    put_key(w, key);
+    putc('"', w->f);
+    put_escaped(w, value);
+    putc('"', w->f);
+}
+
+/* for the names of constants and other strings which need no escaping */
+static void put_name(json_writer *const w, const char *const key,
+        const char *const value)
+{
+    put_key(w, key);
+    putc('"', w->f);
+    fputs(value, w->f);
+    putc('"', w->f);
+}
+
+static void put_int(json_writer *const w, const char *const key,
+        const long value)
+{
+    char buf[24];
+    char *p = buf + sizeof buf;
+    unsigned long n = value < 0 ? -(unsigned long)value : (unsigned long)value;
+    put_key(w, key);
+    do {
+        *--p = (char)('0' + n % 10);
+        n /= 10;
+    } while (n);
+    if (value < 0) {
+        *--p = '-';
+    }
+    fwrite(p, 1, (size_t)(buf + sizeof buf - p), w->f);
+}
+
+static void put_true(json_writer *const w, const char *const key)
+{
+    put_key(w, key);
+    put_raw(w, "true");
+}
+
+static void put_pitch(json_writer *const w, const char *const key,
+        const signed char pitch, const gregorio_score *const score)
+{
+    if (pitch >= LOWEST_PITCH && pitch <= score->highest_pitch) {
+        char letter[2];
+        letter[0] = (char)(pitch + 'a' - LOWEST_PITCH);
+        if (letter[0] == 'o') {
+            letter[0] = 'p';
+        }
+        letter[1] = '\0';
+        put_name(w, key, letter);
+    } else {
+        /* not reachable unless there's a programming error */
+        put_int(w, key, pitch); /* LCOV_EXCL_LINE */
+    }
+}
+
+/* writes a character of a syllable text as UTF-8, escaped */
+static void put_grewchar(json_writer *const w, const grewchar c)
+{
+    unsigned char buf[4];
+    size_t length;
+    if (c < 0x80) {
+        char ascii[2];
+        ascii[0] = (char)c;
+        ascii[1] = '\0';
+        if (c) {
+            put_escaped(w, ascii);
+        }
+        return;
+    }
+    if (c <= 0x7FF) {
+        buf[0] = (unsigned char)(0xC0 | (c >> 6));
+        buf[1] = (unsigned char)(0x80 | (c & 0x3F));
+        length = 2;
+    } else if (c <= 0xFFFF) {
+        if (c >= 0xD800 && c <= 0xDFFF) {
+            /* a lone surrogate can't be written */
+            return;
+        }
+        buf[0] = (unsigned char)(0xE0 | (c >> 12));
+        buf[1] = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+        buf[2] = (unsigned char)(0x80 | (c & 0x3F));
+        length = 3;
+    } else if (c <= 0x10FFFF) {
+        buf[0] = (unsigned char)(0xF0 | (c >> 18));
+        buf[1] = (unsigned char)(0x80 | ((c >> 12) & 0x3F));
+        buf[2] = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+        buf[3] = (unsigned char)(0x80 | (c & 0x3F));
+        length = 4;
+    } else {
+        return;
+    }
+    fwrite(buf, 1, length, w->f);
+}
+
+/* writes the text of a syllable twice: without its styles under key, and with
+ * them under runs_key */
+static void put_text(json_writer *const w, const char *const key,
+        const char *const runs_key, const gregorio_character *const text)
+{
+    const gregorio_character *character;
+    bool in_chars = false;
+
+    put_key(w, key);
+    putc('"', w->f);
+    for (character = text; character;
+            character = character->next_character) {
+        if (character->is_character) {
+            put_grewchar(w, character->cos.character);
+        }
+    }
+    putc('"', w->f);
+
+    begin_array(w, runs_key);
+    for (character = text; character;
+            character = character->next_character) {
+        if (character->is_character) {
+            if (!in_chars) {
+                begin_object(w, NULL);
+                put_key(w, "chars");
+                putc('"', w->f);
+                in_chars = true;
+            }
+            put_grewchar(w, character->cos.character);
+            continue;
+        }
+        if (in_chars) {
+            putc('"', w->f);
+            end_object(w);
+            in_chars = false;
+        }
+        begin_object(w, NULL);
+        put_name(w, character->cos.s.type == ST_T_BEGIN ? "begin" : "end",
+                grestyle_style_to_string(character->cos.s.style));
+        end_object(w);
+    }
+    if (in_chars) {
+        putc('"', w->f);
+        end_object(w);
+    }
+    end_array(w);
+}
+
+static void put_clef(json_writer *const w, const char *const key,
+        const gregorio_clef_info *const clef)
+{
+    char name[2];
+    name[1] = '\0';
+    begin_object(w, key);
+    name[0] = gregorio_clef_to_char(clef->clef);
+    put_name(w, "clef", name);
+    put_int(w, "line", clef->line);
+    if (clef->flatted) {
+        put_true(w, "flatted");
+    }
+    if (clef->secondary_line) {
+        begin_object(w, "secondary");
+        name[0] = gregorio_clef_to_char(clef->secondary_clef);
+        put_name(w, "clef", name);
+        put_int(w, "line", clef->secondary_line);
+        if (clef->secondary_flatted) {
+            put_true(w, "flatted");
+        }
+        end_object(w);
+    }
+    end_object(w);
+}
+
+static void put_space(json_writer *const w,
+        const gregorio_extra_info *const info)
+{
+    put_name(w, "space", gregorio_space_to_string(info->space));
+    if (info->ad_hoc_space_factor) {
+        put_string(w, "factor", info->ad_hoc_space_factor);
+    }
+}
+
+static void put_texverb(json_writer *const w, const unsigned short texverb)
+{
+    const char *const tex = gregorio_texverb(texverb);
+    if (tex) {
+        put_string(w, "tex", tex);
+    }
+}
+
+static void put_note(json_writer *const w, const gregorio_note *const note,
+        const gregorio_score *const score)
+{
+    begin_object(w, NULL);
+    put_name(w, "type", gregorio_type_to_string(note->type));
+    put_int(w, "line", note->src_line);
+    put_int(w, "column", note->src_column);
+    if (note->type == GRE_NOTE) {
+        put_pitch(w, "pitch", note->u.note.pitch, score);
+        put_name(w, "shape", gregorio_shape_to_string(note->u.note.shape));
+        put_name(w, "signs", gregorio_sign_to_string(note->signs));
+        if (note->special_sign) {
+            put_name(w, "special_sign",
+                    gregorio_sign_to_string(note->special_sign));
+        }
+        if (note->u.note.liquescentia) {
+            put_name(w, "liquescentia",
+                    gregorio_liquescentia_to_string(
+                        note->u.note.liquescentia));
+        }
+        if (note->u.note.is_cavum) {
+            put_true(w, "is_cavum");
+        }
+        if (note->h_episema_above != HEPISEMA_NONE) {
+            put_name(w, "h_episema_above",
+                    grehepisema_size_to_string(note->h_episema_above_size));
+        }
+        if (note->h_episema_below != HEPISEMA_NONE) {
+            put_name(w, "h_episema_below",
+                    grehepisema_size_to_string(note->h_episema_below_size));
+        }
+        if (note->high_ledger_line) {
+            put_true(w, "high_ledger_line");
+        }
+        if (note->low_ledger_line) {
+            put_true(w, "low_ledger_line");
+        }
+    }
+    if (note->choral_sign) {
+        put_string(w, "choral_sign", note->choral_sign);
+    }
+    if (note->shape_hint) {
+        put_string(w, "shape_hint", note->shape_hint);
+    }
+    put_texverb(w, note->texverb);
+    end_object(w);
+}
+
+static void put_glyph(json_writer *const w, const gregorio_glyph *const glyph,
+        const gregorio_score *const score)
+{
+    const gregorio_note *note;
+    const char *name;
+    gtex_alignment alignment;
+    gtex_type type;
+
+    begin_object(w, NULL);
+    put_name(w, "type", gregorio_type_to_string(glyph->type));
+    switch (glyph->type) {
+    case GRE_GLYPH:
+        put_name(w, "glyph_type",
+                gregorio_glyph_type_to_string(glyph->u.notes.glyph_type));
+        name = gregoriotex_fused_glyph_name(glyph, &alignment, &type);
+        if (name && *name) {
+            put_string(w, "name", name);
+        }
+        if (glyph->u.notes.liquescentia) {
+            put_name(w, "liquescentia", gregorio_liquescentia_to_string(
+                        glyph->u.notes.liquescentia));
+        }
+        if (glyph->u.notes.is_cavum) {
+            put_true(w, "is_cavum");
+        }
+        begin_array(w, "notes");
+        for (note = glyph->u.notes.first_note; note; note = note->next) {
+            put_note(w, note, score);
+        }
+        end_array(w);
+        break;
+    case GRE_SPACE:
+        put_space(w, &glyph->u.misc.unpitched.info);
+        break;
+    default:
+        break;
+    }
+    put_texverb(w, glyph->texverb);
+    end_object(w);
+}
+
+static void put_element(json_writer *const w,
+        const gregorio_element *const element,
+        const gregorio_score *const score)
+{
+    const gregorio_extra_info *const info = &element->u.misc.unpitched.info;
+    const gregorio_glyph *glyph;
+    size_t i;
+
+    begin_object(w, NULL);
+    put_name(w, "type", gregorio_type_to_string(element->type));
+    switch (element->type) {
+    case GRE_ELEMENT:
+        begin_array(w, "glyphs");
+        for (glyph = element->u.first_glyph; glyph; glyph = glyph->next) {
+            put_glyph(w, glyph, score);
+        }
+        end_array(w);
+        break;
+    case GRE_BAR:
+        put_name(w, "bar", gregorio_bar_to_string(info->bar));
+        if (element->u.misc.unpitched.special_sign) {
+            put_name(w, "special_sign", gregorio_sign_to_string(
+                        element->u.misc.unpitched.special_sign));
+        }
+        break;
+    case GRE_CLEF:
+        put_clef(w, "clef", &element->u.misc.clef);
+        break;
+    case GRE_CUSTOS:
+        put_pitch(w, "pitch", element->u.misc.pitched.pitch, score);
+        if (element->u.misc.pitched.force_pitch) {
+            put_true(w, "force_pitch");
+        }
+        break;
+    case GRE_SPACE:
+        put_space(w, info);
+        break;
+    case GRE_NLBA:
+        put_name(w, "nlba", gregorio_nlba_to_string(info->nlba));
+        break;
+    case GRE_END_OF_LINE:
+        if (info->eol_ragged) {
+            put_true(w, "ragged");
+        }
+        if (info->eol_forces_custos) {
+            put_key(w, "forces_custos");
+            put_raw(w, info->eol_forces_custos_on ? "true" : "false");
+        }
+        break;
+    default:
+        break;
+    }
+    put_texverb(w, element->texverb);
+    if (element->nabc_lines && element->nabc) {
+        begin_array(w, "nabc");
+        for (i = 0; i < element->nabc_lines; ++i) {
+            if (element->nabc[i]) {
+                put_string(w, NULL, element->nabc[i]);
+            } else {
+                put_key(w, NULL);
+                put_raw(w, "null");
+            }
+        }
+        end_array(w);
+    }
+    end_object(w);
+}
+
+static void put_syllable(json_writer *const w,
+        const gregorio_syllable *const syllable,
+        const gregorio_score *const score)
+{
+    const gregorio_element *element;
+    int voice;
+
+    begin_object(w, NULL);
+    put_int(w, "line", syllable->src_line);
+    put_int(w, "column", syllable->src_column);
+    put_name(w, "position",
+            gregorio_word_position_to_string(syllable->position));
+    if (syllable->first_word) {
+        put_true(w, "first_word");
+    }
+    if (syllable->euouae != EUOUAE_NORMAL) {
+        put_name(w, "euouae", gregorio_euouae_to_string(syllable->euouae));
+    }
+    if (syllable->no_linebreak_area != NLBA_NORMAL) {
+        put_name(w, "no_linebreak_area",
+                gregorio_nlba_to_string(syllable->no_linebreak_area));
+    }
+    if (syllable->clear) {
+        put_true(w, "clear");
+    }
+    if (syllable->forced_center) {
+        put_true(w, "forced_center");
+    }
+    if (syllable->text) {
+        put_text(w, "text", "text_runs", syllable->text);
+    }
+    if (syllable->translation) {
+        put_text(w, "translation", "translation_runs", syllable->translation);
+    }
+    if (syllable->translation_type != TR_NORMAL) {
+        put_name(w, "translation_type",
+                gregorio_tr_centering_to_string(syllable->translation_type));
+    }
+    if (syllable->abovelinestext) {
+        put_string(w, "abovelinestext", syllable->abovelinestext);
+    }
+    begin_array(w, "elements");
+    for (element = syllable->elements[0]; element; element = element->next) {
+        put_element(w, element, score);
+    }
+    end_array(w);
+    if (score->number_of_voices > 1) {
+        begin_array(w, "other_voices");
+        for (voice = 1; voice < score->number_of_voices; ++voice) {
+            begin_array(w, NULL);
+            for (element = syllable->elements[voice]; element;
+                    element = element->next) {
+                put_element(w, element, score);
+            }
+            end_array(w);
+        }
+        end_array(w);
+    }
+    end_object(w);
+}
+
+static void put_digest(json_writer *const w,
+        const gregorio_score *const score)
+{
+    static const char *const hex = "0123456789abcdef";
+    char digest[2 * SHA1_DIGEST_SIZE + 6];
+    char *p = digest;
+    int size = SHA1_DIGEST_SIZE, i;
+
+    if (score->digest_algorithm == DIGEST_XXH3) {
+        strcpy(p, "xxh3-");
+        p += 5;
+        size = XXH3_128_DIGEST_SIZE;
+    }
+    for (i = 0; i < size; ++i) {
+        *(p++) = hex[score->digest[i] >> 4];
+        *(p++) = hex[score->digest[i] & 0x0F];
+    }
+    *p = '\0';
+    put_name(w, "digest", digest);
+}
+
+void json_write_score(FILE *const f, gregorio_score *const score)
+{
+    json_writer writer;
+    json_writer *const w = &writer;
+    const gregorio_header *header;
+    const gregorio_voice_info *voice_info;
+    const gregorio_syllable *syllable;
+
+    gregorio_assert(f, json_write_score, "call with NULL file", return);
+
+    writer.f = f;
+    writer.depth = 0;
+    writer.empty[0] = true;
+
+    begin_object(w, NULL);
+    put_int(w, "format_version", JSON_FORMAT_VERSION);
+    put_string(w, "gregorio", GREGORIO_VERSION);
+    put_digest(w, score);
+    put_int(w, "number_of_voices", score->number_of_voices);
+    put_int(w, "staff_lines", score->staff_lines);
+    put_int(w, "nabc_lines", (long)score->nabc_lines);
+    if (score->legacy_oriscus_orientation) {
+        put_true(w, "legacy_oriscus_orientation");
+    }
+
+    begin_array(w, "headers");
+    for (header = score->headers; header; header = header->next) {
+        begin_object(w, NULL);
+        put_string(w, "name", header->name);
+        put_string(w, "value", header->value ? header->value : "");
+        end_object(w);
+    }
+    end_array(w);
+
+    begin_array(w, "voices");
+    for (voice_info = score->first_voice_info; voice_info;
+            voice_info = voice_info->next_voice_info) {
+        begin_object(w, NULL);
+        put_clef(w, "initial_clef", &voice_info->initial_clef);
+        end_object(w);
+    }
+    end_array(w);
+
+    begin_array(w, "syllables");
+    for (syllable = score->first_syllable; syllable;
+            syllable = syllable->next_syllable) {
+        put_syllable(w, syllable, score);
+    }
+    end_array(w);
+    end_object(w);
+    putc('\n', f);
+}
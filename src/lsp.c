@@ -0,0 +1,1287 @@
+/*
+ * Gregorio is a program that translates gabc files to GregorioTeX
+ * This file implements the language server of gregorio --lsp.
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * Gregorio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Gregorio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gregorio.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * gregorio --lsp speaks the Language Server Protocol on its standard input and
+ * output, for the editors.  Each open document is kept as a gabc session (see
+ * gabc-incremental.c), so that a change only parses again the words around it.
+ * The messages of a parse are published as diagnostics, with the location the
+ * parser was reading when they were reported, and a hover on a note tells its
+ * glyph as gregorio determined it.
+ *
+ * The server implements the lifecycle messages, textDocument/didOpen,
+ * didChange (full or incremental), didClose and hover.  Positions are in
+ * UTF-16 code units, the default encoding of the protocol.
+ *
+ * A client which initializes the server with {"preview":true} in its
+ * initializationOptions also gets a gregorio/preview notification after each
+ * opening and change of a document, with the uri of the document and the
+ * GregorioTeX of the score in gtex.  After a change parsed incrementally, gtex
+ * only holds the syllables from the word before the change to the word after
+ * it, each starting on a line starting with \GreSyllable (or one of its
+ * variants) or \GreBarSyllable, and the notification has first, the index
+ * from 0 of the first of them, and replaced, the number of syllables of the
+ * previous preview they replace from there.  A notification without first
+ * holds the whole score.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bool.h"
+#include "struct.h"
+#include "messages.h"
+#include "support.h"
+#include "plugins.h"
+#include "gabc/gabc.h"
+#include "gregoriotex/gregoriotex.h"
+#include "lsp.h"
+
+/* nesting limit of the JSON messages */
+#define MAX_JSON_DEPTH 64
+/* size limit of the messages, far above any gabc document */
+#define MAX_MESSAGE_LENGTH (64ul << 20)
+
+typedef enum json_type {
+    JSON_NULL,
+    JSON_FALSE,
+    JSON_TRUE,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+} json_type;
+
+typedef struct json_value {
+    json_type type;
+    /* the key of a member of an object */
+    char *key;
+    /* the text of a number or the decoded string, NUL-terminated */
+    char *text;
+    size_t length;
+    /* the elements of an array or the members of an object */
+    struct json_value *first, *next;
+} json_value;
+
+typedef struct json_parser {
+    const char *p, *end;
+    int depth;
+} json_parser;
+
+/* a growing output buffer */
+typedef struct lsp_buffer {
+    char *text;
+    size_t length, capacity;
+} lsp_buffer;
+
+typedef struct lsp_diagnostic {
+    /* the bytes of the text it applies to */
+    size_t start, end;
+    gregorio_verbosity verbosity;
+    char *message;
+} lsp_diagnostic;
+
+typedef struct lsp_document {
+    char *uri;
+    gabc_session *session;
+    /* the byte offset of the start of each line */
+    size_t *lines;
+    size_t line_count, line_capacity;
+    lsp_diagnostic *diagnostics;
+    size_t diagnostic_count, diagnostic_capacity;
+    /* what the last preview was written with */
+    gregoriotex_opening opening;
+    size_t syllable_count;
+    struct lsp_document *next;
+} lsp_document;
+
+/* a message reported by a parse, with the location the parser was at */
+typedef struct lsp_message {
+    gregorio_verbosity verbosity;
+    bool located;
+    unsigned short first_line, first_offset, last_line, last_offset;
+    char *message;
+} lsp_message;
+
+typedef struct lsp_server {
+    FILE *out;
+    lsp_buffer buffer;
+    lsp_document *documents;
+    lsp_message *messages;
+    size_t message_count, message_capacity;
+    bool preview;
+    bool shutdown;
+} lsp_server;
+
+static __inline bool is_continuation_byte(const char c)
+{
+    return ((unsigned char)c & 0xc0u) == 0x80u;
+}
+
+/* JSON */
+
+static void json_free(json_value *value)
+{
+    while (value) {
+        json_value *const next = value->next;
+        json_free(value->first);
+        free(value->key);
+        free(value->text);
+        free(value);
+        value = next;
+    }
+}
+
+static void skip_space(json_parser *const parser)
+{
+    while (parser->p < parser->end && (*parser->p == ' '
+                || *parser->p == '\t' || *parser->p == '\n'
+                || *parser->p == '\r')) {
+        ++parser->p;
+    }
+}
+
+static int hex_value(const char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/* reads the 4 hexadecimal digits of a \u escape, or returns -1 */
+static long parse_hex4(json_parser *const parser)
+{
+    long value = 0;
+    int i;
+
+    if (parser->end - parser->p < 4) {
+        return -1;
+    }
+    for (i = 0; i < 4; ++i) {
+        const int digit = hex_value(*parser->p++);
+        if (digit < 0) {
+            return -1;
+        }
+        value = (value << 4) | digit;
+    }
+    return value;
+}
+
+static void append_utf8(char *const out, size_t *const length,
+        const unsigned long code)
+{
+    if (code < 0x80) {
+        out[(*length)++] = (char)code;
+    } else if (code < 0x800) {
+        out[(*length)++] = (char)(0xc0 | (code >> 6));
+        out[(*length)++] = (char)(0x80 | (code & 0x3f));
+    } else if (code < 0x10000) {
+        out[(*length)++] = (char)(0xe0 | (code >> 12));
+        out[(*length)++] = (char)(0x80 | ((code >> 6) & 0x3f));
+        out[(*length)++] = (char)(0x80 | (code & 0x3f));
+    } else {
+        out[(*length)++] = (char)(0xf0 | (code >> 18));
+        out[(*length)++] = (char)(0x80 | ((code >> 12) & 0x3f));
+        out[(*length)++] = (char)(0x80 | ((code >> 6) & 0x3f));
+        out[(*length)++] = (char)(0x80 | (code & 0x3f));
+    }
+}
+
+/* parses a string, the parser being after its opening quote */
+static char *parse_string(json_parser *const parser, size_t *const length)
+{
+    const char *p, *const end = parser->end;
+    char *out;
+
+    /* the decoded string is not longer than the escaped one */
+    for (p = parser->p; p < parser->end && *p != '"'; ++p) {
+        if (*p == '\\') {
+            ++p;
+        }
+    }
+    if (p >= parser->end) {
+        return NULL;
+    }
+    out = gregorio_malloc(p - parser->p + 1);
+    *length = 0;
+    /* the escapes must not read past the closing quote */
+    parser->end = p;
+    while (parser->p < parser->end) {
+        char c = *parser->p++;
+        long code, low;
+        if (c != '\\') {
+            out[(*length)++] = c;
+            continue;
+        }
+        switch (c = *parser->p++) {
+        case 'b':
+            out[(*length)++] = '\b';
+            break;
+        case 'f':
+            out[(*length)++] = '\f';
+            break;
+        case 'n':
+            out[(*length)++] = '\n';
+            break;
+        case 'r':
+            out[(*length)++] = '\r';
+            break;
+        case 't':
+            out[(*length)++] = '\t';
+            break;
+        case 'u':
+            code = parse_hex4(parser);
+            if (code < 0) {
+                parser->end = end;
+                free(out);
+                return NULL;
+            }
+            if (code >= 0xd800 && code < 0xdc00 && parser->end - parser->p >= 6
+                    && parser->p[0] == '\\' && parser->p[1] == 'u') {
+                const char *const mark = parser->p;
+                parser->p += 2;
+                low = parse_hex4(parser);
+                if (low >= 0xdc00 && low < 0xe000) {
+                    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                } else {
+                    parser->p = mark;
+                }
+            }
+            if (code >= 0xd800 && code < 0xe000) {
+                /* a lone surrogate */
+                code = 0xfffd;
+            }
+            append_utf8(out, length, (unsigned long)code);
+            break;
+        default:
+            /* ", \ and / stand for themselves */
+            out[(*length)++] = c;
+            break;
+        }
+    }
+    parser->end = end;
+    ++parser->p;
+    out[*length] = '\0';
+    return out;
+}
+
+static bool parse_literal(json_parser *const parser, const char *const literal)
+{
+    const size_t length = strlen(literal);
+
+    if ((size_t)(parser->end - parser->p) < length
+            || strncmp(parser->p, literal, length) != 0) {
+        return false;
+    }
+    parser->p += length;
+    return true;
+}
+
+static json_value *parse_value(json_parser *const parser)
+{
+    json_value *const value = gregorio_calloc(1, sizeof(json_value));
+    json_value **last = &value->first;
+    const char *start;
+
+    skip_space(parser);
+    if (parser->p >= parser->end || ++parser->depth > MAX_JSON_DEPTH) {
+        free(value);
+        return NULL;
+    }
+    switch (*parser->p) {
+    case '{':
+    case '[':
+        value->type = *parser->p == '{'? JSON_OBJECT : JSON_ARRAY;
+        ++parser->p;
+        skip_space(parser);
+        if (parser->p < parser->end
+                && *parser->p == (value->type == JSON_OBJECT? '}' : ']')) {
+            ++parser->p;
+            break;
+        }
+        for (;;) {
+            char *key = NULL;
+            size_t key_length;
+            if (value->type == JSON_OBJECT) {
+                skip_space(parser);
+                if (parser->p >= parser->end || *parser->p != '"') {
+                    json_free(value);
+                    return NULL;
+                }
+                ++parser->p;
+                key = parse_string(parser, &key_length);
+                skip_space(parser);
+                if (!key || parser->p >= parser->end || *parser->p != ':') {
+                    free(key);
+                    json_free(value);
+                    return NULL;
+                }
+                ++parser->p;
+            }
+            *last = parse_value(parser);
+            if (!*last) {
+                free(key);
+                json_free(value);
+                return NULL;
+            }
+            (*last)->key = key;
+            last = &(*last)->next;
+            skip_space(parser);
+            if (parser->p < parser->end && *parser->p == ',') {
+                ++parser->p;
+                continue;
+            }
+            if (parser->p < parser->end && *parser->p
+                    == (value->type == JSON_OBJECT? '}' : ']')) {
+                ++parser->p;
+                break;
+            }
+            json_free(value);
+            return NULL;
+        }
+        break;
+    case '"':
+        value->type = JSON_STRING;
+        ++parser->p;
+        value->text = parse_string(parser, &value->length);
+        if (!value->text) {
+            free(value);
+            return NULL;
+        }
+        break;
+    case 't':
+        value->type = JSON_TRUE;
+        if (!parse_literal(parser, "true")) {
+            free(value);
+            return NULL;
+        }
+        break;
+    case 'f':
+        value->type = JSON_FALSE;
+        if (!parse_literal(parser, "false")) {
+            free(value);
+            return NULL;
+        }
+        break;
+    case 'n':
+        value->type = JSON_NULL;
+        if (!parse_literal(parser, "null")) {
+            free(value);
+            return NULL;
+        }
+        break;
+    default:
+        value->type = JSON_NUMBER;
+        for (start = parser->p; parser->p < parser->end
+                && strchr("+-.eE0123456789", *parser->p); ++parser->p) {
+        }
+        if (parser->p == start) {
+            free(value);
+            return NULL;
+        }
+        value->length = parser->p - start;
+        value->text = gregorio_malloc(value->length + 1);
+        memcpy(value->text, start, value->length);
+        value->text[value->length] = '\0';
+        break;
+    }
+    --parser->depth;
+    return value;
+}
+
+static json_value *json_parse(const char *const text, const size_t length)
+{
+    json_parser parser;
+
+    parser.p = text;
+    parser.end = text + length;
+    parser.depth = 0;
+    return parse_value(&parser);
+}
+
+static const json_value *json_get(const json_value *const object,
+        const char *const key)
+{
+    const json_value *member;
+
+    if (!object || object->type != JSON_OBJECT) {
+        return NULL;
+    }
+    for (member = object->first; member; member = member->next) {
+        if (strcmp(member->key, key) == 0) {
+            return member;
+        }
+    }
+    return NULL;
+}
+
+static const char *json_string(const json_value *const value)
+{
+    return value && value->type == JSON_STRING? value->text : NULL;
+}
+
+static size_t json_size(const json_value *const value)
+{
+    long number;
+
+    if (!value || value->type != JSON_NUMBER) {
+        return 0;
+    }
+    number = strtol(value->text, NULL, 10);
+    return number > 0? (size_t)number : 0;
+}
+
+/* output */
+
+static void buffer_append(lsp_buffer *const buffer, const char *const text,
+        const size_t length)
+{
+    if (buffer->length + length + 1 > buffer->capacity) {
+        while (buffer->length + length + 1 > buffer->capacity) {
+            buffer->capacity = buffer->capacity? buffer->capacity * 2 : 1024;
+        }
+        buffer->text = gregorio_realloc(buffer->text, buffer->capacity);
+    }
+    memcpy(buffer->text + buffer->length, text, length);
+    buffer->length += length;
+}
+
+static void buffer_puts(lsp_buffer *const buffer, const char *const text)
+{
+    buffer_append(buffer, text, strlen(text));
+}
+
+static void buffer_size(lsp_buffer *const buffer, const size_t number)
+{
+    char text[24];
+
+    gregorio_snprintf(text, sizeof text, "%lu", (unsigned long)number);
+    buffer_puts(buffer, text);
+}
+
+static void buffer_string(lsp_buffer *const buffer, const char *text)
+{
+    static const char *const hex = "0123456789abcdef";
+    const char *plain;
+
+    buffer_append(buffer, "\"", 1);
+    for (plain = text; *text; ++text) {
+        const unsigned char c = (unsigned char)*text;
+        if (c == '"' || c == '\\' || c < 0x20) {
+            char escape[6] = { '\\', 'u', '0', '0', 0, 0 };
+            buffer_append(buffer, plain, text - plain);
+            switch (c) {
+            case '"':
+            case '\\':
+                escape[1] = (char)c;
+                buffer_append(buffer, escape, 2);
+                break;
+            case '\n':
+                buffer_append(buffer, "\\n", 2);
+                break;
+            case '\t':
+                buffer_append(buffer, "\\t", 2);
+                break;
+            default:
+                escape[4] = hex[c >> 4];
+                escape[5] = hex[c & 0xf];
+                buffer_append(buffer, escape, 6);
+                break;
+            }
+            plain = text + 1;
+        }
+    }
+    buffer_append(buffer, plain, text - plain);
+    buffer_append(buffer, "\"", 1);
+}
+
+/* writes a JSON value back, for the identifiers of the requests */
+static void buffer_value(lsp_buffer *const buffer,
+        const json_value *const value)
+{
+    if (!value) {
+        buffer_puts(buffer, "null");
+        return;
+    }
+    switch (value->type) {
+    case JSON_NUMBER:
+        buffer_puts(buffer, value->text);
+        break;
+    case JSON_STRING:
+        buffer_string(buffer, value->text);
+        break;
+    default:
+        buffer_puts(buffer, "null");
+        break;
+    }
+}
+
+static void send(lsp_server *const server)
+{
+    fprintf(server->out, "Content-Length: %lu\r\n\r\n",
+            (unsigned long)server->buffer.length);
+    fwrite(server->buffer.text, 1, server->buffer.length, server->out);
+    fflush(server->out);
+    server->buffer.length = 0;
+}
+
+static void start_response(lsp_server *const server, const json_value *const id)
+{
+    buffer_puts(&server->buffer, "{\"jsonrpc\":\"2.0\",\"id\":");
+    buffer_value(&server->buffer, id);
+}
+
+static void send_error(lsp_server *const server, const json_value *const id,
+        const int code, const char *const message)
+{
+    char text[16];
+
+    start_response(server, id);
+    gregorio_snprintf(text, sizeof text, "%d", code);
+    buffer_puts(&server->buffer, ",\"error\":{\"code\":");
+    buffer_puts(&server->buffer, text);
+    buffer_puts(&server->buffer, ",\"message\":");
+    buffer_string(&server->buffer, message);
+    buffer_puts(&server->buffer, "}}");
+    send(server);
+}
+
+/* documents */
+
+static void index_lines(lsp_document *const document)
+{
+    size_t length, i;
+    const char *const text = gabc_session_text(document->session, &length);
+
+    document->line_count = 0;
+    for (i = 0; i <= length; ++i) {
+        if (i == 0 || text[i - 1] == '\n') {
+            if (!document->lines
+                    || document->line_count >= document->line_capacity) {
+                document->lines = gregorio_grow_buffer(document->lines,
+                        &document->line_capacity, size_t);
+            }
+            document->lines[document->line_count++] = i;
+        }
+    }
+}
+
+/* the byte at a 1-based line and a character offset of the parser */
+static size_t byte_of_location(const lsp_document *const document,
+        const unsigned short line, unsigned short offset)
+{
+    size_t length, i;
+    const char *const text = gabc_session_text(document->session, &length);
+
+    if (line < 1) {
+        return 0;
+    }
+    if (line > document->line_count) {
+        return length;
+    }
+    for (i = document->lines[line - 1]; i < length && text[i] != '\n'; ++i) {
+        if (!is_continuation_byte(text[i])) {
+            if (!offset) {
+                break;
+            }
+            --offset;
+        }
+    }
+    return i;
+}
+
+/* the byte at a 0-based line and a character in UTF-16 code units */
+static size_t byte_of_position(const lsp_document *const document,
+        const size_t line, size_t character)
+{
+    size_t length, i;
+    const char *const text = gabc_session_text(document->session, &length);
+
+    if (line >= document->line_count) {
+        return length;
+    }
+    i = document->lines[line];
+    while (i < length && text[i] != '\n' && character > 0) {
+        /* a 4-byte sequence is a surrogate pair in UTF-16 */
+        character -= ((unsigned char)text[i] >= 0xf0 && character > 1)? 2 : 1;
+        for (++i; i < length && is_continuation_byte(text[i]); ++i) {
+        }
+    }
+    return i;
+}
+
+static void position_of_byte(const lsp_document *const document,
+        const size_t byte, size_t *const line, size_t *const character)
+{
+    size_t length, low = 0, high = document->line_count, i;
+    const char *const text = gabc_session_text(document->session, &length);
+
+    while (high - low > 1) {
+        const size_t middle = (low + high) / 2;
+        if (document->lines[middle] <= byte) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    *line = low;
+    *character = 0;
+    for (i = document->lines[low]; i < byte && i < length; ++i) {
+        if ((unsigned char)text[i] >= 0xf0) {
+            *character += 2;
+        } else if (!is_continuation_byte(text[i])) {
+            ++*character;
+        }
+    }
+}
+
+static void collect_message(void *const data,
+        const gregorio_verbosity verbosity, const char *const message)
+{
+    lsp_server *const server = (lsp_server *)data;
+    const gregorio_scanner_location *const location = gabc_current_location();
+    lsp_message *collected;
+
+    if (!server->messages
+            || server->message_count >= server->message_capacity) {
+        server->messages = gregorio_grow_buffer(server->messages,
+                &server->message_capacity, lsp_message);
+    }
+    collected = server->messages + server->message_count++;
+    memset(collected, 0, sizeof *collected);
+    collected->verbosity = verbosity;
+    collected->message = gregorio_strdup(message);
+    if (location) {
+        collected->located = true;
+        collected->first_line = location->first_line;
+        collected->first_offset = location->first_offset;
+        collected->last_line = location->last_line;
+        collected->last_offset = location->last_offset;
+    }
+}
+
+static void drop_messages(lsp_server *const server)
+{
+    size_t i;
+
+    for (i = 0; i < server->message_count; ++i) {
+        free(server->messages[i].message);
+    }
+    server->message_count = 0;
+}
+
+static void clear_diagnostics(lsp_document *const document)
+{
+    size_t i;
+
+    for (i = 0; i < document->diagnostic_count; ++i) {
+        free(document->diagnostics[i].message);
+    }
+    document->diagnostic_count = 0;
+}
+
+/* makes the messages of a parse of the whole document its diagnostics */
+static void take_messages(lsp_server *const server,
+        lsp_document *const document)
+{
+    size_t i;
+
+    clear_diagnostics(document);
+    for (i = 0; i < server->message_count; ++i) {
+        const lsp_message *const message = server->messages + i;
+        lsp_diagnostic *diagnostic;
+        if (!document->diagnostics || document->diagnostic_count
+                >= document->diagnostic_capacity) {
+            document->diagnostics = gregorio_grow_buffer(
+                    document->diagnostics, &document->diagnostic_capacity,
+                    lsp_diagnostic);
+        }
+        diagnostic = document->diagnostics + document->diagnostic_count++;
+        diagnostic->verbosity = message->verbosity;
+        diagnostic->message = message->message;
+        if (message->located) {
+            diagnostic->start = byte_of_location(document,
+                    message->first_line, message->first_offset);
+            diagnostic->end = byte_of_location(document, message->last_line,
+                    message->last_offset);
+            if (diagnostic->end < diagnostic->start) {
+                diagnostic->end = diagnostic->start;
+            }
+        } else {
+            diagnostic->start = diagnostic->end = 0;
+        }
+    }
+    server->message_count = 0;
+}
+
+/* after an edit parsed again from start to end, which was end - delta before
+ * it: the diagnostics of that part go, as it reported nothing, and those after
+ * it move */
+static void shift_diagnostics(lsp_document *const document,
+        const size_t start, const size_t end, const long delta)
+{
+    size_t i, kept = 0;
+
+    for (i = 0; i < document->diagnostic_count; ++i) {
+        lsp_diagnostic diagnostic = document->diagnostics[i];
+        if (diagnostic.start >= start
+                && (long)diagnostic.start < (long)end - delta) {
+            free(diagnostic.message);
+            continue;
+        }
+        if ((long)diagnostic.start >= (long)end - delta) {
+            diagnostic.start += delta;
+            diagnostic.end += delta;
+        } else if (diagnostic.end > start) {
+            diagnostic.end = start;
+        }
+        document->diagnostics[kept++] = diagnostic;
+    }
+    document->diagnostic_count = kept;
+}
+
+static int severity(const gregorio_verbosity verbosity)
+{
+    switch (verbosity) {
+    case VERBOSITY_INFO:
+        return 3;
+    case VERBOSITY_WARNING:
+    case VERBOSITY_DEPRECATION:
+        return 2;
+    default:
+        return 1;
+    }
+}
+
+static void buffer_position(lsp_buffer *const buffer,
+        const lsp_document *const document, const size_t byte)
+{
+    size_t line, character;
+
+    position_of_byte(document, byte, &line, &character);
+    buffer_puts(buffer, "{\"line\":");
+    buffer_size(buffer, line);
+    buffer_puts(buffer, ",\"character\":");
+    buffer_size(buffer, character);
+    buffer_puts(buffer, "}");
+}
+
+static void publish_diagnostics(lsp_server *const server,
+        const lsp_document *const document)
+{
+    lsp_buffer *const buffer = &server->buffer;
+    size_t i;
+
+    buffer_puts(buffer, "{\"jsonrpc\":\"2.0\","
+            "\"method\":\"textDocument/publishDiagnostics\","
+            "\"params\":{\"uri\":");
+    buffer_string(buffer, document->uri);
+    buffer_puts(buffer, ",\"diagnostics\":[");
+    for (i = 0; i < document->diagnostic_count; ++i) {
+        const lsp_diagnostic *const diagnostic = document->diagnostics + i;
+        if (i) {
+            buffer_puts(buffer, ",");
+        }
+        buffer_puts(buffer, "{\"range\":{\"start\":");
+        buffer_position(buffer, document, diagnostic->start);
+        buffer_puts(buffer, ",\"end\":");
+        buffer_position(buffer, document, diagnostic->end);
+        buffer_puts(buffer, "},\"severity\":");
+        buffer_size(buffer, severity(diagnostic->verbosity));
+        buffer_puts(buffer, ",\"source\":\"gregorio\",\"message\":");
+        buffer_string(buffer, diagnostic->message);
+        buffer_puts(buffer, "}");
+    }
+    buffer_puts(buffer, "]}}");
+    send(server);
+}
+
+static lsp_document *find_document(lsp_server *const server,
+        const char *const uri)
+{
+    lsp_document *document;
+
+    for (document = server->documents; document; document = document->next) {
+        if (strcmp(document->uri, uri) == 0) {
+            return document;
+        }
+    }
+    return NULL;
+}
+
+/* reads back what was written to a temporary file, NUL-terminated */
+static char *read_back(FILE *const f)
+{
+    const long length = ftell(f);
+    char *text;
+
+    if (length < 0 || fflush(f) || fseek(f, 0, SEEK_SET)) {
+        return NULL;
+    }
+    text = (char *)gregorio_malloc(length + 1);
+    if (fread(text, 1, length, f) != (size_t)length) {
+        free(text);
+        return NULL;
+    }
+    text[length] = '\0';
+    return text;
+}
+
+/* sends the GregorioTeX of the syllables from first to last if the writer can
+ * write them alone, or else of the whole score */
+static void send_preview(lsp_server *const server,
+        lsp_document *const document, gregorio_syllable *first,
+        const gregorio_syllable *last)
+{
+    gregorio_score *score = gabc_session_score(document->session);
+    lsp_buffer *const buffer = &server->buffer;
+    const gregorio_syllable *syllable;
+    size_t syllables = 0, index = 0, count = 0;
+    bool partial;
+    char *gtex;
+    FILE *f;
+
+    if (!score) {
+        memset(&document->opening, 0, sizeof document->opening);
+        document->syllable_count = 0;
+        return;
+    }
+    if (!(f = tmpfile())) {
+        return;
+    }
+    partial = first && gregoriotex_write_syllables(f, score, first, last,
+            false, &document->opening);
+    if (!partial && first) {
+        /* the writer has positioned the notes of the other syllables in
+         * place, which it does not do twice */
+        gabc_session_reparse(document->session);
+        score = gabc_session_score(document->session);
+        first = NULL;
+        last = NULL;
+    }
+    if (!partial) {
+        gregoriotex_write_score(f, score, NULL);
+        /* keeps the opening for the next preview */
+        gregoriotex_write_syllables(f, score, NULL, NULL, false,
+                &document->opening);
+    }
+    gtex = read_back(f);
+    fclose(f);
+    /* the writer reports nothing the parse did not */
+    drop_messages(server);
+    if (!gtex) {
+        return;
+    }
+
+    for (syllable = score->first_syllable; syllable;
+            syllable = syllable->next_syllable) {
+        if (syllable == first) {
+            index = syllables;
+        }
+        ++syllables;
+        if (syllable == last) {
+            count = syllables - index;
+        }
+    }
+    buffer_puts(buffer, "{\"jsonrpc\":\"2.0\","
+            "\"method\":\"gregorio/preview\",\"params\":{\"uri\":");
+    buffer_string(buffer, document->uri);
+    if (partial) {
+        buffer_puts(buffer, ",\"first\":");
+        buffer_size(buffer, index);
+        buffer_puts(buffer, ",\"replaced\":");
+        buffer_size(buffer, count + document->syllable_count - syllables);
+    }
+    buffer_puts(buffer, ",\"gtex\":");
+    buffer_string(buffer, gtex);
+    buffer_puts(buffer, "}}");
+    send(server);
+    free(gtex);
+    document->syllable_count = syllables;
+}
+
+static void close_document(lsp_server *const server, const char *const uri)
+{
+    lsp_document **link, *document;
+
+    for (link = &server->documents; *link; link = &(*link)->next) {
+        if (strcmp((*link)->uri, uri) == 0) {
+            document = *link;
+            *link = document->next;
+            clear_diagnostics(document);
+            free(document->diagnostics);
+            free(document->lines);
+            gabc_session_free(document->session);
+            free(document->uri);
+            free(document);
+            return;
+        }
+    }
+}
+
+static void open_document(lsp_server *const server, const char *const uri,
+        const char *const text, const size_t length)
+{
+    gabc_session *session;
+    lsp_document *document;
+
+    close_document(server, uri);
+    session = gabc_session_new(text, length, false, DIGEST_XXH3);
+    if (!session) {
+        drop_messages(server);
+        return;
+    }
+    document = gregorio_calloc(1, sizeof(lsp_document));
+    document->uri = gregorio_strdup(uri);
+    document->session = session;
+    document->line_capacity = 64;
+    document->diagnostic_capacity = 8;
+    document->next = server->documents;
+    server->documents = document;
+    index_lines(document);
+    take_messages(server, document);
+    publish_diagnostics(server, document);
+    if (server->preview) {
+        send_preview(server, document, NULL, NULL);
+    }
+}
+
+static void change_document(lsp_server *const server,
+        lsp_document *const document, const json_value *const change)
+{
+    const json_value *const range = json_get(change, "range");
+    const json_value *const text = json_get(change, "text");
+    size_t start, end, changed_start, changed_end;
+    gregorio_syllable *first, *last;
+    long delta;
+
+    if (!text || text->type != JSON_STRING) {
+        return;
+    }
+    if (range) {
+        const json_value *const from = json_get(range, "start");
+        const json_value *const to = json_get(range, "end");
+        start = byte_of_position(document,
+                json_size(json_get(from, "line")),
+                json_size(json_get(from, "character")));
+        end = byte_of_position(document, json_size(json_get(to, "line")),
+                json_size(json_get(to, "character")));
+        if (end < start) {
+            end = start;
+        }
+    } else {
+        start = 0;
+        gabc_session_text(document->session, &end);
+    }
+    delta = (long)text->length - (long)(end - start);
+    if (gabc_session_edit(document->session, start, end, text->text,
+                text->length, &first, &last)) {
+        index_lines(document);
+        gabc_session_changed_range(document->session, &changed_start,
+                &changed_end);
+        shift_diagnostics(document, changed_start, changed_end, delta);
+        /* a window is parsed with its messages held */
+        drop_messages(server);
+        if (server->preview) {
+            send_preview(server, document, first, last);
+        }
+    } else {
+        index_lines(document);
+        take_messages(server, document);
+        if (server->preview) {
+            send_preview(server, document, NULL, NULL);
+        }
+    }
+}
+
+/* the note at the given byte, with its glyph and syllable */
+static const gregorio_note *find_note(const lsp_document *const document,
+        const size_t byte, const gregorio_glyph **const found_glyph,
+        gregorio_syllable **const found_syllable)
+{
+    const gregorio_score *const score = gabc_session_score(document->session);
+    const gregorio_note *found = NULL;
+    gregorio_syllable *syllable;
+    size_t line, offset, length, i;
+    const char *const text = gabc_session_text(document->session, &length);
+
+    if (!score) {
+        return NULL;
+    }
+    position_of_byte(document, byte, &line, &offset);
+    /* the parser counts characters, not UTF-16 code units */
+    offset = 0;
+    for (i = document->lines[line]; i < byte; ++i) {
+        if (!is_continuation_byte(text[i])) {
+            ++offset;
+        }
+    }
+    ++line;
+
+    for (syllable = score->first_syllable; syllable;
+            syllable = syllable->next_syllable) {
+        const gregorio_element *element;
+        for (element = syllable->elements[0]; element;
+                element = element->next) {
+            const gregorio_glyph *glyph;
+            if (element->type != GRE_ELEMENT) {
+                continue;
+            }
+            for (glyph = element->u.first_glyph; glyph; glyph = glyph->next) {
+                const gregorio_note *note;
+                if (glyph->type != GRE_GLYPH) {
+                    continue;
+                }
+                for (note = glyph->u.notes.first_note; note;
+                        note = note->next) {
+                    if (note->type == GRE_NOTE && note->src_line == line
+                            && note->src_offset <= offset) {
+                        found = note;
+                        *found_glyph = glyph;
+                        *found_syllable = syllable;
+                    }
+                }
+            }
+        }
+    }
+
+    if (found) {
+        /* the byte must be in the same group of notes */
+        for (i = byte_of_location(document, found->src_line,
+                    found->src_offset); i < byte; ++i) {
+            if (text[i] == ')' || text[i] == '(' || text[i] == ' ') {
+                return NULL;
+            }
+        }
+    }
+    return found;
+}
+
+static void hover(lsp_server *const server, const json_value *const id,
+        const json_value *const params)
+{
+    const lsp_document *const document = find_document(server,
+            json_string(json_get(json_get(params, "textDocument"), "uri")));
+    const json_value *const position = json_get(params, "position");
+    const gregorio_note *note = NULL;
+    const gregorio_glyph *glyph = NULL;
+    gregorio_syllable *syllable = NULL;
+    lsp_buffer *const buffer = &server->buffer;
+
+    if (document) {
+        note = find_note(document, byte_of_position(document,
+                    json_size(json_get(position, "line")),
+                    json_size(json_get(position, "character"))), &glyph,
+                &syllable);
+    }
+    start_response(server, id);
+    if (note) {
+        char text[256];
+        const char *name;
+        gtex_alignment alignment;
+        gtex_type type;
+        char pitch = note->u.note.pitch + 'a' - LOWEST_PITCH;
+        if (pitch == 'o') {
+            pitch = 'p';
+        }
+        name = gregoriotex_fused_glyph_name(glyph, &alignment, &type);
+        gregorio_snprintf(text, sizeof text,
+                "glyph: `%s`%s%s%s\n\nnote: `%s` on %c",
+                gregorio_glyph_type_to_string(glyph->u.notes.glyph_type),
+                name? " (GregorioTeX: `" : "", name? name : "",
+                name? "`)" : "", gregorio_shape_to_string(note->u.note.shape),
+                pitch);
+        buffer_puts(buffer, ",\"result\":{\"contents\":"
+                "{\"kind\":\"markdown\",\"value\":");
+        buffer_string(buffer, text);
+        buffer_puts(buffer, "}}}");
+    } else {
+        buffer_puts(buffer, ",\"result\":null}");
+    }
+    send(server);
+}
+
+static void initialize(lsp_server *const server, const json_value *const id,
+        const json_value *const params)
+{
+    const json_value *const preview =
+            json_get(json_get(params, "initializationOptions"), "preview");
+
+    server->preview = preview && preview->type == JSON_TRUE;
+    start_response(server, id);
+    buffer_puts(&server->buffer, ",\"result\":{\"capabilities\":{"
+            "\"positionEncoding\":\"utf-16\","
+            "\"textDocumentSync\":{\"openClose\":true,\"change\":2},"
+            "\"hoverProvider\":true},"
+            "\"serverInfo\":{\"name\":\"gregorio\",\"version\":\""
+            GREGORIO_VERSION "\"}}}");
+    send(server);
+}
+
+/* handles a message; returns false after the exit notification */
+static bool handle(lsp_server *const server, const json_value *const message)
+{
+    const char *const method = json_string(json_get(message, "method"));
+    const json_value *const id = json_get(message, "id");
+    const json_value *const params = json_get(message, "params");
+    const json_value *text_document = json_get(params, "textDocument");
+    const char *const uri = json_string(json_get(text_document, "uri"));
+
+    if (!method) {
+        /* a response, the server sends no request */
+        return true;
+    }
+    if (strcmp(method, "exit") == 0) {
+        return false;
+    }
+    if (strcmp(method, "initialize") == 0) {
+        initialize(server, id, params);
+    } else if (strcmp(method, "shutdown") == 0) {
+        server->shutdown = true;
+        start_response(server, id);
+        buffer_puts(&server->buffer, ",\"result\":null}");
+        send(server);
+    } else if (strcmp(method, "textDocument/didOpen") == 0) {
+        const json_value *const text = json_get(text_document, "text");
+        if (uri && text && text->type == JSON_STRING) {
+            open_document(server, uri, text->text, text->length);
+        }
+    } else if (strcmp(method, "textDocument/didChange") == 0) {
+        lsp_document *const document = uri? find_document(server, uri) : NULL;
+        const json_value *change;
+        if (document) {
+            const json_value *const changes =
+                    json_get(params, "contentChanges");
+            for (change = changes? changes->first : NULL; change;
+                    change = change->next) {
+                change_document(server, document, change);
+            }
+            publish_diagnostics(server, document);
+        }
+    } else if (strcmp(method, "textDocument/didClose") == 0) {
+        if (uri) {
+            close_document(server, uri);
+        }
+    } else if (strcmp(method, "textDocument/hover") == 0) {
+        hover(server, id, params);
+    } else if (id) {
+        /* an unknown request, as opposed to a notification */
+        send_error(server, id, -32601, "method not found");
+    }
+    return true;
+}
+
+/* reads the content of a message, or returns NULL at the end of the input;
+ * the content of a message longer than MAX_MESSAGE_LENGTH is skipped and
+ * *too_long set instead */
+static char *read_message(FILE *const in, size_t *const length,
+        bool *const too_long)
+{
+    static const char content_length[] = "Content-Length:";
+    char line[256];
+    bool has_length = false;
+    unsigned long value = 0;
+    size_t skipped;
+    char *content;
+
+    for (;;) {
+        if (!fgets(line, sizeof line, in)) {
+            return NULL;
+        }
+        if (line[0] == '\r' || line[0] == '\n') {
+            if (has_length) {
+                break;
+            }
+        } else if (strncmp(line, content_length, sizeof content_length - 1)
+                == 0) {
+            value = strtoul(line + sizeof content_length - 1, NULL, 10);
+            has_length = true;
+            *too_long = value > MAX_MESSAGE_LENGTH;
+            *length = (size_t)value;
+        }
+    }
+    if (*too_long) {
+        /* skips the content, to read the next message */
+        for (; value > 0; value -= skipped) {
+            skipped = fread(line, 1, value < sizeof line? value : sizeof line,
+                    in);
+            if (!skipped) {
+                return NULL;
+            }
+        }
+        *length = 0;
+        return gregorio_strdup("");
+    }
+    content = gregorio_malloc(*length + 1);
+    if (fread(content, 1, *length, in) != *length) {
+        free(content);
+        return NULL;
+    }
+    content[*length] = '\0';
+    return content;
+}
+
+/* serves until the exit notification or the end of the input; returns the
+ * exit code the protocol asks for */
+int gregorio_lsp(FILE *const in, FILE *const out)
+{
+    lsp_server server;
+    char *content;
+    size_t length;
+    bool running = true;
+    bool too_long = false;
+
+    memset(&server, 0, sizeof server);
+    server.out = out;
+    server.message_capacity = 8;
+    gregorio_set_message_handler(collect_message, &server);
+
+    while (running && (content = read_message(in, &length, &too_long))) {
+        json_value *const message = too_long? NULL
+                : json_parse(content, length);
+        if (too_long) {
+            send_error(&server, NULL, -32600, "message too long");
+        } else if (message) {
+            running = handle(&server, message);
+            json_free(message);
+        } else {
+            send_error(&server, NULL, -32700, "parse error");
+        }
+        free(content);
+    }
+
+    gregorio_set_message_handler(NULL, NULL);
+    while (server.documents) {
+        close_document(&server, server.documents->uri);
+    }
+    free(server.messages);
+    free(server.buffer.text);
+    return server.shutdown? 0 : 1;
+}
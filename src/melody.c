@@ -0,0 +1,220 @@
+/*
+ * Gregorio is a program that translates gabc files to GregorioTeX
+ * This file extracts the melody of a score and computes its intervals.
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * Gregorio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Gregorio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gregorio.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include "bool.h"
+#include "struct.h"
+#include "support.h"
+#include "melody.h"
+
+/* The intervals are computed 16 at a time with SSE2 or NEON, which every
+ * x86_64 and aarch64 processor has, so there is nothing to decide at run
+ * time.  Define MELODY_NO_ACCELERATION to only build the portable code. */
+#ifndef MELODY_NO_ACCELERATION
+#if defined(__SSE2__)
+#define MELODY_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define MELODY_NEON 1
+#include <arm_neon.h>
+#endif
+#endif
+
+#define INITIAL_CAPACITY 256
+
+void gregorio_melody_init(gregorio_melody *const melody)
+{
+    melody->pitches = NULL;
+    melody->notes = NULL;
+    melody->syllables = NULL;
+    melody->count = 0;
+    melody->capacity = 0;
+}
+
+void gregorio_melody_free(gregorio_melody *const melody)
+{
+    free(melody->pitches);
+    free(melody->notes);
+    free(melody->syllables);
+    gregorio_melody_init(melody);
+}
+
+static void grow(gregorio_melody *const melody)
+{
+    size_t capacity;
+
+    if (!melody->capacity) {
+        melody->capacity = INITIAL_CAPACITY;
+        melody->pitches = gregorio_grow_buffer(NULL, &melody->capacity,
+                signed char);
+        melody->notes = gregorio_grow_buffer(NULL, &melody->capacity,
+                const gregorio_note *);
+        melody->syllables = gregorio_grow_buffer(NULL, &melody->capacity,
+                unsigned int);
+        return;
+    }
+    capacity = melody->capacity;
+    melody->pitches = gregorio_grow_buffer(melody->pitches, &capacity,
+            signed char);
+    capacity = melody->capacity;
+    melody->notes = gregorio_grow_buffer(melody->notes, &capacity,
+            const gregorio_note *);
+    capacity = melody->capacity;
+    melody->syllables = gregorio_grow_buffer(melody->syllables, &capacity,
+            unsigned int);
+    melody->capacity = capacity;
+}
+
+/* fills the melody with the notes of a voice (numbered from 0) of the score,
+ * reusing its arrays */
+void gregorio_melody_fill(gregorio_melody *const melody,
+        const gregorio_score *const score, const int voice)
+{
+    const gregorio_voice_info *voice_info = score->first_voice_info;
+    const gregorio_syllable *syllable;
+    unsigned int number = 0;
+    int key = 0, i;
+
+    melody->count = 0;
+    if (voice < 0 || voice >= score->number_of_voices) {
+        return;
+    }
+    for (i = 0; i < voice && voice_info; ++i) {
+        voice_info = voice_info->next_voice_info;
+    }
+    if (voice_info) {
+        key = gregorio_calculate_new_key(voice_info->initial_clef);
+    }
+    for (syllable = score->first_syllable; syllable;
+            syllable = syllable->next_syllable, ++number) {
+        const gregorio_element *element;
+        for (element = syllable->elements[voice]; element;
+                element = element->next) {
+            const gregorio_glyph *glyph;
+            if (element->type == GRE_CLEF) {
+                key = gregorio_calculate_new_key(element->u.misc.clef);
+                continue;
+            }
+            if (element->type != GRE_ELEMENT) {
+                continue;
+            }
+            for (glyph = element->u.first_glyph; glyph; glyph = glyph->next) {
+                const gregorio_note *note;
+                if (glyph->type != GRE_GLYPH) {
+                    continue;
+                }
+                for (note = glyph->u.notes.first_note; note;
+                        note = note->next) {
+                    if (note->type != GRE_NOTE) {
+                        continue;
+                    }
+                    if (melody->count == melody->capacity) {
+                        grow(melody);
+                    }
+                    melody->pitches[melody->count] =
+                            (signed char) (note->u.note.pitch - key);
+                    melody->notes[melody->count] = note;
+                    melody->syllables[melody->count] = number;
+                    ++melody->count;
+                }
+            }
+        }
+    }
+}
+
+static __inline signed char contour(const int interval)
+{
+    if (interval > 0) {
+        return interval > 1? CONTOUR_LEAP_UP : CONTOUR_STEP_UP;
+    }
+    if (interval < 0) {
+        return interval < -1? CONTOUR_LEAP_DOWN : CONTOUR_STEP_DOWN;
+    }
+    return CONTOUR_REPEAT;
+}
+
+/* computes the count - 1 intervals between the count pitches, and their
+ * contour classes if contours is not NULL */
+void gregorio_melody_intervals(const signed char *const pitches,
+        const size_t count, signed char *const intervals,
+        signed char *const contours)
+{
+    size_t i = 0, n;
+
+    if (count < 2) {
+        return;
+    }
+    n = count - 1;
+#if defined MELODY_SSE2
+    {
+        /* a comparison gives -1 where it holds, so the contour class is the
+         * sum of the comparisons d < 0 and d < -1, less that of the
+         * comparisons d > 0 and d > 1 */
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi8(1);
+        const __m128i minus_one = _mm_set1_epi8(-1);
+        for (; i + 16 <= n; i += 16) {
+            const __m128i from = _mm_loadu_si128(
+                    (const __m128i *) (const void *) (pitches + i));
+            const __m128i to = _mm_loadu_si128(
+                    (const __m128i *) (const void *) (pitches + i + 1));
+            const __m128i d = _mm_sub_epi8(to, from);
+            _mm_storeu_si128((__m128i *) (void *) (intervals + i), d);
+            if (contours) {
+                const __m128i down = _mm_add_epi8(_mm_cmpgt_epi8(zero, d),
+                        _mm_cmpgt_epi8(minus_one, d));
+                const __m128i up = _mm_add_epi8(_mm_cmpgt_epi8(d, zero),
+                        _mm_cmpgt_epi8(d, one));
+                _mm_storeu_si128((__m128i *) (void *) (contours + i),
+                        _mm_sub_epi8(down, up));
+            }
+        }
+    }
+#elif defined MELODY_NEON
+    {
+        const int8x16_t zero = vdupq_n_s8(0);
+        const int8x16_t one = vdupq_n_s8(1);
+        const int8x16_t minus_one = vdupq_n_s8(-1);
+        for (; i + 16 <= n; i += 16) {
+            const int8x16_t d = vsubq_s8(vld1q_s8(pitches + i + 1),
+                    vld1q_s8(pitches + i));
+            vst1q_s8(intervals + i, d);
+            if (contours) {
+                const int8x16_t down = vaddq_s8(
+                        vreinterpretq_s8_u8(vcltq_s8(d, zero)),
+                        vreinterpretq_s8_u8(vcltq_s8(d, minus_one)));
+                const int8x16_t up = vaddq_s8(
+                        vreinterpretq_s8_u8(vcgtq_s8(d, zero)),
+                        vreinterpretq_s8_u8(vcgtq_s8(d, one)));
+                vst1q_s8(contours + i, vsubq_s8(down, up));
+            }
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        intervals[i] = (signed char) (pitches[i + 1] - pitches[i]);
+        if (contours) {
+            contours[i] = contour(intervals[i]);
+        }
+    }
+}
@@ -0,0 +1,59 @@
+/*
+ * Gregorio is a program that translates gabc files to GregorioTeX
+ * This header declares the extraction of the melody of a score.
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * Gregorio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Gregorio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gregorio.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MELODY_H
+#define MELODY_H
+
+#include <stddef.h>
+#include "struct.h"
+
+/* The contour class of an interval: a leap is an interval of a third or
+ * more. */
+typedef enum gregorio_contour {
+    CONTOUR_LEAP_DOWN = -2,
+    CONTOUR_STEP_DOWN = -1,
+    CONTOUR_REPEAT = 0,
+    CONTOUR_STEP_UP = 1,
+    CONTOUR_LEAP_UP = 2
+} gregorio_contour;
+
+/* The notes of a voice of a score, in order, as contiguous arrays.  The
+ * pitches are those sung: the pitch of a note less the key of the clef in
+ * force (see gregorio_calculate_new_key), so that a clef change does not
+ * change them. */
+typedef struct gregorio_melody {
+    signed char *pitches;
+    /* the note itself, for what else the caller wants of it */
+    const gregorio_note **notes;
+    /* the number of the syllable of the note in the score, from 0 */
+    unsigned int *syllables;
+    size_t count, capacity;
+} gregorio_melody;
+
+void gregorio_melody_init(gregorio_melody *melody);
+void gregorio_melody_free(gregorio_melody *melody);
+void gregorio_melody_fill(gregorio_melody *melody,
+        const gregorio_score *score, int voice);
+void gregorio_melody_intervals(const signed char *pitches, size_t count,
+        signed char *intervals, signed char *contours);
+
+#endif
@@ -31,13 +31,66 @@
 static gregorio_verbosity verbosity_mode = 0;
 static bool debug_messages = false;
 static bool deprecation_is_warning = true;
+static bool fatal_exits = true;
 static int return_value = 0;
+static bool hold_messages = false;
+static unsigned int held_message_count = 0;
+static gregorio_message_handler message_handler = NULL;
+static void *message_handler_data = NULL;
 
 int gregorio_get_return_value(void)
 {
     return return_value;
 }
 
+void gregorio_reset_return_value(void)
+{
+    return_value = 0;
+}
+
+/*
+ * While messages are held, the messages which do not end the program are
+ * counted instead of being printed, and they don't change the return value.
+ * This is used to try a parse which is abandoned (and done again normally) if
+ * it reports anything.
+ */
+void gregorio_hold_messages(const bool hold)
+{
+    hold_messages = hold;
+    held_message_count = 0;
+}
+
+/* the number of warnings and errors held since messages are held */
+unsigned int gregorio_held_message_count(void)
+{
+    return held_message_count;
+}
+
+/*
+ * With a handler, the messages are given to it instead of being printed, for
+ * a front end which reports them elsewhere (see lsp.c).  Such a front end
+ * outlives the score which caused a fatal error, so that it does not end the
+ * program then (see gregorio_set_fatal_exit).
+ */
+void gregorio_set_message_handler(const gregorio_message_handler handler,
+        void *const data)
+{
+    message_handler = handler;
+    message_handler_data = data;
+}
+
+/*
+ * A fatal error normally ends the program.  A program which reads several
+ * scores in turn makes it count as a mere error instead, so that the score
+ * which caused it fails while the others go on.  The parser reads on after its
+ * fatal errors, and the failures nothing can go on from (such as running out
+ * of memory) exit by themselves.
+ */
+void gregorio_set_fatal_exit(const bool fatal_exit)
+{
+    fatal_exits = fatal_exit;
+}
+
 void gregorio_set_verbosity_mode(const gregorio_verbosity verbosity)
 {
     verbosity_mode = verbosity;
@@ -95,6 +148,8 @@ void gregorio_messagef(const char *function_name,
 {
     va_list args;
     const char *verbosity_str;
+    const bool exits = verbosity == VERBOSITY_FATAL && fatal_exits
+            && !message_handler;
 
     if (!debug_messages && verbosity != VERBOSITY_ASSERTION) {
         line_number = 0;
@@ -105,6 +160,12 @@ void gregorio_messagef(const char *function_name,
     assert(stderr);
     assert(verbosity_mode);
 
+    if (hold_messages && !exits) {
+        if (verbosity >= VERBOSITY_WARNING) {
+            ++held_message_count;
+        }
+        return;
+    }
     if (verbosity < verbosity_mode) {
         return;
     }
@@ -113,26 +174,34 @@ void gregorio_messagef(const char *function_name,
          * assertions coming after to warnings */
         verbosity = VERBOSITY_WARNING;
     }
-    verbosity_str = verbosity_to_str(verbosity);
-    if (line_number) {
-        /* if line number is specified, function_name must be specified */
-        assert(function_name);
-        if (function_name) {
-            fprintf(stderr, "%d: in function `%s': %s", line_number,
-                    function_name, verbosity_str);
-        }
+    if (message_handler) {
+        char message[512];
+        va_start(args, format);
+        gregorio_vsnprintf(message, sizeof message, format, args);
+        va_end(args);
+        message_handler(message_handler_data, verbosity, message);
     } else {
-        if (function_name) {
-            fprintf(stderr, "in function `%s': %s", function_name,
-                    verbosity_str);
+        verbosity_str = verbosity_to_str(verbosity);
+        if (line_number) {
+            /* if line number is specified, function_name must be specified */
+            assert(function_name);
+            if (function_name) {
+                fprintf(stderr, "%d: in function `%s': %s",
+                        line_number, function_name, verbosity_str);
+            }
         } else {
-            fprintf(stderr, "%s", verbosity_str);
+            if (function_name) {
+                fprintf(stderr, "in function `%s': %s", function_name,
+                        verbosity_str);
+            } else {
+                fprintf(stderr, "%s", verbosity_str);
+            }
         }
+        va_start(args, format);
+        vfprintf(stderr, format, args);
+        va_end(args);
+        fprintf(stderr, "\n");
     }
-    va_start(args, format);
-    vfprintf(stderr, format, args);
-    va_end(args);
-    fprintf(stderr, "\n");
 
     switch (verbosity) {
     case VERBOSITY_DEPRECATION:
@@ -150,7 +219,10 @@ void gregorio_messagef(const char *function_name,
     case VERBOSITY_FATAL:
         /* all fatal errors should not be reasonably testable */
         /* LCOV_EXCL_START */
-        gregorio_exit(1);
+        if (exits) {
+            gregorio_exit(1);
+        }
+        return_value = 1;
         break;
         /* LCOV_EXCL_STOP */
     default:
@@ -55,7 +55,17 @@ void gregorio_messagef(const char *function_name,
 void gregorio_set_verbosity_mode(gregorio_verbosity verbosity);
 void gregorio_set_debug_messages(bool debug);
 void gregorio_set_deprecation_errors(bool deprecation_errors);
+void gregorio_set_fatal_exit(bool fatal_exit);
 int gregorio_get_return_value(void);
+void gregorio_reset_return_value(void);
+void gregorio_hold_messages(bool hold);
+unsigned int gregorio_held_message_count(void);
+
+typedef void (*gregorio_message_handler)(void *data,
+        gregorio_verbosity verbosity, const char *message);
+
+void gregorio_set_message_handler(gregorio_message_handler handler,
+        void *data);
 
 #define gregorio_assert_only(TEST,FUNCTION,MESSAGE) \
     if (!(TEST)) { \
@@ -0,0 +1,320 @@
+/*
+ * Gregorio is a program that translates gabc files to GregorioTeX
+ * This file implements the nabc (adiastematic neumes) parser.
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * Gregorio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Gregorio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gregorio.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This is the grammar of the nabc parser of GregorioTeX (in
+ * gregoriotex-nabc.lua), which still handles the nabc written by hand with
+ * \GreNABCChar and chooses the glyphs of the font for what is parsed here.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include "bool.h"
+#include "messages.h"
+#include "support.h"
+#include "nabc.h"
+
+static const char *const neume_kinds[] = {
+    "vi", "pu", "ta", "gr", "cl", "un", "pv", "pe", "po", "to", "ci", "sc",
+    "pf", "sf", "tr", "st", "ds", "ts", "tg", "bv", "tv", "pr", "pi", "vs",
+    "or", "sa", "pq", "qi", "ql", "pt", "oc", "ni", NULL
+};
+
+/* significative letters of St. Gall (ls) */
+static const char *const ls_kinds[] = {
+    "c", "t", "s", "l", "x", "+", "a", "al", "am", "b", "cm", "co", "cw", "d",
+    "e", "eq", "ew", "f", "fid", "fr", "g", "h", "hp", "hn", "i", "im", "iv",
+    "k", "lb", "lc", "len", "lm", "lp", "lt", "m", "md", "moll", "n", "nl",
+    "nt", "p", "par", "pfec", "pm", "q", "sb", "sc", "simil", "simul", "sj",
+    "sjc", "sjcm", "sm", "st", "sta", "su", "tb", "th", "tm", "tw", "v", "ve",
+    "vol", "eq-", "equ", "simp", "simpl", "sp", NULL
+};
+
+/* significative letters of Laon (lt) */
+static const char *const lt_kinds[] = {
+    "i", "do", "dr", "dx", "ps", "qm", "sb", "se", "sj", "sl", "sn", "sp",
+    "sr", "st", "us", NULL
+};
+
+/* in canonical order */
+static const char alternations[] = "MSG-><~";
+static const char heights[] = "abcdefghijklmnp";
+
+#define DEFAULT_HEIGHT 5
+
+typedef struct nabc_parser {
+    const char *start;
+    const char *p;
+    const char *error;
+    /* the components of the current neume, each one at most as long as the
+     * nabc string */
+    char *glyph, *letters, *prepunctis, *subpunctis;
+    size_t glyph_length, letters_length, prepunctis_length, subpunctis_length;
+} nabc_parser;
+
+static __inline bool is_position(const char c)
+{
+    return c >= '1' && c <= '9';
+}
+
+static bool is_kind(const char *const *kinds, const char *const kind,
+        const size_t length)
+{
+    for (; *kinds; ++kinds) {
+        if (strlen(*kinds) == length && strncmp(*kinds, kind, length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static __inline void append(char *const buffer, size_t *const length,
+        const char *const text, const size_t text_length)
+{
+    memcpy(buffer + *length, text, text_length);
+    *length += text_length;
+    buffer[*length] = '\0';
+}
+
+static bool fail(nabc_parser *const parser, const char *const error)
+{
+    parser->error = error;
+    return false;
+}
+
+/* parses one base neume, appending its name to the glyph */
+static bool parse_base(nabc_parser *const parser, int *const height)
+{
+    const char *p = parser->p;
+    unsigned int alternation_mask = 0;
+    const char *found;
+    int i;
+
+    if (!p[0] || !p[1] || !is_kind(neume_kinds, p, 2)) {
+        return fail(parser, _("unknown nabc neume"));
+    }
+    append(parser->glyph, &parser->glyph_length, p, 2);
+    p += 2;
+    /* the alternation modifiers can be written in arbitrary order,
+     * canonicalize it and remove duplicates */
+    while (*p && (found = strchr(alternations, *p))) {
+        alternation_mask |= 1u << (found - alternations);
+        ++p;
+    }
+    for (i = 0; alternations[i]; ++i) {
+        if (alternation_mask & (1u << i)) {
+            append(parser->glyph, &parser->glyph_length, alternations + i, 1);
+        }
+    }
+    /* followed by a single optional variant digit */
+    if (is_position(*p)) {
+        append(parser->glyph, &parser->glyph_length, p, 1);
+        ++p;
+    }
+    /* then by an optional height, h[a-np]; an h which ends the string is
+     * left alone (and then fails as the start of a neume) */
+    *height = DEFAULT_HEIGHT;
+    if (p[0] == 'h' && p[1]) {
+        if (!(found = strchr(heights, p[1]))) {
+            parser->p = p + 1;
+            return fail(parser, _("invalid nabc height"));
+        }
+        *height = (int)(found - heights);
+        p += 2;
+    }
+    parser->p = p;
+    return true;
+}
+
+/* parses a significative letter, ls or lt followed by its kind and its
+ * position */
+static bool parse_letter(nabc_parser *const parser,
+        const char *const *const kinds)
+{
+    const char *const start = parser->p;
+    const char *p = start + 2;
+
+    while (*p && !is_position(*p)) {
+        ++p;
+    }
+    if (!*p) {
+        return fail(parser, _("nabc significative letter without position"));
+    }
+    if (!is_kind(kinds, start + 2, p - start - 2)) {
+        return fail(parser, _("unknown nabc significative letter"));
+    }
+    ++p;
+    append(parser->letters, &parser->letters_length, start, p - start);
+    parser->p = p;
+    return true;
+}
+
+/* parses a prepunctis (pp) or subpunctis (su) modifier */
+static bool parse_punctis(nabc_parser *const parser, char *const buffer,
+        size_t *const length)
+{
+    const char *const start = parser->p;
+    const char *p = start + 2;
+
+    if (*p && strchr("tuvwxyqnz", *p)) {
+        ++p;
+    }
+    /* pre/subpuncta with height are not supported yet */
+    if (!is_position(*p)) {
+        parser->p = p;
+        return fail(parser, _("nabc prepunctis or subpunctis without count"));
+    }
+    ++p;
+    append(buffer, length, start, p - start);
+    parser->p = p;
+    return true;
+}
+
+/* parses one neume, which is one base neume or several base neumes
+ * separated with ! characters, and all this followed by arbitrary ls, lt,
+ * pp and su modifiers */
+static bool parse_neume(nabc_parser *const parser, int *const height)
+{
+    int next_height;
+
+    parser->glyph_length = parser->letters_length = 0;
+    parser->prepunctis_length = parser->subpunctis_length = 0;
+    parser->glyph[0] = parser->letters[0] = '\0';
+    parser->prepunctis[0] = parser->subpunctis[0] = '\0';
+
+    if (!parse_base(parser, height)) {
+        return false;
+    }
+    while (*parser->p == '!') {
+        ++parser->p;
+        append(parser->glyph, &parser->glyph_length, "!", 1);
+        if (!parse_base(parser, &next_height)) {
+            return false;
+        }
+        if (next_height != *height) {
+            next_height += DEFAULT_HEIGHT - *height;
+            if (next_height < 0 || next_height > 14) {
+                return fail(parser, _("nabc neume too far from the previous "
+                            "one"));
+            }
+            append(parser->glyph, &parser->glyph_length,
+                    heights + next_height, 1);
+        }
+    }
+    while (parser->p[0] && parser->p[1]) {
+        const char *const p = parser->p;
+        bool ok;
+        if (p[0] == 'l' && p[1] == 's') {
+            ok = parse_letter(parser, ls_kinds);
+        } else if (p[0] == 'l' && p[1] == 't') {
+            ok = parse_letter(parser, lt_kinds);
+        } else if (p[0] == 'p' && p[1] == 'p') {
+            ok = parse_punctis(parser, parser->prepunctis,
+                    &parser->prepunctis_length);
+        } else if (p[0] == 's' && p[1] == 'u') {
+            ok = parse_punctis(parser, parser->subpunctis,
+                    &parser->subpunctis_length);
+        } else {
+            break;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void parse_spaces(nabc_parser *const parser,
+        const gregorio_nabc_space_handler space, void *const data)
+{
+    const char *p = parser->p;
+    gregorio_nabc_space value;
+
+    while (*p == '/' || *p == '`') {
+        if (p[0] == '/' && p[1] == '/') {
+            value = NABC_LARGER_SPACE;
+            p += 2;
+        } else if (p[0] == '`' && p[1] == '`') {
+            value = NABC_NEGATIVE_LARGER_SPACE;
+            p += 2;
+        } else if (*p == '/') {
+            value = NABC_INTERELEMENT_SPACE;
+            ++p;
+        } else {
+            value = NABC_NEGATIVE_INTERELEMENT_SPACE;
+            ++p;
+        }
+        if (space) {
+            space(data, value);
+        }
+    }
+    parser->p = p;
+}
+
+bool gregorio_nabc_parse(const char *const nabc,
+        const gregorio_nabc_space_handler space,
+        const gregorio_nabc_neume_handler neume, void *const data,
+        size_t *const error_offset, const char **const error)
+{
+    const size_t size = strlen(nabc) + 1;
+    nabc_parser parser;
+    gregorio_nabc_neume result;
+    char *buffer;
+    bool ok = true;
+
+    buffer = (char *)gregorio_malloc(4 * size);
+    parser.start = parser.p = nabc;
+    parser.error = NULL;
+    parser.glyph = buffer;
+    parser.letters = buffer + size;
+    parser.prepunctis = buffer + 2 * size;
+    parser.subpunctis = buffer + 3 * size;
+
+    result.glyph = parser.glyph;
+    result.letters = parser.letters;
+    result.prepunctis = parser.prepunctis;
+    result.subpunctis = parser.subpunctis;
+
+    parse_spaces(&parser, space, data);
+    while (*parser.p) {
+        if (!parse_neume(&parser, &result.height)) {
+            ok = false;
+            break;
+        }
+        if (neume) {
+            neume(data, &result);
+        }
+        parse_spaces(&parser, space, data);
+    }
+
+    if (!ok) {
+        if (error_offset) {
+            *error_offset = (size_t)(parser.p - nabc);
+        }
+        if (error) {
+            *error = parser.error;
+        }
+    }
+    free(buffer);
+    return ok;
+}
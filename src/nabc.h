@@ -0,0 +1,66 @@
+/*
+ * Gregorio is a program that translates gabc files to GregorioTeX
+ * This header prototypes the nabc (adiastematic neumes) parser.
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * Gregorio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Gregorio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gregorio.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NABC_H
+#define NABC_H
+
+#include <stddef.h>
+#include "bool.h"
+
+typedef enum gregorio_nabc_space {
+    NABC_INTERELEMENT_SPACE = 1, /* / */
+    NABC_LARGER_SPACE, /* // */
+    NABC_NEGATIVE_INTERELEMENT_SPACE, /* ` */
+    NABC_NEGATIVE_LARGER_SPACE /* `` */
+} gregorio_nabc_space;
+
+/* A neume, resolved as far as possible without knowing which glyphs the
+ * nabc font has; choosing among them is left to GregorioTeX. */
+typedef struct gregorio_nabc_neume {
+    /* the base neumes, with their modifiers in canonical order, separated by
+     * ! and each but the first followed by its height relative to the first
+     * one when it is different (such as "vi!pub") */
+    const char *glyph;
+    /* the height of the first base neume, from 0 (a) to 14 (p) */
+    int height;
+    /* the significative letters (ls and lt), in order (such as "lsc2lst1") */
+    const char *letters;
+    /* the prepunctis and the subpunctis (such as "pp1" and "sut1su2") */
+    const char *prepunctis;
+    const char *subpunctis;
+} gregorio_nabc_neume;
+
+typedef void (*gregorio_nabc_space_handler)(void *data,
+        gregorio_nabc_space space);
+typedef void (*gregorio_nabc_neume_handler)(void *data,
+        const gregorio_nabc_neume *neume);
+
+/* Parses a nabc string, calling the handlers (when not NULL) for each space
+ * and neume in order.  When the string is not valid nabc, returns false,
+ * with the offset of the error in the string and its description in
+ * error_offset and error (when not NULL); the handlers may already have been
+ * called for what precedes the error. */
+bool gregorio_nabc_parse(const char *nabc, gregorio_nabc_space_handler space,
+        gregorio_nabc_neume_handler neume, void *data, size_t *error_offset,
+        const char **error);
+
+#endif
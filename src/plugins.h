@@ -30,11 +30,33 @@ void dump_write_score(FILE *f, gregorio_score *score);
 void dump_write_characters(FILE *const f,
         const gregorio_character *current_character);
 
-gregorio_score *gabc_read_score(FILE *f_in, bool point_and_click);
+gregorio_score *gabc_read_score(FILE *f_in, bool point_and_click,
+        gregorio_digest_algorithm digest_algorithm);
+
+gregorio_score *gabc_read_canonical_score(FILE *f_in);
 
 void gabc_write_score(FILE *f, gregorio_score *score);
 
+void gabc_write_canonical_score(FILE *f, gregorio_score *score);
+
+void json_write_score(FILE *f, gregorio_score *score);
+
+void gbin_write_score(FILE *f, gregorio_score *score);
+
+gregorio_score *gbin_read_score(FILE *f);
+
 void gregoriotex_write_score(FILE *f, gregorio_score *score,
         const char *point_and_click_filename);
 
+/* what \GreBeginScore and the score opening take from the whole score */
+typedef struct gregoriotex_opening {
+    gregorio_clef_info largest_clef;
+    signed char top_height, bottom_height;
+    bool translation, abovelinestext;
+} gregoriotex_opening;
+
+bool gregoriotex_write_syllables(FILE *f, gregorio_score *score,
+        gregorio_syllable *first, const gregorio_syllable *last,
+        bool point_and_click, gregoriotex_opening *opening);
+
 #endif
@@ -29,6 +29,7 @@
 
 #include "config.h"
 #include "sha1.h"
+#include "bool.h"
 #ifdef HAVE_STDINT_H
 #include <stdint.h>
 #else
@@ -37,6 +38,27 @@
 #include <stdlib.h>
 #include <string.h>
 
+/* Hardware-accelerated block functions are compiled in when the compiler can
+ * target them; whether they are used is decided at run time (see
+ * select_process_blocks below).  Define SHA1_NO_ACCELERATION to only build
+ * the portable code. */
+#ifndef SHA1_NO_ACCELERATION
+#if (defined(__x86_64__) || defined(__i386__)) \
+        && ((defined(__GNUC__) && __GNUC__ >= 5) || defined(__clang__))
+#define SHA1_X86_SHA 1
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__aarch64__) \
+        && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2))
+#define SHA1_ARM_CE 1
+#include <arm_neon.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+#endif
+
 #ifdef WORDS_BIGENDIAN
 #define SWAP(n) (n)
 #else
@@ -49,6 +71,8 @@
 #error "invalid BLOCKSIZE"
 #endif
 
+static void select_process_blocks(void);
+
 /* This array contains the bytes used to pad the buffer to the next
    64-byte boundary.  (RFC 1321, 3.1: Step 1)  */
 static const unsigned char fillbuf[64] = { 0x80, 0 /* , 0, 0, ...  */  };
@@ -58,6 +82,8 @@ static const unsigned char fillbuf[64] = { 0x80, 0 /* , 0, 0, ...  */  };
    must be called before using hash in the call to sha1_hash.  */
 void sha1_init_ctx(struct sha1_ctx *ctx)
 {
+    select_process_blocks();
+
     ctx->A = 0x67452301;
     ctx->B = 0xefcdab89;
     ctx->C = 0x98badcfe;
@@ -208,30 +234,20 @@ void sha1_process_bytes(const void *buffer, size_t len, struct sha1_ctx *ctx)
 #define F3(B,C,D) ( ( B & C ) | ( D & ( B | C ) ) )
 #define F4(B,C,D) (B ^ C ^ D)
 
-/* Process LEN bytes of BUFFER, accumulating context into CTX.
-   It is assumed that LEN % 64 == 0.
+/* Process NBLOCKS 64-byte blocks of BUFFER, accumulating context into CTX.
    Most of this code comes from GnuPG's cipher/sha1.c.  */
 
-void sha1_process_block(const void *buffer, size_t len, struct sha1_ctx *ctx)
+static void process_blocks_portable(const void *buffer, size_t nblocks,
+        struct sha1_ctx *ctx)
 {
     const uint32_t *words = buffer;
-    size_t nwords = len / sizeof(uint32_t);
-    const uint32_t *endp = words + nwords;
+    const uint32_t *endp = words + nblocks * 16;
     uint32_t x[16];
     uint32_t a = ctx->A;
     uint32_t b = ctx->B;
     uint32_t c = ctx->C;
     uint32_t d = ctx->D;
     uint32_t e = ctx->E;
-    uint32_t lolen = len;
-
-    /*
-     * First increment the byte count.  RFC 1321 specifies the possible
-     * length of the file up to 2^64 bits.  Here we only compute the
-     * number of bytes.  Do a double word increment.  
-     */
-    ctx->total[0] += lolen;
-    ctx->total[1] += (len >> 31 >> 1) + (ctx->total[0] < lolen);
 
 #define rol(x, n) (((x) << (n)) | ((uint32_t) (x) >> (32 - (n))))
 
@@ -344,3 +360,299 @@ void sha1_process_block(const void *buffer, size_t len, struct sha1_ctx *ctx)
         e = ctx->E += e;
     }
 }
+
+#ifdef SHA1_X86_SHA
+/* Four rounds using the x86 SHA extensions, also advancing the message
+   schedule: M0 holds the current words, M1 is finished, M2 and M3 are
+   prepared for the following rounds.  Work on words that are not needed
+   in the last rounds is removed by the compiler.  */
+#define SHA1_NI_ROUNDS(F, E_IN, E_OUT, M0, M1, M2, M3) do { \
+        E_IN = _mm_sha1nexte_epu32(E_IN, M0);                  \
+        E_OUT = abcd;                                           \
+        M1 = _mm_sha1msg2_epu32(M1, M0);                        \
+        abcd = _mm_sha1rnds4_epu32(abcd, E_IN, F);              \
+        M3 = _mm_sha1msg1_epu32(M3, M0);                        \
+        M2 = _mm_xor_si128(M2, M0);                             \
+    } while (0)
+
+__attribute__((target("sha,sse4.1")))
+static void process_blocks_x86_sha(const void *buffer, size_t nblocks,
+        struct sha1_ctx *ctx)
+{
+    /* reverses the bytes of the 128-bit value, which turns four big-endian
+     * words into the lane order expected by the SHA instructions */
+    const __m128i mask = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+            12, 13, 14, 15);
+    const __m128i *data = buffer;
+    __m128i abcd, abcd_save, e0, e0_save, e1, msg0, msg1, msg2, msg3;
+    uint32_t out[4];
+
+    abcd = _mm_set_epi32(ctx->A, ctx->B, ctx->C, ctx->D);
+    e0 = _mm_set_epi32(ctx->E, 0, 0, 0);
+
+    for (; nblocks; --nblocks, data += 4) {
+        abcd_save = abcd;
+        e0_save = e0;
+
+        /* rounds 0-3 */
+        msg0 = _mm_shuffle_epi8(_mm_loadu_si128(data), mask);
+        e0 = _mm_add_epi32(e0, msg0);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+        /* rounds 4-7 */
+        msg1 = _mm_shuffle_epi8(_mm_loadu_si128(data + 1), mask);
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+        msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+        /* rounds 8-11 */
+        msg2 = _mm_shuffle_epi8(_mm_loadu_si128(data + 2), mask);
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+        msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+        msg0 = _mm_xor_si128(msg0, msg2);
+
+        /* rounds 12-79 */
+        msg3 = _mm_shuffle_epi8(_mm_loadu_si128(data + 3), mask);
+        SHA1_NI_ROUNDS(0, e1, e0, msg3, msg0, msg1, msg2);
+        SHA1_NI_ROUNDS(0, e0, e1, msg0, msg1, msg2, msg3);
+        SHA1_NI_ROUNDS(1, e1, e0, msg1, msg2, msg3, msg0);
+        SHA1_NI_ROUNDS(1, e0, e1, msg2, msg3, msg0, msg1);
+        SHA1_NI_ROUNDS(1, e1, e0, msg3, msg0, msg1, msg2);
+        SHA1_NI_ROUNDS(1, e0, e1, msg0, msg1, msg2, msg3);
+        SHA1_NI_ROUNDS(1, e1, e0, msg1, msg2, msg3, msg0);
+        SHA1_NI_ROUNDS(2, e0, e1, msg2, msg3, msg0, msg1);
+        SHA1_NI_ROUNDS(2, e1, e0, msg3, msg0, msg1, msg2);
+        SHA1_NI_ROUNDS(2, e0, e1, msg0, msg1, msg2, msg3);
+        SHA1_NI_ROUNDS(2, e1, e0, msg1, msg2, msg3, msg0);
+        SHA1_NI_ROUNDS(2, e0, e1, msg2, msg3, msg0, msg1);
+        SHA1_NI_ROUNDS(3, e1, e0, msg3, msg0, msg1, msg2);
+        SHA1_NI_ROUNDS(3, e0, e1, msg0, msg1, msg2, msg3);
+        SHA1_NI_ROUNDS(3, e1, e0, msg1, msg2, msg3, msg0);
+        SHA1_NI_ROUNDS(3, e0, e1, msg2, msg3, msg0, msg1);
+        SHA1_NI_ROUNDS(3, e1, e0, msg3, msg0, msg1, msg2);
+
+        e0 = _mm_sha1nexte_epu32(e0, e0_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    _mm_storeu_si128((__m128i *) out, abcd);
+    ctx->A = out[3];
+    ctx->B = out[2];
+    ctx->C = out[1];
+    ctx->D = out[0];
+    _mm_storeu_si128((__m128i *) out, e0);
+    ctx->E = out[3];
+}
+
+static bool has_x86_sha(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, NULL) < 7) {
+        return false;
+    }
+    __cpuid(1, eax, ebx, ecx, edx);
+    /* SSSE3 and SSE4.1 */
+    if (!(ecx & (1 << 9)) || !(ecx & (1 << 19))) {
+        return false;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    /* SHA */
+    return (ebx & (1 << 29)) != 0;
+}
+#endif /* SHA1_X86_SHA */
+
+#ifdef SHA1_ARM_CE
+/* Four rounds using the ARMv8 cryptography extension.  */
+#define SHA1_CE_ROUNDS(OP, K, E_IN, E_OUT, M) do {          \
+        tmp = vaddq_u32(M, vdupq_n_u32(K));                   \
+        E_OUT = vsha1h_u32(vgetq_lane_u32(abcd, 0));          \
+        abcd = OP(abcd, E_IN, tmp);                           \
+    } while (0)
+
+/* The same, computing the next four words of the message schedule first.  */
+#define SHA1_CE_SCHEDULE_ROUNDS(OP, K, E_IN, E_OUT, M0, M1, M2, M3) do { \
+        M0 = vsha1su1q_u32(vsha1su0q_u32(M0, M1, M2), M3);                 \
+        SHA1_CE_ROUNDS(OP, K, E_IN, E_OUT, M0);                            \
+    } while (0)
+
+static void process_blocks_arm_ce(const void *buffer, size_t nblocks,
+        struct sha1_ctx *ctx)
+{
+    const uint8_t *data = buffer;
+    uint32x4_t abcd, abcd_save, tmp, msg0, msg1, msg2, msg3;
+    uint32_t e0, e0_save, e1;
+    uint32_t in[4];
+
+    in[0] = ctx->A;
+    in[1] = ctx->B;
+    in[2] = ctx->C;
+    in[3] = ctx->D;
+    abcd = vld1q_u32(in);
+    e0 = ctx->E;
+
+    for (; nblocks; --nblocks, data += 64) {
+        abcd_save = abcd;
+        e0_save = e0;
+
+        msg0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data)));
+        msg1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16)));
+        msg2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 32)));
+        msg3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 48)));
+
+        SHA1_CE_ROUNDS(vsha1cq_u32, K1, e0, e1, msg0);
+        SHA1_CE_ROUNDS(vsha1cq_u32, K1, e1, e0, msg1);
+        SHA1_CE_ROUNDS(vsha1cq_u32, K1, e0, e1, msg2);
+        SHA1_CE_ROUNDS(vsha1cq_u32, K1, e1, e0, msg3);
+        SHA1_CE_SCHEDULE_ROUNDS(vsha1cq_u32, K1, e0, e1, msg0, msg1, msg2, msg3);
+        SHA1_CE_SCHEDULE_ROUNDS(vsha1pq_u32, K2, e1, e0, msg1, msg2, msg3, msg0);
+        SHA1_CE_SCHEDULE_ROUNDS(vsha1pq_u32, K2, e0, e1, msg2, msg3, msg0, msg1);
+        SHA1_CE_SCHEDULE_ROUNDS(vsha1pq_u32, K2, e1, e0, msg3, msg0, msg1, msg2);
+        SHA1_CE_SCHEDULE_ROUNDS(vsha1pq_u32, K2, e0, e1, msg0, msg1, msg2, msg3);
+        SHA1_CE_SCHEDULE_ROUNDS(vsha1pq_u32, K2, e1, e0, msg1, msg2, msg3, msg0);
+        SHA1_CE_SCHEDULE_ROUNDS(vsha1mq_u32, K3, e0, e1, msg2, msg3, msg0, msg1);
+        SHA1_CE_SCHEDULE_ROUNDS(vsha1mq_u32, K3, e1, e0, msg3, msg0, msg1, msg2);
+        SHA1_CE_SCHEDULE_ROUNDS(vsha1mq_u32, K3, e0, e1, msg0, msg1, msg2, msg3);
+        SHA1_CE_SCHEDULE_ROUNDS(vsha1mq_u32, K3, e1, e0, msg1, msg2, msg3, msg0);
+        SHA1_CE_SCHEDULE_ROUNDS(vsha1mq_u32, K3, e0, e1, msg2, msg3, msg0, msg1);
+        SHA1_CE_SCHEDULE_ROUNDS(vsha1pq_u32, K4, e1, e0, msg3, msg0, msg1, msg2);
+        SHA1_CE_SCHEDULE_ROUNDS(vsha1pq_u32, K4, e0, e1, msg0, msg1, msg2, msg3);
+        SHA1_CE_SCHEDULE_ROUNDS(vsha1pq_u32, K4, e1, e0, msg1, msg2, msg3, msg0);
+        SHA1_CE_SCHEDULE_ROUNDS(vsha1pq_u32, K4, e0, e1, msg2, msg3, msg0, msg1);
+        SHA1_CE_SCHEDULE_ROUNDS(vsha1pq_u32, K4, e1, e0, msg3, msg0, msg1, msg2);
+
+        e0 += e0_save;
+        abcd = vaddq_u32(abcd, abcd_save);
+    }
+
+    ctx->E = e0;
+    ctx->A = vgetq_lane_u32(abcd, 0);
+    ctx->B = vgetq_lane_u32(abcd, 1);
+    ctx->C = vgetq_lane_u32(abcd, 2);
+    ctx->D = vgetq_lane_u32(abcd, 3);
+}
+
+static bool has_arm_ce(void)
+{
+#if defined(__linux__) && defined(HWCAP_SHA1)
+    return (getauxval(AT_HWCAP) & HWCAP_SHA1) != 0;
+#else
+    /* the compiler was told the extension is there */
+    return true;
+#endif
+}
+#endif /* SHA1_ARM_CE */
+
+typedef void (*process_blocks_function)(const void *, size_t,
+        struct sha1_ctx *);
+
+static process_blocks_function process_blocks = NULL;
+
+#if defined(SHA1_X86_SHA) || defined(SHA1_ARM_CE)
+/* Puts into digest the SHA-1 of the length bytes of message (at most 247),
+   padded here as sha1_finish_ctx pads it, so that function is given all the
+   blocks of the message in one call.  */
+static void digest_with(const process_blocks_function function,
+        const unsigned char *const message, const size_t length,
+        unsigned char *const digest)
+{
+    unsigned char blocks[256];
+    const size_t size = (length + 9 + 63) / 64 * 64;
+    struct sha1_ctx ctx;
+    int i;
+
+    memset(blocks, 0, sizeof blocks);
+    memcpy(blocks, message, length);
+    blocks[length] = 0x80;
+    /* the message length in bits */
+    for (i = 0; i < 4; ++i) {
+        blocks[size - 1 - i] = (unsigned char) ((length * 8) >> (8 * i));
+    }
+
+    ctx.A = 0x67452301;
+    ctx.B = 0xefcdab89;
+    ctx.C = 0x98badcfe;
+    ctx.D = 0x10325476;
+    ctx.E = 0xc3d2e1f0;
+    function(blocks, size / 64, &ctx);
+    sha1_read_ctx(&ctx, digest);
+}
+
+/* Checks a block function against the digest of "abc" (FIPS 180-1,
+   appendix A), then against the portable function on messages of one to
+   four blocks, most of them ending inside a block, so that a miscompiled or
+   misbehaving accelerated path is never used.  */
+static bool passes_known_answer(const process_blocks_function function)
+{
+    static const unsigned char expected[SHA1_DIGEST_SIZE] = {
+        0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a, 0xba, 0x3e,
+        0x25, 0x71, 0x78, 0x50, 0xc2, 0x6c, 0x9c, 0xd0, 0xd8, 0x9d
+    };
+    static const size_t lengths[] = { 0, 1, 55, 56, 63, 64, 65, 119, 183,
+        247 };
+    unsigned char message[247];
+    unsigned char digest[SHA1_DIGEST_SIZE];
+    unsigned char portable[SHA1_DIGEST_SIZE];
+    uint32_t seed = 1;
+    size_t i;
+
+    digest_with(function, (const unsigned char *) "abc", 3, digest);
+    if (memcmp(digest, expected, sizeof expected) != 0) {
+        return false;
+    }
+
+    for (i = 0; i < sizeof message; ++i) {
+        seed = seed * 1103515245 + 12345;
+        message[i] = (unsigned char) (seed >> 16);
+    }
+    for (i = 0; i < sizeof lengths / sizeof lengths[0]; ++i) {
+        digest_with(function, message, lengths[i], digest);
+        digest_with(process_blocks_portable, message, lengths[i], portable);
+        if (memcmp(digest, portable, sizeof portable) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
+/* Chooses the fastest block function the processor supports.  */
+static void select_process_blocks(void)
+{
+    if (process_blocks) {
+        return;
+    }
+    process_blocks = process_blocks_portable;
+#ifdef SHA1_X86_SHA
+    if (has_x86_sha() && passes_known_answer(process_blocks_x86_sha)) {
+        process_blocks = process_blocks_x86_sha;
+    }
+#endif
+#ifdef SHA1_ARM_CE
+    if (has_arm_ce() && passes_known_answer(process_blocks_arm_ce)) {
+        process_blocks = process_blocks_arm_ce;
+    }
+#endif
+}
+
+/* Process LEN bytes of BUFFER, accumulating context into CTX.
+   It is assumed that LEN % 64 == 0.  */
+
+void sha1_process_block(const void *buffer, size_t len, struct sha1_ctx *ctx)
+{
+    uint32_t lolen = len;
+
+    /*
+     * First increment the byte count.  RFC 1321 specifies the possible
+     * length of the file up to 2^64 bits.  Here we only compute the
+     * number of bytes.  Do a double word increment.  
+     */
+    ctx->total[0] += lolen;
+    ctx->total[1] += (len >> 31 >> 1) + (ctx->total[0] < lolen);
+
+    select_process_blocks();
+    process_blocks(buffer, len / 64, ctx);
+}
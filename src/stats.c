@@ -0,0 +1,208 @@
+/*
+ * Gregorio is a program that translates gabc files to GregorioTeX
+ * This file implements the phase timing and statistics functions.
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * Gregorio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Gregorio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gregorio.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "bool.h"
+#include "struct.h"
+#include "support.h"
+#include "stats.h"
+
+/* the names used in the output, indexed by gregorio_stats_phase */
+static const char *const phase_names[STATS_NUMBER_OF_PHASES] = {
+    "read",
+    "parse",
+    "notes",
+    "glyphs",
+    "elements",
+    "vowels",
+    "oriscus_orientation",
+    "punctum_inclinatum_orientation",
+    "ledger_lines",
+    "initial_keys",
+    "score_characters",
+    "custos_suppression",
+    "next_pitches",
+    "custos_pitches",
+    "integrity",
+    "write",
+    "positioning",
+};
+
+typedef struct stats_timer {
+    double wall;
+    double cpu;
+    double wall_start;
+    double cpu_start;
+    unsigned long calls;
+} stats_timer;
+
+static bool stats_enabled = false;
+static stats_timer timers[STATS_NUMBER_OF_PHASES];
+
+/* returns a monotonic wall-clock time in seconds */
+double gregorio_stats_clock(void)
+{
+#if defined _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#elif defined CLOCK_MONOTONIC
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+static __inline double cpu_seconds(void)
+{
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+void gregorio_stats_enable(void)
+{
+    stats_enabled = true;
+}
+
+void gregorio_stats_start(const gregorio_stats_phase phase)
+{
+    if (stats_enabled) {
+        timers[phase].wall_start = gregorio_stats_clock();
+        timers[phase].cpu_start = cpu_seconds();
+    }
+}
+
+void gregorio_stats_stop(const gregorio_stats_phase phase)
+{
+    if (stats_enabled) {
+        timers[phase].wall +=
+            gregorio_stats_clock() - timers[phase].wall_start;
+        timers[phase].cpu += cpu_seconds() - timers[phase].cpu_start;
+        ++timers[phase].calls;
+    }
+}
+
+void gregorio_stats_count_score(const gregorio_score *const score,
+        gregorio_score_counts *const counts)
+{
+    const gregorio_syllable *syllable;
+    const gregorio_element *element;
+    const gregorio_glyph *glyph;
+    const gregorio_note *note;
+    int voice;
+
+    counts->syllables = counts->elements = counts->glyphs = counts->notes = 0;
+    if (!score) {
+        return;
+    }
+    for (syllable = score->first_syllable; syllable;
+            syllable = syllable->next_syllable) {
+        ++counts->syllables;
+        for (voice = 0; voice < score->number_of_voices; ++voice) {
+            for (element = syllable->elements[voice]; element;
+                    element = element->next) {
+                ++counts->elements;
+                if (element->type != GRE_ELEMENT) {
+                    continue;
+                }
+                for (glyph = element->u.first_glyph; glyph;
+                        glyph = glyph->next) {
+                    ++counts->glyphs;
+                    if (glyph->type != GRE_GLYPH) {
+                        continue;
+                    }
+                    for (note = glyph->u.notes.first_note; note;
+                            note = note->next) {
+                        ++counts->notes;
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void print_text(FILE *const f,
+        const gregorio_score_counts *const counts,
+        const size_t allocations, const size_t allocated_bytes)
+{
+    int i;
+
+    fprintf(f, "%-32s %6s %12s %12s\n", "phase", "calls", "wall (ms)",
+            "cpu (ms)");
+    for (i = 0; i < STATS_NUMBER_OF_PHASES; ++i) {
+        fprintf(f, "%-32s %6lu %12.3f %12.3f\n", phase_names[i],
+                timers[i].calls, timers[i].wall * 1000.0,
+                timers[i].cpu * 1000.0);
+    }
+    fprintf(f, "allocations: %lu (%lu bytes)\n", (unsigned long)allocations,
+            (unsigned long)allocated_bytes);
+    fprintf(f, "syllables: %lu, elements: %lu, glyphs: %lu, notes: %lu\n",
+            counts->syllables, counts->elements, counts->glyphs,
+            counts->notes);
+}
+
+static void print_json(FILE *const f,
+        const gregorio_score_counts *const counts,
+        const size_t allocations, const size_t allocated_bytes)
+{
+    int i;
+
+    fprintf(f, "{\n  \"version\": \"%s\",\n  \"phases\": {\n",
+            GREGORIO_VERSION);
+    for (i = 0; i < STATS_NUMBER_OF_PHASES; ++i) {
+        fprintf(f, "    \"%s\": {\"calls\": %lu, \"wall\": %.9f, "
+                "\"cpu\": %.9f}%s\n", phase_names[i], timers[i].calls,
+                timers[i].wall, timers[i].cpu,
+                i + 1 < STATS_NUMBER_OF_PHASES ? "," : "");
+    }
+    fprintf(f, "  },\n  \"allocations\": {\"count\": %lu, \"bytes\": %lu},\n",
+            (unsigned long)allocations, (unsigned long)allocated_bytes);
+    fprintf(f, "  \"score\": {\"syllables\": %lu, \"elements\": %lu, "
+            "\"glyphs\": %lu, \"notes\": %lu}\n}\n", counts->syllables,
+            counts->elements, counts->glyphs, counts->notes);
+}
+
+void gregorio_stats_print(FILE *const f, const gregorio_score *const score,
+        const gregorio_stats_format format)
+{
+    gregorio_score_counts counts;
+    size_t allocations, allocated_bytes;
+
+    gregorio_stats_count_score(score, &counts);
+    gregorio_allocation_counts(&allocations, &allocated_bytes);
+
+    switch (format) {
+    case STATS_JSON:
+        print_json(f, &counts, allocations, allocated_bytes);
+        break;
+    default:
+        print_text(f, &counts, allocations, allocated_bytes);
+        break;
+    }
+}
@@ -0,0 +1,76 @@
+/*
+ * Gregorio is a program that translates gabc files to GregorioTeX
+ * This header prototypes the phase timing and statistics functions.
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * Gregorio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Gregorio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gregorio.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include "bool.h"
+#include "struct.h"
+
+/* The phases are not exclusive: STATS_READ covers everything done by
+ * gabc_read_score, STATS_PARSE covers the parsing of the gabc file (which
+ * includes the determination of notes, glyphs and elements and the loading
+ * of the vowel tables), and STATS_WRITE includes STATS_POSITIONING. */
+typedef enum gregorio_stats_phase {
+    STATS_READ = 0,
+    STATS_PARSE,
+    STATS_NOTES,
+    STATS_GLYPHS,
+    STATS_ELEMENTS,
+    STATS_VOWELS,
+    STATS_ORISCUS_ORIENTATION,
+    STATS_PUNCTUM_INCLINATUM_ORIENTATION,
+    STATS_LEDGER_LINES,
+    STATS_INITIAL_KEYS,
+    STATS_SCORE_CHARACTERS,
+    STATS_CUSTOS_SUPPRESSION,
+    STATS_NEXT_PITCHES,
+    STATS_CUSTOS_PITCHES,
+    STATS_INTEGRITY,
+    STATS_WRITE,
+    STATS_POSITIONING,
+    STATS_NUMBER_OF_PHASES
+} gregorio_stats_phase;
+
+typedef enum gregorio_stats_format {
+    STATS_TEXT = 0,
+    STATS_JSON
+} gregorio_stats_format;
+
+typedef struct gregorio_score_counts {
+    unsigned long syllables;
+    unsigned long elements;
+    unsigned long glyphs;
+    unsigned long notes;
+} gregorio_score_counts;
+
+double gregorio_stats_clock(void);
+void gregorio_stats_count_score(const gregorio_score *score,
+        gregorio_score_counts *counts);
+void gregorio_stats_enable(void);
+void gregorio_stats_start(gregorio_stats_phase phase);
+void gregorio_stats_stop(gregorio_stats_phase phase);
+void gregorio_stats_print(FILE *f, const gregorio_score *score,
+        gregorio_stats_format format);
+
+#endif
@@ -112,6 +112,18 @@ void gregorio_struct_destroy(void)
     free(texverbs);
 }
 
+/* forgets the texverbs, horizontal episema adjustments and TeX position ids
+ * of the scores read so far, which must all have been freed, so that the next
+ * score is numbered as if it were the first */
+void gregorio_struct_reset(void)
+{
+    gregorio_struct_destroy();
+    hepisema_adjustments_last = 0;
+    texverbs_last = 0;
+    gregorio_struct_init();
+    tex_position_id = 0;
+}
+
 static unsigned short register_texverb(char *const texverb)
 {
     if (texverbs_last == USHRT_MAX) {
@@ -1070,8 +1082,9 @@ void gregorio_add_syllable(gregorio_syllable **current_syllable,
     gregorio_element **tab;
     int i;
     gregorio_not_null(elements, gregorio_add_syllable, return);
-    gregorio_assert(number_of_voices == 1, gregorio_add_syllable,
-            "gregorio only supports one voice", return);
+    gregorio_assert(number_of_voices >= 1
+            && number_of_voices <= MAX_NUMBER_OF_VOICES, gregorio_add_syllable,
+            "invalid number of voices", return);
     next = gregorio_calloc(1, sizeof(gregorio_syllable));
     next->position = position;
     next->no_linebreak_area = no_linebreak_area;
@@ -1127,7 +1140,7 @@ static void gregorio_free_one_syllable(gregorio_syllable **syllable,
     *syllable = next;
 }
 
-static void gregorio_free_syllables(gregorio_syllable **syllable,
+void gregorio_free_syllables(gregorio_syllable **syllable,
         int number_of_voices)
 {
     gregorio_not_null_ptr(syllable, gregorio_free_one_syllable, return);
@@ -1165,9 +1178,49 @@ static void free_headers(gregorio_score *score) {
     }
 }
 
+/* the nodes and strings of a single-block score are freed with the block, but
+ * its texverbs are registered like those of any score */
+static void free_single_block_score(gregorio_score *const score)
+{
+    gregorio_syllable *syllable;
+    gregorio_element *element;
+    gregorio_glyph *glyph;
+    gregorio_note *note;
+    int voice;
+
+    for (syllable = score->first_syllable; syllable;
+            syllable = syllable->next_syllable) {
+        for (voice = 0; voice < score->number_of_voices; ++voice) {
+            for (element = syllable->elements[voice]; element;
+                    element = element->next) {
+                free_one_texverb(element->texverb);
+                if (element->type != GRE_ELEMENT) {
+                    continue;
+                }
+                for (glyph = element->u.first_glyph; glyph;
+                        glyph = glyph->next) {
+                    free_one_texverb(glyph->texverb);
+                    if (glyph->type != GRE_GLYPH) {
+                        continue;
+                    }
+                    for (note = glyph->u.notes.first_note; note;
+                            note = note->next) {
+                        free_one_texverb(note->texverb);
+                    }
+                }
+            }
+        }
+    }
+    free(score);
+}
+
 void gregorio_free_score(gregorio_score *score)
 {
     gregorio_not_null(score, gregorio_free_score, return);
+    if (score->single_block) {
+        free_single_block_score(score);
+        return;
+    }
     if (score->first_syllable) {
         gregorio_free_syllables(&(score->first_syllable),
                 score->number_of_voices);
@@ -1180,9 +1233,9 @@ void gregorio_free_score(gregorio_score *score)
 void gregorio_add_voice_info(gregorio_voice_info **current_voice_info)
 {
     gregorio_voice_info *next = gregorio_calloc(1, sizeof(gregorio_voice_info));
-    gregorio_assert(!*current_voice_info, gregorio_add_voice_info,
-            "since gregorio only supports once voice, this should only be "
-            "called once", (*current_voice_info)->next_voice_info = next);
+    if (*current_voice_info) {
+        (*current_voice_info)->next_voice_info = next;
+    }
     *current_voice_info = next;
 }
 
@@ -1363,12 +1416,122 @@ static signed char syllable_first_note(const gregorio_syllable *syllable,
     return 0;
 }
 
+/* records the alterations of an alteration glyph on the pitch of the note
+ * that follows, unless an alteration closer to that note was already found */
+static __inline void apply_alterations_to_next_pitch(
+        const gregorio_glyph *const glyph, gregorio_next_pitch *const next)
+{
+    const gregorio_note *note;
+    for (note = glyph->u.notes.first_note; note; note = note->next) {
+        switch (note->u.note.shape) {
+        case S_FLAT:
+        case S_FLAT_PAREN:
+        case S_FLAT_SOFT:
+        case S_SHARP:
+        case S_SHARP_PAREN:
+        case S_SHARP_SOFT:
+        case S_NATURAL:
+        case S_NATURAL_PAREN:
+        case S_NATURAL_SOFT:
+            break;
+        default:
+            /* not reachable unless there's a programming error */
+            /* LCOV_EXCL_START */
+            gregorio_fail2(apply_alterations_to_next_pitch,
+                    "unrecognized alteration shape: %s",
+                    gregorio_shape_to_string(note->u.note.shape));
+            continue;
+            /* LCOV_EXCL_STOP */
+        }
+        /* when a glyph alters the same pitch several times, the last one
+         * wins, so we don't stop at the first match */
+        if (next->note && next->note->u.note.pitch == note->u.note.pitch) {
+            next->alteration = note->u.note.shape;
+        }
+    }
+}
+
+/*
+ * Walks each voice of the score backwards, recording in each element and
+ * glyph the next pitched item of its voice and its alteration, so that
+ * gregorio_determine_next_pitch runs in constant time.  This must be called
+ * once the element and glyph lists are final.
+ */
+void gregorio_determine_next_pitches(gregorio_score *const score)
+{
+    gregorio_syllable *last, *syllable;
+    gregorio_element *element;
+    gregorio_glyph *glyph;
+    gregorio_next_pitch next;
+    int voice;
+
+    gregorio_not_null(score, gregorio_determine_next_pitches, return);
+
+    last = score->first_syllable;
+    if (!last) {
+        return;
+    }
+    while (last->next_syllable) {
+        last = last->next_syllable;
+    }
+    for (voice = 0; voice < score->number_of_voices; ++voice) {
+        memset(&next, 0, sizeof next);
+        next.alteration = S_UNDETERMINED;
+        next.determined = true;
+
+        for (syllable = last; syllable;
+                syllable = syllable->previous_syllable) {
+            element = syllable->elements[voice];
+            if (!element) {
+                continue;
+            }
+            while (element->next) {
+                element = element->next;
+            }
+            for (; element; element = element->previous) {
+                element->next_pitch = next;
+                if (element->type == GRE_CUSTOS) {
+                    next.note = NULL;
+                    next.custos = element;
+                    next.alteration = S_UNDETERMINED;
+                    continue;
+                }
+                if (element->type != GRE_ELEMENT || !element->u.first_glyph) {
+                    continue;
+                }
+                glyph = element->u.first_glyph;
+                while (glyph->next) {
+                    glyph = glyph->next;
+                }
+                for (; glyph; glyph = glyph->previous) {
+                    glyph->next_pitch = next;
+                    if (glyph->type != GRE_GLYPH) {
+                        continue;
+                    }
+                    if (glyph->u.notes.glyph_type == G_ALTERATION) {
+                        /* an alteration closer to the note wins */
+                        if (next.alteration == S_UNDETERMINED) {
+                            apply_alterations_to_next_pitch(glyph, &next);
+                        }
+                    } else if (glyph->u.notes.first_note) {
+                        assert(glyph->u.notes.first_note->type == GRE_NOTE);
+                        next.note = glyph->u.notes.first_note;
+                        next.custos = NULL;
+                        next.alteration = S_UNDETERMINED;
+                    }
+                }
+            }
+        }
+    }
+}
+
 /* shape is an output parameter */
 signed char gregorio_determine_next_pitch(const gregorio_syllable *syllable,
         const gregorio_element *element, const gregorio_glyph *glyph,
         gregorio_shape *const shape)
 {
     signed char pitch;
+    const gregorio_next_pitch *next;
     gregorio_shape alterations[MAX_PITCH + 1];
 
     memset(alterations, 0, sizeof alterations);
@@ -1380,7 +1543,22 @@ signed char gregorio_determine_next_pitch(const gregorio_syllable *syllable,
             return DUMMY_PITCH);
     gregorio_not_null(syllable, gregorio_determine_next_pitch,
             return DUMMY_PITCH);
-    /* we first explore the next glyphs to find a note, if there is one */
+    /* use the links of gregorio_determine_next_pitches if available */
+    next = glyph ? &glyph->next_pitch : &element->next_pitch;
+    if (next->determined) {
+        if (next->note) {
+            if (shape) {
+                *shape = next->alteration;
+            }
+            return next->note->u.note.pitch;
+        }
+        if (next->custos) {
+            return next->custos->u.misc.pitched.pitch;
+        }
+        return DUMMY_PITCH;
+    }
+    /* otherwise, we first explore the next glyphs to find a note, if there
+     * is one */
     if (glyph) {
         glyph = glyph->next;
         pitch = next_pitch_from_glyph(glyph, alterations, shape);
@@ -1593,6 +1771,12 @@ gregorio_hepisema_adjustment *gregorio_get_hepisema_adjustment(
     return &hepisema_adjustments[index];
 }
 
+/* registers a texverb which is not yet in a note, returning its index */
+unsigned short gregorio_add_texverb(char *const texverb)
+{
+    return register_texverb(texverb);
+}
+
 const char *gregorio_texverb(unsigned short index)
 {
     gregorio_assert(index <= texverbs_last, gregorio_texverb,
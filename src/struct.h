@@ -36,6 +36,7 @@
 #include "enum_generator.h"
 #include "bool.h"
 #include "sha1.h"
+#include "xxh3.h"
 #include "messages.h"
 
 #ifdef __cplusplus
@@ -528,6 +529,24 @@ typedef struct gregorio_note {
     bool choral_sign_is_nabc:1;
 } gregorio_note;
 
+/*
+ * gregorio_next_pitch caches, for a glyph or an element, the next pitched
+ * item that follows it in the score (across elements and syllables), so that
+ * gregorio_determine_next_pitch does not have to scan forward each time it
+ * is called.  It is filled by gregorio_determine_next_pitches.
+ */
+typedef struct gregorio_next_pitch {
+    /* the first note of the next glyph with notes, if a note comes next */
+    const struct gregorio_note *note;
+    /* the next custos, if a custos comes next; its pitch is read when the
+     * cache is consulted, because custos pitches are adjusted afterwards */
+    const struct gregorio_element *custos;
+    /* the alteration set on the pitch of note between the item and note */
+    ENUM_BITFIELD(gregorio_shape) alteration:8;
+    /* true once the cache has been filled */
+    bool determined:1;
+} gregorio_next_pitch;
+
 /*
  * ! @brief The gregorio glyph structure Unlike gregorio_note, gregorio_glyph
  * can be other things besides GRE_GLYPH: it can also be GRE_SPACE
@@ -554,6 +573,9 @@ typedef struct gregorio_glyph {
         union gregorio_misc_element_info misc;
     } u;
 
+    /* the next pitched item after this glyph */
+    gregorio_next_pitch next_pitch;
+
     /* index to a string containing a possible TeX verbatim; necessary during
      * structure generation. */
     unsigned short texverb;
@@ -581,6 +603,8 @@ typedef struct gregorio_element {
         struct gregorio_glyph *first_glyph;
         union gregorio_misc_element_info misc;
     } u;
+    /* the next pitched item after this element */
+    gregorio_next_pitch next_pitch;
 
     /* index to a string containing a possible TeX verbatim; necessary during
      * structure generation. */
@@ -703,7 +727,18 @@ typedef struct gregorio_header {
 
 #define MAX_ANNOTATIONS 2
 
+/* the algorithm used to compute the digest identifying a score */
+typedef enum gregorio_digest_algorithm {
+    /* SHA-1, written as 40 hexadecimal digits */
+    DIGEST_SHA1 = 0,
+    /* XXH3 128-bit, written as "xxh3-" followed by 32 hexadecimal digits;
+     * it is much faster, but not cryptographically strong, which is enough
+     * for detecting changes */
+    DIGEST_XXH3
+} gregorio_digest_algorithm;
+
 typedef struct gregorio_score {
+    /* the digest of the input (large enough for any digest_algorithm) */
     unsigned char digest[SHA1_DIGEST_SIZE];
     /* the structure starts by a pointer to the first syllable of the
      * score. */
@@ -738,6 +773,10 @@ typedef struct gregorio_score {
     signed char high_ledger_line_pitch;
     signed char virgula_far_pitch;
     bool legacy_oriscus_orientation;
+    ENUM_BITFIELD(gregorio_digest_algorithm) digest_algorithm:1;
+    /* true for a score loaded from a gbin file, which holds all its nodes and
+     * strings in the block it starts (see gbin.c) */
+    bool single_block:1;
 } gregorio_score;
 
 /*
@@ -819,6 +858,7 @@ static __inline bool is_fused(char liquescentia)
 
 void gregorio_struct_init(void);
 void gregorio_struct_destroy(void);
+void gregorio_struct_reset(void);
 gregorio_score *gregorio_new_score(void);
 void gregorio_add_note(gregorio_note **current_note, signed char pitch,
         gregorio_shape shape, gregorio_sign signs,
@@ -858,6 +898,8 @@ void gregorio_free_one_note(gregorio_note **note);
 void gregorio_free_one_glyph(gregorio_glyph **glyph);
 void gregorio_free_one_element(gregorio_element **element);
 void gregorio_free_score(gregorio_score *score);
+void gregorio_free_syllables(gregorio_syllable **syllable,
+        int number_of_voices);
 void gregorio_free_characters(gregorio_character *current_character);
 void gregorio_go_to_first_character(const gregorio_character **character);
 void gregorio_add_clef_as_glyph(gregorio_glyph **current_glyph,
@@ -919,6 +961,7 @@ void gregorio_begin_style(gregorio_character **current_character,
 void gregorio_end_style(gregorio_character **current_character,
         grestyle_style style);
 gregorio_character *gregorio_clone_characters(const gregorio_character *source);
+void gregorio_determine_next_pitches(gregorio_score *score);
 signed char gregorio_determine_next_pitch(const gregorio_syllable *syllable,
         const gregorio_element *element, const gregorio_glyph *glyph,
         gregorio_shape *next_pitch_alteration);
@@ -928,6 +971,7 @@ unsigned short gregorio_add_hepisema_adjustment(
         gregorio_hepisema_vbasepos vbasepos, char *nudge);
 gregorio_hepisema_adjustment *gregorio_get_hepisema_adjustment(
         unsigned short index);
+unsigned short gregorio_add_texverb(char *texverb);
 const char *gregorio_texverb(unsigned short index);
 void gregorio_change_texverb(unsigned short index, char *texverb);
 
@@ -38,19 +38,27 @@ void gregorio_snprintf(char *s, size_t size, const char *format, ...)
 {
     va_list args;
 
-#ifdef _MSC_VER
-    memset(s, 0, size);
-#endif
-
     va_start(args, format);
+    gregorio_vsnprintf(s, size, format, args);
+    va_end(args);
+}
+
+void gregorio_vsnprintf(char *s, size_t size, const char *format,
+        va_list args)
+{
 #ifdef _MSC_VER
+    memset(s, 0, size);
     _vsnprintf_s(s, size, _TRUNCATE, format, args);
 #else
     vsnprintf(s, size, format, args);
 #endif
-    va_end(args);
 }
 
+/* the number of allocations done through the functions below, and the total
+ * number of bytes requested, reported by gregorio --stats */
+static size_t allocation_count = 0;
+static size_t allocation_bytes = 0;
+
 static __inline void *assert_successful_allocation(void *ptr, char *funcname) {
     if (!ptr) {
         /* it's not realistic to test this for coverage  */
@@ -65,24 +73,38 @@ static __inline void *assert_successful_allocation(void *ptr, char *funcname) {
 
 void *gregorio_malloc(size_t size)
 {
+    ++allocation_count;
+    allocation_bytes += size;
     return assert_successful_allocation(malloc(size), "gregorio_malloc");
 }
 
 void *gregorio_calloc(size_t nmemb, size_t size)
 {
+    ++allocation_count;
+    allocation_bytes += nmemb * size;
     return assert_successful_allocation(calloc(nmemb, size), "gregorio_calloc");
 }
 
 void *gregorio_realloc(void *ptr, size_t size)
 {
+    ++allocation_count;
+    allocation_bytes += size;
     return assert_successful_allocation(realloc(ptr, size), "gregorio_realloc");
 }
 
 char *gregorio_strdup(const char *s)
 {
+    ++allocation_count;
+    allocation_bytes += strlen(s) + 1;
     return (char *)assert_successful_allocation(strdup(s), "gregorio_strdup");
 }
 
+void gregorio_allocation_counts(size_t *const count, size_t *const bytes)
+{
+    *count = allocation_count;
+    *bytes = allocation_bytes;
+}
+
 void *_gregorio_grow_buffer(void *buffer, size_t *nmemb, size_t size)
 {
     if (buffer == NULL) {
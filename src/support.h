@@ -25,6 +25,7 @@
 
 #include <stdlib.h>
 #include <limits.h>
+#include <stdarg.h>
 #ifdef USE_KPSE
 #include <kpathsea/kpathsea.h>
 #endif
@@ -38,11 +39,14 @@
 
 void gregorio_snprintf(char *s, size_t size, const char *format, ...)
         __attribute__((__format__ (__printf__, 3, 4)));
+void gregorio_vsnprintf(char *s, size_t size, const char *format,
+        va_list args) __attribute__((__format__ (__printf__, 3, 0)));
 void *gregorio_malloc(size_t size) __attribute__((malloc));
 void *gregorio_calloc(size_t nmemb, size_t size) __attribute__((malloc));
 void *gregorio_realloc(void *ptr, size_t size)
     __attribute__((warn_unused_result));
 char *gregorio_strdup(const char *s) __attribute__((malloc));
+void gregorio_allocation_counts(size_t *count, size_t *bytes);
 void *_gregorio_grow_buffer(void *buffer, size_t *nmemb, size_t size)
     __attribute__((warn_unused_result));
 void gregorio_support_init(const char *program, const char *argv0);
@@ -257,18 +257,23 @@ void gregorio_vowel_tables_free(void)
 {
     if (vowel_table) {
         character_set_free(vowel_table);
+        vowel_table = NULL;
     }
     if (prefix_table) {
         character_set_free(prefix_table);
+        prefix_table = NULL;
     }
     if (suffix_table) {
         character_set_free(suffix_table);
+        suffix_table = NULL;
     }
     if (secondary_table) {
         character_set_free(secondary_table);
+        secondary_table = NULL;
     }
     if (prefix_buffer) {
         free(prefix_buffer);
+        prefix_buffer = NULL;
     }
 }
 
@@ -0,0 +1,453 @@
+/*
+ * Gregorio is a program that translates gabc files to GregorioTeX
+ * This file implements the XXH3 128-bit hash, used as a fast (non
+ * cryptographic) alternative to the SHA-1 score digest.
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * Gregorio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Gregorio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gregorio.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This is a straightforward implementation of the XXH3 128-bit algorithm
+ * from the xxHash specification (https://github.com/Cyan4973/xxHash), with
+ * the default secret and a seed of 0, so that its results are identical to
+ * those of XXH3_128bits.  It favours portability (C89, no 128-bit integers,
+ * no vector intrinsics, byte-wise little-endian reads) over raw speed.
+ */
+
+#include "config.h"
+#include "xxh3.h"
+#include <string.h>
+
+/* builds a 64-bit constant from its two 32-bit halves, avoiding long long
+ * literals which are not C89 */
+#define U64(hi, lo) ((((uint64_t) (hi)) << 32) | (uint64_t) (lo))
+
+#define PRIME32_1 0x9E3779B1U
+#define PRIME32_2 0x85EBCA77U
+#define PRIME32_3 0xC2B2AE3DU
+#define PRIME64_1 U64(0x9E3779B1U, 0x85EBCA87U)
+#define PRIME64_2 U64(0xC2B2AE3DU, 0x27D4EB4FU)
+#define PRIME64_3 U64(0x165667B1U, 0x9E3779F9U)
+#define PRIME64_4 U64(0x85EBCA77U, 0xC2B2AE63U)
+#define PRIME64_5 U64(0x27D4EB2FU, 0x165667C5U)
+#define PRIME_MX1 U64(0x16566791U, 0x9E3779F9U)
+#define PRIME_MX2 U64(0x9FB21C65U, 0x1E98DF25U)
+
+#define STRIPE_LEN 64
+#define SECRET_SIZE 192
+#define SECRET_CONSUME_RATE 8
+#define SECRET_LIMIT (SECRET_SIZE - STRIPE_LEN)
+#define STRIPES_PER_BLOCK (SECRET_LIMIT / SECRET_CONSUME_RATE)
+#define SECRET_MERGEACCS_START 11
+#define SECRET_LASTACC_START 7
+#define MIDSIZE_MAX 240
+#define MIDSIZE_STARTOFFSET 3
+#define MIDSIZE_LASTOFFSET 17
+#define SECRET_SIZE_MIN 136
+
+static const unsigned char secret[SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c,
+    0xf7, 0x21, 0xad, 0x1c, 0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb,
+    0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f, 0xcb, 0x79, 0xe6, 0x4e,
+    0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6,
+    0x81, 0x3a, 0x26, 0x4c, 0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb,
+    0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3, 0x71, 0x64, 0x48, 0x97,
+    0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7,
+    0xc7, 0x0b, 0x4f, 0x1d, 0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31,
+    0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64, 0xea, 0xc5, 0xac, 0x83,
+    0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26,
+    0x29, 0xd4, 0x68, 0x9e, 0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc,
+    0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce, 0x45, 0xcb, 0x3a, 0x8f,
+    0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+typedef struct uint128 {
+    uint64_t low;
+    uint64_t high;
+} uint128;
+
+static __inline uint32_t read32(const unsigned char *const p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16)
+            | ((uint32_t) p[3] << 24);
+}
+
+static __inline uint64_t read64(const unsigned char *const p)
+{
+    return (uint64_t) read32(p) | ((uint64_t) read32(p + 4) << 32);
+}
+
+static __inline uint32_t swap32(const uint32_t x)
+{
+    return (x << 24) | ((x << 8) & 0x00ff0000U) | ((x >> 8) & 0x0000ff00U)
+            | (x >> 24);
+}
+
+static __inline uint64_t swap64(const uint64_t x)
+{
+    return ((uint64_t) swap32((uint32_t) x) << 32)
+            | (uint64_t) swap32((uint32_t) (x >> 32));
+}
+
+static __inline uint32_t rotl32(const uint32_t x, const int r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+/* full 64x64->128 multiplication, computed with 32-bit halves */
+static __inline uint128 mult64to128(const uint64_t lhs, const uint64_t rhs)
+{
+    const uint64_t lo_lo = (lhs & 0xFFFFFFFFU) * (rhs & 0xFFFFFFFFU);
+    const uint64_t hi_lo = (lhs >> 32) * (rhs & 0xFFFFFFFFU);
+    const uint64_t lo_hi = (lhs & 0xFFFFFFFFU) * (rhs >> 32);
+    const uint64_t hi_hi = (lhs >> 32) * (rhs >> 32);
+    const uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFU) + lo_hi;
+    uint128 result;
+    result.high = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    result.low = (cross << 32) | (lo_lo & 0xFFFFFFFFU);
+    return result;
+}
+
+static __inline uint64_t mul128_fold64(const uint64_t lhs, const uint64_t rhs)
+{
+    const uint128 product = mult64to128(lhs, rhs);
+    return product.low ^ product.high;
+}
+
+static __inline uint64_t xorshift64(const uint64_t v, const int shift)
+{
+    return v ^ (v >> shift);
+}
+
+static __inline uint64_t xxh64_avalanche(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static __inline uint64_t xxh3_avalanche(uint64_t h)
+{
+    h = xorshift64(h, 37);
+    h *= PRIME_MX1;
+    h = xorshift64(h, 32);
+    return h;
+}
+
+static uint128 hash_len_1to3(const unsigned char *const input,
+        const size_t len)
+{
+    const uint32_t c1 = input[0];
+    const uint32_t c2 = input[len >> 1];
+    const uint32_t c3 = input[len - 1];
+    const uint32_t combinedl = (c1 << 16) | (c2 << 24) | c3
+            | ((uint32_t) len << 8);
+    const uint32_t combinedh = rotl32(swap32(combinedl), 13);
+    const uint64_t bitflipl = read32(secret) ^ read32(secret + 4);
+    const uint64_t bitfliph = read32(secret + 8) ^ read32(secret + 12);
+    uint128 h;
+    h.low = xxh64_avalanche((uint64_t) combinedl ^ bitflipl);
+    h.high = xxh64_avalanche((uint64_t) combinedh ^ bitfliph);
+    return h;
+}
+
+static uint128 hash_len_4to8(const unsigned char *const input,
+        const size_t len)
+{
+    const uint64_t input_64 = (uint64_t) read32(input)
+            + ((uint64_t) read32(input + len - 4) << 32);
+    const uint64_t bitflip = read64(secret + 16) ^ read64(secret + 24);
+    uint128 m = mult64to128(input_64 ^ bitflip,
+            PRIME64_1 + ((uint64_t) len << 2));
+    m.high += m.low << 1;
+    m.low ^= m.high >> 3;
+    m.low = xorshift64(m.low, 35);
+    m.low *= PRIME_MX2;
+    m.low = xorshift64(m.low, 28);
+    m.high = xxh3_avalanche(m.high);
+    return m;
+}
+
+static uint128 hash_len_9to16(const unsigned char *const input,
+        const size_t len)
+{
+    const uint64_t bitflipl = read64(secret + 32) ^ read64(secret + 40);
+    const uint64_t bitfliph = read64(secret + 48) ^ read64(secret + 56);
+    const uint64_t input_lo = read64(input);
+    uint64_t input_hi = read64(input + len - 8);
+    uint128 m = mult64to128(input_lo ^ input_hi ^ bitflipl, PRIME64_1);
+    uint128 h;
+    m.low += (uint64_t) (len - 1) << 54;
+    input_hi ^= bitfliph;
+    m.high += input_hi + (uint64_t) (uint32_t) input_hi * (PRIME32_2 - 1);
+    m.low ^= swap64(m.high);
+    h = mult64to128(m.low, PRIME64_2);
+    h.high += m.high * PRIME64_2;
+    h.low = xxh3_avalanche(h.low);
+    h.high = xxh3_avalanche(h.high);
+    return h;
+}
+
+static __inline uint64_t mix16(const unsigned char *const input,
+        const unsigned char *const key)
+{
+    return mul128_fold64(read64(input) ^ read64(key),
+            read64(input + 8) ^ read64(key + 8));
+}
+
+static __inline void mix32(uint128 *const acc,
+        const unsigned char *const input_1,
+        const unsigned char *const input_2, const unsigned char *const key)
+{
+    acc->low += mix16(input_1, key);
+    acc->low ^= read64(input_2) + read64(input_2 + 8);
+    acc->high += mix16(input_2, key + 16);
+    acc->high ^= read64(input_1) + read64(input_1 + 8);
+}
+
+static uint128 finish_midsize(const uint128 acc, const size_t len)
+{
+    uint128 h;
+    h.low = acc.low + acc.high;
+    h.high = acc.low * PRIME64_1 + acc.high * PRIME64_4
+            + (uint64_t) len * PRIME64_2;
+    h.low = xxh3_avalanche(h.low);
+    h.high = (uint64_t) 0 - xxh3_avalanche(h.high);
+    return h;
+}
+
+static uint128 hash_len_17to128(const unsigned char *const input,
+        const size_t len)
+{
+    uint128 acc;
+    acc.low = (uint64_t) len * PRIME64_1;
+    acc.high = 0;
+    if (len > 32) {
+        if (len > 64) {
+            if (len > 96) {
+                mix32(&acc, input + 48, input + len - 64, secret + 96);
+            }
+            mix32(&acc, input + 32, input + len - 48, secret + 64);
+        }
+        mix32(&acc, input + 16, input + len - 32, secret + 32);
+    }
+    mix32(&acc, input, input + len - 16, secret);
+    return finish_midsize(acc, len);
+}
+
+static uint128 hash_len_129to240(const unsigned char *const input,
+        const size_t len)
+{
+    const size_t rounds = len / 32;
+    uint128 acc;
+    size_t i;
+    acc.low = (uint64_t) len * PRIME64_1;
+    acc.high = 0;
+    for (i = 0; i < 4; ++i) {
+        mix32(&acc, input + 32 * i, input + 32 * i + 16, secret + 32 * i);
+    }
+    acc.low = xxh3_avalanche(acc.low);
+    acc.high = xxh3_avalanche(acc.high);
+    for (i = 4; i < rounds; ++i) {
+        mix32(&acc, input + 32 * i, input + 32 * i + 16,
+                secret + MIDSIZE_STARTOFFSET + 32 * (i - 4));
+    }
+    mix32(&acc, input + len - 16, input + len - 32,
+            secret + SECRET_SIZE_MIN - MIDSIZE_LASTOFFSET - 16);
+    return finish_midsize(acc, len);
+}
+
+static uint128 hash_short(const unsigned char *const input, const size_t len)
+{
+    if (len > 128) {
+        return hash_len_129to240(input, len);
+    }
+    if (len > 16) {
+        return hash_len_17to128(input, len);
+    }
+    if (len > 8) {
+        return hash_len_9to16(input, len);
+    }
+    if (len >= 4) {
+        return hash_len_4to8(input, len);
+    }
+    if (len) {
+        return hash_len_1to3(input, len);
+    }
+    {
+        uint128 h;
+        h.low = xxh64_avalanche(read64(secret + 64) ^ read64(secret + 72));
+        h.high = xxh64_avalanche(read64(secret + 80) ^ read64(secret + 88));
+        return h;
+    }
+}
+
+static __inline void accumulate_stripe(uint64_t *const acc,
+        const unsigned char *const input, const unsigned char *const key)
+{
+    int i;
+    for (i = 0; i < 8; ++i) {
+        const uint64_t data = read64(input + 8 * i);
+        const uint64_t keyed = data ^ read64(key + 8 * i);
+        acc[i ^ 1] += data;
+        acc[i] += (keyed & 0xFFFFFFFFU) * (keyed >> 32);
+    }
+}
+
+static __inline void scramble(uint64_t *const acc,
+        const unsigned char *const key)
+{
+    int i;
+    for (i = 0; i < 8; ++i) {
+        acc[i] = (xorshift64(acc[i], 47) ^ read64(key + 8 * i)) * PRIME32_1;
+    }
+}
+
+/* accumulates STRIPES stripes of INPUT, scrambling at the end of blocks */
+static void consume_stripes(uint64_t *const acc,
+        size_t *const stripes_in_block, const unsigned char *input,
+        size_t stripes)
+{
+    while (stripes) {
+        size_t count = STRIPES_PER_BLOCK - *stripes_in_block;
+        size_t i;
+        if (count > stripes) {
+            count = stripes;
+        }
+        for (i = 0; i < count; ++i) {
+            accumulate_stripe(acc, input + i * STRIPE_LEN,
+                    secret + (*stripes_in_block + i) * SECRET_CONSUME_RATE);
+        }
+        input += count * STRIPE_LEN;
+        stripes -= count;
+        *stripes_in_block += count;
+        if (*stripes_in_block == STRIPES_PER_BLOCK) {
+            scramble(acc, secret + SECRET_LIMIT);
+            *stripes_in_block = 0;
+        }
+    }
+}
+
+static __inline uint64_t merge_accs(const uint64_t *const acc,
+        const unsigned char *const key, const uint64_t start)
+{
+    uint64_t result = start;
+    int i;
+    for (i = 0; i < 4; ++i) {
+        result += mul128_fold64(acc[2 * i] ^ read64(key + 16 * i),
+                acc[2 * i + 1] ^ read64(key + 16 * i + 8));
+    }
+    return xxh3_avalanche(result);
+}
+
+void xxh3_init_ctx(struct xxh3_ctx *ctx)
+{
+    ctx->acc[0] = PRIME32_3;
+    ctx->acc[1] = PRIME64_1;
+    ctx->acc[2] = PRIME64_2;
+    ctx->acc[3] = PRIME64_3;
+    ctx->acc[4] = PRIME64_4;
+    ctx->acc[5] = PRIME32_2;
+    ctx->acc[6] = PRIME64_5;
+    ctx->acc[7] = PRIME32_1;
+    ctx->total = 0;
+    ctx->stripes_in_block = 0;
+    ctx->buflen = 0;
+}
+
+void xxh3_process_bytes(const void *buffer, size_t len, struct xxh3_ctx *ctx)
+{
+    const unsigned char *input = buffer;
+
+    ctx->total += len;
+
+    if (ctx->buflen + len <= XXH3_BUFFER_SIZE) {
+        memcpy(ctx->buffer + ctx->buflen, input, len);
+        ctx->buflen += len;
+        return;
+    }
+
+    /* the last bytes are always kept in the buffer, so that the final stripe
+     * can be processed by xxh3_finish_ctx */
+    if (ctx->buflen) {
+        const size_t add = XXH3_BUFFER_SIZE - ctx->buflen;
+        memcpy(ctx->buffer + ctx->buflen, input, add);
+        input += add;
+        len -= add;
+        consume_stripes(ctx->acc, &ctx->stripes_in_block, ctx->buffer,
+                XXH3_BUFFER_SIZE / STRIPE_LEN);
+        ctx->buflen = 0;
+    }
+
+    if (len > XXH3_BUFFER_SIZE) {
+        const size_t stripes = (len - 1) / STRIPE_LEN;
+        consume_stripes(ctx->acc, &ctx->stripes_in_block, input, stripes);
+        input += stripes * STRIPE_LEN;
+        len -= stripes * STRIPE_LEN;
+        /* keep the previous stripe for a short final stripe */
+        memcpy(ctx->buffer + XXH3_BUFFER_SIZE - STRIPE_LEN, input - STRIPE_LEN,
+                STRIPE_LEN);
+    }
+
+    memcpy(ctx->buffer, input, len);
+    ctx->buflen = len;
+}
+
+void *xxh3_finish_ctx(const struct xxh3_ctx *ctx, void *resbuf)
+{
+    unsigned char *const r = resbuf;
+    uint128 h;
+    int i;
+
+    if (ctx->total <= MIDSIZE_MAX) {
+        h = hash_short(ctx->buffer, (size_t) ctx->total);
+    } else {
+        uint64_t acc[8];
+        size_t stripes_in_block = ctx->stripes_in_block;
+        memcpy(acc, ctx->acc, sizeof acc);
+        if (ctx->buflen >= STRIPE_LEN) {
+            consume_stripes(acc, &stripes_in_block, ctx->buffer,
+                    (ctx->buflen - 1) / STRIPE_LEN);
+            accumulate_stripe(acc, ctx->buffer + ctx->buflen - STRIPE_LEN,
+                    secret + SECRET_LIMIT - SECRET_LASTACC_START);
+        } else {
+            unsigned char last[STRIPE_LEN];
+            const size_t catchup = STRIPE_LEN - ctx->buflen;
+            memcpy(last, ctx->buffer + XXH3_BUFFER_SIZE - catchup, catchup);
+            memcpy(last + catchup, ctx->buffer, ctx->buflen);
+            accumulate_stripe(acc, last,
+                    secret + SECRET_LIMIT - SECRET_LASTACC_START);
+        }
+        h.low = merge_accs(acc, secret + SECRET_MERGEACCS_START,
+                ctx->total * PRIME64_1);
+        h.high = merge_accs(acc, secret + SECRET_LIMIT - SECRET_MERGEACCS_START,
+                ~(ctx->total * PRIME64_2));
+    }
+
+    for (i = 0; i < 8; ++i) {
+        r[i] = (unsigned char) (h.high >> (56 - 8 * i));
+        r[8 + i] = (unsigned char) (h.low >> (56 - 8 * i));
+    }
+    return resbuf;
+}
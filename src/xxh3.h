@@ -0,0 +1,62 @@
+/*
+ * Gregorio is a program that translates gabc files to GregorioTeX
+ * This header declares the XXH3 128-bit fingerprint functions.
+ *
+ * Copyright (C) 2025 The Gregorio Project (see CONTRIBUTORS.md)
+ *
+ * This file is part of Gregorio.
+ *
+ * Gregorio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Gregorio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gregorio.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef XXH3_H
+#define XXH3_H 1
+
+#include <stddef.h>
+#ifdef HAVE_STDINT_H
+#include <stdint.h>
+#else
+#include <inttypes.h>
+#endif
+
+#define XXH3_128_DIGEST_SIZE 16
+
+/* size of the input buffer, which must be a multiple of the stripe size */
+#define XXH3_BUFFER_SIZE 256
+
+/* Structure to save state of computation between the single steps.  */
+struct xxh3_ctx {
+    uint64_t acc[8];
+    uint64_t total;
+    size_t stripes_in_block;
+    size_t buflen;
+    unsigned char buffer[XXH3_BUFFER_SIZE];
+};
+
+/* Initialize structure containing state of computation. */
+extern void xxh3_init_ctx(struct xxh3_ctx *ctx);
+
+/* Starting with the result of former calls of this function (or the
+   initialization function) update the context for the next LEN bytes
+   starting at BUFFER.  */
+extern void xxh3_process_bytes(const void *buffer, size_t len,
+        struct xxh3_ctx *ctx);
+
+/* Put the XXH3 128-bit hash (with the default secret and a seed of 0) of
+   the bytes processed so far in the first 16 bytes following RESBUF, in
+   the canonical (big endian, high half first) byte order.  CTX is not
+   modified, so more bytes may be processed afterwards.  */
+extern void *xxh3_finish_ctx(const struct xxh3_ctx *ctx, void *resbuf);
+
+#endif
@@ -117,100 +117,74 @@ local gregalllskinds = { c = 1, t = 1, s = 1, l = 1, x = 1, ["+"] = 1, a = 1, al
   ["eq-"] = 1, equ = 1, simp = 1, simpl = 1, sp = 1 }
 local grelaonltkinds = { i = 1, ["do"] = 1, dr = 1, dx = 1, ps = 1, qm = 1, sb = 1, se = 1, sj = 1, sl = 1, sn = 1, sp = 1, sr = 1, st = 1, us = 1 }
 
--- Parse a single base neume
-local gregallparse_base = function (str, idx, len)
-  local ret = str:sub(idx, idx + 1)
-  local alt = {}
-  local height = 5
-  local alts = "MSG-><~"
-  if idx >= len or not gregallneumekinds[ret] then return 1 end
-  idx = idx + 2
-  -- The alternation modifiers can be written in arbitrary order,
-  -- canonicalize it and remove duplicates.
-  while idx <= len and alts:find(str:sub(idx, idx)) do
-    alt[str:sub(idx, idx)] = 1
-    idx = idx + 1
-  end
-  for i = 1, 7 do
-    local c = alts:sub(i, i)
-    if alt[c] then ret = ret .. c end
-  end
-  -- This is followed by a single optional variant digit.
-  if idx <= len and string.find("123456789", str:sub(idx, idx)) then
-    ret = ret .. str:sub(idx, idx)
-    idx = idx + 1
-  end
-  -- Ambitus not handled yet, neither during parsing, nor when
-  -- typesetting.
-  -- Optional height, h[a-np].
-  if idx < len and str:sub(idx, idx) == "h" then
-    local p = string.find("abcdefghijklmnp", str:sub(idx + 1, idx + 1))
-    if not p then return 1 end
-    height = p - 1
-    idx = idx + 2
-  end
-  return 0, idx, ret, height
+-- The nabc grammar.  A neume is one base neume or several base neumes
+-- separated with ! characters, and all this followed by arbitrary ls
+-- (or lt for Laon), pp and su modifiers.  A neume matches as a table
+-- { base1, height1, base2, height2, ..., { modifier1, modifier2, ... } }
+-- followed by the position after it.  Whenever a construct is started but
+-- not finished (a ! not followed by a base neume, an h not followed by a
+-- height, a modifier without its position digit...), the whole neume
+-- fails to match.
+local P, R, S, C, Cc, Cp, Ct, Cmt, Cs = lpeg.P, lpeg.R, lpeg.S, lpeg.C, lpeg.Cc, lpeg.Cp, lpeg.Ct, lpeg.Cmt, lpeg.Cs
+
+local gregalldigit = R"19"
+
+local gregallkind = P(false)
+for kind, _ in pairs(gregallneumekinds) do
+  gregallkind = gregallkind + P(kind)
 end
 
--- Parse one neume, which is one base neume or several base neumes
--- separated with ! characters, and all this followed by arbitrary
--- ls, pp and su modifiers.
-local gregallparse_neume = function (str, idx, len)
-  local err
-  local bases = {}
-  local heights = {}
-  local pp = ''
-  local su = ''
-  local ls = {}
-  local lsidx = 0
-  local i = 1
-  err, idx, bases[0], heights[0] = gregallparse_base(str, idx, len)
-  if err == 1 then return 1 end
-  while idx <= len and str:sub(idx, idx) == "!" do
-    err, idx, bases[i], heights[i] = gregallparse_base(str, idx + 1, len)
-    if err == 1 then return 1 end
-    i = i + 1
+-- The alternation modifiers can be written in arbitrary order,
+-- canonicalize it and remove duplicates.
+local gregallcanonical_alts = {}
+local function gregallcanonicalize_alts(alts)
+  local ret = gregallcanonical_alts[alts]
+  if not ret then
+    ret = ''
+    for c in string.gmatch("MSG-><~", ".") do
+      if alts:find(c, 1, true) then ret = ret .. c end
+    end
+    gregallcanonical_alts[alts] = ret
   end
-  while idx < len do
-    local v = str:sub(idx, idx + 1)
-    if v == "ls" then
-      local idx2 = idx + 2
-      while idx2 <= len and not string.find("123456789", str:sub(idx2, idx2)) do
-        idx2 = idx2 + 1
-      end
-      if idx2 > len or not gregalllskinds[str:sub(idx + 2, idx2 - 1)] then return 1 end
-      ls[lsidx] = str:sub(idx, idx2)
-      lsidx = lsidx + 1
-      idx = idx2 + 1
-    elseif v == "lt" then
-      local idx2 = idx + 2
-      while idx2 <= len and not string.find("123456789", str:sub(idx2, idx2)) do
-        idx2 = idx2 + 1
-      end
-      if idx2 > len or not grelaonltkinds[str:sub(idx + 2, idx2 - 1)] then return 1 end
-      ls[lsidx] = str:sub(idx, idx2)
-      lsidx = lsidx + 1
-      idx = idx2 + 1
-    elseif v == "su" or v == "pp" then
-      local mod = ''
-      idx = idx + 2
-      local c = str:sub(idx, idx)
-      if idx <= len and string.find("tuvwxyqnz", c) then
-        mod = mod .. c
-        idx = idx + 1
-        c = str:sub(idx, idx)
-      end
-      -- Pre/subpuncta with height not supported yet
-      -- the heights would need to be adjusted relatively to heights[0]
-      if idx > len or not string.find("123456789", c) then return 1 end
-      mod = mod .. c
-      if v == "su" then su = su .. "su" .. mod else pp = pp .. "pp" .. mod end
-      idx = idx + 1
-    else break end
+  return ret
+end
+
+local gregallheights = {}
+for i = 1, 15 do
+  gregallheights[string.sub("abcdefghijklmnp", i, i)] = i - 1
+end
+
+-- This is followed by a single optional variant digit.
+-- Ambitus not handled yet, neither during parsing, nor when
+-- typesetting.
+-- Optional height, h[a-np]; an h at the very end is left alone.
+local function gregallbase_name(kind, alts, variant)
+  return kind .. alts .. variant
+end
+local gregallbase = (C(gregallkind) * (C(S"MSG-><~"^0) / gregallcanonicalize_alts)
+    * (C(gregalldigit) + Cc(''))) / gregallbase_name
+  * (P"h" * (S"abcdefghijklmnp" / gregallheights) + -(P"h" * P(1)) * Cc(5))
+
+local function gregallvalidate(kinds)
+  return function(str, idx, kind)
+    return kinds[kind] ~= nil
   end
-  return 0, idx, bases, heights, ls, pp, su
 end
 
+-- Pre/subpuncta with height not supported yet
+-- the heights would need to be adjusted relatively to the first base neume
+local gregallmodifier = C(P"ls" * Cmt(C((1 - gregalldigit)^0), gregallvalidate(gregalllskinds)) * gregalldigit)
+  + C(P"lt" * Cmt(C((1 - gregalldigit)^0), gregallvalidate(grelaonltkinds)) * gregalldigit)
+  + C((P"su" + P"pp") * S"tuvwxyqnz"^-1 * gregalldigit)
+
+local gregallneume = Ct(gregallbase * (P"!" * gregallbase)^0 * -P"!"
+    * Ct(gregallmodifier^0) * -(P"ls" + P"lt" + P"su" + P"pp")) * Cp()
+
+local gregallspacing = Cs((P"//" / "\\gre@hskip \\gre@space@skip@nabclargerspace"
+    + P"``" / "\\gre@hskip -\\gre@space@skip@nabclargerspace"
+    + P"/" / "\\gre@hskip \\gre@space@skip@nabcinterelementspace"
+    + P"`" / "\\gre@hskip -\\gre@space@skip@nabcinterelementspace")^0) * Cp()
+
 local add_ls = function(base, pre, post, ls, position, glyphbox, lsbox, baseraise, lwidths, curlwidths, scale)
   local raise = 0
   if position == 3 or position == 6 or position == 9 then
@@ -272,190 +246,324 @@ local add_ls = function(base, pre, post, ls, position, glyphbox, lsbox, baserais
   end
 end
 
-local add_spacing = function(str, len, idx, ret)
-  while idx <= len and (str:sub(idx, idx) == "/" or str:sub(idx, idx) == "`") do
-    if idx < len and str:sub(idx, idx + 1) == "//" then
-      ret = ret .. "\\gre@hskip \\gre@space@skip@nabclargerspace"
-      idx = idx + 2
-    elseif idx < len and str:sub(idx, idx + 1) == "``" then
-      ret = ret .. "\\gre@hskip -\\gre@space@skip@nabclargerspace"
-      idx = idx + 2
-    elseif str:sub(idx, idx) == "/" then
-      ret = ret .. "\\gre@hskip \\gre@space@skip@nabcinterelementspace"
-      idx = idx + 1
-    else
-      ret = ret .. "\\gre@hskip -\\gre@space@skip@nabcinterelementspace"
-      idx = idx + 1
-    end
-  end
-  return idx, ret
+
+local function gregalltry(kind, base, parts, pp, su, ls5, ls)
+  local tab = gregalltab[kind]
+  if parts == 2 and pp ~= '' and su ~= '' and tab[base .. pp .. su .. ls5 .. ls] then return base .. pp .. su .. ls5 .. ls, '', '' end
+  -- Prefer subpunctis over prepunctis.
+  if parts == 1 and su ~= '' and tab[base .. su .. ls5 .. ls] then return base .. su .. ls5 .. ls, pp, '' end
+  if parts == 1 and pp ~= '' and tab[base .. pp .. ls5 .. ls] then return base .. pp .. ls5 .. ls, '', su end
+  -- Prefer subpunctis over significative letters.
+  if parts == 0 and su ~= '' and ls ~= '' and tab[base .. su .. ls5] then return nil, pp, su end
+  if parts == 0 and tab[base .. ls5 .. ls] then return base .. ls5 .. ls, pp, su end
+  return nil, pp, su
 end
 
-local gregallparse_neumes = function(str, kind, scale)
-  local len = str:len()
-  local idx = 1
-  local ret = ''
-  idx, ret = add_spacing(str, len, idx, ret)
-  while idx <= len do
-    local err, bases, heights, ls, pp, su, lscount
-    err, idx, bases, heights, ls, pp, su = gregallparse_neume (str, idx, len)
-    if err == 1 then return ret .. "ERR" end
-    local base = bases[0]
-    local i = 1
-    while bases[i] do
-      base = base .. "!" .. bases[i]
-      local h = heights[i] - heights[0]
-      if h ~= 0 then
-        h = h + 5
-        if h < 0 or h > 14 then
-          base = "ERR"
-          break
+-- Typeset one neume: base is its base neumes, with the relative heights
+-- of all but the first one, heights1 the height of the first one, ls the
+-- list of its significative letters, and pp and su its prepunctis and
+-- subpunctis.  This is also how gregorio writes the neumes it has parsed
+-- (see \GreNABCNeume).
+local function gregalltypeset_neume(base, heights1, ls, pp, su, kind, scale)
+  local ls5 = ''
+  local lscount = #ls
+  for i = 1, lscount do
+    if not gregalltab[kind][ls[i]:sub(1, -2)] then base = "ERR" end
+    if tonumber(ls[i]:sub(-1, -1)) == 5 then
+      ls5 = ls5 .. ls[i]
+      ls[i] = ''
+    end
+  end
+  if base == "ERR" then return base end
+  local r = nil
+  local ppsuparts = 0
+  if pp ~= '' then ppsuparts = 1 end
+  if su ~= '' then ppsuparts = ppsuparts + 1 end
+  -- We assume here no character in the font has more than three
+  -- significative letters.  Significative letters with position 5
+  -- are always required to be in font and have preference over
+  -- pre/subpunctis and other significative letters.
+  local allparts = ppsuparts + lscount
+  if lscount >= 3 then allparts = ppsuparts + 3 end
+  -- Try to match as many parts (ls sequences, pp string, su string) as possible
+  -- except that for ls accept any of ls sequences only if we have all of them.
+  for parts = allparts, 0, -1 do
+    if lscount == 3 and parts >= 3 and parts <= 3 + ppsuparts then
+      r, pp, su = gregalltry(kind, base, parts - 3, pp, su, ls5, ls[1] .. ls[2] .. ls[3])
+      if (not r) and ls[1] ~= '' and ls[2] ~= '' and ls[3] ~= '' then
+        local p1 = tonumber(ls[1]:sub(-1, -1))
+        local p2 = tonumber(ls[2]:sub(-1, -1))
+        local p3 = tonumber(ls[3]:sub(-1, -1))
+        if (p1 ~= p2) and (p1 ~= p3) and (p2 ~= p3) then
+          r, pp, su = gregalltry(kind, base, parts - 3, pp, su, ls5, ls[2] .. ls[1] .. ls[3])
+          if not r then r, pp, su = gregalltry(kind, base, parts - 3, pp, su, ls5, ls[1] .. ls[3] .. ls[2]) end
+          if not r then r, pp, su = gregalltry(kind, base, parts - 3, pp, su, ls5, ls[2] .. ls[3] .. ls[1]) end
+          if not r then r, pp, su = gregalltry(kind, base, parts - 3, pp, su, ls5, ls[3] .. ls[1] .. ls[2]) end
+          if not r then r, pp, su = gregalltry(kind, base, parts - 3, pp, su, ls5, ls[3] .. ls[2] .. ls[1]) end
         end
-        base = base .. string.sub("abcdefghijklmnp", h + 1, h + 1)
       end
-      i = i + 1
-    end
-    local ls5 = ''
-    lscount = 0
-    while ls[lscount] do
-      if not gregalltab[kind][ls[lscount]:sub(1, -2)] then base = "ERR" end
-      if tonumber(ls[lscount]:sub(-1, -1)) == 5 then
-        ls5 = ls5 .. ls[lscount]
-        ls[lscount] = ''
+      if r then
+        ls[1] = ''
+        ls[2] = ''
+        ls[3] = ''
+        break
       end
-      lscount = lscount + 1
     end
-    if base ~= "ERR" then
-      local l = {}
-      function l.try (kind, base, parts, pp, su, ls5, ls)
-        if parts == 2 and pp ~= '' and su ~= '' and gregalltab[kind][base .. pp .. su .. ls5 .. ls] then return base .. pp .. su .. ls5 .. ls, '', '' end
-        -- Prefer subpunctis over prepunctis.
-        if parts == 1 and su ~= '' and gregalltab[kind][base .. su .. ls5 .. ls] then return base .. su .. ls5 .. ls, pp, '' end
-        if parts == 1 and pp ~= '' and gregalltab[kind][base .. pp .. ls5 .. ls] then return base .. pp .. ls5 .. ls, '', su end
-        -- Prefer subpunctis over significative letters.
-        if parts == 0 and su ~= '' and ls ~= '' and gregalltab[kind][base .. su .. ls5] then return nil, pp, su end
-        if parts == 0 and gregalltab[kind][base .. ls5 .. ls] then return base .. ls5 .. ls, pp, su end
-        return nil, pp, su
+    if lscount == 2 and parts >= 2 and parts <= 2 + ppsuparts then
+      r, pp, su = gregalltry(kind, base, parts - 2, pp, su, ls5, ls[1] .. ls[2])
+      if (not r) and ls[1] ~= '' and ls[2] ~= '' and (tonumber(ls[1]:sub(-1, -1)) ~= tonumber(ls[2]:sub(-1, -1))) then
+        r, pp, su = gregalltry(kind, base, parts - 2, pp, su, ls5, ls[2] .. ls[1])
       end
-      local r = nil
-      local ppsuparts = 0
-      if pp ~= '' then ppsuparts = 1 end
-      if su ~= '' then ppsuparts = ppsuparts + 1 end
-      -- We assume here no character in the font has more than three
-      -- significative letters.  Significative letters with position 5
-      -- are always required to be in font and have preference over
-      -- pre/subpunctis and other significative letters.
-      local allparts = ppsuparts + lscount
-      if lscount >= 3 then allparts = ppsuparts + 3 end
-      -- Try to match as many parts (ls sequences, pp string, su string) as possible
-      -- except that for ls accept any of ls sequences only if we have all of them.
-      for parts = allparts, 0, -1 do
-        if lscount == 3 and parts >= 3 and parts <= 3 + ppsuparts then
-          r, pp, su = l.try(kind, base, parts - 3, pp, su, ls5, ls[0] .. ls[1] .. ls[2])
-          if (not r) and ls[0] ~= '' and ls[1] ~= '' and ls[2] ~= '' then
-            local p0 = tonumber(ls[0]:sub(-1, -1))
-            local p1 = tonumber(ls[1]:sub(-1, -1))
-            local p2 = tonumber(ls[2]:sub(-1, -1))
-            if (p0 ~= p1) and (p0 ~= p2) and (p1 ~= p2) then
-              r, pp, su = l.try(kind, base, parts - 3, pp, su, ls5, ls[1] .. ls[0] .. ls[2])
-              if not r then r, pp, su = l.try(kind, base, parts - 3, pp, su, ls5, ls[0] .. ls[2] .. ls[1]) end
-              if not r then r, pp, su = l.try(kind, base, parts - 3, pp, su, ls5, ls[1] .. ls[2] .. ls[0]) end
-              if not r then r, pp, su = l.try(kind, base, parts - 3, pp, su, ls5, ls[2] .. ls[0] .. ls[1]) end
-              if not r then r, pp, su = l.try(kind, base, parts - 3, pp, su, ls5, ls[2] .. ls[1] .. ls[0]) end
-            end
-          end
-          if r then
-            ls[0] = ''
-            ls[1] = ''
-            ls[2] = ''
-            break
-          end
-          if r then break end
-        end
-        if lscount == 2 and parts >= 2 and parts <= 2 + ppsuparts then
-          r, pp, su = l.try(kind, base, parts - 2, pp, su, ls5, ls[0] .. ls[1])
-          if (not r) and ls[0] ~= '' and ls[1] ~= '' and (tonumber(ls[0]:sub(-1, -1)) ~= tonumber(ls[1]:sub(-1, -1))) then
-            r, pp, su = l.try(kind, base, parts - 2, pp, su, ls5, ls[1] .. ls[0])
-          end
-          if r then
-            ls[0] = ''
-            ls[1] = ''
-            break
-          end
-          if r then break end
-        end
-        if lscount == 1 and parts >= 1 and parts <= 1 + ppsuparts then
-          r, pp, su = l.try(kind, base, parts - 1, pp, su, ls5, ls[0])
-          if r then
-            ls[0] = ''
-            break
-          end
-        end
-        r, pp, su = l.try(kind, base, parts, pp, su, ls5, '')
-        if r then break end
+      if r then
+        ls[1] = ''
+        ls[2] = ''
+        break
       end
-      if not r or (pp ~= '' and not gregalltab[kind][pp]) or (su ~= '' and not gregalltab[kind][su]) then
-        base = "ERR"
-      else
-        base = gregalltab[kind][r]
-        local above = ''
-        local below = ''
-        local rmetrics = { width = gregallmetrics[kind][r].width,
-                           height = gregallmetrics[kind][r].height,
-                           depth = gregallmetrics[kind][r].depth }
-        -- Should the pre and subpuncta be somehow specially positioned
-        -- against the base neume?
-        if pp ~= '' then
-          base = gregalltab[kind][pp] .. base
-          rmetrics.width = rmetrics.width + gregallmetrics[kind][pp].width
-          rmetrics.height = math.max (rmetrics.height, gregallmetrics[kind][pp].height)
-          rmetrics.depth = math.max (rmetrics.height, gregallmetrics[kind][pp].depth)
-        end
-        if su ~= '' then
-          base = base .. gregalltab[kind][su]
-          rmetrics.width = rmetrics.width + gregallmetrics[kind][su].width
-          rmetrics.height = math.max (rmetrics.height, gregallmetrics[kind][su].height)
-          rmetrics.depth = math.max (rmetrics.height, gregallmetrics[kind][su].depth)
-        end
-        local baseraise = 0
-        if heights[0] ~= 5 then
-          baseraise = (heights[0] - 5) * gregallmetrics[kind].cl.height / 4
-          base = '\\raise '..string.format("%.3f",baseraise * scale)..'sp\\hbox{'..base..'}'
-        end
-        local lwidths = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
-        local curlwidths = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
-        for i = 0, lscount - 1 do
-          if ls[i] ~= '' then
-            local p = tonumber(ls[i]:sub(-1, -1))
-            local l = ls[i]:sub(1, -2)
-            lwidths[p] = lwidths[p] + gregallmetrics[kind][l].width
-          end
-        end
-        lwidths[10] = math.max (lwidths[1], lwidths[4], lwidths[7])
-        lwidths[11] = math.max (lwidths[2], lwidths[8])
-        lwidths[12] = math.max (lwidths[3], lwidths[6], lwidths[9])
-        local pre = ''
-        local post = ''
-        for i = 0, lscount - 1 do
-          if ls[i] ~= '' then
-            local p = tonumber(ls[i]:sub(-1, -1))
-            local l = ls[i]:sub(1, -2)
-            local lstr = gregalltab[kind][l]
-            base, pre, post = add_ls(base, pre, post, lstr, p, rmetrics, gregallmetrics[kind][l], baseraise, lwidths, curlwidths, scale)
-          end
-        end
-        base = pre..base..post
+    end
+    if lscount == 1 and parts >= 1 and parts <= 1 + ppsuparts then
+      r, pp, su = gregalltry(kind, base, parts - 1, pp, su, ls5, ls[1])
+      if r then
+        ls[1] = ''
+        break
+      end
+    end
+    r, pp, su = gregalltry(kind, base, parts, pp, su, ls5, '')
+    if r then break end
+  end
+  if not r or (pp ~= '' and not gregalltab[kind][pp]) or (su ~= '' and not gregalltab[kind][su]) then
+    return "ERR"
+  end
+  base = gregalltab[kind][r]
+  local rmetrics = { width = gregallmetrics[kind][r].width,
+                     height = gregallmetrics[kind][r].height,
+                     depth = gregallmetrics[kind][r].depth }
+  -- Should the pre and subpuncta be somehow specially positioned
+  -- against the base neume?
+  if pp ~= '' then
+    base = gregalltab[kind][pp] .. base
+    rmetrics.width = rmetrics.width + gregallmetrics[kind][pp].width
+    rmetrics.height = math.max (rmetrics.height, gregallmetrics[kind][pp].height)
+    rmetrics.depth = math.max (rmetrics.height, gregallmetrics[kind][pp].depth)
+  end
+  if su ~= '' then
+    base = base .. gregalltab[kind][su]
+    rmetrics.width = rmetrics.width + gregallmetrics[kind][su].width
+    rmetrics.height = math.max (rmetrics.height, gregallmetrics[kind][su].height)
+    rmetrics.depth = math.max (rmetrics.height, gregallmetrics[kind][su].depth)
+  end
+  local baseraise = 0
+  if heights1 ~= 5 then
+    baseraise = (heights1 - 5) * gregallmetrics[kind].cl.height / 4
+    base = '\\raise '..string.format("%.3f",baseraise * scale)..'sp\\hbox{'..base..'}'
+  end
+  local lwidths = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
+  local curlwidths = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
+  for i = 1, lscount do
+    if ls[i] ~= '' then
+      local p = tonumber(ls[i]:sub(-1, -1))
+      local l = ls[i]:sub(1, -2)
+      lwidths[p] = lwidths[p] + gregallmetrics[kind][l].width
+    end
+  end
+  lwidths[10] = math.max (lwidths[1], lwidths[4], lwidths[7])
+  lwidths[11] = math.max (lwidths[2], lwidths[8])
+  lwidths[12] = math.max (lwidths[3], lwidths[6], lwidths[9])
+  local pre = ''
+  local post = ''
+  for i = 1, lscount do
+    if ls[i] ~= '' then
+      local p = tonumber(ls[i]:sub(-1, -1))
+      local l = ls[i]:sub(1, -2)
+      local lstr = gregalltab[kind][l]
+      base, pre, post = add_ls(base, pre, post, lstr, p, rmetrics, gregallmetrics[kind][l], baseraise, lwidths, curlwidths, scale)
+    end
+  end
+  return pre..base..post
+end
+
+-- Typeset one neume as matched by gregallneume
+local function gregalltypeset_matched_neume(neume, kind, scale)
+  local ls = {}
+  local pp = {}
+  local su = {}
+  for _, modifier in ipairs(neume[#neume]) do
+    local c = modifier:sub(1, 1)
+    if c == 'l' then
+      ls[#ls + 1] = modifier
+    elseif c == 'p' then
+      pp[#pp + 1] = modifier
+    else
+      su[#su + 1] = modifier
+    end
+  end
+  local heights1 = neume[2]
+  local base = neume[1]
+  for i = 3, #neume - 1, 2 do
+    base = base .. "!" .. neume[i]
+    local h = neume[i + 1] - heights1
+    if h ~= 0 then
+      h = h + 5
+      if h < 0 or h > 14 then
+        return "ERR"
       end
+      base = base .. string.sub("abcdefghijklmnp", h + 1, h + 1)
+    end
+  end
+  return gregalltypeset_neume(base, heights1, ls, table.concat(pp), table.concat(su), kind, scale)
+end
+
+local function gregallparse_neumes(str, kind, scale)
+  local len = str:len()
+  local ret = {}
+  local spacing, idx = lpeg.match(gregallspacing, str)
+  ret[1] = spacing
+  while idx <= len do
+    local neume
+    neume, idx = lpeg.match(gregallneume, str, idx)
+    if not neume then
+      ret[#ret + 1] = "ERR"
+      break
+    end
+    ret[#ret + 1] = gregalltypeset_matched_neume(neume, kind, scale)
+    spacing, idx = lpeg.match(gregallspacing, str, idx)
+    ret[#ret + 1] = spacing
+  end
+  return table.concat(ret)
+end
+
+-- Memo of the TeX code generated for nabc strings, so that the neumes
+-- repeated throughout a score, or from one run to the next, are only parsed
+-- once.  fonts[kind] holds, by scale and nabc string, the entries read from
+-- the cache file which are still valid (old) and those used in this run
+-- (new); only the latter are written back at the end of the run, with or
+-- without height computation (see write_greaux in gregoriotex.lua).  The
+-- entries of a font are only reused if the font has the same signature as
+-- when they were computed.
+local nabc_cache = {
+  filename = nil, loaded = false, stored = {}, fonts = {}, changed = false,
+}
+local nabc_cache_version = '6.1.0' -- GREGORIO_VERSION
+local gregallsignatures = {}
+
+local function set_nabc_cache_file(filename)
+  nabc_cache.filename = filename
+end
+
+local function load_nabc_cache()
+  nabc_cache.loaded = true
+  local filename = nabc_cache.filename
+  if not filename or not lfs.isfile(filename) then return end
+  -- to get latexmk to realize the cache file is a dependency
+  texio.write_nl('('..filename..')')
+  local ok, cache = pcall(dofile, filename)
+  if not ok or type(cache) ~= 'table' or cache.version ~= nabc_cache_version then
+    nabc_cache.changed = true
+    return
+  end
+  for kind, stored in pairs(cache.fonts or {}) do
+    local count = 0
+    for _, _ in pairs(stored.entries) do
+      count = count + 1
+    end
+    nabc_cache.stored[kind] = { signature = stored.signature, entries = stored.entries, count = count }
+  end
+end
+
+local function font_nabc_cache(kind)
+  local cache = nabc_cache.fonts[kind]
+  if not cache then
+    if not nabc_cache.loaded then load_nabc_cache() end
+    local stored = nabc_cache.stored[kind]
+    cache = { old = {}, new = {}, reused = 0 }
+    if stored and stored.signature == gregallsignatures[kind] then
+      cache.old = stored.entries
     end
-    ret = ret .. base
-    idx, ret = add_spacing(str, len, idx, ret)
+    nabc_cache.fonts[kind] = cache
   end
+  return cache
+end
+
+local function gregallcached_parse_neumes(str, kind, scale)
+  local cache = font_nabc_cache(kind)
+  local key = scale .. ' ' .. str
+  local ret = cache.new[key]
+  if ret then return ret end
+  ret = cache.old[key]
+  if ret then
+    cache.reused = cache.reused + 1
+  else
+    ret = gregallparse_neumes(str, kind, scale)
+    nabc_cache.changed = true
+  end
+  cache.new[key] = ret
   return ret
 end
 
+-- Typeset a neume parsed by gregorio, letters being its significative
+-- letters one after the other
+local function gregallcached_typeset_neume(base, height, letters, pp, su, kind, scale)
+  local cache = font_nabc_cache(kind)
+  -- | cannot appear in a nabc string, so these keys are distinct from
+  -- those of gregallcached_parse_neumes
+  local key = table.concat({ scale, base, height, letters, pp, su }, '|')
+  local ret = cache.new[key]
+  if ret then return ret end
+  ret = cache.old[key]
+  if ret then
+    cache.reused = cache.reused + 1
+  else
+    local ls = {}
+    for letter in letters:gmatch("l[st]%D*%d") do
+      ls[#ls + 1] = letter
+    end
+    ret = gregalltypeset_neume(base, height, ls, pp, su, kind, scale)
+    nabc_cache.changed = true
+  end
+  cache.new[key] = ret
+  return ret
+end
+
+local function write_nabc_cache()
+  local filename = nabc_cache.filename
+  if not filename then return end
+  if not nabc_cache.loaded then
+    -- no nabc in this run
+    if lfs.isfile(filename) then os.remove(filename) end
+    return
+  end
+  local changed = nabc_cache.changed
+  for kind, stored in pairs(nabc_cache.stored) do
+    local cache = nabc_cache.fonts[kind]
+    if not cache or cache.reused ~= stored.count then changed = true end
+  end
+  if not changed then return end
+  local out = io.open(filename, 'w')
+  if not out then
+    gregoriotex.module.err("\n Unable to open %s", filename)
+    return
+  end
+  gregoriotex.module.log("Writing %s", filename)
+  out:write(string.format('return {\n ["version"]=%q,\n ["fonts"]={\n', nabc_cache_version))
+  for kind, cache in pairs(nabc_cache.fonts) do
+    out:write(string.format('  [%q]={\n   ["signature"]=%q,\n   ["entries"]={\n', kind, gregallsignatures[kind]))
+    for key, value in pairs(cache.new) do
+      out:write(string.format('    [%q]=%q,\n', key, value))
+    end
+    out:write('   },\n  },\n')
+  end
+  out:write(' },\n}\n')
+  out:close()
+end
+
 local function init_font(fontname)
   if not gregalltab[fontname] then
-    gregalltab[fontname], gregallmetrics[fontname] = gregallreadfont(fontname, font.current())
+    local font_id = font.current()
+    gregalltab[fontname], gregallmetrics[fontname] = gregallreadfont(fontname, font_id)
+    -- the generated code depends on the font and its size
+    local fontdata = font.getfont(font_id)
+    local attributes = fontdata.filename and lfs.attributes(fontdata.filename)
+    gregallsignatures[fontname] = string.format('%s %s %s', fontdata.name or fontname,
+        fontdata.size or 0, attributes and attributes.modification or '')
   end
 end
 
@@ -463,7 +571,10 @@ local function print_nabc(nabc)
   tex.sprint(catcode_at_letter, nabc)
 end
 
-gregoriotex.parse_nabc = gregallparse_neumes
+gregoriotex.parse_nabc = gregallcached_parse_neumes
+gregoriotex.typeset_nabc_neume = gregallcached_typeset_neume
 gregoriotex.print_nabc = print_nabc
 gregoriotex.init_nabc_font = init_font
 gregoriotex.nabc_font_tables = gregalltab
+gregoriotex.set_nabc_cache_file = set_nabc_cache_file
+gregoriotex.write_nabc_cache = write_nabc_cache
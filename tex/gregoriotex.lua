@@ -19,7 +19,7 @@
 
 -- this file contains lua functions used by GregorioTeX when called with LuaTeX.
 
-local hpack, traverse, traverse_id, has_attribute, count, remove, insert_after, copy = node.hpack, node.traverse, node.traverse_id, node.has_attribute, node.count, node.remove, node.insert_after, node.copy
+local hpack, traverse, traverse_id, has_attribute, copy = node.hpack, node.traverse, node.traverse_id, node.has_attribute, node.copy
 
 gregoriotex = gregoriotex or {}
 local gregoriotex = gregoriotex
@@ -43,6 +43,9 @@ gregoriotex.module = { err = err, warn = warn, info = info, log = log }
 
 local format = string.format
 
+-- the direct node interface, used in the hot paths of post_linebreak
+local direct = node.direct
+
 local hlist = node.id('hlist')
 local vlist = node.id('vlist')
 local glyph = node.id('glyph')
@@ -95,17 +98,54 @@ local first_alterations = nil
 local new_first_alterations = nil
 local state_hashes = nil
 local new_state_hashes = nil
+-- the trial typesetting of a score, see trial.begin: whether one is in
+-- progress, the values it collected for the score, and the scores for which
+-- a trial changed the values read from their gaux file
+local trial = { in_progress = false, score = nil, updated_scores = {} }
+-- auxname is the gaux file of versions which kept the values of all the
+-- scores in a single file, now read only to migrate them; score_aux.dir is the
+-- directory with one gaux file per score, which are read on demand
 local auxname = nil
+local score_aux = { dir = nil, loaded = {}, all_loaded = false }
 local tmpname = nil
 local test_snippet_filename = nil
-local snippet_filename = nil
-local snippet_logname = nil
+-- the gabc snippets (see direct_gabc): the files a snippet is compiled with,
+-- and the cache of their gtex and messages, by a digest of their gabc and of
+-- the options they are compiled with.  As in the nabc cache, old holds the
+-- entries read from the cache file and new those used in this run, which are
+-- the only ones written back.  In batch mode, the snippets which are not in
+-- the cache are only compiled at the end of the run, all with one run of
+-- gregorio, and typeset in the next run.
+local snippets = {
+  filename = nil, logname = nil, cache_filename = nil, loaded = false,
+  old = {}, new = {}, count = 0, reused = 0, changed = false,
+  batch = false, pending = {},
+}
 
 local base_output_dir = 'tmp-gre'
 local function set_base_output_dir(new_dirname)
   base_output_dir = lfs.normalize(new_dirname)
 end
 
+-- the algorithm gregorio uses for the score identifiers it writes, and the
+-- algorithms it knows
+local score_digest = {
+  algorithm = 'sha1', known = { sha1 = true, xxh3 = true },
+}
+function score_digest.set(algorithm)
+  if score_digest.known[algorithm] then
+    score_digest.algorithm = algorithm
+  else
+    err("Unknown score digest algorithm: %s", algorithm)
+  end
+end
+
+-- Return the algorithm of the digest in a score identifier written by
+-- gregorio: digests other than SHA-1 carry a prefix
+function score_digest.algorithm_of(score_id)
+  return string.match(score_id, '^(%a[%w]*)%-') or 'sha1'
+end
+
 local space_below_staff = 5
 local space_above_staff = 13
 
@@ -113,7 +153,9 @@ local score_fonts = {}
 local symbol_fonts = {}
 local loaded_font_sizes = {}
 local font_factors = {}
-local font_indexed = {}
+-- glyph name to code point maps of the score fonts, by font name (see
+-- glyph_maps.get), and the version of the format of their cache files
+local glyph_maps = { by_font = {}, version = 1 }
 local next_variant = 0
 local variant_prefix = 'gre@font@variant@'
 local number_to_letter = {
@@ -153,42 +195,161 @@ local function get_prog_output(cmd, tmpname, fmt)
   return content
 end
 
+-- Returns the gregorio executable to run, found once per run.  Asking an
+-- executable for its version (gregorio --probe) needs no compilation, and
+-- the answer is kept in the gaux directory for as long as PATH and the
+-- executable do not change, so that most runs do not start any process for
+-- it.  Versions of gregorio without --probe are asked by compiling a score.
 local function gregorio_exe()
-  if real_gregorio_exe == nil then
-    local tmp_gabcfile = io.open(test_snippet_filename, 'w')
-    tmp_gabcfile:write("name:test;\n%%\n(c4)(g)\n")
-    tmp_gabcfile:close()
-
-    local exe_version
-
-    -- first look for one with the exact version
-    real_gregorio_exe = 'gregorio-6_1_0' -- FILENAME_VERSION
-    local cmd = {real_gregorio_exe, '-o', tmpname, test_snippet_filename}
-    exe_version = get_prog_output(cmd, tmpname, '*line')
-    if not exe_version then
-      -- look for suffix-less executable
-      real_gregorio_exe = 'gregorio'
-      cmd = {real_gregorio_exe, '-o', tmpname, test_snippet_filename}
-      exe_version = get_prog_output(cmd, tmpname, '*line')
-    end
-    if not exe_version or string.match(exe_version,"%d+%.%d+%.")
-        ~= string.match(internalversion,"%d+%.%d+%.") then
-      real_gregorio_exe = nil
-      err("Unable to find gregorio executable.\n"..
-          "shell-escape mode may not be activated. Try\n\n"..
-          "%s --shell-escape %s.tex\n\n"..
-          "See the documentation of Gregorio or your TeX\n"..
-          "distribution to automatize it.",
-          tex.formatname, tex.jobname)
-    end
-
-    os.remove(test_snippet_filename)
-    log("will use %s", real_gregorio_exe)
+  if real_gregorio_exe ~= nil then return real_gregorio_exe end
+  local path = os.getenv('PATH') or ''
+  local cache_filename = score_aux.dir..'/gregorio-exe.gcache'
+
+  -- the modification time of the file of an executable found in PATH, to
+  -- tell when it has been replaced
+  local function exe_modification(name)
+    local separator, suffix = ':', ''
+    if os.type == 'windows' then separator, suffix = ';', '.exe' end
+    local dir
+    for dir in string.gmatch(path, '[^'..separator..']+') do
+      local modification = lfs.attributes(dir..'/'..name..suffix, 'modification')
+      if modification then return modification end
+    end
+    return 0
+  end
+
+  local function probe(name)
+    local version = get_prog_output({name, '--probe', '-o', tmpname}, tmpname, '*line')
+    if not version then
+      local tmp_gabcfile = io.open(test_snippet_filename, 'w')
+      tmp_gabcfile:write("name:test;\n%%\n(c4)(g)\n")
+      tmp_gabcfile:close()
+      version = get_prog_output({name, '-o', tmpname, test_snippet_filename},
+          tmpname, '*line')
+      os.remove(test_snippet_filename)
+    end
+    return version
+  end
+
+  local ok, cache = pcall(dofile, cache_filename)
+  if ok and type(cache) == 'table' and cache.path == path
+      and cache.version == internalversion
+      and cache.modification == exe_modification(cache.exe) then
+    real_gregorio_exe = cache.exe
+    log("will use %s (from %s)", real_gregorio_exe, cache_filename)
+    return real_gregorio_exe
+  end
+
+  -- first look for one with the exact version, then for the suffix-less
+  -- executable
+  local exe_version
+  local name
+  for _, name in ipairs({'gregorio-6_1_0', 'gregorio'}) do -- FILENAME_VERSION
+    exe_version = probe(name)
+    if exe_version then
+      real_gregorio_exe = name
+      break
+    end
+  end
+  if not exe_version or string.match(exe_version,"%d+%.%d+%.")
+      ~= string.match(internalversion,"%d+%.%d+%.") then
+    real_gregorio_exe = nil
+    err("Unable to find gregorio executable.\n"..
+        "shell-escape mode may not be activated. Try\n\n"..
+        "%s --shell-escape %s.tex\n\n"..
+        "See the documentation of Gregorio or your TeX\n"..
+        "distribution to automatize it.",
+        tex.formatname, tex.jobname)
+    return nil
+  end
+
+  log("will use %s", real_gregorio_exe)
+  if lfs.isdir(score_aux.dir) or lfs.mkdirp(score_aux.dir) then
+    local out = io.open(cache_filename, 'w')
+    if out then
+      out:write(string.format('return {\n ["path"]=%q,\n ["version"]=%q,\n'
+          ..' ["exe"]=%q,\n ["modification"]=%d,\n}\n', path, internalversion,
+          real_gregorio_exe, exe_modification(real_gregorio_exe)))
+      out:close()
+    end
   end
-
   return real_gregorio_exe
 end
 
+function snippets.load_cache()
+  snippets.loaded = true
+  local filename = snippets.cache_filename
+  if not filename or not lfs.isfile(filename) then return end
+  -- to get latexmk to realize the cache file is a dependency
+  texio.write_nl('('..filename..')')
+  local ok, cache = pcall(dofile, filename)
+  if not ok or type(cache) ~= 'table' or cache.version ~= internalversion then
+    snippets.changed = true
+    return
+  end
+  snippets.old = cache.entries or {}
+  for _, _ in pairs(snippets.old) do
+    snippets.count = snippets.count + 1
+  end
+end
+
+function snippets.write_cache()
+  local filename = snippets.cache_filename
+  if not filename then return end
+  if not snippets.loaded then
+    -- no snippet in this run
+    if lfs.isfile(filename) then os.remove(filename) end
+    return
+  end
+  if not snippets.changed and snippets.reused == snippets.count then return end
+  local out = io.open(filename, 'w')
+  if not out then
+    err("\n Unable to open %s", filename)
+    return
+  end
+  log("Writing %s", filename)
+  out:write(string.format('return {\n ["version"]=%q,\n ["entries"]={\n',
+      internalversion))
+  for key, entry in pairs(snippets.new) do
+    out:write(string.format('  [%q]={["gtex"]=%q,["glog"]=%q},\n', key,
+        entry.gtex, entry.glog))
+  end
+  out:write(' },\n}\n')
+  out:close()
+end
+
+function snippets.read_log(filename)
+  local glog = io.open(filename, 'r')
+  if glog == nil then
+    err("\n Unable to open %s", filename)
+    return ''
+  end
+  local content = glog:read('*a')
+  glog:close()
+  return content
+end
+
+-- prints the gtex of a compiled snippet and the messages gregorio gave for it
+function snippets.typeset(entry)
+  tex.print(entry.gtex:explode('\n'))
+  if entry.glog ~= '' then
+    local line
+    for line in entry.glog:gmatch('[^\n]+') do
+      warn(line)
+    end
+    warn("*** end of warnings/errors processing snippet ***")
+  end
+end
+
+function snippets.command(allow_deprecated)
+  local cmd = {gregorio_exe(), '-W'}
+  if allow_deprecated then table.insert(cmd, '-D') end
+  if score_digest.algorithm ~= 'sha1' then
+    table.extend(cmd, {'-H', score_digest.algorithm})
+  end
+  return cmd
+end
+
 local function mark(value)
   local marker = create_marker()
   marker.type = 100
@@ -205,9 +366,13 @@ local function mark_abovelinestext()
   mark(abovelinestext_mark)
 end
 
-local function is_mark(node, value)
-  return node.id == whatsit and node.subtype == user_defined_subtype and
-      node.user_id == marker_whatsit_id and node.value == value
+-- n is a direct node
+local function is_mark(n, value)
+  local getfield = direct.getfield
+  return direct.getid(n) == whatsit
+      and direct.getsubtype(n) == user_defined_subtype
+      and getfield(n, 'user_id') == marker_whatsit_id
+      and getfield(n, 'value') == value
 end
 
 local function keys_changed(tab1, tab2)
@@ -222,34 +387,6 @@ local function keys_changed(tab1, tab2)
   return false
 end
 
-local function saved_computations_changed(tab1, tab2)
-  local score_ids = {}
-  local id,_
-  for id,_ in pairs(tab1) do
-    score_ids[id] = true
-  end
-  for id,_ in pairs(tab2) do
-    score_ids[id] = true
-  end
-  for id,_ in pairs(score_ids) do
-    local inner1 = tab1[id]
-    local inner2 = tab2[id]
-    if inner1 == nil or inner2 == nil then return true end
-    local keys = {}
-    local index
-    for index,_ in pairs(inner1) do
-      keys[index] = true
-    end
-    for index,_ in pairs(inner2) do
-      keys[index] = true
-    end
-    for index,_ in pairs(keys) do
-      if inner1[index] ~= inner2[index] then return true end
-    end
-  end
-  return false
-end
-
 local function entries_changed(tab1, tab2)
   local k, v
   for k, v in pairs(tab1) do
@@ -258,125 +395,201 @@ local function entries_changed(tab1, tab2)
   return false
 end
 
-local function is_greaux_write_needed()
-  local id, tab
-  if entries_changed(state_hashes, new_state_hashes) or
-      entries_changed(new_state_hashes, state_hashes) then
-    return true
+-- Whether the values computed for a score in this run differ from the ones
+-- read from its gaux file (and so whether another run is needed)
+function score_aux.is_write_needed(score_id)
+  -- compare the entries of the score in an old and a new table of values,
+  -- using the given comparison function when both are present
+  local function score_entry_changed(old, new, id, compare)
+    local old_entry = old[id]
+    local new_entry = new[id]
+    if old_entry == nil and new_entry == nil then return false end
+    if old_entry == nil or new_entry == nil then return true end
+    return compare(old_entry, new_entry)
+  end
+  local function values_or_keys_changed(tab1, tab2)
+    return keys_changed(tab1, tab2) or entries_changed(tab1, tab2)
+  end
+  local function saved_values_changed(tab1, tab2)
+    local index, _
+    for index, _ in pairs(tab1) do
+      if tab1[index] ~= tab2[index] then return true end
+    end
+    for index, _ in pairs(tab2) do
+      if tab1[index] ~= tab2[index] then return true end
+    end
+    return false
+  end
+  return state_hashes[score_id] ~= new_state_hashes[score_id]
+      or score_entry_changed(line_heights, new_line_heights, score_id,
+          keys_changed)
+      or score_entry_changed(last_syllables, new_last_syllables, score_id,
+          keys_changed)
+      or score_entry_changed(saved_lengths, new_saved_lengths, score_id,
+          saved_values_changed)
+      or score_entry_changed(saved_newline_before_euouae,
+          new_saved_newline_before_euouae, score_id, saved_values_changed)
+      or score_entry_changed(first_alterations, new_first_alterations,
+          score_id, values_or_keys_changed)
+end
+
+function score_aux.filename(score_id)
+  return score_aux.dir..'/'..score_id..'.gaux'
+end
+
+--- Load the gaux file of a score, if it has not been loaded yet.
+function score_aux.load(score_id)
+  if score_aux.all_loaded or score_aux.loaded[score_id] then return end
+  score_aux.loaded[score_id] = true
+  local filename = score_aux.filename(score_id)
+  if not lfs.isfile(filename) then return end
+  -- to get latexmk to realize the aux file is a dependency
+  texio.write_nl('('..filename..')')
+  local ok, score_info = pcall(dofile, filename)
+  if not ok or type(score_info) ~= 'table' then
+    warn("Ignoring unreadable %s", filename)
+    return
   end
-  for id, tab in pairs(new_line_heights) do
-    if keys_changed(tab, line_heights[id]) then return true end
+  line_heights[score_id] = score_info.line_heights
+  last_syllables[score_id] = score_info.last_syllables
+  saved_lengths[score_id] = score_info.saved_lengths
+  saved_newline_before_euouae[score_id] = score_info.saved_newline_before_euouae
+  state_hashes[score_id] = score_info.state_hash
+  first_alterations[score_id] = score_info.first_alterations
+end
+
+function score_aux.write(score_id)
+  local filename = score_aux.filename(score_id)
+  if new_state_hashes[score_id] == nil then
+    -- the score is no longer in the document
+    os.remove(filename)
+    return
   end
-  for id, tab in pairs(line_heights) do
-    if keys_changed(tab, new_line_heights[id]) then return true end
+  local aux = io.open(filename, 'w')
+  if not aux then
+    err("\n Unable to open %s", filename)
+    return
   end
-  for id, tab in pairs(new_last_syllables) do
-    if keys_changed(tab, last_syllables[id]) then return true end
+  log("Writing %s", filename)
+  local id2, line, value
+  aux:write('return {\n ["line_heights"]={\n')
+  for id2, line in pairs(new_line_heights[score_id] or {}) do
+    if id2 == 'last' then
+      aux:write(string.format('  ["%s"]=%d,\n', id2, line))
+    else
+      aux:write(string.format('  [%d]={%d,%d,%d,%d,%d},\n', id2, line[1],
+          line[2], line[3], line[4], line[5]))
+    end
   end
-  for id, tab in pairs(last_syllables) do
-    if keys_changed(tab, new_last_syllables[id]) then return true end
+  aux:write(' },\n ["last_syllables"]={\n')
+  for id2, value in pairs(new_last_syllables[score_id] or {}) do
+    if id2 == 'state' then
+      aux:write(string.format('  state="%s",\n', value))
+    else
+      aux:write(string.format('  [%d]=%d,\n', id2, value))
+    end
   end
-  if saved_computations_changed(saved_lengths, new_saved_lengths) then
-    return true
+  aux:write(' },\n ["saved_lengths"]={\n')
+  for id2, value in pairs(new_saved_lengths[score_id] or {}) do
+    aux:write(string.format('  [%d]=%d,\n', id2, value))
   end
-  if saved_computations_changed(saved_newline_before_euouae, new_saved_newline_before_euouae) then
-    return true
+  aux:write(' },\n ["saved_newline_before_euouae"]={\n')
+  for id2, value in pairs(new_saved_newline_before_euouae[score_id] or {}) do
+    if value then
+      aux:write(string.format('  [%d]=true,\n', id2))
+    else
+      aux:write(string.format('  [%d]=false,\n', id2))
+    end
   end
-  -- For alterations, check if either the keys or values changed.
-  for id, tab in pairs(new_first_alterations) do
-    if keys_changed(tab, first_alterations[id]) or entries_changed(tab, first_alterations[id]) then return true end
+  aux:write(string.format(' },\n ["state_hash"]="%s",\n',
+      new_state_hashes[score_id]))
+  -- Write information about alterations and line breaks. This needs to go
+  -- into the gaux file because it affects whether alterations are printed,
+  -- which in turn affects which lines alterations fall on.
+  aux:write(' ["first_alterations"]={')
+  for id2, value in pairs(new_first_alterations[score_id] or {}) do
+    aux:write(string.format('[%q]=%s,', id2, value))
   end
-  for id, tab in pairs(first_alterations) do
-    if keys_changed(tab, new_first_alterations[id]) or entries_changed(tab, first_alterations[id]) then return true end
+  aux:write('},\n}\n')
+  aux:close()
+end
+
+-- a field rather than a local function: the main chunk of this file is close
+-- to Lua's limit of 200 local variables
+function score_aux.make_dir()
+  if not lfs.isdir(score_aux.dir) then
+    local ok, message = lfs.mkdirp(score_aux.dir)
+    if not ok then
+      err("\n Unable to create %s: %s", score_aux.dir, message)
+      return false
+    end
   end
-  return false
+  return true
 end
 
 local function write_greaux()
-  if is_greaux_write_needed() then
-    -- only write this if heights change; since table ordering is not
-    -- predictable, this ensures a steady state if the heights are unchanged.
-    local aux = io.open(auxname, 'w')
-    if aux then
-      log("Writing %s", auxname)
-      local id, tab, id2, line, value
-      aux:write('return {\n ["line_heights"]={\n')
-      for id, tab in pairs(new_line_heights) do
-        aux:write(string.format('  ["%s"]={\n', id))
-        for id2, line in pairs(tab) do
-          if id2 == 'last' then
-            aux:write(string.format('   ["%s"]=%d,\n', id2, line))
-          else
-            aux:write(string.format('   [%d]={%d,%d,%d,%d,%d},\n', id2, line[1],
-                line[2], line[3], line[4], line[5]))
-          end
-        end
-        aux:write('  },\n')
-      end
-      aux:write(' },\n ["last_syllables"]={\n')
-      for id, tab in pairs(new_last_syllables) do
-        aux:write(string.format('  ["%s"]={\n', id))
-        for id2, value in pairs(tab) do
-          if id2 == 'state' then
-            aux:write(string.format('   state="%s",\n', value))
-          else
-            aux:write(string.format('   [%d]=%d,\n', id2, value))
-          end
-        end
-        aux:write('  },\n')
-      end
-      aux:write(' },\n ["saved_lengths"]={\n')
-      for id, tab in pairs(new_saved_lengths) do
-        aux:write(string.format('  ["%s"]={\n', id))
-        for id2, value in pairs(tab) do
-          if value ~= nil then
-            aux:write(string.format('   [%d]=%d,\n', id2, value))
-          end
-        end
-        aux:write('  },\n')
-      end
-      aux:write(' },\n ["saved_newline_before_euouae"]={\n')
-      for id, tab in pairs(new_saved_newline_before_euouae) do
-        aux:write(string.format('  ["%s"]={\n', id))
-        for id2, value in pairs(tab) do
-          if value ~= nil then
-            if value then
-              aux:write(string.format('   [%d]=true,\n', id2))
-            else
-              aux:write(string.format('   [%d]=false,\n', id2))
-            end
-          end
-        end
-        aux:write('  },\n')
-      end
-      aux:write(' },\n ["state_hashes"]={\n')
-      for id, value in pairs(new_state_hashes) do
-        aux:write(string.format('  ["%s"]="%s",\n', id, value))
-      end
-      aux:write(' },\n')
-      
-      -- Write information about alterations and line breaks. This
-      -- needs to go into the .gaux file because it affects whether
-      -- alterations are printed, which in turn affects which lines
-      -- alterations fall on.
-      aux:write(' ["first_alterations"]={\n')
-      for id, tab in pairs(new_first_alterations) do
-        aux:write(string.format('  ["%s"]={', id))
-        for i, value in pairs(tab) do
-          aux:write(string.format('[%q]=%s,', i, value))
-        end
-        aux:write(string.format('},\n'))
-      end
-      aux:write(' },\n}\n')
-      aux:close()
-    else
-      err("\n Unable to open %s", auxname)
+  local rerun_needed = false
+  local score_ids = {}
+  local id, _, tab
+  for _, tab in ipairs({new_state_hashes, new_line_heights, new_last_syllables,
+      new_saved_lengths, new_saved_newline_before_euouae,
+      new_first_alterations, state_hashes}) do
+    for id, _ in pairs(tab) do
+      score_ids[id] = true
     end
+  end
+  if not score_aux.make_dir() then
+    return
+  end
+  gregoriotex.write_nabc_cache()
+  snippets.compile_pending()
+  snippets.write_cache()
+  -- only rewrite the gaux files of the scores whose values changed, which
+  -- also ensures a steady state when nothing changes.  When trial
+  -- typesetting converged, the values in memory are already the new ones,
+  -- so no rerun is needed, but the file is still updated so that the next
+  -- run starts from them.
+  for id, _ in pairs(score_ids) do
+    local write_needed = score_aux.is_write_needed(id)
+    if write_needed or trial.updated_scores[id] or score_aux.all_loaded then
+      score_aux.write(id)
+    end
+    rerun_needed = rerun_needed or write_needed
+  end
+  -- remove the files of the scores which are no longer in the document
+  local filename
+  for filename in lfs.dir(score_aux.dir) do
+    id = string.match(filename, '^(.+)%.gaux$')
+    if id and not new_state_hashes[id] then
+      os.remove(score_aux.dir..'/'..filename)
+    end
+  end
+  if score_aux.all_loaded and lfs.isfile(auxname) then
+    -- the values have been migrated to score_aux.dir
+    os.remove(auxname)
+  end
 
+  if rerun_needed then
     warn("Line heights, variable brace lengths, or soft flats/sharps may have changed. Rerun to fix.")
   end
 end
 
+-- calls func at the end of the run
+local function add_end_of_run_callback(func, name)
+  local mcb_version = luatexbase.get_module_version and
+      luatexbase.get_module_version('luatexbase-mcb') or 9999
+  if mcb_version and mcb_version > 0.6 then
+    luatexbase.add_to_callback('finish_pdffile', func, name)
+  else
+    -- The version of luatexbase in TeX Live 2014 does not support it, and
+    -- luatexbase prevents a direct call to callback.register.  Because of
+    -- this, we lose the LuaTeX statistics and "output written to" messages,
+    -- but I know of no other workaround.
+
+    luatexbase.add_to_callback('stop_run', func, name)
+  end
+end
+
 local function init(arg, enable_height_computation)
   -- is there a better way to get the output directory?
   local outputdir = nil
@@ -397,15 +610,26 @@ local function init(arg, enable_height_computation)
   basepath = lfs.normalize(basepath)
     
   auxname = basepath..'.gaux'
+  score_aux.dir = basepath..'.gaux.d'
   tmpname = basepath..'.gtmp'
   test_snippet_filename = basepath..'.test.gsnippet'
-  snippet_filename = basepath..'.gsnippet'
-  snippet_logname = basepath..'.gsniplog'
-
-  -- to get latexmk to realize the aux file is a dependency
-  texio.write_nl('('..auxname..')')
+  snippets.filename = basepath..'.gsnippet'
+  snippets.logname = basepath..'.gsniplog'
+  snippets.cache_filename = score_aux.dir..'/snippets.gcache'
+  gregoriotex.set_nabc_cache_file(score_aux.dir..'/nabc.gcache')
+
+  line_heights = {}
+  last_syllables = {}
+  state_hashes = {}
+  saved_lengths = {}
+  saved_newline_before_euouae = {}
+  first_alterations = {}
+  -- the gaux files of the scores are read on demand by score_aux.load,
+  -- except for the single gaux file of older versions, read whole
   if lfs.isfile(auxname) then
+    texio.write_nl('('..auxname..')')
     log("Reading %s", auxname)
+    score_aux.all_loaded = true
     local score_info = dofile(auxname)
     line_heights = score_info.line_heights or {}
     last_syllables = score_info.last_syllables or {}
@@ -413,13 +637,6 @@ local function init(arg, enable_height_computation)
     saved_lengths = score_info.saved_lengths or {}
     saved_newline_before_euouae = score_info.saved_newline_before_euouae or {}
     first_alterations = score_info.first_alterations or {}
-  else
-    line_heights = {}
-    last_syllables = {}
-    state_hashes = {}
-    saved_lengths = {}
-    saved_newline_before_euouae = {}
-    first_alterations = {}
   end
 
   if enable_height_computation then
@@ -427,21 +644,15 @@ local function init(arg, enable_height_computation)
     new_last_syllables = {}
     new_state_hashes = {}
 
-    local mcb_version = luatexbase.get_module_version and
-        luatexbase.get_module_version('luatexbase-mcb') or 9999
-    if mcb_version and mcb_version > 0.6 then
-      luatexbase.add_to_callback('finish_pdffile', write_greaux,
-          'gregoriotex.write_greaux')
-    else
-      -- The version of luatexbase in TeX Live 2014 does not support it, and
-      -- luatexbase prevents a direct call to callback.register.  Because of
-      -- this, we lose the LuaTeX statistics and "output written to" messages,
-      -- but I know of no other workaround.
-
-      luatexbase.add_to_callback('stop_run', write_greaux,
-          'gregoriotex.write_greaux')
-    end
+    add_end_of_run_callback(write_greaux, 'gregoriotex.write_greaux')
   else
+    -- only the nabc cache is written, which does not depend on the line
+    -- heights
+    add_end_of_run_callback(function()
+      if score_aux.make_dir() then
+        gregoriotex.write_nabc_cache()
+      end
+    end, 'gregoriotex.write_nabc_cache')
     warn('Height computation has been skipped.  Gregorio will use '..
         'previously computed values if available but will not recompute '..
         'line heights.  Remove or undefine \\greskipheightcomputation to '..
@@ -505,16 +716,18 @@ local function dump_nodes(head)
   log('--end dump--')
 end
 
--- helper function for center_translation()
+-- helper function for center_translation(); works on direct nodes
 local function get_first_node_by_id(id, head)
-  for n in traverse_id(id, head) do
+  for n in direct.traverse_id(id, head) do
     return n
   end
 end
 
+-- startnode and endnode are direct nodes
 local function center_translation(startnode, endnode, ratio, sign, order)
+  local getlist, setfield = direct.getlist, direct.setfield
   -- total width between beginning the two centering points
-  local total_width = node.dimensions(ratio, sign, order, startnode, endnode)
+  local total_width = direct.dimensions(ratio, sign, order, startnode, endnode)
   -- definition of translation with a beginning is:
   --  \hbox to 0pt{
   --    \kern 0pt
@@ -534,15 +747,15 @@ local function center_translation(startnode, endnode, ratio, sign, order)
   --
   -- To avoid unpleasant surprises, let's search for each desired node
   -- by its type:
-  local vlistnode = get_first_node_by_id(vlist, startnode.head)
-  local hlistnode = get_first_node_by_id(hlist, vlistnode.head)
-  local glyphnode = get_first_node_by_id(glyph, hlistnode.head)
+  local vlistnode = get_first_node_by_id(vlist, getlist(startnode))
+  local hlistnode = get_first_node_by_id(hlist, getlist(vlistnode))
+  local glyphnode = get_first_node_by_id(glyph, getlist(hlistnode))
   -- hence translation width is:
-  local trans_width = node.dimensions(glyphnode)
+  local trans_width = direct.dimensions(glyphnode)
   -- now we must transform the kern 0pt into kern Xpt and kern -Xpt where X is:
   local X = (total_width - trans_width) / 2
-  vlistnode.prev.kern = X
-  vlistnode.next.kern = -X
+  setfield(direct.getprev(vlistnode), 'kern', X)
+  setfield(direct.getnext(vlistnode), 'kern', -X)
 end
 
 local debug_types_activated = {['linesglues'] = false}
@@ -565,31 +778,34 @@ gregoriotex.module.debugmessage = debugmessage
 
 -- Find stafflines and commentary, which are meant to take up the full
 -- line width, and adjust them to actually take up the full line
--- width.
+-- width.  line is a direct node.
 local function adjust_fullwidth (line)
+  local getfield, setfield = direct.getfield, direct.setfield
+  local getlist, setlist = direct.getlist, direct.setlist
+  local d_has_attribute = direct.has_attribute
   -- Determine line width, ignoring \leftskip
-  local line_width = line.width
-  for child in node.traverse(line.head) do
-    if child.id == glue and child.subtype == 8 then
-      line_width = line_width - node.effective_glue(child, line)
+  local line_width = getfield(line, 'width')
+  for child in direct.traverse_id(glue, getlist(line)) do
+    if direct.getsubtype(child) == 8 then
+      line_width = line_width - direct.effective_glue(child, line)
     end
   end
   debugmessage("stafflines", "line width %spt", line_width/2^16)
 
   local function visit(cur)
-    for child in node.traverse_list(cur.head) do
-      if has_attribute(child, part_attr, part_commentary) then
-        debugmessage("adjust_fullwidth", "commentary width %spt -> %spt", child.width/2^16, line_width/2^16)
-        child.width = line_width
-        local new = node.hpack(child.head, line_width, 'exactly')
-        cur.head = node.insert_before(cur.head, child, new)
-        cur.head = node.remove(cur.head, child)
-      elseif has_attribute(child, part_attr, part_stafflines) then
-        debugmessage("adjust_fullwidth", "staff width %spt -> %spt", child.width/2^16, line_width/2^16)
-        for r in traverse_id(rule, child.head) do
-          r.width = line_width
+    for child in direct.traverse_list(getlist(cur)) do
+      if d_has_attribute(child, part_attr, part_commentary) then
+        debugmessage("adjust_fullwidth", "commentary width %spt -> %spt", getfield(child, 'width')/2^16, line_width/2^16)
+        setfield(child, 'width', line_width)
+        local new = direct.hpack(getlist(child), line_width, 'exactly')
+        local head = direct.insert_before(getlist(cur), child, new)
+        setlist(cur, (direct.remove(head, child)))
+      elseif d_has_attribute(child, part_attr, part_stafflines) then
+        debugmessage("adjust_fullwidth", "staff width %spt -> %spt", getfield(child, 'width')/2^16, line_width/2^16)
+        for r in direct.traverse_id(rule, getlist(child)) do
+          setfield(r, 'width', line_width)
         end
-        child.width = line_width
+        setfield(child, 'width', line_width)
       else
         visit(child)
       end
@@ -712,9 +928,25 @@ local function drop_initial(h)
 
 end
   
+-- time spent in post_linebreak for the current score, reported at the end
+-- of the score when the postlinebreak debug messages are activated
+local post_linebreak_profile = { calls = 0, time = 0 }
+
 -- in each function we check if we really are inside a score,
 -- which we can see with the dash_attr being set or not
+--
+-- Everything is done in a single traversal of the paragraph, each line's
+-- children being visited once, through the direct node interface.  Only the
+-- dropped initial, which needs the final line heights, is handled after the
+-- traversal; it touches neither the widths nor the contents of the syllables
+-- which are changed on the way.
 local function post_linebreak(h, groupcode, glyphes)
+  local start_time = debug_types_activated['postlinebreak'] and os.clock()
+  local getid, getnext, getlist = direct.getid, direct.getnext, direct.getlist
+  local getfield = direct.getfield
+  local d_has_attribute = direct.has_attribute
+  local d_traverse_id = direct.traverse_id
+  local head = direct.todirect(h)
   -- TODO: to be changed according to the font
   local lastseennode            = nil
   local centerstartnode         = nil
@@ -726,156 +958,173 @@ local function post_linebreak(h, groupcode, glyphes)
   local linenum                 = 0
   local syl_id                  = nil
   -- we explore the lines
-  for line in traverse(h) do
-    if line.id == glue then
-      if line.next ~= nil and line.next.id == hlist
-          and has_attribute(line.next, dash_attr)
-          and count(hlist, line.next.head) <= 2 then
+  local line = head
+  while line do
+    local next_line = getnext(line)
+    local id = getid(line)
+    if id == glue then
+      if next_line ~= nil and getid(next_line) == hlist
+          and d_has_attribute(next_line, dash_attr)
+          and direct.count(hlist, getlist(next_line)) <= 2 then
         --log("eating glue")
-        h, line = remove(h, line)
+        head = direct.remove(head, line)
       end
-    elseif line.id == hlist and has_attribute(line, dash_attr) then
+    elseif id == hlist then
+      local in_score = d_has_attribute(line, dash_attr) ~= nil
       -- the next two lines are to remove the dumb lines
-      if count(hlist, line.head) <= 2 then
+      if in_score and direct.count(hlist, getlist(line)) <= 2 then
         --log("eating line")
-        h, line = remove(h, line)
+        head = direct.remove(head, line)
       else
-        linenum = linenum + 1
-        debugmessage('linesglues', 'line %d: %s factor %.0f%%', linenum, glue_sign_name[line.glue_sign], line.glue_set*100)
-        centerstartnode = nil
-        line_id = nil
-        line_top = nil
-        line_bottom = nil
-        line_has_translation = false
-        line_has_abovelinestext = false
-
-        for n in traverse_id(hlist, line.head) do
-          syl_id = has_attribute(n, syllable_id_attr) or syl_id
-          if has_attribute(n, center_attr, startcenter) then
-            centerstartnode = n
-          elseif has_attribute(n, center_attr, endcenter) then
-            if not centerstartnode then
-              warn("End of a translation centering area encountered on a\nline without translation centering beginning,\nskipping translation...")
+        -- the alterations seen on this line, by pitch
+        local seen = {}
+        -- whether the last syllable of the line needs a dash
+        local adddash = false
+        local glue_set, glue_sign, glue_order
+        if in_score then
+          glue_set = getfield(line, 'glue_set')
+          glue_sign = getfield(line, 'glue_sign')
+          glue_order = getfield(line, 'glue_order')
+          linenum = linenum + 1
+          debugmessage('linesglues', 'line %d: %s factor %.0f%%', linenum, glue_sign_name[glue_sign], glue_set*100)
+          centerstartnode = nil
+          line_id = nil
+          line_top = nil
+          line_bottom = nil
+          line_has_translation = false
+          line_has_abovelinestext = false
+        end
+
+        for n in d_traverse_id(hlist, getlist(line)) do
+          if in_score then
+            syl_id = d_has_attribute(n, syllable_id_attr) or syl_id
+            local center = d_has_attribute(n, center_attr)
+            if center == startcenter then
+              centerstartnode = n
+            elseif center == endcenter then
+              if not centerstartnode then
+                warn("End of a translation centering area encountered on a\nline without translation centering beginning,\nskipping translation...")
+              else
+                center_translation(centerstartnode, n, glue_set, glue_sign, glue_order)
+              end
+            end
+
+            if new_score_heights then
+              local glyph_id = d_has_attribute(n, glyph_id_attr)
+              if glyph_id and glyph_id > prev_line_id then
+                local glyph_top = d_has_attribute(n, glyph_top_attr) or 7 -- 'e' = \gre@pitch@dummy
+                local glyph_bottom = d_has_attribute(n, glyph_bottom_attr) or 7 -- 'e' = \gre@pitch@dummy
+                if not line_id or glyph_id > line_id then
+                  line_id = glyph_id
+                end
+                if not line_top or glyph_top > line_top then
+                  line_top = glyph_top
+                end
+                if not line_bottom or glyph_bottom < line_bottom then
+                  line_bottom = glyph_bottom
+                end
+              end
+            end
+          end
+
+          -- Collect information about each alteration (flat, sharp, or
+          -- natural):
+          --   1 if it is the first alteration on the line (on the same pitch)
+          --   2 if it has a different type from the previous alteration on
+          --     the line (on the same pitch)
+          --   3 otherwise.
+          -- This skips custos alterations because they're one level
+          -- deeper. As a result, they are always printed.
+          local t = d_has_attribute(n, alteration_type_attr)
+          if t ~= nil and t > 0 then
+            local i = d_has_attribute(n, alteration_id_attr)
+            local pitch = d_has_attribute(n, alteration_pitch_attr)
+            if seen[pitch] == nil then
+              new_score_first_alterations[i] = 1
+            elseif seen[pitch] ~= t then
+              new_score_first_alterations[i] = 2
             else
-              center_translation(centerstartnode, n, line.glue_set, line.glue_sign, line.glue_order)
+              new_score_first_alterations[i] = 3
             end
+            new_score_first_alterations['last'] = i
+            debugmessage("alteration", "id=%s type=%s height=%s seen=%s first=%s", i, t, pitch, seen[t], new_score_first_alterations[i])
+            seen[pitch] = t
           end
- 
-          if new_score_heights then
-            local glyph_id = has_attribute(n, glyph_id_attr)
-            local glyph_top = has_attribute(n, glyph_top_attr) or 7 -- 'e' = \gre@pitch@dummy
-            local glyph_bottom = has_attribute(n, glyph_bottom_attr) or 7 -- 'e' = \gre@pitch@dummy
-            if glyph_id and glyph_id > prev_line_id then
-              if not line_id or glyph_id > line_id then
-                line_id = glyph_id
-              end
-              if not line_top or glyph_top > line_top then
-                line_top = glyph_top
-              end
-              if not line_bottom or glyph_bottom < line_bottom then
-                line_bottom = glyph_bottom
-              end
+
+          if in_score then
+            -- Look for the last node that has dash_attr > 0.
+            -- If a syllable is not word-final, it may need a dash if it
+            -- ends up being line-final.
+            -- Note: This also loops over translations, but translations
+            -- come before lyrics, so they should never become lastseennode
+            local dash = d_has_attribute(n, dash_attr)
+            if dash == potentialdashvalue then
+              adddash=true
+              lastseennode=n
+              -- if we encounter a text that doesn't need a dash, we acknowledge it
+            elseif dash == nopotentialdashvalue then
+              adddash=false
             end
           end
         end
-        -- look for marks
-        if new_score_heights then
-          for n in traverse_id(whatsit, line.head) do
-            line_has_translation = line_has_translation or
-                is_mark(n, translation_mark)
-            line_has_abovelinestext = line_has_abovelinestext or
-                is_mark(n, abovelinestext_mark)
+
+        if in_score then
+          -- look for marks
+          if new_score_heights then
+            for n in d_traverse_id(whatsit, getlist(line)) do
+              line_has_translation = line_has_translation or
+                  is_mark(n, translation_mark)
+              line_has_abovelinestext = line_has_abovelinestext or
+                  is_mark(n, abovelinestext_mark)
+            end
           end
-        end
 
-        if line_id then
-          new_score_heights[prev_line_id] = { linenum, line_top, line_bottom,
-              line_has_translation and 1 or 0,
-              line_has_abovelinestext and 1 or 0 }
-          new_score_heights['last'] = prev_line_id
-          prev_line_id = line_id
-        end
-        if new_score_last_syllables and syl_id then
-          new_score_last_syllables[syl_id] = syl_id
+          if line_id then
+            new_score_heights[prev_line_id] = { linenum, line_top, line_bottom,
+                line_has_translation and 1 or 0,
+                line_has_abovelinestext and 1 or 0 }
+            new_score_heights['last'] = prev_line_id
+            prev_line_id = line_id
+          end
+          if new_score_last_syllables and syl_id then
+            new_score_last_syllables[syl_id] = syl_id
+          end
         end
-      end
-    end
-  end
 
-  -- If there is a dropped initial, lower it to its correct position
-  if tex.count['gre@count@initiallines'] > 1 or tex.count['gre@count@initialposition'] == 3 then
-    drop_initial(h)
-  end
-
-  -- Change width of staff lines and commentary
-  for line in traverse_id(hlist, h) do
-    adjust_fullwidth(line)
-  end
+        -- Change width of staff lines and commentary
+        adjust_fullwidth(line)
 
-  -- Collect information about each alteration (flat, sharp, or natural):
-  --   1 if it is the first alteration on the line (on the same pitch)
-  --   2 if it has a different type from the previous alteration on the line (on the same pitch)
-  --   3 otherwise.
-  for line in traverse_id(hlist, h) do
-    local seen = {}
-    for n in traverse_id(hlist, line.head) do
-      -- This skips custos alterations because they're one level
-      -- deeper. As a result, they are always printed.
-      local t = has_attribute(n, alteration_type_attr)
-      if t ~= nil and t > 0 then
-        local i = has_attribute(n, alteration_id_attr)
-        local h = has_attribute(n, alteration_pitch_attr)
-        if seen[h] == nil then
-          new_score_first_alterations[i] = 1
-        elseif seen[h] ~= t then
-          new_score_first_alterations[i] = 2
-        else
-          new_score_first_alterations[i] = 3
+        -- If the last syllable needed a dash, add it
+        if adddash then
+          local lastglyph
+          -- we traverse the list, to detect the font to use,
+          -- and also not to add an hyphen if there is already one
+          for g in d_traverse_id(glyph, getlist(lastseennode)) do
+            lastglyph = g
+          end
+          local char = direct.getchar(lastglyph)
+          if not (char == hyphen or char == 45) then
+            local dashnode, hyphnode = getdashnnode()
+            hyphnode.font = direct.getfont(lastglyph)
+            direct.insert_after(getlist(lastseennode), lastglyph,
+                direct.todirect(dashnode))
+          end
         end
-        new_score_first_alterations['last'] = i
-        debugmessage("alteration", "id=%s type=%s height=%s seen=%s first=%s", i, t, h, seen[t], new_score_first_alterations[i])
-        seen[h] = t
       end
     end
+    line = next_line
   end
 
-  -- Look for words that are broken across lines and insert a hyphen
-  for line in traverse_id(hlist, h) do
-    if has_attribute(line, dash_attr) then
-      -- Look for the last node that has dash_attr > 0
-      local adddash=false
-      for n in traverse_id(hlist, line.head) do
-        -- If a syllable is not word-final, it may need a dash if it
-        -- ends up being line-final.
-        -- Note: This also loops over translations, but translations
-        -- come before lyrics, so they should never become lastseennode
-        if has_attribute(n, dash_attr, potentialdashvalue) then
-          adddash=true
-          lastseennode=n
-          -- if we encounter a text that doesn't need a dash, we acknowledge it
-        elseif has_attribute(n, dash_attr, nopotentialdashvalue) then
-          adddash=false
-        end
-      end
-
-      -- If the last syllable needed a dash, add it
-      if adddash then
-        local lastglyph
-        -- we traverse the list, to detect the font to use,
-        -- and also not to add an hyphen if there is already one
-        for g in node.traverse_id(glyph, lastseennode.head) do
-          lastglyph = g
-        end
-        if not (lastglyph.char == hyphen or lastglyph.char == 45) then
-          local dashnode, hyphnode = getdashnnode()
-          hyphnode.font = lastglyph.font
-          insert_after(lastseennode.head, lastglyph, dashnode)
-        end
-      end
-    end
+  -- If there is a dropped initial, lower it to its correct position
+  if tex.count['gre@count@initiallines'] > 1 or tex.count['gre@count@initialposition'] == 3 then
+    drop_initial(direct.tonode(head))
   end
 
   --dump_nodes(h)
+  if start_time then
+    post_linebreak_profile.calls = post_linebreak_profile.calls + 1
+    post_linebreak_profile.time = post_linebreak_profile.time + os.clock() - start_time
+  end
   -- due to special cases, we don't return h here (see comments in bug #20974)
   return true
 end
@@ -929,16 +1178,70 @@ local function get_font_resources(id)
   return resource_dummy
 end
 
--- get_score_font_resources(string) -- Retrieve the resource table
--- belonging to a font in the ``score_font`` table. Always returns
--- a table whose ``unicodes`` field is indexable.
-local function get_score_font_resources(name)
-  return get_font_resources(get_score_font_id(name))
-end
-
-local function get_score_font_unicode_pairs(name)
-  local unicodes = get_score_font_resources(name).unicodes
-  if not font_indexed[name] then
+-- glyph_maps.cache_file(table) -- Return the name of the file caching the
+-- glyph map of a font, in the LuaTeX cache of luaotfload, and the signature
+-- identifying the font version, or nil if there is no such cache.
+function glyph_maps.cache_file(fnt)
+  if not (caches and caches.getwritablepath) then return nil end
+  local metadata = fnt.shared and fnt.shared.rawdata and fnt.shared.rawdata.metadata
+  if not metadata or not metadata.fontname or not fnt.filename then return nil end
+  local ok, dir = pcall(caches.getwritablepath, 'gregoriotex', 'glyphs')
+  if not ok or not dir or not lfs.isdir(dir) then return nil end
+  local attributes = lfs.attributes(fnt.filename)
+  local signature = string.format('%s %s %s %s', glyph_maps.version,
+      metadata.fontname, metadata.version or '',
+      attributes and attributes.modification or '')
+  return dir..'/'..string.gsub(metadata.fontname, '[^%w%-_]', '_')..'.lua', signature
+end
+
+-- glyph_maps.read(string, string) -- Read a cached glyph map, returning nil
+-- if it is missing or for another version of the font.
+function glyph_maps.read(filename, signature)
+  if not lfs.isfile(filename) then return nil end
+  local ok, map = pcall(dofile, filename)
+  if ok and type(map) == 'table' and map.signature == signature
+      and type(map.unicodes) == 'table' and type(map.names) == 'table' then
+    return map
+  end
+  return nil
+end
+
+function glyph_maps.write(filename, map)
+  local out = io.open(filename, 'w')
+  if not out then
+    warn("Unable to write the glyph cache %s", filename)
+    return
+  end
+  log("Writing %s", filename)
+  local name, unicode
+  out:write(string.format('return {\n ["signature"]=%q,\n ["unicodes"]={\n', map.signature))
+  for name, unicode in pairs(map.unicodes) do
+    out:write(string.format('  [%q]=%d,\n', name, unicode))
+  end
+  out:write(' },\n ["names"]={\n')
+  for _, name in ipairs(map.names) do
+    out:write(string.format('  %q,\n', name))
+  end
+  out:write(' },\n}\n')
+  out:close()
+end
+
+-- glyph_maps.get(string) -- Retrieve the glyph map of a font in
+-- the ``score_font`` table: ``unicodes`` maps every glyph name to its code
+-- point and ``names`` is the sorted list of the names of the glyphs without
+-- a suffix (a dot) which have a code point.  The map is kept in the LuaTeX
+-- cache, so that it is only built from the font when its version changes.
+function glyph_maps.get(name)
+  local map = glyph_maps.by_font[name]
+  if map then return map end
+  local fnt = get_font_by_id(get_score_font_id(name))
+  if not fnt then
+    return { unicodes = {}, names = {} }
+  end
+  local filename, signature = glyph_maps.cache_file(fnt)
+  map = filename and glyph_maps.read(filename, signature)
+  if not map then
+    local unicodes = (fnt.resources or resource_dummy).unicodes
     -- The unicodes table may be lazy-loaded, so iterating it may not
     -- return everything.  Attempting to retrieve the code point of a
     -- glyph that has not already been loaded will trigger the __index
@@ -948,9 +1251,52 @@ local function get_score_font_unicode_pairs(name)
     -- access a non-existing glyph in order to force load the entire
     -- table.
     local ignored = unicodes['_this_is_hopefully_a_nonexistent_glyph_']
-    font_indexed[name] = true
+    map = { signature = signature, unicodes = {}, names = {} }
+    local glyph, unicode
+    for glyph, unicode in pairs(unicodes) do
+      map.unicodes[glyph] = unicode
+      if unicode >= 0 and not string.match(glyph, '%.') then
+        map.names[#map.names + 1] = glyph
+      end
+    end
+    table.sort(map.names)
+    if filename then
+      glyph_maps.write(filename, map)
+    end
+  end
+  glyph_maps.by_font[name] = map
+  return map
+end
+
+-- glyph_maps.matching(table, string) -- Iterate over the names of a glyph map
+-- matching a glyph name in which * stands for any sequence of characters,
+-- with their code points.  Only the names starting with the part before the
+-- first * are looked at.
+function glyph_maps.matching(map, wildcard)
+  local prefix = string.match(wildcard, '^[^*]*')
+  local pattern = '^'..wildcard:gsub('%*', '.*')..'$'
+  local names, unicodes = map.names, map.unicodes
+  -- binary search for the first name not before the prefix
+  local low, high = 1, #names + 1
+  while low < high do
+    local middle = math.floor((low + high) / 2)
+    if names[middle] < prefix then
+      low = middle + 1
+    else
+      high = middle
+    end
+  end
+  local i = low - 1
+  return function()
+    while true do
+      i = i + 1
+      local glyph = names[i]
+      if not glyph or glyph:sub(1, #prefix) ~= prefix then return nil end
+      if string.match(glyph, pattern) then
+        return glyph, unicodes[glyph]
+      end
+    end
   end
-  return pairs(unicodes)
 end
 
 local inside_score = false
@@ -968,17 +1314,25 @@ local function at_score_beginning(score_id, top_height, bottom_height,
     has_translation, has_above_lines_text, top_height_adj, bottom_height_adj,
     score_font_name)
   inside_score = true
+  debugmessage("digest", "score %s has a %s digest", score_id,
+    score_digest.algorithm_of(score_id))
   local inclusion = score_inclusion[score_id] or 1
-  score_inclusion[score_id] = inclusion + 1
+  -- a trial typesetting is not a new inclusion of the score
+  if not trial.in_progress then
+    score_inclusion[score_id] = inclusion + 1
+  end
   score_id = score_id..'.'..inclusion
   cur_score_id = score_id
+  score_aux.load(score_id)
   if (top_height > top_height_adj or bottom_height < bottom_height_adj
       or has_translation ~= 0 or has_above_lines_text ~= 0)
       and tex.count['gre@variableheightexpansion'] == 1 then
     score_heights = line_heights[score_id] or {}
     if new_line_heights then
       new_score_heights = {}
-      new_line_heights[score_id] = new_score_heights
+      if not trial.in_progress then
+        new_line_heights[score_id] = new_score_heights
+      end
     end
     prev_line_id = tex.getattribute(glyph_id_attr)
   else
@@ -997,16 +1351,29 @@ local function at_score_beginning(score_id, top_height, bottom_height,
   if score_first_alterations and state_hashes[score_id] ~= state then
     score_first_alterations = nil
   end
-  if new_state_hashes then
+  if new_state_hashes and not trial.in_progress then
     new_state_hashes[score_id] = state
   end
   if new_last_syllables then
     new_score_last_syllables = {}
-    new_last_syllables[score_id] = new_score_last_syllables
+    if not trial.in_progress then
+      new_last_syllables[score_id] = new_score_last_syllables
+    end
   end
   if new_first_alterations then
     new_score_first_alterations = {}
-    new_first_alterations[score_id] = new_score_first_alterations
+    if not trial.in_progress then
+      new_first_alterations[score_id] = new_score_first_alterations
+    end
+  end
+  if trial.in_progress then
+    trial.score = {
+      score_id = score_id,
+      state = state,
+      heights = new_score_heights,
+      last_syllables = new_score_last_syllables,
+      first_alterations = new_score_first_alterations,
+    }
   end
 
   luatexbase.add_to_callback('post_linebreak_filter', post_linebreak, 'gregoriotex.post_linebreak', 1)
@@ -1019,12 +1386,90 @@ local function at_score_end()
   inside_score = false
   luatexbase.remove_from_callback('post_linebreak_filter', 'gregoriotex.post_linebreak')
   luatexbase.remove_from_callback("hyphenate", "gregoriotex.disable_hyphenation")
+  debugmessage('postlinebreak', 'post_linebreak: %d paragraphs in %.3f ms',
+      post_linebreak_profile.calls, post_linebreak_profile.time * 1000)
+  post_linebreak_profile.calls = 0
+  post_linebreak_profile.time = 0
   per_line_dims = {}
   per_line_counts = {}
   saved_dims = {}
   saved_counts = {}
 end
 
+-- Compare two tables of values or of arrays of values (a missing table is
+-- the same as an empty one)
+local function values_changed(tab1, tab2)
+  tab1 = tab1 or {}
+  tab2 = tab2 or {}
+  local k, v, i
+  for k, v in pairs(tab1) do
+    local v2 = tab2[k]
+    if type(v) == 'table' and type(v2) == 'table' then
+      if #v ~= #v2 then return true end
+      for i = 1, #v do
+        if v[i] ~= v2[i] then return true end
+      end
+    elseif v ~= v2 then
+      return true
+    end
+  end
+  for k, _ in pairs(tab2) do
+    if tab1[k] == nil then return true end
+  end
+  return false
+end
+
+--- Start the trial typesetting of a score.
+-- During a trial (see \gre@inputscore), post_linebreak collects the line
+-- heights, last syllables and first alterations of the score in a scratch
+-- table instead of the tables written to the gaux file.
+function trial.begin()
+  trial.in_progress = true
+  trial.score = nil
+end
+
+--- Finish the trial typesetting of a score.
+-- If the values collected during the trial differ from the ones the trial
+-- was typeset with, they replace them, so that the next trial (or the
+-- final typesetting) uses them.  Sets \ifgre@trialstable accordingly.
+function trial.finish()
+  local stable = true
+  trial.in_progress = false
+  local collected = trial.score
+  if collected then
+    local id = collected.score_id
+    if collected.heights and
+        values_changed(collected.heights, line_heights[id]) then
+      line_heights[id] = collected.heights
+      stable = false
+    end
+    if state_hashes[id] ~= collected.state then
+      state_hashes[id] = collected.state
+      stable = false
+    end
+    if collected.last_syllables and
+        values_changed(collected.last_syllables, last_syllables[id]) then
+      last_syllables[id] = collected.last_syllables
+      stable = false
+    end
+    if collected.first_alterations and
+        values_changed(collected.first_alterations, first_alterations[id]) then
+      first_alterations[id] = collected.first_alterations
+      stable = false
+    end
+    if not stable then
+      log("Line heights of score %s changed during trial typesetting", id)
+      trial.updated_scores[id] = true
+    end
+  end
+  trial.score = nil
+  if stable then
+    tex.sprint(catcode_at_letter, [[\gre@trialstabletrue]])
+  else
+    tex.sprint(catcode_at_letter, [[\gre@trialstablefalse]])
+  end
+end
+
 --- Toggle the state of GretorioTeX callbacks.
 -- Our callbacks can affect fancyhdr's ability to create multi-line headers/footers
 -- By adding this function to fancyhdr's before and after hooks, our callbacks are removed
@@ -1121,6 +1566,9 @@ local function compile_gabc(gabc_file, gtex_file, glog_file, allow_deprecated)
   if not allow_deprecated then
     table.insert(cmd, '-D')
   end
+  if score_digest.algorithm ~= 'sha1' then
+    table.extend(cmd, {'-H', score_digest.algorithm})
+  end
 
   table.extend(cmd, {'-W', '-o', gtex_file, '-l', glog_file, gabc_file})
   info("running: %s", table.concat(cmd, ' '))
@@ -1291,48 +1739,123 @@ local function include_score(gabc_file, force_gabccompile, allow_deprecated)
   end
 
   -- Input the gtex file
-  tex.print(string.format([[\input %s\relax]], gtex_file))
+  tex.sprint(catcode_at_letter, string.format([[\gre@inputscore{%s}]],
+      gtex_file))
+end
+
+-- compiles the snippets which were not in the cache in batch mode, with one
+-- run of gregorio for all those compiled with the same options
+function snippets.compile_pending()
+  local groups = {}
+  local key, snippet, group, first, i
+  for key, snippet in pairs(snippets.pending) do
+    local filename = string.format('%s/snippet-%s.gabc', score_aux.dir, key)
+    local f = io.open(filename, 'w')
+    if f then
+      f:write(snippet.gabc)
+      f:close()
+      group = groups[snippet.allow_deprecated] or {}
+      groups[snippet.allow_deprecated] = group
+      group[#group + 1] = filename
+    else
+      err("\n Unable to open %s", filename)
+    end
+  end
+  if next(groups) == nil then return end
+  local allow_deprecated
+  for allow_deprecated, group in pairs(groups) do
+    -- keep the command lines within the limits of every system
+    for first = 1, #group, 64 do
+      local cmd = snippets.command(allow_deprecated)
+      table.insert(cmd, '-B')
+      for i = first, math.min(first + 63, #group) do
+        table.insert(cmd, group[i])
+      end
+      info('Running %s', table.concat(cmd, ' '))
+      os.spawn(cmd)
+    end
+  end
+  local keep_files = debug_types_activated['snippet'] or debug_types_activated['all']
+  for key, _ in pairs(snippets.pending) do
+    local base = string.format('%s/snippet-%s', score_aux.dir, key)
+    local f = io.open(base..'.gtex', 'r')
+    if f then
+      snippets.new[key] = { gtex = f:read('*a'), glog = snippets.read_log(base..'.glog') }
+      snippets.changed = true
+      f:close()
+    else
+      -- gregorio removes the output of a snippet with errors
+      local glog = lfs.isfile(base..'.glog') and snippets.read_log(base..'.glog') or ''
+      err("\nUnable to compile the gabc snippet %s.gabc:\n%s", base, glog)
+    end
+    if not keep_files then
+      os.remove(base..'.gabc')
+      os.remove(base..'.gtex')
+      os.remove(base..'.glog')
+    end
+  end
+  warn("gabc snippets have been compiled.  Rerun to typeset them.")
 end
 
 local function direct_gabc(gabc, header, allow_deprecated)
   info('Processing gabc snippet...')
-  local f = io.open(snippet_filename, 'w')
   -- trims spaces on both ends (trim6 from http://lua-users.org/wiki/StringTrim)
   gabc = gabc:match('^()%s*$') and '' or gabc:match('^%s*(.*%S)')
-  f:write('name:direct-gabc;\n'..(header or '')..'\n%%\n'..gabc:gsub('\\par', '\n'))
+  gabc = 'name:direct-gabc;\n'..(header or '')..'\n%%\n'..gabc:gsub('\\par', '\n')
+  local key = md5.sumhexa(string.format('%s %s\n%s', score_digest.algorithm,
+      tostring(allow_deprecated), gabc))
+  if not snippets.loaded then snippets.load_cache() end
+  local entry = snippets.new[key]
+  if not entry then
+    entry = snippets.old[key]
+    if entry then
+      snippets.reused = snippets.reused + 1
+      snippets.new[key] = entry
+    end
+  end
+  if entry then
+    snippets.typeset(entry)
+    return
+  end
+  -- the snippets are only compiled at the end of the run in batch mode,
+  -- which needs the callback of write_greaux
+  if snippets.batch and new_state_hashes then
+    snippets.pending[key] = { gabc = gabc, allow_deprecated = allow_deprecated }
+    return
+  end
+  local f = io.open(snippets.filename, 'w')
+  f:write(gabc)
   f:close()
-  cmd = {gregorio_exe(), '-W'}
-  if allow_deprecated then table.insert(cmd, '-D') end
-  table.extend(cmd, {'-o', tmpname, '-l', snippet_logname, snippet_filename})
+  local cmd = snippets.command(allow_deprecated)
+  table.extend(cmd, {'-o', tmpname, '-l', snippets.logname, snippets.filename})
   info('Running %s', table.concat(cmd, ' '))
   local content = get_prog_output(cmd, tmpname, '*a')
+  entry = { gtex = content or '', glog = snippets.read_log(snippets.logname) }
   if content == nil then
     err("\nSomething went wrong when executing\n    %s\n"
         .."shell-escape mode may not be activated. Try\n\n"
         .."%s --shell-escape %s.tex\n\n"
         .."See the documentation of Gregorio or your TeX\n"
-        .."distribution to automatize it.", cmd, tex.formatname, tex.jobname)
-  else
-    tex.print(content:explode('\n'))
-  end
-  local glog = io.open(snippet_logname, 'a+')
-  if glog == nil then
-    err("\n Unable to open %s", snippet_logname)
+        .."distribution to automatize it.", table.concat(cmd, ' '),
+        tex.formatname, tex.jobname)
   else
-    local size = glog:seek('end')
-    if size > 0 then
-      glog:seek('set')
-      local line
-      for line in glog:lines() do
-        warn(line)
-      end
-      warn("*** end of warnings/errors processing snippet ***")
-    end
-    glog:close()
+    snippets.new[key] = entry
+    snippets.changed = true
   end
+  snippets.typeset(entry)
   if not (debug_types_activated['snippet'] or debug_types_activated['all']) then
-    os.remove(snippet_filename)
-    os.remove(snippet_logname)
+    os.remove(snippets.filename)
+    os.remove(snippets.logname)
+  end
+end
+
+local function set_snippet_compilation(mode)
+  if mode == 'batch' then
+    snippets.batch = true
+  elseif mode == 'immediate' then
+    snippets.batch = false
+  else
+    err("Unknown snippet compilation mode: %s", mode)
   end
 end
 
@@ -1359,14 +1882,14 @@ end
 
 local function map_font(name, prefix)
   log("Mapping font %s", name)
-  local glyph, unicode
-  for glyph, unicode in get_score_font_unicode_pairs(name) do
-    if unicode >= 0 and not string.match(glyph, '%.') then
-      debugmessage("mapfont", "Setting \\Gre%s%s to \\char%d", prefix, glyph, unicode)
-      tex.sprint(catcode_at_letter, string.format(
-          [[\xdef\Gre%s%s{\char%d}]], prefix, glyph, unicode))
-    end
+  local map = glyph_maps.get(name)
+  local definitions = {}
+  for i, glyph in ipairs(map.names) do
+    local unicode = map.unicodes[glyph]
+    debugmessage("mapfont", "Setting \\Gre%s%s to \\char%d", prefix, glyph, unicode)
+    definitions[i] = string.format([[\xdef\Gre%s%s{\char%d}]], prefix, glyph, unicode)
   end
+  tex.sprint(catcode_at_letter, table.concat(definitions))
 end
 
 local function init_variant_font(font_name, for_score, gre_factor)
@@ -1468,24 +1991,21 @@ end
 local function change_score_glyph(glyph_name, font_name, replacement, cavum)
   cavum = cavum or ''
   if string.match(glyph_name, '%*') then
-    glyph_name = '^'..glyph_name:gsub('%*', '.*')..'$'
     if replacement ~= '' and not string.match(replacement, '^%.') then
       err('If a wildcard is supplied for glyph name, replacement must be blank or start with a dot.')
     end
     local general_font = general_font_for(cavum)
     local other_font
     if font_name == '*' then
-      other_font = get_score_font_resources(general_font).unicodes
+      other_font = glyph_maps.get(general_font).unicodes
     else
-      other_font = get_score_font_resources(font_name).unicodes
+      other_font = glyph_maps.get(font_name).unicodes
     end
-    local name, char
-    for name, char in get_score_font_unicode_pairs(general_font) do
-      if not string.match(name, '%.') and char >= 0 and string.match(name, glyph_name) then
-        local matched_replacement = name..replacement
-        if other_font[matched_replacement] ~= nil and other_font[matched_replacement] >= 0 then
-          change_single_score_glyph(name, cavum, font_name, matched_replacement)
-        end
+    local name
+    for name in glyph_maps.matching(glyph_maps.get(general_font), glyph_name) do
+      local matched_replacement = name..replacement
+      if other_font[matched_replacement] ~= nil and other_font[matched_replacement] >= 0 then
+        change_single_score_glyph(name, cavum, font_name, matched_replacement)
       end
     end
   else
@@ -1500,15 +2020,13 @@ local function reset_score_glyph(glyph_name, cavum)
   cavum = cavum or ''
   local general_font = general_font_for(cavum)
   if string.match(glyph_name, '%*') then
-    glyph_name = '^'..glyph_name:gsub('%*', '.*')..'$'
     local name, char
-    for name, char in get_score_font_unicode_pairs(general_font) do
-      if not string.match(name, '%.') and char >= 0 and string.match(name, glyph_name) then
-        set_common_score_glyph('Gre'..cavum..'CP'..name, nil, char)
-      end
+    for name, char in glyph_maps.matching(glyph_maps.get(general_font),
+        glyph_name) do
+      set_common_score_glyph('Gre'..cavum..'CP'..name, nil, char)
     end
   else
-    local char = get_score_font_resources(general_font).unicodes[glyph_name]
+    local char = glyph_maps.get(general_font).unicodes[glyph_name]
     if char == nil then
       err('\nGlyph %s was not found.', glyph_name)
     end
@@ -1886,6 +2404,8 @@ gregoriotex.init                         = init
 gregoriotex.include_score                = include_score
 gregoriotex.at_score_end                 = at_score_end
 gregoriotex.at_score_beginning           = at_score_beginning
+gregoriotex.begin_trial                  = trial.begin
+gregoriotex.end_trial                    = trial.finish
 gregoriotex.check_font_version           = check_font_version
 gregoriotex.get_gregoriotexluaversion    = get_gregoriotexluaversion
 gregoriotex.map_font                     = map_font
@@ -1897,6 +2417,7 @@ gregoriotex.set_font_factor              = set_font_factor
 gregoriotex.def_symbol                   = def_symbol
 gregoriotex.font_size                    = font_size
 gregoriotex.direct_gabc                  = direct_gabc
+gregoriotex.set_snippet_compilation      = set_snippet_compilation
 gregoriotex.adjust_line_height           = adjust_line_height
 gregoriotex.var_brace_len                = var_brace_len
 gregoriotex.save_length                  = save_length
@@ -1920,9 +2441,54 @@ gregoriotex.save_count                   = save_count
 gregoriotex.change_next_score_line_dim   = change_next_score_line_dim
 gregoriotex.change_next_score_line_count = change_next_score_line_count
 gregoriotex.set_base_output_dir          = set_base_output_dir
+gregoriotex.set_score_digest             = score_digest.set
+gregoriotex.score_digest_algorithm       = score_digest.algorithm_of
 gregoriotex.is_first_alteration          = is_first_alteration
 gregoriotex.fancyhdr_toggle_callbacks    = fancyhdr_toggle_callbacks
 
-dofile(kpse.find_file('gregoriotex-nabc.lua', 'lua'))
-dofile(kpse.find_file('gregoriotex-signs.lua', 'lua'))
-dofile(kpse.find_file('gregoriotex-symbols.lua', 'lua'))
+-- called by gregoriotex.ini just before the format is dumped: the Lua state
+-- is not dumped, so this keeps the Lua files compiled, along with the spaces
+-- hashed while loading, and defines \gre@format@bytecodes to find them again
+function gregoriotex.prepare_format()
+  local bytecodes = {}
+  local function keep(name, chunk)
+    local number = luatexbase.new_bytecode(name)
+    lua.bytecode[number] = chunk
+    bytecodes[#bytecodes + 1] = name..'='..number
+  end
+  for _, name in ipairs{'gregoriotex', 'gregoriotex-nabc', 'gregoriotex-symbols'} do
+    keep(name, assert(loadfile(kpse.find_file(name..'.lua', 'lua'))))
+  end
+  local spaces = {}
+  for name, value in pairs(hashed_spaces) do
+    spaces[#spaces + 1] = string.format('[%q] = %q', name, value)
+  end
+  keep('gregoriotex-spaces', assert(load('return {'..table.concat(spaces, ',\n')..'}')))
+  tex.sprint(catcode_at_letter, [[\gdef\gre@format@bytecodes{]]..table.concat(bytecodes, ',')..'}')
+end
+
+-- restores the spaces hashed while the format was made (see above)
+function gregoriotex.restore_hashed_spaces(spaces)
+  for name, value in pairs(spaces) do
+    hashed_spaces[name] = value
+  end
+  -- hashing one of them again computes the hash of them all
+  local name = next(spaces)
+  if name then
+    hash_spaces(name, spaces[name])
+  end
+end
+
+-- runs one of the other Lua files of GregorioTeX, which a format made with
+-- gregoriotex.ini keeps compiled (see gregoriotex-main.tex)
+function gregoriotex.run_lua_file(name)
+  local preloaded = gregoriotex_preloaded and gregoriotex_preloaded[name]
+  if preloaded then
+    preloaded()
+  else
+    dofile(kpse.find_file(name..'.lua', 'lua'))
+  end
+end
+
+gregoriotex.run_lua_file('gregoriotex-nabc')
+gregoriotex.run_lua_file('gregoriotex-symbols')